@@ -0,0 +1,65 @@
+#include "atommodel.h"
+#include "parallel.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <string>
+#include <vector>
+
+
+// Run job several times and return the best time in milliseconds
+static double measure(int repeat, const std::function<void()> &job)
+{
+    double best = 0;
+    for (int i=0; i<repeat; i++) {
+        auto start = std::chrono::steady_clock::now();
+        job();
+        double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        if (i == 0 || ms < best)
+            best = ms;
+    }
+    return best;
+}
+
+
+// Benchmarks of render kernels: simulatom-bench [--threads N] [--size N] [--repeat N]
+int main(int argc, char *argv[])
+{
+    int size = 512, repeat = 3;
+    for (int i=1; i+1<argc; i+=2) {
+        if (strcmp(argv[i], "--threads") == 0)
+            TileScheduler::setThreadCount(atoi(argv[i+1]));
+        else if (strcmp(argv[i], "--size") == 0)
+            size = atoi(argv[i+1]);
+        else if (strcmp(argv[i], "--repeat") == 0)
+            repeat = atoi(argv[i+1]);
+    }
+    if (size < 16 || repeat < 1) {
+        fprintf(stderr, "usage: %s [--threads N] [--size N] [--repeat N]\n", argv[0]);
+        return 1;
+    }
+
+// States of growing radius and angular complexity
+    const int states[][3] = {{1, 0, 0}, {3, 2, 1}, {5, 3, 2}, {8, 5, 3}};
+    std::vector<long double> p((size_t)size * size);
+    printf("threads: %d, image: %dx%d, best of %d\n", TileScheduler::threadCount(), size, size, repeat);
+    printf("%-8s %10s %10s %10s %10s %10s\n", "state", "graphic", "2D", "3D slice", "volume", "grid 64^3");
+    for (auto &s : states) {
+        AtomModel model;
+        model.set_n(s[0]);
+        model.set_l(s[1]);
+        model.set_m(s[2]);
+        std::vector<float> grid(64 * 64 * 64);
+        double graphic = measure(repeat, [&]() { model.modelGraphic(p.data(), size); });
+        double model_2d = measure(repeat, [&]() { model.model2D(p.data(), size, size); });
+        double model_3d = measure(repeat, [&]() { model.model3D(p.data(), size, size, 0, 0, 0.5l, 0.3l); });
+        double volume = measure(repeat, [&]() { model.modelVolume(p.data(), size, size, 0, 0, 0.5l, 0.3l); });
+        double sampled = measure(repeat, [&]() { model.modelGrid(grid.data(), 64, model.densityCutoffRadius()); });
+        std::string name = model.getState() + " m=" + std::to_string(s[2]);
+        printf("%-8s %8.2fms %8.2fms %8.2fms %8.2fms %8.2fms\n", name.c_str(), graphic, model_2d, model_3d, volume, sampled);
+    }
+    return 0;
+}
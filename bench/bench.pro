@@ -0,0 +1,11 @@
+# Benchmarks of render kernels: simulatom-bench [--threads N] [--size N] [--repeat N]
+TEMPLATE = app
+TARGET = simulatom-bench
+
+CONFIG += c++11 console thread
+CONFIG -= qt app_bundle
+
+include(../core/core.pri)
+
+SOURCES += \
+    bench.cpp
@@ -0,0 +1,144 @@
+#include "commands.h"
+#include "camerapath.h"
+#include "encodepipeline.h"
+#include "parallel.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <mutex>
+#include <thread>
+
+
+// Render animation: simulatom-cli animate --path FILE [--fps N] [options] -o FRAME%05d.png|FRAME%05d.qoi|FILE.y4m|-
+int animate_command(int argc, char *argv[])
+{
+    Options o;
+    View3DMode mode;
+    if (!parse_options(argc, argv, 2, o) || o.path.empty() || o.fps < 1 || !view_mode(o.view, mode)) {
+        usage(argv[0]);
+        return 1;
+    }
+
+// Standard output gets Y4M stream, other names are patterns of frame files
+    bool stream = (o.output == "-" || o.format == "y4m");
+    ImageFormat format;
+    if (!stream && (!image_format(o, format) || o.output.find('%') == std::string::npos)) {
+        fprintf(stderr, "output is a pattern of png or qoi frames (e.g. frame%%05d.png), y4m file or -\n");
+        return 1;
+    }
+    CameraPath path;
+    if (!path.load(o.path)) {
+        fprintf(stderr, "failed to read camera path %s\n", o.path.c_str());
+        return 1;
+    }
+    TileScheduler::setThreadCount(o.threads);
+    AtomModel model;
+    if (!setup_model(o, model)) {
+        fprintf(stderr, "invalid state or settings\n");
+        return 1;
+    }
+
+// Slices and volumes sample voxel volume of state, so the volume is computed once per state
+    if (o.voxels == 0)
+        model.setVolumeCache(true, (size_t)64 << 20);
+
+// Y4M frames are converted and written in order by writer thread, frame files by encoder pipeline
+    FILE *file = nullptr;
+    bool written = true;
+    BoundedQueue<std::vector<unsigned int>> frames(2 * TileScheduler::threadCount());
+    std::thread writer;
+    std::unique_ptr<EncodePipeline> pipeline;
+    if (stream) {
+        file = ImageWriter::openFile(o.output);
+        if (file == nullptr) {
+            fprintf(stderr, "failed to write %s\n", o.output.c_str());
+            return 1;
+        }
+        std::string header = ImageWriter::y4mHeader(o.width, o.height, o.fps);
+        written = fwrite(header.data(), 1, header.size(), file) == header.size();
+        writer = std::thread([&]() {
+            TileScheduler::setInline(true);
+            std::vector<unsigned int> image;
+            std::vector<unsigned char> frame;
+            while (frames.pop(image)) {
+                ImageWriter::encodeY4MFrame(image.data(), o.width, o.height, frame);
+                written = written && fwrite(frame.data(), 1, frame.size(), file) == frame.size();
+            }
+        });
+    } else {
+        pipeline.reset(new EncodePipeline(o.encoders));
+    }
+    int count = path.frameCount(), failed = 0;
+    std::mutex failed_mutex;
+    auto emit = [&](int frame, std::vector<unsigned int> &image) {
+        if (stream) {
+            frames.push(std::move(image));
+            return;
+        }
+        char name[4096];
+        snprintf(name, sizeof(name), o.output.c_str(), frame);
+        std::string file_name = name;
+        EncodeJob job = {std::move(image), o.width, o.height, format, file_name, [&, file_name](bool ok) {
+            std::lock_guard<std::mutex> lock(failed_mutex);
+            if (!ok) {
+                failed++;
+                fprintf(stderr, "\nfailed to write %s\n", file_name.c_str());
+            }
+        }};
+        pipeline->submit(std::move(job));
+    };
+
+// Frame is rendered by the calling thread, or by all workers when it is the only one
+    FrameRenderer renderer;
+    auto render = [&](int frame, std::vector<unsigned int> &image) {
+        View3D view = o.view_3d;
+        view.mode = mode;
+        path.camera(frame, view);
+        FrameJob job = renderer.job3D(model, o.width, o.height, view);
+        std::vector<long double> p(job.size);
+        job.compute(model, p.data());
+        frame_image(o, model, o.view, p, image);
+    };
+
+// Frames of one state share its tables, volume and meshes. The first frame of every state builds them
+// using all workers, then frames are rendered in parallel by windows and passed on in order
+    int window = 2 * TileScheduler::threadCount();
+    for (int first=0; first<count; ) {
+        QuantumState state = path.state(first, QuantumState(o.n, o.l, o.m));
+        int last = first + 1;
+        while (last < count && path.state(last, QuantumState(o.n, o.l, o.m)) == state)
+            last++;
+        model.set_n(state.n);
+        model.set_l(state.l);
+        model.set_m(state.m);
+
+        std::vector<unsigned int> image;
+        render(first, image);
+        emit(first, image);
+        fprintf(stderr, "\r%d / %d", first + 1, count);
+        for (int start=first+1; start<last; start+=window) {
+            int size = std::min(window, last - start);
+            std::vector<std::vector<unsigned int>> images(size);
+            TileScheduler::forEach(size, [&](int index, int) {
+                render(start + index, images[index]);
+            });
+            for (int i=0; i<size; i++)
+                emit(start + i, images[i]);
+            fprintf(stderr, "\r%d / %d", start + size, count);
+        }
+        first = last;
+    }
+    fprintf(stderr, "\n");
+
+    if (stream) {
+        frames.close();
+        writer.join();
+        if (!ImageWriter::closeFile(file, written)) {
+            fprintf(stderr, "failed to write %s\n", o.output.c_str());
+            return 1;
+        }
+        return 0;
+    }
+    pipeline->finish();
+    return failed ? 1 : 0;
+}
@@ -0,0 +1,21 @@
+# Headless renderer of models: simulatom-cli [options] -o FILE
+TEMPLATE = app
+TARGET = simulatom-cli
+
+CONFIG += c++11 console thread
+CONFIG -= qt app_bundle
+
+include(../core/core.pri)
+
+SOURCES += \
+    animate.cpp \
+    gallery.cpp \
+    main.cpp \
+    mesh.cpp \
+    options.cpp \
+    profile.cpp \
+    serve.cpp \
+    volume.cpp
+
+HEADERS += \
+    commands.h
@@ -0,0 +1,89 @@
+#ifndef COMMANDS_H
+#define COMMANDS_H
+
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "atommodel.h"
+#include "framerenderer.h"
+#include "imagewriter.h"
+
+
+// Options of rendered models
+struct Options {
+    std::string view, output, format, atlas;
+    int n, l, m;
+    bool density, tiled;
+    int width, height, points;
+    View3D view_3d;
+    long double zoom, center_x, center_y;
+    ToneMap tone_map;
+    long double opacity;
+    int voxels;
+    bool tricubic, octree;
+    int shared_cache, threads;
+// Gallery: maximum main quantum number, output directory and encoder threads (0 - half of workers)
+    int n_max;
+    std::string directory;
+    int encoders;
+// Animation: file of camera path and frame rate
+    std::string path;
+    int fps;
+// Volume and mesh export: grid size, radius in Bohr radii (0 - cutoff radius of state) and sample type
+    int grid;
+    double radius;
+    std::string sample;
+// Radial profile: tolerance of adaptive sampling (0 - evenly spaced points)
+    double tolerance;
+// Render daemon: socket path
+    std::string socket;
+
+    Options();
+};
+
+
+// Print usage of all commands
+void usage(const char *name);
+
+// Parse options starting from given argument, false on unknown or malformed option
+bool parse_options(int argc, char *argv[], int first, Options &o);
+
+// Create directory, existing directory is fine
+bool make_directory(const std::string &path);
+
+// Apply options to model, false if the state or settings are invalid
+bool setup_model(const Options &o, AtomModel &model);
+
+// Get mode of 3D view (slice, volume, isosurface, cloud), false for other views
+bool view_mode(const std::string &view, View3DMode &mode);
+
+// Get job of view (graphic, 2d, slice, volume, isosurface, cloud), nullptr for unknown view
+std::shared_ptr<FrameJob> make_job(const Options &o, FrameRenderer &renderer, const AtomModel &model, const std::string &view);
+
+// Check if format of options is one of frame formats: PNG, QOI, raw floats, CSV
+bool frame_format(const Options &o);
+
+// Check if format of options is an image format (PNG, QOI) and get it
+bool image_format(const Options &o, ImageFormat &format);
+
+// Color computed model of view to width x height image, graphic is drawn as filled plot
+void frame_image(const Options &o, AtomModel &model, const std::string &view, const std::vector<long double> &p, std::vector<unsigned int> &image);
+
+// Write computed model of view in format of options: PNG, raw floats or CSV (graphic only)
+bool write_frame(const Options &o, AtomModel &model, const std::string &view, const std::vector<long double> &p, const std::string &path);
+
+// Commands: render one model, render gallery of states, export volume and isosurface, render animation,
+// sample radial profile, run render daemon and request frame from it
+int render_command(int argc, char *argv[]);
+int gallery_command(int argc, char *argv[]);
+int volume_command(int argc, char *argv[]);
+int mesh_command(int argc, char *argv[]);
+int animate_command(int argc, char *argv[]);
+int profile_command(int argc, char *argv[]);
+int serve_command(int argc, char *argv[]);
+int request_command(int argc, char *argv[]);
+
+
+#endif // COMMANDS_H
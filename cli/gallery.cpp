@@ -0,0 +1,135 @@
+#include "commands.h"
+#include "encodepipeline.h"
+#include "galleryplan.h"
+#include "parallel.h"
+
+#include <cstdio>
+#include <mutex>
+
+
+// Check if file exists
+static bool file_exists(const std::string &path)
+{
+    FILE *file = fopen(path.c_str(), "rb");
+    if (file == nullptr)
+        return false;
+    fclose(file);
+    return true;
+}
+
+
+// Split list separated by commas
+static std::vector<std::string> split(const std::string &text)
+{
+    std::vector<std::string> items;
+    size_t start = 0;
+    while (start <= text.size()) {
+        size_t end = text.find(',', start);
+        if (end == std::string::npos)
+            end = text.size();
+        if (end > start)
+            items.push_back(text.substr(start, end - start));
+        start = end + 1;
+    }
+    return items;
+}
+
+
+// Render gallery: simulatom-cli gallery --n-max N --dir DIR [--view VIEW,...] [options]
+int gallery_command(int argc, char *argv[])
+{
+    Options o;
+    o.view = "2d,slice";
+    if (!parse_options(argc, argv, 2, o) || !frame_format(o) || o.n_max < 1 || o.directory.empty()) {
+        usage(argv[0]);
+        return 1;
+    }
+    if (o.n_max > AtomModel::MAX_N) {
+        fprintf(stderr, "n-max must be from 1 to %d\n", AtomModel::MAX_N);
+        return 1;
+    }
+    std::vector<std::string> views = split(o.view);
+    FrameRenderer check_renderer;
+    AtomModel check_model;
+    if (!setup_model(o, check_model)) {
+        fprintf(stderr, "invalid settings\n");
+        return 1;
+    }
+    for (auto &view : views)
+        if (!make_job(o, check_renderer, check_model, view) || (o.format == "csv" && view != "graphic")) {
+            fprintf(stderr, "view %s can't be written as %s\n", view.c_str(), o.format.c_str());
+            return 1;
+        }
+    if (!make_directory(o.directory)) {
+        fprintf(stderr, "failed to create directory %s\n", o.directory.c_str());
+        return 1;
+    }
+
+// Models which are already on disk are skipped, so interrupted gallery is resumed
+    std::vector<GalleryItem> items = GalleryPlan::items(o.n_max, views, o.format);
+    auto on_disk = [&](const GalleryItem &item) {
+        return file_exists(o.directory + "/" + item.file);
+    };
+    std::vector<const GalleryItem *> pending = GalleryPlan::schedule(items, on_disk);
+    fprintf(stderr, "%d models, %d on disk\n", (int)items.size(), (int)(items.size() - pending.size()));
+
+// Every worker renders its own state with its own model, models of one state are not split.
+// Images are encoded and written by encoder threads while workers render next ones
+    TileScheduler::setThreadCount(o.threads);
+    std::vector<std::unique_ptr<AtomModel>> models(TileScheduler::threadCount());
+    std::vector<std::unique_ptr<FrameRenderer>> renderers(models.size());
+    ImageFormat format;
+    bool encode = image_format(o, format);
+    EncodePipeline pipeline(encode ? o.encoders : 1);
+    std::mutex progress_mutex;
+    int done = 0, failed = 0;
+
+// File appears under its name only when it is complete
+    auto finish = [&](const std::string &path, bool written) {
+        bool ok = written && rename((path + ".part").c_str(), path.c_str()) == 0;
+        std::lock_guard<std::mutex> lock(progress_mutex);
+        done++;
+        if (!ok) {
+            failed++;
+            fprintf(stderr, "\nfailed to write %s\n", path.c_str());
+        }
+        fprintf(stderr, "\r%d / %d", done, (int)pending.size());
+    };
+    TileScheduler::forEach(pending.size(), [&](int index, int worker) {
+        const GalleryItem &item = *pending[index];
+        if (!models[worker]) {
+            models[worker].reset(new AtomModel());
+            renderers[worker].reset(new FrameRenderer());
+            setup_model(o, *models[worker]);
+        }
+        AtomModel &model = *models[worker];
+        model.set_n(item.n);
+        model.set_l(item.l);
+        model.set_m(item.m);
+        model.setProbabilityDensityStatus(item.density);
+        std::shared_ptr<FrameJob> job = make_job(o, *renderers[worker], model, item.view);
+        std::vector<long double> p(job->size);
+        job->compute(model, p.data());
+        std::string path = o.directory + "/" + item.file;
+        if (!encode) {
+            finish(path, write_frame(o, model, item.view, p, path + ".part"));
+            return;
+        }
+        EncodeJob image = {std::vector<unsigned int>(), o.width, o.height, format, path + ".part", [=, &finish](bool written) {
+            finish(path, written);
+        }};
+        frame_image(o, model, item.view, p, image.pixels);
+        pipeline.submit(std::move(image));
+    });
+    pipeline.finish();
+    if (!pending.empty())
+        fprintf(stderr, "\n");
+
+// Manifest lists all models of gallery on disk
+    std::string manifest = GalleryPlan::manifest(items, on_disk);
+    if (!ImageWriter::writeFile(o.directory + "/index.csv", manifest.data(), manifest.size())) {
+        fprintf(stderr, "failed to write manifest\n");
+        return 1;
+    }
+    return failed ? 1 : 0;
+}
@@ -0,0 +1,88 @@
+#include "commands.h"
+#include "parallel.h"
+#include "tiledrenderer.h"
+
+#include <cstdio>
+#include <cstring>
+
+
+// Render model larger than memory to memory-mapped raw or TIFF file by bands of tiles
+static int render_tiled(const Options &o, AtomModel &model)
+{
+    if ((o.view != "2d" && o.view != "slice") || (o.format != "raw" && o.format != "tif") || o.output == "-") {
+        fprintf(stderr, "tiled render writes 2d or slice to raw or tif file\n");
+        return 1;
+    }
+    TiledRenderer renderer = (o.view == "2d") ? TiledRenderer(model, o.width, o.height) : TiledRenderer(model, o.width, o.height, o.view_3d);
+    auto progress = [](int done, int total) {
+        fprintf(stderr, "\r%d / %d", done, total);
+    };
+    bool ok;
+    if (o.format == "raw") {
+        ok = renderer.writeRaw(o.output, progress);
+    } else {
+        std::vector<unsigned int> colors_2d(FrameRenderer::COLOR_TABLE_SIZE), colors_3d(FrameRenderer::COLOR_TABLE_SIZE);
+        FrameRenderer::buildColorTables(model.getToneMap(), colors_2d.data(), colors_3d.data());
+        ok = renderer.writeTIFF(o.output, (o.view == "2d") ? colors_2d.data() : colors_3d.data(), progress);
+    }
+    fprintf(stderr, "\n");
+    if (!ok) {
+        fprintf(stderr, "failed to write %s\n", o.output.c_str());
+        return 1;
+    }
+    return 0;
+}
+
+
+// Render one model: simulatom-cli [options] -o FILE
+int render_command(int argc, char *argv[])
+{
+    Options o;
+    if (argc < 2 || !parse_options(argc, argv, 1, o) || (!o.tiled && !frame_format(o))) {
+        usage(argv[0]);
+        return 1;
+    }
+    TileScheduler::setThreadCount(o.threads);
+    AtomModel model;
+    if (!setup_model(o, model)) {
+        fprintf(stderr, "invalid state or settings\n");
+        return 1;
+    }
+    if (o.tiled)
+        return render_tiled(o, model);
+
+// Jobs are the same as ones of the window
+    FrameRenderer renderer;
+    std::shared_ptr<FrameJob> job = make_job(o, renderer, model, o.view);
+    if (!job) {
+        usage(argv[0]);
+        return 1;
+    }
+    std::vector<long double> p(job->size);
+    job->compute(model, p.data());
+    if (!write_frame(o, model, o.view, p, o.output)) {
+        fprintf(stderr, "failed to write %s\n", o.output.c_str());
+        return 1;
+    }
+    return 0;
+}
+
+
+int main(int argc, char *argv[])
+{
+    if (argc > 1 && strcmp(argv[1], "gallery") == 0)
+        return gallery_command(argc, argv);
+    if (argc > 1 && strcmp(argv[1], "volume") == 0)
+        return volume_command(argc, argv);
+    if (argc > 1 && strcmp(argv[1], "mesh") == 0)
+        return mesh_command(argc, argv);
+    if (argc > 1 && strcmp(argv[1], "animate") == 0)
+        return animate_command(argc, argv);
+    if (argc > 1 && strcmp(argv[1], "profile") == 0)
+        return profile_command(argc, argv);
+    if (argc > 1 && strcmp(argv[1], "serve") == 0)
+        return serve_command(argc, argv);
+    if (argc > 1 && strcmp(argv[1], "request") == 0)
+        return request_command(argc, argv);
+    return render_command(argc, argv);
+}
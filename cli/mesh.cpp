@@ -0,0 +1,40 @@
+#include "commands.h"
+#include "imagewriter.h"
+#include "meshwriter.h"
+#include "parallel.h"
+
+#include <cstdio>
+
+
+// Export isosurface: simulatom-cli mesh [--grid N] [--iso-probability P | --iso-level P] [options] -o FILE.ply|vtp
+int mesh_command(int argc, char *argv[])
+{
+    Options o;
+    if (!parse_options(argc, argv, 2, o) || o.grid < 2 || o.grid > IsoSurface::MAX_GRID_SIZE) {
+        usage(argv[0]);
+        return 1;
+    }
+
+// Files of other extensions are PLY
+    bool vtp = (o.format == "vtp");
+    if (!vtp && o.format != "ply" && o.format != "png") {
+        fprintf(stderr, "isosurface can be written as ply or vtp\n");
+        return 1;
+    }
+    TileScheduler::setThreadCount(o.threads);
+    AtomModel model;
+    if (!setup_model(o, model)) {
+        fprintf(stderr, "invalid state or settings\n");
+        return 1;
+    }
+
+// Isosurface is extracted from grid over the cutoff sphere of state
+    std::shared_ptr<const Mesh> mesh = IsoSurface::extract(model, o.view_3d.level, o.grid);
+    fprintf(stderr, "%d triangles\n", mesh->triangleCount());
+    FILE *file = ImageWriter::openFile(o.output);
+    if (file == nullptr || !ImageWriter::closeFile(file, vtp ? MeshWriter::writeVTP(file, *mesh) : MeshWriter::writePLY(file, *mesh))) {
+        fprintf(stderr, "failed to write %s\n", o.output.c_str());
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,382 @@
+#include "commands.h"
+#include "imagewriter.h"
+#include "parallel.h"
+#include "renderprotocol.h"
+#include "sharedcache.h"
+#include "stateatlas.h"
+
+#include <cerrno>
+#include <climits>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <sys/stat.h>
+
+#ifdef _WIN32
+#include <direct.h>
+#endif
+
+
+Options::Options() :
+    view("slice"),
+    output("-"),
+    n(1),
+    l(0),
+    m(0),
+    density(false),
+    tiled(false),
+    width(512),
+    height(512),
+    points(FrameRenderer::GRAPHIC_POINTS),
+    zoom(1),
+    center_x(0),
+    center_y(0),
+    opacity(4),
+    voxels(0),
+    tricubic(false),
+    octree(false),
+    shared_cache(0),
+    threads(0),
+    n_max(0),
+    encoders(0),
+    fps(30),
+    grid(256),
+    radius(0),
+    sample("float32"),
+    tolerance(0),
+    socket(RenderProtocol::DEFAULT_SOCKET) {
+}
+
+
+void usage(const char *name)
+{
+    fprintf(stderr,
+            "usage: %s [options] -o FILE\n"
+            "       %s gallery --n-max N --dir DIR [--view VIEW,...] [options]\n"
+            "       %s volume --grid N [--radius R] [--type float32|float16] [options] -o FILE.raw|vti|nrrd\n"
+            "       %s mesh [--grid N] [--iso-probability P | --iso-level P] [options] -o FILE.ply|vtp\n"
+            "       %s animate --path FILE [--fps N] [options] -o FRAME%%05d.png|FRAME%%05d.qoi|FILE.y4m|-\n"
+            "       %s profile [--points N | --tolerance T] [--radius R] [options] -o FILE.csv|FILE.raw|-\n"
+            "       %s profile --n-max N --dir DIR [--format csv|raw] [--points N | --tolerance T] [--radius R]\n"
+            "       %s serve [--socket PATH] [options]\n"
+            "       %s request [--socket PATH] [options] -o FILE.png|qoi|raw\n"
+            "  --view graphic|2d|slice|volume|isosurface|cloud   model (slice)\n"
+            "  --n N --l L --m M                                  quantum numbers, n <= 10 (1 0 0)\n"
+            "  --density                                          probability density instead of probability\n"
+            "  --size WIDTHxHEIGHT                                image size (512x512)\n"
+            "  --points N                                         points of graphic (1000)\n"
+            "  --camera MOV_X,MOV_Y,ROT_X,ROT_Y --zoom Z          view of 3D model\n"
+            "  --center X,Y --zoom Z                              view of 2D model\n"
+            "  --tone linear|log|gamma --gamma G --decades D --clip PERCENT\n"
+            "  --iso-probability PERCENT | --iso-level PERCENT    isosurface level\n"
+            "  --opacity K                                        opacity of volume\n"
+            "  --voxels MB [--tricubic] [--octree]                voxel volume of 3D models\n"
+            "  --atlas FILE --shared-cache MB --threads N\n"
+            "  --format FORMAT                                    png|qoi|raw|csv, raw|vti|nrrd, ply|vtp (by extension)\n"
+            "  --tiled                                            render 2d or slice of any size to raw or tiled TIFF file\n"
+            "  -o FILE                                            output file, - is standard output\n"
+            "  --n-max N --dir DIR --encoders N                   states of gallery, its directory, encoder threads\n"
+            "  --grid N --radius R --type float32|float16         volume grid (2..2048, mesh 2..1024), its radius in Bohr radii, samples\n"
+            "  --path FILE --fps N                                keyframes of camera path, frame rate of Y4M (30)\n"
+            "  --points N | --tolerance T                         radial profile points (1000000) or adaptive tolerance\n"
+            "  --socket PATH                                      socket of render daemon (/tmp/simulatom.sock)\n",
+            name, name, name, name, name, name, name, name, name);
+}
+
+
+// Parse list of numbers separated by commas or 'x'
+static int parse_list(const char *text, long double *values, int count)
+{
+    int parsed = 0;
+    char *end;
+    while (parsed < count) {
+        values[parsed] = strtold(text, &end);
+        if (end == text)
+            break;
+        parsed++;
+        if (*end != ',' && *end != 'x')
+            break;
+        text = end + 1;
+    }
+    return parsed;
+}
+
+
+// Parse whole text as integer in int range
+static bool parse_int(const char *text, int &value)
+{
+    char *end;
+    errno = 0;
+    long parsed = strtol(text, &end, 10);
+    if (end == text || *end != 0 || errno != 0 || parsed < INT_MIN || parsed > INT_MAX)
+        return false;
+    value = (int)parsed;
+    return true;
+}
+
+
+// Parse options starting from given argument, false on unknown or malformed option
+bool parse_options(int argc, char *argv[], int first, Options &o)
+{
+    for (int i=first; i<argc; i++) {
+        const char *opt = argv[i];
+        if (strcmp(opt, "--density") == 0) {
+            o.density = true;
+            continue;
+        }
+        if (strcmp(opt, "--tiled") == 0) {
+            o.tiled = true;
+            continue;
+        }
+        if (strcmp(opt, "--tricubic") == 0) {
+            o.tricubic = true;
+            continue;
+        }
+        if (strcmp(opt, "--octree") == 0) {
+            o.octree = true;
+            continue;
+        }
+        if (i + 1 >= argc)
+            return false;
+        const char *arg = argv[++i];
+        long double v[4];
+        if (strcmp(opt, "--view") == 0) {
+            o.view = arg;
+        } else if (strcmp(opt, "-o") == 0) {
+            o.output = arg;
+        } else if (strcmp(opt, "--format") == 0) {
+            o.format = arg;
+        } else if (strcmp(opt, "--n") == 0) {
+            o.n = atoi(arg);
+        } else if (strcmp(opt, "--l") == 0) {
+            o.l = atoi(arg);
+        } else if (strcmp(opt, "--m") == 0) {
+            o.m = atoi(arg);
+        } else if (strcmp(opt, "--size") == 0) {
+            if (parse_list(arg, v, 2) != 2)
+                return false;
+            o.width = v[0];
+            o.height = v[1];
+        } else if (strcmp(opt, "--points") == 0) {
+            o.points = atoi(arg);
+        } else if (strcmp(opt, "--camera") == 0) {
+            if (parse_list(arg, v, 4) != 4)
+                return false;
+            o.view_3d.mov_x = v[0];
+            o.view_3d.mov_y = v[1];
+            o.view_3d.rot_x = v[2];
+            o.view_3d.rot_y = v[3];
+        } else if (strcmp(opt, "--center") == 0) {
+            if (parse_list(arg, v, 2) != 2)
+                return false;
+            o.center_x = v[0];
+            o.center_y = v[1];
+        } else if (strcmp(opt, "--zoom") == 0) {
+            o.zoom = o.view_3d.zoom = strtold(arg, nullptr);
+        } else if (strcmp(opt, "--tone") == 0) {
+            if (strcmp(arg, "linear") == 0)
+                o.tone_map.setCurve(TONE_LINEAR);
+            else if (strcmp(arg, "log") == 0)
+                o.tone_map.setCurve(TONE_LOG);
+            else if (strcmp(arg, "gamma") == 0)
+                o.tone_map.setCurve(TONE_GAMMA);
+            else
+                return false;
+        } else if (strcmp(opt, "--gamma") == 0) {
+            if (!o.tone_map.setGamma(strtold(arg, nullptr)))
+                return false;
+        } else if (strcmp(opt, "--decades") == 0) {
+            if (!o.tone_map.setDecades(strtold(arg, nullptr)))
+                return false;
+        } else if (strcmp(opt, "--clip") == 0) {
+            if (!o.tone_map.setClipPercentile(strtold(arg, nullptr)))
+                return false;
+        } else if (strcmp(opt, "--iso-probability") == 0) {
+            o.view_3d.level = IsoLevel(true, strtod(arg, nullptr) / 100);
+        } else if (strcmp(opt, "--iso-level") == 0) {
+            o.view_3d.level = IsoLevel(false, strtod(arg, nullptr) / 100);
+        } else if (strcmp(opt, "--opacity") == 0) {
+            o.opacity = strtold(arg, nullptr);
+        } else if (strcmp(opt, "--voxels") == 0) {
+            o.voxels = atoi(arg);
+        } else if (strcmp(opt, "--atlas") == 0) {
+            o.atlas = arg;
+        } else if (strcmp(opt, "--shared-cache") == 0) {
+            o.shared_cache = atoi(arg);
+        } else if (strcmp(opt, "--threads") == 0) {
+            o.threads = atoi(arg);
+        } else if (strcmp(opt, "--n-max") == 0) {
+            o.n_max = atoi(arg);
+        } else if (strcmp(opt, "--dir") == 0) {
+            o.directory = arg;
+        } else if (strcmp(opt, "--encoders") == 0) {
+            o.encoders = atoi(arg);
+        } else if (strcmp(opt, "--path") == 0) {
+            o.path = arg;
+        } else if (strcmp(opt, "--fps") == 0) {
+            o.fps = atoi(arg);
+        } else if (strcmp(opt, "--grid") == 0) {
+            if (!parse_int(arg, o.grid))
+                return false;
+        } else if (strcmp(opt, "--radius") == 0) {
+            o.radius = strtod(arg, nullptr);
+        } else if (strcmp(opt, "--type") == 0) {
+            o.sample = arg;
+        } else if (strcmp(opt, "--tolerance") == 0) {
+            o.tolerance = strtod(arg, nullptr);
+        } else if (strcmp(opt, "--socket") == 0) {
+            o.socket = arg;
+        } else {
+            return false;
+        }
+    }
+
+// Format is taken from extension of output file
+    if (o.format.empty()) {
+        size_t dot = o.output.rfind('.');
+        std::string ext = (dot == std::string::npos) ? "" : o.output.substr(dot + 1);
+        if (ext == "tiff")
+            ext = "tif";
+        o.format = (ext == "raw" || ext == "csv" || ext == "qoi" || ext == "tif" || ext == "y4m" || ext == "vti" || ext == "nrrd" || ext == "ply" || ext == "vtp") ? ext : "png";
+    }
+    return o.width > 0 && o.height > 0 && o.points > 1;
+}
+
+
+// Create directory, existing directory is fine
+bool make_directory(const std::string &path)
+{
+#ifdef _WIN32
+    _mkdir(path.c_str());
+#else
+    mkdir(path.c_str(), 0755);
+#endif
+    struct stat info;
+    return stat(path.c_str(), &info) == 0 && (info.st_mode & S_IFDIR);
+}
+
+
+// Apply options to model, false if the state or settings are invalid
+bool setup_model(const Options &o, AtomModel &model)
+{
+    if (!model.set_n(o.n) || !model.set_l(o.l) || !model.set_m(o.m))
+        return false;
+    model.setProbabilityDensityStatus(o.density);
+    model.setToneMap(o.tone_map);
+    if (!model.setVolumeOpacity(o.opacity))
+        return false;
+    if (o.voxels > 0)
+        model.setVolumeCache(true, (size_t)o.voxels << 20);
+    model.setVolumeTricubic(o.tricubic);
+    model.setVolumeOctree(o.octree);
+    if (!o.atlas.empty()) {
+        std::shared_ptr<StateAtlas> atlas(new StateAtlas());
+        if (!atlas->open(o.atlas)) {
+            fprintf(stderr, "failed to open atlas %s\n", o.atlas.c_str());
+            return false;
+        }
+        model.setAtlas(atlas);
+    }
+    if (o.shared_cache > 0) {
+        std::shared_ptr<SharedCache> cache(new SharedCache());
+        if (cache->open(SharedCache::defaultName(), (size_t)o.shared_cache << 20))
+            model.setSharedCache(cache);
+        else
+            fprintf(stderr, "shared cache is not available: %s\n", cache->getError().c_str());
+    }
+    return true;
+}
+
+
+// Write graphic as CSV
+static bool write_csv(AtomModel &model, const std::vector<long double> &p, const std::string &path)
+{
+    std::string text = model.isProbabilityDensity() ? "rho,density\n" : "rho,probability\n";
+    char line[64];
+    for (size_t i=0; i<p.size(); i++) {
+        snprintf(line, sizeof(line), "%.6Lf,%.9Lf\n", model.maxRelativeRadius() * i / p.size(), p[i]);
+        text += line;
+    }
+    return ImageWriter::writeFile(path, text.data(), text.size());
+}
+
+
+// Get mode of 3D view
+bool view_mode(const std::string &view, View3DMode &mode)
+{
+    static const char *modes[] = {"slice", "volume", "isosurface", "cloud"};
+    for (int i=0; i<4; i++)
+        if (view == modes[i]) {
+            mode = (View3DMode)i;
+            return true;
+        }
+    return false;
+}
+
+
+// Get job of view
+std::shared_ptr<FrameJob> make_job(const Options &o, FrameRenderer &renderer, const AtomModel &model, const std::string &view)
+{
+    if (view == "graphic")
+        return std::make_shared<FrameJob>(renderer.graphicJob(model, o.points));
+    if (view == "2d")
+        return std::make_shared<FrameJob>(renderer.job2D(model, o.width, o.height, o.zoom, o.center_x, o.center_y));
+    View3D view_3d = o.view_3d;
+    if (view_mode(view, view_3d.mode))
+        return std::make_shared<FrameJob>(renderer.job3D(model, o.width, o.height, view_3d));
+    return nullptr;
+}
+
+
+// Check if format of options is one of frame formats
+bool frame_format(const Options &o)
+{
+    return o.format == "png" || o.format == "qoi" || o.format == "raw" || o.format == "csv";
+}
+
+
+// Check if format of options is an image format
+bool image_format(const Options &o, ImageFormat &format)
+{
+    format = (o.format == "qoi") ? IMAGE_QOI : IMAGE_PNG;
+    return o.format == "png" || o.format == "qoi";
+}
+
+
+// Color computed model of view
+void frame_image(const Options &o, AtomModel &model, const std::string &view, const std::vector<long double> &p, std::vector<unsigned int> &image)
+{
+    std::vector<unsigned int> colors_2d(FrameRenderer::COLOR_TABLE_SIZE), colors_3d(FrameRenderer::COLOR_TABLE_SIZE);
+    if (view != "graphic") {
+        FrameRenderer::buildColorTables(model.getToneMap(), colors_2d.data(), colors_3d.data());
+        image.resize(p.size());
+        FrameRenderer::colorize(p.data(), p.size(), (view == "2d") ? colors_2d.data() : colors_3d.data(), image.data());
+        return;
+    }
+
+// Area under the graphic has color of maximum value of 2D model
+    FrameRenderer::buildColorTables(ToneMap(), colors_2d.data(), colors_3d.data());
+    image.assign((size_t)o.width * o.height, 0xFF000000);
+    for (int x=0; x<o.width; x++) {
+        long double v = p[(size_t)x * p.size() / o.width];
+        int top = o.height - (int)(v * (o.height - 1)) - 1;
+        for (int y=(top < 0 ? 0 : top); y<o.height; y++)
+            image[(size_t)y * o.width + x] = 0xFF000000 | colors_2d.back();
+    }
+}
+
+
+// Write computed model of view in format of options
+bool write_frame(const Options &o, AtomModel &model, const std::string &view, const std::vector<long double> &p, const std::string &path)
+{
+    if (o.format == "raw")
+        return ImageWriter::writeRaw(path, p.data(), p.size());
+    if (o.format == "csv")
+        return view == "graphic" && write_csv(model, p, path);
+    ImageFormat format;
+    if (!image_format(o, format))
+        return false;
+    std::vector<unsigned int> image;
+    frame_image(o, model, view, p, image);
+    return ImageWriter::writeImage(path, format, image.data(), o.width, o.height);
+}
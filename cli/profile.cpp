@@ -0,0 +1,159 @@
+#include "commands.h"
+#include "imagewriter.h"
+#include "parallel.h"
+#include "radialprofile.h"
+
+#include <cstdio>
+
+
+// Summary of sampled state as JSON
+static std::string summary_json(int n, int l, const RadialProfile &profile, const RadialSummary &summary,
+                                const std::string &data_file, const std::string &format)
+{
+    char text[1024];
+    snprintf(text, sizeof(text),
+             "{\n"
+             "  \"data\": \"%s\",\n"
+             "  \"format\": \"%s\",\n"
+             "  \"type\": \"float64\",\n"
+             "  \"endian\": \"%s\",\n"
+             "  \"fields\": [\"r\", \"R\", \"probability\", \"cumulative\"],\n"
+             "  \"units\": \"bohr\",\n"
+             "  \"state\": {\"n\": %d, \"l\": %d},\n"
+             "  \"radius\": %.17g,\n"
+             "  \"samples\": %zu,\n"
+             "  \"total_probability\": %.17g,\n"
+             "  \"most_probable_radius\": %.17g,\n"
+             "  \"mean_radius\": %.17g,\n"
+             "  \"nodes\": [",
+             data_file.c_str(), format.c_str(), ImageWriter::littleEndian() ? "little" : "big", n, l, profile.getRadius(),
+             summary.samples, summary.total, summary.peak_radius, summary.mean_radius);
+    std::string json = text;
+    for (size_t i=0; i<summary.nodes.size(); i++) {
+        snprintf(text, sizeof(text), (i > 0) ? ", %.17g" : "%.17g", summary.nodes[i]);
+        json += text;
+    }
+    return json + "]\n}\n";
+}
+
+
+// Sample radial component of one state and stream it to file as CSV or native float64 records (r, R, P, cumulative)
+static bool write_profile(const Options &o, const RadialProfile &profile, const std::string &path, RadialSummary &summary)
+{
+    FILE *file = ImageWriter::openFile(path);
+    if (file == nullptr)
+        return false;
+    bool csv = o.format == "csv";
+    bool ok = !csv || fputs("r,R,probability,cumulative\n", file) >= 0;
+
+// Lines of chunk are formatted by blocks in parallel and written in order
+    const size_t block = 1024;
+    std::vector<std::string> texts;
+    auto output = [&](const RadialSample *samples, size_t count) {
+        if (!csv)
+            return fwrite(samples, sizeof(RadialSample), count, file) == count;
+        texts.resize((count + block - 1) / block);
+        TileScheduler::forEach(texts.size(), [&](int index, int) {
+            std::string &text = texts[index];
+            char line[128];
+            text.clear();
+            for (size_t i=index*block; i<count && i<(index+1)*block; i++) {
+                int size = snprintf(line, sizeof(line), "%.12g,%.12g,%.12g,%.12g\n",
+                                    samples[i].r, samples[i].R, samples[i].probability, samples[i].cumulative);
+                text.append(line, size);
+            }
+        });
+        for (auto &text : texts)
+            if (fwrite(text.data(), 1, text.size(), file) != text.size())
+                return false;
+        return true;
+    };
+    ok = ok && ((o.tolerance > 0) ? profile.sampleAdaptive(o.tolerance, output, summary) : profile.sample(o.points, output, summary));
+    return ImageWriter::closeFile(file, ok);
+}
+
+
+// Sample radial profile: simulatom-cli profile [--points N | --tolerance T] [--radius R] [options] -o FILE.csv|raw|-
+// or profiles of all states: simulatom-cli profile --n-max N --dir DIR [--format csv|raw] [options]
+int profile_command(int argc, char *argv[])
+{
+    Options o;
+    o.points = 1000000;
+    if (!parse_options(argc, argv, 2, o) || o.radius < 0 || o.tolerance < 0) {
+        usage(argv[0]);
+        return 1;
+    }
+    if (o.format == "png")
+        o.format = "csv";
+    if (o.format != "csv" && o.format != "raw") {
+        fprintf(stderr, "profile can be written as csv or raw float64\n");
+        return 1;
+    }
+    if (o.n_max > AtomModel::MAX_N) {
+        fprintf(stderr, "n-max must be from 1 to %d\n", AtomModel::MAX_N);
+        return 1;
+    }
+    TileScheduler::setThreadCount(o.threads);
+
+// One state: summary is written next to the file, or to standard error with profile on standard output
+    if (o.n_max < 1) {
+        AtomModel model;
+        if (!setup_model(o, model)) {
+            fprintf(stderr, "invalid state or settings\n");
+            return 1;
+        }
+        RadialProfile profile(o.n, o.l, o.radius);
+        RadialSummary summary;
+        if (!write_profile(o, profile, o.output, summary)) {
+            fprintf(stderr, "failed to write %s\n", o.output.c_str());
+            return 1;
+        }
+        size_t slash = o.output.find_last_of("/\\");
+        std::string json = summary_json(o.n, o.l, profile, summary, (slash == std::string::npos) ? o.output : o.output.substr(slash + 1), o.format);
+        if (o.output == "-") {
+            fputs(json.c_str(), stderr);
+        } else if (!ImageWriter::writeFile(o.output + ".json", json.data(), json.size())) {
+            fprintf(stderr, "failed to write %s.json\n", o.output.c_str());
+            return 1;
+        }
+        return 0;
+    }
+
+// All states up to n-max: profile and summary of every (n, l) and table of summaries. States are sampled one
+// after another, every state uses all workers
+    if (o.directory.empty() || !make_directory(o.directory)) {
+        fprintf(stderr, "failed to create directory %s\n", o.directory.c_str());
+        return 1;
+    }
+    std::string table = "n,l,samples,total_probability,most_probable_radius,mean_radius,nodes\n";
+    char name[128];
+    for (int n=1; n<=o.n_max; n++)
+        for (int l=0; l<n; l++) {
+            RadialProfile profile(n, l, o.radius);
+            RadialSummary summary;
+            snprintf(name, sizeof(name), "n%d-l%d.%s", n, l, o.format.c_str());
+            std::string path = o.directory + "/" + name;
+            bool ok = write_profile(o, profile, path, summary);
+            std::string json = summary_json(n, l, profile, summary, name, o.format);
+            if (!ok || !ImageWriter::writeFile(path + ".json", json.data(), json.size())) {
+                fprintf(stderr, "failed to write %s\n", path.c_str());
+                return 1;
+            }
+            snprintf(name, sizeof(name), "%d,%d,%zu,%.17g,%.17g,%.17g,", n, l, summary.samples, summary.total, summary.peak_radius, summary.mean_radius);
+            table += name;
+
+        // Nodes are separated by semicolons
+            for (size_t i=0; i<summary.nodes.size(); i++) {
+                snprintf(name, sizeof(name), (i > 0) ? ";%.17g" : "%.17g", summary.nodes[i]);
+                table += name;
+            }
+            table += "\n";
+            fprintf(stderr, "\rn=%d l=%d", n, l);
+        }
+    fprintf(stderr, "\n");
+    if (!ImageWriter::writeFile(o.directory + "/summary.csv", table.data(), table.size())) {
+        fprintf(stderr, "failed to write summary\n");
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,389 @@
+#include "boundedqueue.h"
+#include "commands.h"
+#include "parallel.h"
+#include "renderprotocol.h"
+
+#include <algorithm>
+#include <chrono>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <mutex>
+#include <thread>
+
+#ifndef _WIN32
+#include <cerrno>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#endif
+
+
+// Client connection, its socket is closed when the connection is dropped and all its requests are answered
+struct Connection {
+    int socket;
+    RenderRequest partial;
+    size_t received;
+    std::mutex send_mutex;
+
+    explicit Connection(int fd) :
+        socket(fd),
+        received(0) {
+    }
+
+    ~Connection()
+    {
+        RenderProtocol::close(socket);
+    }
+
+// Send reply with optional descriptor of frame, replies of render and I/O threads don't interleave
+    bool reply(const RenderReply &message, int fd = -1)
+    {
+        std::lock_guard<std::mutex> lock(send_mutex);
+        return RenderProtocol::send(socket, &message, sizeof(message), fd);
+    }
+};
+
+
+// Request waiting for its batch
+struct PendingRequest {
+    std::shared_ptr<Connection> connection;
+    RenderRequest request;
+};
+
+
+// State of daemon shared by all requests: one model keeps tables of the current state, renderer keeps isosurfaces,
+// clouds and pyramids, frame cache keeps computed models (and shares them with other processes with --shared-cache)
+struct RenderDaemon {
+    Options options;
+    AtomModel model;
+    FrameRenderer renderer;
+    FrameCache frames;
+    std::vector<unsigned int> colors_2d, colors_3d;
+};
+
+
+// Frame written to shared memory, it is shared by equal requests of batch
+struct SharedFrame {
+    int fd;
+    RenderReply reply;
+};
+
+
+static const char *RENDER_VIEWS[] = {"graphic", "2d", "slice", "volume", "isosurface", "cloud"};
+
+
+// Reply without frame
+static RenderReply make_reply(const RenderRequest &r, RenderStatus status)
+{
+    RenderReply reply;
+    memset(&reply, 0, sizeof(reply));
+    reply.magic = RenderProtocol::MAGIC;
+    reply.id = r.id;
+    reply.status = status;
+    reply.format = r.format;
+    return reply;
+}
+
+
+// Render frame of request in the current state of model and write it to shared memory. Values and pixels are
+// written there directly, encoded images are copied
+static SharedFrame render_frame(RenderDaemon &d, const RenderRequest &r)
+{
+    SharedFrame shared = {-1, make_reply(r, RENDER_FAILED)};
+    Options o = d.options;
+    o.width = r.width;
+    o.height = r.height;
+    o.points = r.width;
+    o.zoom = o.view_3d.zoom = r.zoom;
+    o.center_x = r.center_x;
+    o.center_y = r.center_y;
+    o.view_3d.mov_x = r.mov_x;
+    o.view_3d.mov_y = r.mov_y;
+    o.view_3d.rot_x = r.rot_x;
+    o.view_3d.rot_y = r.rot_y;
+    o.view_3d.level = IsoLevel(r.iso_by_probability != 0, r.iso_level / 100);
+    std::string view = RENDER_VIEWS[r.view];
+    std::shared_ptr<FrameJob> job = make_job(o, d.renderer, d.model, view);
+
+// Models computed for earlier requests are taken from cache
+    std::shared_ptr<const std::vector<long double>> frame = d.frames.get(job->key);
+    if (!frame) {
+        std::shared_ptr<std::vector<long double>> computed(new std::vector<long double>(job->size));
+        auto start = std::chrono::steady_clock::now();
+        job->compute(d.model, computed->data());
+        d.frames.put(job->key, computed, std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+        frame = computed;
+    }
+    const std::vector<long double> &p = *frame;
+
+    void *data;
+    std::vector<unsigned int> image;
+    std::vector<unsigned char> encoded;
+    shared.reply.width = r.width;
+    shared.reply.height = (r.view == RENDER_GRAPHIC && r.format == RENDER_FLOAT32) ? 1 : r.height;
+    if (r.format == RENDER_FLOAT32) {
+        shared.reply.size = p.size() * sizeof(float);
+        if ((shared.fd = RenderProtocol::createShared(shared.reply.size, data)) < 0)
+            return shared;
+        float *values = (float *)data;
+        for (size_t i=0; i<p.size(); i++)
+            values[i] = p[i];
+    } else if (r.format == RENDER_PIXELS && r.view != RENDER_GRAPHIC) {
+        shared.reply.size = p.size() * sizeof(unsigned int);
+        if ((shared.fd = RenderProtocol::createShared(shared.reply.size, data)) < 0)
+            return shared;
+        FrameRenderer::colorize(p.data(), p.size(), (r.view == RENDER_2D) ? d.colors_2d.data() : d.colors_3d.data(), (unsigned int *)data);
+    } else {
+        frame_image(o, d.model, view, p, image);
+        const void *bytes = image.data();
+        shared.reply.size = image.size() * sizeof(unsigned int);
+        if (r.format != RENDER_PIXELS) {
+            ImageWriter::encodeImage((r.format == RENDER_QOI) ? IMAGE_QOI : IMAGE_PNG, image.data(), r.width, r.height, encoded);
+            bytes = encoded.data();
+            shared.reply.size = encoded.size();
+        }
+        if ((shared.fd = RenderProtocol::createShared(shared.reply.size, data)) < 0)
+            return shared;
+        memcpy(data, bytes, shared.reply.size);
+    }
+    RenderProtocol::unmap(data, shared.reply.size);
+    shared.reply.status = RENDER_OK;
+    return shared;
+}
+
+
+// Render batch of requests received together. Requests are grouped by state, so tables, volumes and caches of state
+// are prepared once for the group, and equal requests of group get the same frame
+static void render_batch(RenderDaemon &d, std::vector<PendingRequest> &batch)
+{
+    auto start = std::chrono::steady_clock::now();
+    std::stable_sort(batch.begin(), batch.end(), [](const PendingRequest &a, const PendingRequest &b) {
+        QuantumState sa(a.request.n, a.request.l, a.request.m), sb(b.request.n, b.request.l, b.request.m);
+        if (sa != sb)
+            return sa < sb;
+        return a.request.density < b.request.density;
+    });
+    int states = 0, frames = 0;
+    for (size_t first=0; first<batch.size(); ) {
+        const RenderRequest &head = batch[first].request;
+        size_t last = first + 1;
+        while (last < batch.size() && QuantumState(batch[last].request.n, batch[last].request.l, batch[last].request.m) ==
+               QuantumState(head.n, head.l, head.m) && batch[last].request.density == head.density)
+            last++;
+        d.model.set_n(head.n);
+        d.model.set_l(head.l);
+        d.model.set_m(head.m);
+        d.model.setProbabilityDensityStatus(head.density != 0);
+        states++;
+
+    // Requests which differ by id only are rendered once
+        std::map<std::string, SharedFrame> rendered;
+        for (size_t i=first; i<last; i++) {
+            RenderRequest key = batch[i].request;
+            key.id = 0;
+            key.m = abs(key.m);
+            std::string bytes((const char *)&key, sizeof(key));
+            if (rendered.find(bytes) == rendered.end()) {
+                rendered[bytes] = render_frame(d, batch[i].request);
+                frames++;
+            }
+            RenderReply reply = rendered[bytes].reply;
+            reply.id = batch[i].request.id;
+            reply.batch = last - first;
+            batch[i].connection->reply(reply, rendered[bytes].fd);
+        }
+
+    // Clients keep frames by their descriptors
+        for (auto &frame : rendered)
+            RenderProtocol::close(frame.second.fd);
+        first = last;
+    }
+    fprintf(stderr, "%d requests, %d states, %d frames, %.1f ms\n", (int)batch.size(), states, frames,
+            std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+}
+
+
+static volatile sig_atomic_t stop_requested = 0;
+
+static void request_stop(int)
+{
+    stop_requested = 1;
+}
+
+
+// Read available requests of connection, false if it is closed or sent malformed request
+static bool read_requests(const std::shared_ptr<Connection> &connection, BoundedQueue<PendingRequest> &queue)
+{
+#ifdef _WIN32
+    (void)connection;
+    (void)queue;
+    return false;
+#else
+    for (;;) {
+        char *partial = (char *)&connection->partial;
+        ssize_t result = recv(connection->socket, partial + connection->received, sizeof(RenderRequest) - connection->received, MSG_DONTWAIT);
+        if (result < 0 && errno == EINTR)
+            continue;
+        if (result < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+            return true;
+        if (result <= 0)
+            return false;
+        connection->received += result;
+        if (connection->received < sizeof(RenderRequest))
+            continue;
+        connection->received = 0;
+        const RenderRequest &r = connection->partial;
+        if (r.magic != RenderProtocol::MAGIC || r.version != RenderProtocol::VERSION) {
+            connection->reply(make_reply(r, RENDER_INVALID));
+            return false;
+        }
+        if (!RenderProtocol::valid(r)) {
+            connection->reply(make_reply(r, RENDER_INVALID));
+            continue;
+        }
+        PendingRequest pending = {connection, r};
+        queue.push(pending);
+    }
+#endif
+}
+
+
+// Run render daemon: simulatom-cli serve [--socket PATH] [options]
+int serve_command(int argc, char *argv[])
+{
+    RenderDaemon d;
+    if (!parse_options(argc, argv, 2, d.options)) {
+        usage(argv[0]);
+        return 1;
+    }
+    TileScheduler::setThreadCount(d.options.threads);
+    if (!setup_model(d.options, d.model)) {
+        fprintf(stderr, "invalid settings\n");
+        return 1;
+    }
+    d.frames.setShared(d.model.getSharedCache());
+    d.colors_2d.resize(FrameRenderer::COLOR_TABLE_SIZE);
+    d.colors_3d.resize(FrameRenderer::COLOR_TABLE_SIZE);
+    FrameRenderer::buildColorTables(d.model.getToneMap(), d.colors_2d.data(), d.colors_3d.data());
+#ifdef _WIN32
+    fprintf(stderr, "render daemon needs Unix domain sockets\n");
+    return 1;
+#else
+    int listener = RenderProtocol::listen(d.options.socket);
+    if (listener < 0) {
+        fprintf(stderr, "failed to listen on %s\n", d.options.socket.c_str());
+        return 1;
+    }
+    signal(SIGPIPE, SIG_IGN);
+    signal(SIGINT, request_stop);
+    signal(SIGTERM, request_stop);
+    fprintf(stderr, "listening on %s\n", d.options.socket.c_str());
+
+// Render thread takes all requests received while it rendered the previous batch
+    BoundedQueue<PendingRequest> queue(4096);
+    std::thread render_thread([&]() {
+        std::vector<PendingRequest> batch;
+        while (queue.popAll(batch)) {
+            render_batch(d, batch);
+            batch.clear();
+        }
+    });
+
+// Connections are polled by this thread, stop signal is checked twice a second
+    std::vector<std::shared_ptr<Connection>> connections;
+    std::vector<pollfd> fds;
+    while (!stop_requested) {
+        fds.clear();
+        pollfd listen_fd = {listener, POLLIN, 0};
+        fds.push_back(listen_fd);
+        for (auto &connection : connections) {
+            pollfd fd = {connection->socket, POLLIN, 0};
+            fds.push_back(fd);
+        }
+        if (poll(fds.data(), fds.size(), 500) <= 0)
+            continue;
+        for (size_t i=1; i<fds.size(); i++)
+            if ((fds[i].revents & (POLLIN | POLLHUP | POLLERR)) && !read_requests(connections[i-1], queue))
+                connections[i-1].reset();
+        connections.erase(std::remove(connections.begin(), connections.end(), nullptr), connections.end());
+        if (fds[0].revents & POLLIN) {
+            int fd = accept(listener, nullptr, nullptr);
+            if (fd >= 0)
+                connections.push_back(std::make_shared<Connection>(fd));
+        }
+    }
+
+// Requests already received are answered
+    queue.close();
+    render_thread.join();
+    connections.clear();
+    RenderProtocol::close(listener);
+    unlink(d.options.socket.c_str());
+    return 0;
+#endif
+}
+
+
+// Request frame from daemon: simulatom-cli request [--socket PATH] [options] -o FILE.png|qoi|raw
+int request_command(int argc, char *argv[])
+{
+    Options o;
+    if (!parse_options(argc, argv, 2, o) || (o.format != "png" && o.format != "qoi" && o.format != "raw")) {
+        usage(argv[0]);
+        return 1;
+    }
+    RenderRequest r = RenderProtocol::request(1);
+    int view = -1;
+    for (int i=0; i<6; i++)
+        if (o.view == RENDER_VIEWS[i])
+            view = i;
+    if (view < 0) {
+        usage(argv[0]);
+        return 1;
+    }
+    r.n = o.n;
+    r.l = o.l;
+    r.m = o.m;
+    r.density = o.density;
+    r.view = view;
+    r.format = (o.format == "raw") ? RENDER_FLOAT32 : (o.format == "qoi") ? RENDER_QOI : RENDER_PNG;
+    r.width = (view == RENDER_GRAPHIC && o.format == "raw") ? o.points : o.width;
+    r.height = o.height;
+    r.mov_x = o.view_3d.mov_x;
+    r.mov_y = o.view_3d.mov_y;
+    r.rot_x = o.view_3d.rot_x;
+    r.rot_y = o.view_3d.rot_y;
+    r.zoom = o.zoom;
+    r.center_x = o.center_x;
+    r.center_y = o.center_y;
+    r.iso_by_probability = o.view_3d.level.by_probability;
+    r.iso_level = o.view_3d.level.value * 100;
+
+// Frame is mapped from shared memory of daemon and written to file
+    int socket = RenderProtocol::connect(o.socket);
+    if (socket < 0) {
+        fprintf(stderr, "failed to connect to %s\n", o.socket.c_str());
+        return 1;
+    }
+    RenderReply reply;
+    int fd = -1;
+    bool ok = RenderProtocol::send(socket, &r, sizeof(r)) && RenderProtocol::receive(socket, &reply, sizeof(reply), &fd);
+    RenderProtocol::close(socket);
+    if (!ok || reply.status != RENDER_OK) {
+        fprintf(stderr, ok ? "request is rejected\n" : "daemon doesn't answer\n");
+        RenderProtocol::close(fd);
+        return 1;
+    }
+    const void *data = RenderProtocol::mapShared(fd, reply.size);
+    RenderProtocol::close(fd);
+    ok = data != nullptr && ImageWriter::writeFile(o.output, data, reply.size);
+    RenderProtocol::unmap(data, reply.size);
+    if (!ok) {
+        fprintf(stderr, "failed to write %s\n", o.output.c_str());
+        return 1;
+    }
+    return 0;
+}
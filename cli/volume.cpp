@@ -0,0 +1,65 @@
+#include "commands.h"
+#include "imagewriter.h"
+#include "parallel.h"
+#include "volumeexporter.h"
+
+#include <cstdio>
+
+
+// Export volume: simulatom-cli volume --grid N [--radius R] [--type float32|float16] [options] -o FILE.raw|vti|nrrd
+int volume_command(int argc, char *argv[])
+{
+    Options o;
+    if (!parse_options(argc, argv, 2, o) || o.grid < 2 || o.grid > VolumeExporter::MAX_GRID_SIZE || o.radius < 0 || (o.sample != "float32" && o.sample != "float16")) {
+        usage(argv[0]);
+        return 1;
+    }
+
+// Files of other extensions are raw, VTK and NRRD have no half precision floats
+    VolumeFormat format = (o.format == "vti") ? VOLUME_VTI : (o.format == "nrrd") ? VOLUME_NRRD : VOLUME_RAW;
+    if ((format == VOLUME_RAW && o.format != "raw" && o.format != "png") || (format != VOLUME_RAW && o.sample != "float32")) {
+        fprintf(stderr, "volume can be written as raw float32 or float16, vti or nrrd float32\n");
+        return 1;
+    }
+    TileScheduler::setThreadCount(o.threads);
+    AtomModel model;
+    if (!setup_model(o, model)) {
+        fprintf(stderr, "invalid state or settings\n");
+        return 1;
+    }
+
+// Grid covers the cutoff sphere of state by default
+    double radius = (o.radius > 0) ? o.radius : model.densityCutoffRadius();
+    VolumeGrid grid(o.grid, radius);
+    VolumeExporter exporter(model, grid, (o.sample == "float16") ? SAMPLE_FLOAT16 : SAMPLE_FLOAT32);
+    fprintf(stderr, "%d^3 %s, %.1f MB, slab of %d planes\n", o.grid, o.sample.c_str(),
+            exporter.volumeSize() / 1048576.0, exporter.slabPlanes());
+
+// Slabs go to file as they are computed
+    FILE *file = ImageWriter::openFile(o.output);
+    if (file == nullptr) {
+        fprintf(stderr, "failed to write %s\n", o.output.c_str());
+        return 1;
+    }
+    int planes_done = 0;
+    bool ok = exporter.write(file, format, [&](int planes) {
+        planes_done += planes;
+        fprintf(stderr, "\r%d / %d", planes_done, grid.nz);
+    });
+    fprintf(stderr, "\n");
+    if (!ImageWriter::closeFile(file, ok)) {
+        fprintf(stderr, "failed to write %s\n", o.output.c_str());
+        return 1;
+    }
+
+// Header of raw file is written next to it, it refers to the file by name
+    if (format == VOLUME_RAW && o.output != "-") {
+        size_t slash = o.output.find_last_of("/\\");
+        std::string header = exporter.header((slash == std::string::npos) ? o.output : o.output.substr(slash + 1));
+        if (!ImageWriter::writeFile(o.output + ".json", header.data(), header.size())) {
+            fprintf(stderr, "failed to write %s.json\n", o.output.c_str());
+            return 1;
+        }
+    }
+    return 0;
+}
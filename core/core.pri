@@ -0,0 +1,12 @@
+# Link Qt-free core library, core.pro puts it to lib directory of the build tree
+CORE_LIB_DIR = $$OUT_PWD/../lib
+
+INCLUDEPATH += $$PWD/../src
+DEPENDPATH += $$PWD/../src
+
+LIBS += -L$$CORE_LIB_DIR -lsimulatom-core
+win32-msvc*: PRE_TARGETDEPS += $$CORE_LIB_DIR/simulatom-core.lib
+else: PRE_TARGETDEPS += $$CORE_LIB_DIR/libsimulatom-core.a
+
+# Shared memory of cross-process cache
+unix:!macx: LIBS += -lrt
@@ -0,0 +1,73 @@
+# Qt-free core library: model, caches and render kernels. It is linked by GUI, CLI and benchmarks
+TEMPLATE = lib
+TARGET = simulatom-core
+
+CONFIG += c++11 staticlib thread
+CONFIG -= qt
+
+DESTDIR = $$OUT_PWD/../lib
+
+SRC = $$PWD/../src
+INCLUDEPATH += $$SRC
+
+SOURCES += \
+    $$SRC/atommodel.cpp \
+    $$SRC/cacheaccountant.cpp \
+    $$SRC/camera.cpp \
+    $$SRC/camerapath.cpp \
+    $$SRC/densityoctree.cpp \
+    $$SRC/densitypyramid.cpp \
+    $$SRC/densityvolume.cpp \
+    $$SRC/electroncloud.cpp \
+    $$SRC/encodepipeline.cpp \
+    $$SRC/emptyspace.cpp \
+    $$SRC/framecache.cpp \
+    $$SRC/framerenderer.cpp \
+    $$SRC/galleryplan.cpp \
+    $$SRC/imagewriter.cpp \
+    $$SRC/isosurface.cpp \
+    $$SRC/mappedfile.cpp \
+    $$SRC/meshwriter.cpp \
+    $$SRC/parallel.cpp \
+    $$SRC/prefetcher.cpp \
+    $$SRC/radialprofile.cpp \
+    $$SRC/rasterizer.cpp \
+    $$SRC/renderprotocol.cpp \
+    $$SRC/sharedcache.cpp \
+    $$SRC/stateatlas.cpp \
+    $$SRC/tiledrenderer.cpp \
+    $$SRC/tonemap.cpp \
+    $$SRC/vectormatrix.cpp \
+    $$SRC/volumeexporter.cpp
+
+HEADERS += \
+    $$SRC/accountedcache.h \
+    $$SRC/atommodel.h \
+    $$SRC/boundedqueue.h \
+    $$SRC/cacheaccountant.h \
+    $$SRC/camera.h \
+    $$SRC/camerapath.h \
+    $$SRC/densityoctree.h \
+    $$SRC/densitypyramid.h \
+    $$SRC/densityvolume.h \
+    $$SRC/electroncloud.h \
+    $$SRC/encodepipeline.h \
+    $$SRC/emptyspace.h \
+    $$SRC/framecache.h \
+    $$SRC/framerenderer.h \
+    $$SRC/galleryplan.h \
+    $$SRC/imagewriter.h \
+    $$SRC/isosurface.h \
+    $$SRC/mappedfile.h \
+    $$SRC/meshwriter.h \
+    $$SRC/parallel.h \
+    $$SRC/prefetcher.h \
+    $$SRC/radialprofile.h \
+    $$SRC/rasterizer.h \
+    $$SRC/renderprotocol.h \
+    $$SRC/sharedcache.h \
+    $$SRC/stateatlas.h \
+    $$SRC/tiledrenderer.h \
+    $$SRC/tonemap.h \
+    $$SRC/vectormatrix.h \
+    $$SRC/volumeexporter.h
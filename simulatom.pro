@@ -0,0 +1,10 @@
+# Qt-free core library, GUI and tools: qmake simulatom.pro && make
+TEMPLATE = subdirs
+
+SUBDIRS = core app cli bench tests
+
+app.file = src/simulatom.pro
+app.depends = core
+cli.depends = core
+bench.depends = core
+tests.depends = core
@@ -0,0 +1,123 @@
+#ifndef ACCOUNTEDCACHE_H
+#define ACCOUNTEDCACHE_H
+
+
+#include <chrono>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+
+#include "cacheaccountant.h"
+
+
+// Cache of shared results per key with limited number of entries, least recently used entry is removed.
+// Entries are accounted in one category of the global accountant, which can evict them over its budget.
+// Result is computed without locking and accounted with time spent on it before the cache is locked again,
+// as adding it can evict entries of this cache
+template <typename Key, typename Value>
+class AccountedCache {
+
+    struct Entry {
+        std::shared_ptr<Value> value;
+        unsigned long long last_use;
+        uint64_t id;
+    };
+
+    std::map<Key, Entry> entries;
+    CacheCategory category;
+    int capacity;
+    unsigned long long use_counter;
+    std::shared_ptr<CacheGuard> guard;
+
+// Remove entry without locking
+    void erase(typename std::map<Key, Entry>::iterator it)
+    {
+        CacheAccountant::global().remove(it->second.id);
+        entries.erase(it);
+    }
+
+public:
+
+    AccountedCache(CacheCategory cache_category, int max_entries) :
+        category(cache_category),
+        capacity(max_entries < 1 ? 1 : max_entries),
+        use_counter(0),
+        guard(new CacheGuard()) {
+    }
+
+    ~AccountedCache()
+    {
+        std::lock_guard<std::mutex> lock(guard->mutex);
+        guard->alive = false;
+        for (auto &entry : entries)
+            CacheAccountant::global().remove(entry.second.id);
+    }
+
+    AccountedCache(const AccountedCache &) = delete;
+    AccountedCache & operator=(const AccountedCache &) = delete;
+
+// Get result of key, compute it if it is not cached. Size gives memory usage of result in bytes.
+// Id of accountant entry is stored to id if it is given
+    std::shared_ptr<Value> get(const Key &key, const std::function<std::shared_ptr<Value>()> &compute,
+                               const std::function<size_t(const Value &)> &size, uint64_t *id = nullptr)
+    {
+        {
+            std::lock_guard<std::mutex> lock(guard->mutex);
+            auto it = entries.find(key);
+            if (it != entries.end()) {
+                it->second.last_use = ++use_counter;
+                CacheAccountant::global().hit(it->second.id);
+                if (id != nullptr)
+                    *id = it->second.id;
+                return it->second.value;
+            }
+        }
+        CacheAccountant::global().miss(category);
+
+        auto start = std::chrono::steady_clock::now();
+        Entry entry;
+        entry.value = compute();
+        double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        entry.id = CacheAccountant::global().add(category, size(*entry.value), ms, guard, [this](uint64_t evicted) {
+            for (auto it = entries.begin(); it != entries.end(); ++it)
+                if (it->second.id == evicted) {
+                    entries.erase(it);
+                    return;
+                }
+        });
+        if (id != nullptr)
+            *id = entry.id;
+
+        std::lock_guard<std::mutex> lock(guard->mutex);
+        auto it = entries.find(key);
+        if (it != entries.end())
+            erase(it);
+
+    // Remove least recently used entry
+        if ((int)entries.size() >= capacity) {
+            auto lru = entries.begin();
+            for (auto i = entries.begin(); i != entries.end(); ++i)
+                if (i->second.last_use < lru->second.last_use)
+                    lru = i;
+            erase(lru);
+        }
+
+        entry.last_use = ++use_counter;
+        entries[key] = entry;
+        return entry.value;
+    }
+
+// Remove all entries
+    void clear()
+    {
+        std::lock_guard<std::mutex> lock(guard->mutex);
+        for (auto &entry : entries)
+            CacheAccountant::global().remove(entry.second.id);
+        entries.clear();
+    }
+
+};
+
+
+#endif // ACCOUNTEDCACHE_H
@@ -1,20 +1,97 @@
 #include "atommodel.h"
+#include "camera.h"
+#include "densityoctree.h"
+#include "parallel.h"
+#include "radialprofile.h"
+#include "sharedcache.h"
+#include "stateatlas.h"
 #include "vectormatrix.h"
 
+#include <chrono>
+
+
+QuantumState::QuantumState(int _n, int _l, int _m) :
+    n(_n),
+    l(_l),
+    m(abs(_m)) {
+}
+
+
+bool QuantumState::operator<(const QuantumState &op1) const
+{
+    if (n != op1.n)
+        return n < op1.n;
+    if (l != op1.l)
+        return l < op1.l;
+    return m < op1.m;
+}
+
+
+bool QuantumState::operator==(const QuantumState &op1) const
+{
+    return n == op1.n && l == op1.l && m == op1.m;
+}
+
+
+bool QuantumState::operator!=(const QuantumState &op1) const
+{
+    return !(*this == op1);
+}
+
 
 AtomModel::AtomModel() :
     qn(1),
     ql(0),
     qm(0),
-    probability_density(false) {
+    probability_density(false),
+    volume_opacity(4),
+    radial_revision(0),
+    angular_revision(0),
+    mode_revision(0),
+    radial_data(nullptr),
+    angular_data(nullptr),
+    envelope_n(0),
+    radial_n(0),
+    radial_l(-1),
+    angular_l(-1),
+    angular_m(0),
+    table_radius(0),
+    radial_peak(0),
+    radial_probability_peak(0),
+    angular_peak(0),
+    radial_table_scale(0),
+    density_scale(0),
+    probability_scale(0),
+    volume_enabled(false),
+    volume_tricubic(false),
+    volume_budget(64u << 20),
+    volume_state(0, 0, 0),
+    volume_octree(false),
+    octree_state(0, 0, 0),
+    cache_guard(new CacheGuard()),
+    volume_id(0),
+    octree_id(0) {
+    tables_id = CacheAccountant::global().add(CACHE_TABLES, 0, 0, cache_guard, nullptr);
+}
+
+
+AtomModel::~AtomModel()
+{
+    std::lock_guard<std::mutex> lock(cache_guard->mutex);
+    cache_guard->alive = false;
+    CacheAccountant::global().remove(volume_id);
+    CacheAccountant::global().remove(octree_id);
+    CacheAccountant::global().remove(tables_id);
 }
 
 
 // Set main quantum number
 bool AtomModel::set_n(int n)
 {
-    if (n < 1)
+    if (n < 1 || n > MAX_N)
         return false;
+    if (n != qn)
+        radial_revision++;
     qn = n;
     return true;
 }
@@ -25,6 +102,10 @@ bool AtomModel::set_l(int l)
 {
     if (l < 0 || l > qn-1)
         return false;
+    if (l != ql) {
+        radial_revision++;
+        angular_revision++;
+    }
     ql = l;
     return true;
 }
@@ -35,6 +116,8 @@ bool AtomModel::set_m(int m)
 {
     if (m < -ql || m > ql)
         return false;
+    if (abs(m) != abs(qm))
+        angular_revision++;
     qm = m;
     return true;
 }
@@ -64,6 +147,8 @@ int AtomModel::get_m() const
 // Set model type
 void AtomModel::setProbabilityDensityStatus(bool prob_dens)
 {
+    if (prob_dens != probability_density)
+        mode_revision++;
     probability_density = prob_dens;
 }
 
@@ -75,11 +160,286 @@ bool AtomModel::isProbabilityDensity() const
 }
 
 
+// Get revision of radial factor
+unsigned long AtomModel::getRadialRevision() const
+{
+    return radial_revision;
+}
+
+
+// Get revision of angular factor
+unsigned long AtomModel::getAngularRevision() const
+{
+    return angular_revision;
+}
+
+
+// Get revision of model type
+unsigned long AtomModel::getModeRevision() const
+{
+    return mode_revision;
+}
+
+
+// Set tone mapping of 2D and 3D models
+void AtomModel::setToneMap(const ToneMap &tm)
+{
+    tone_map = tm;
+}
+
+
+// Get tone mapping of 2D and 3D models
+const ToneMap & AtomModel::getToneMap() const
+{
+    return tone_map;
+}
+
+
+// Set opacity of volumetric model, optical depth per model radius of the densest region
+bool AtomModel::setVolumeOpacity(long double opacity)
+{
+    if (!(opacity > 0))
+        return false;
+    volume_opacity = opacity;
+    return true;
+}
+
+
+// Get opacity of volumetric model
+long double AtomModel::getVolumeOpacity() const
+{
+    return volume_opacity;
+}
+
+
+// Enable / disable voxel volume of 3D models
+void AtomModel::setVolumeCache(bool enabled, size_t budget_bytes)
+{
+    volume_enabled = enabled;
+    if (budget_bytes != volume_budget || !enabled) {
+        resetVolume();
+        resetOctree();
+    }
+    volume_budget = budget_bytes;
+}
+
+
+// Check if voxel volume of 3D models is enabled
+bool AtomModel::isVolumeCacheEnabled() const
+{
+    return volume_enabled;
+}
+
+
+// Get memory budget of voxel volume
+size_t AtomModel::getVolumeBudget() const
+{
+    return volume_budget;
+}
+
+
+// Set tricubic interpolation of voxel volume
+void AtomModel::setVolumeTricubic(bool tricubic)
+{
+    volume_tricubic = tricubic;
+}
+
+
+// Check if voxel volume is interpolated by tricubic interpolation
+bool AtomModel::isVolumeTricubic() const
+{
+    return volume_tricubic;
+}
+
+
+// Get voxel volume of current state, build it if needed
+std::shared_ptr<const DensityVolume> AtomModel::getVolume()
+{
+    QuantumState state = canonicalState();
+    {
+        std::lock_guard<std::mutex> lock(cache_guard->mutex);
+        if (volume && volume_state == state) {
+            CacheAccountant::global().hit(volume_id);
+            return volume;
+        }
+    }
+    CacheAccountant::global().miss(CACHE_VOLUMES);
+
+// Volume of atlas is used when it fits memory budget
+    auto start = std::chrono::steady_clock::now();
+    std::shared_ptr<const DensityVolume> vol;
+    if (atlas) {
+        vol = atlas->volume(state);
+        if (vol && vol->memoryUsage() > volume_budget)
+            vol.reset();
+    }
+    if (!vol)
+        vol = std::make_shared<const DensityVolume>(*this, DensityVolume::sizeForBudget(volume_budget));
+    double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+// Volume is accounted before locking, accountant can evict it at once
+    uint64_t id = CacheAccountant::global().add(CACHE_VOLUMES, vol->memoryUsage(), ms, cache_guard, [this](uint64_t id) {
+        if (id != volume_id)
+            return;
+        volume.reset();
+        volume_levels.clear();
+        volume_id = 0;
+    });
+    std::lock_guard<std::mutex> lock(cache_guard->mutex);
+    CacheAccountant::global().remove(volume_id);
+    volume = vol;
+    volume_state = state;
+    volume_levels.clear();
+    volume_id = id;
+    return vol;
+}
+
+
+// Get mip level of voxel volume
+std::shared_ptr<const DensityVolume> AtomModel::getVolumeLevel(int level)
+{
+    std::shared_ptr<const DensityVolume> vol = getVolume();
+    std::vector<std::shared_ptr<const DensityVolume>> levels;
+    uint64_t id;
+    {
+        std::lock_guard<std::mutex> lock(cache_guard->mutex);
+        if (volume_levels.empty() || volume_levels[0] != vol)
+            volume_levels.assign(1, vol);
+        levels = volume_levels;
+        id = (volume == vol) ? volume_id : 0;
+    }
+
+// Coarser levels are built without locking and accounted with the volume
+    size_t count = levels.size();
+    while ((int)levels.size() <= level && levels.back()->gridSize() > 16) {
+        const DensityVolume &finer = *levels.back();
+        levels.push_back(std::make_shared<const DensityVolume>(finer, finer.gridSize() / 2));
+    }
+    if (levels.size() > count && id != 0) {
+        size_t size = 0;
+        for (auto &l : levels)
+            size += l->memoryUsage();
+        {
+            std::lock_guard<std::mutex> lock(cache_guard->mutex);
+            if (volume_id == id)
+                volume_levels = levels;
+        }
+        CacheAccountant::global().resize(id, size);
+    }
+    return levels[(level < (int)levels.size()) ? level : levels.size() - 1];
+}
+
+
+// Drop voxel volume of current state
+void AtomModel::resetVolume()
+{
+    std::lock_guard<std::mutex> lock(cache_guard->mutex);
+    CacheAccountant::global().remove(volume_id);
+    volume.reset();
+    volume_levels.clear();
+    volume_id = 0;
+}
+
+
+// Drop adaptive octree of current state
+void AtomModel::resetOctree()
+{
+    std::lock_guard<std::mutex> lock(cache_guard->mutex);
+    CacheAccountant::global().remove(octree_id);
+    octree.reset();
+    octree_id = 0;
+}
+
+
+// Set adaptive octree of 3D models
+void AtomModel::setVolumeOctree(bool enabled)
+{
+    volume_octree = enabled;
+    if (!enabled)
+        resetOctree();
+}
+
+
+// Check if adaptive octree is used instead of voxel grid
+bool AtomModel::isVolumeOctree() const
+{
+    return volume_octree;
+}
+
+
+// Get adaptive octree of current state, build it if needed
+std::shared_ptr<const DensityOctree> AtomModel::getOctree()
+{
+    QuantumState state = canonicalState();
+    {
+        std::lock_guard<std::mutex> lock(cache_guard->mutex);
+        if (octree && octree_state == state) {
+            CacheAccountant::global().hit(octree_id);
+            return octree;
+        }
+    }
+    CacheAccountant::global().miss(CACHE_VOLUMES);
+
+    auto start = std::chrono::steady_clock::now();
+    std::shared_ptr<const DensityOctree> tree = std::make_shared<const DensityOctree>(*this);
+    double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    uint64_t id = CacheAccountant::global().add(CACHE_VOLUMES, tree->memoryUsage(), ms, cache_guard, [this](uint64_t id) {
+        if (id != octree_id)
+            return;
+        octree.reset();
+        octree_id = 0;
+    });
+    std::lock_guard<std::mutex> lock(cache_guard->mutex);
+    CacheAccountant::global().remove(octree_id);
+    octree = tree;
+    octree_state = state;
+    octree_id = id;
+    return tree;
+}
+
+
+// Set precomputed atlas, tables and volume are taken from it on next use
+void AtomModel::setAtlas(std::shared_ptr<const StateAtlas> state_atlas)
+{
+    atlas = state_atlas;
+    radial_n = 0;
+    angular_l = -1;
+    resetVolume();
+}
+
+
+// Get precomputed atlas
+std::shared_ptr<const StateAtlas> AtomModel::getAtlas() const
+{
+    return atlas;
+}
+
+
+// Set cache shared with other processes
+void AtomModel::setSharedCache(std::shared_ptr<SharedCache> cache)
+{
+    shared_cache = cache;
+}
+
+
+// Get cache shared with other processes
+std::shared_ptr<SharedCache> AtomModel::getSharedCache() const
+{
+    return shared_cache;
+}
+
+
+// Get canonical identity of current state
+QuantumState AtomModel::canonicalState() const
+{
+    return QuantumState(qn, ql, qm);
+}
+
+
 // Get quantum state in text format
-QString AtomModel::getState() const
+std::string AtomModel::getState() const
 {
-    QString state;
-    state.setNum(qn);
+    std::string state = std::to_string(qn);
     const char lstate[] = "spdfgh";
     if ((unsigned)ql < sizeof(lstate))
         state = state + lstate[ql];
@@ -90,109 +450,677 @@ QString AtomModel::getState() const
 // Compute graphic model
 void AtomModel::modelGraphic(long double *p, int points) {
 
-    long double dr = BOHR_RADIUS * maxRelativeRadius() / points;
+    RadialProfile profile(qn, ql, maxRelativeRadius());
+    std::vector<double> r(points), R(points);
+    for (int i=0; i<points; i++)
+        r[i] = profile.getRadius() * i / points;
+    profile.evaluate(r.data(), R.data(), points);
 
 // Compute probability or probability density
-    if (probability_density) {
-        for (int r=0; r<points; r++)
-            p[r] = squareRadialComponent(dr * r);
-    } else {
-        for (int r=0; r<points; r++)
-            p[r] = squareRadialComponent(dr * r) * r * r;
-    }
+    for (int i=0; i<points; i++)
+        p[i] = probability_density ? R[i] * R[i] : R[i] * R[i] * r[i] * r[i];
 
 // Go to the relative values, dividing all values ​​by the maximum
     long double pmax = 0;
-    for (int r=0; r<points; r++)
-        if (p[r] > pmax)
-            pmax = p[r];
-    for (int r=0; r<points; r++)
-        p[r] /= pmax;
+    for (int i=0; i<points; i++)
+        if (p[i] > pmax)
+            pmax = p[i];
+    for (int i=0; i<points; i++)
+        p[i] /= pmax;
+}
+
+
+// Sources of 2D model or 3D slice
+struct AtomModel::SliceSetup {
+    long double dr, scale_coeff;
+    const EmptySpaceMap *space;
+    const float *map;
+    int map_size;
+    double map_radius;
+    Camera3D camera;
+    std::shared_ptr<const DensityVolume> vol;
+    std::shared_ptr<const DensityOctree> tree;
+
+    SliceSetup() :
+        dr(0),
+        scale_coeff(0),
+        space(nullptr),
+        map(nullptr),
+        map_size(0),
+        map_radius(0),
+        camera(0, 0, 0, 0) {
+    }
+};
+
+
+// Choose sources of 2D model
+void AtomModel::setup2D(SliceSetup &s, int width, int height)
+{
+    s.dr = maxRelativeRadius() * BOHR_RADIUS / sqrt((long double)height*height + (long double)width*width) * 2;
+    s.space = &getEmptySpaceMap();
+
+// Meridional map of atlas is used when its nodes are not sparser than two pixels
+    s.map_size = atlas ? atlas->getMeridionalSize() : 0;
+    s.map = atlas ? atlas->meridionalMap(canonicalState(), s.map_radius) : nullptr;
+    if (s.map && s.map_radius / (s.map_size - 1) > 2 * s.dr / BOHR_RADIUS)
+        s.map = nullptr;
+}
+
+
+// Choose sources of 3D slice
+void AtomModel::setup3D(SliceSetup &s, int width, int height, long double mov_x, long double mov_y, long double rot_x, long double rot_y, long double zoom)
+{
+    s.dr = maxRelativeRadius() * BOHR_RADIUS;
+    s.camera = Camera3D(mov_x, mov_y, rot_x, rot_y);
+    s.space = &getEmptySpaceMap();
+    s.scale_coeff = 2.0l / sqrt((long double)height*height + (long double)width*width) / zoom;
+
+// Voxel volume level is chosen by pixel size: coarser levels for zoomed out views, and psi-function
+// for views zoomed in beyond voxel resolution
+    if (volume_enabled && volume_octree) {
+        s.tree = getOctree();
+    } else if (volume_enabled) {
+        double pixel = s.scale_coeff * maxRelativeRadius();
+        std::shared_ptr<const DensityVolume> full = getVolume();
+        int level = 0;
+        for (double step = full->getStep() * 2; step <= pixel; step *= 2)
+            level++;
+        if (pixel * 2 >= full->getStep())
+            s.vol = (level == 0) ? full : getVolumeLevel(level);
+    }
+}
+
+
+// Compute region of 2D model
+void AtomModel::region2D(const SliceSetup &s, long double *p, size_t stride, int width, int height, const Tile &region, DensityHistogram &hist)
+{
+    for (int yy=region.y0; yy<region.y1; yy++)
+        for (int xx=region.x0; xx<region.x1; xx++) {
+
+        // Compute radius and theta
+            long double z = height/2 - yy;
+            long double xy = xx - width/2;
+            long double r = sqrt(z*z + xy*xy);
+            long double cos_theta = z / r;
+            r *= s.dr;
+
+        // Compute probability or probability density, empty regions are filled with zero
+            long double v = 0;
+            if (!s.space->isEmptySpherical(r / BOHR_RADIUS, cos_theta)) {
+                if (s.map)
+                    v = StateAtlas::sampleMeridional(s.map, s.map_size, s.map_radius, fabs(xy) * s.dr / BOHR_RADIUS, z * s.dr / BOHR_RADIUS);
+                else
+                    v = squareSpherical(r, acos(cos_theta), 0);
+                if (!probability_density)
+                    v *= r * r;
+            }
+            p[(yy - region.y0) * stride + (xx - region.x0)] = v;
+            hist.add(v);
+        }
+}
+
+
+// Compute region of 3D slice
+void AtomModel::region3D(const SliceSetup &s, long double *p, size_t stride, int width, int height, const Tile &region, DensityHistogram &hist)
+{
+    for (int yy=region.y0; yy<region.y1; yy++)
+        for (int xx=region.x0; xx<region.x1; xx++) {
+
+        // Compute canvas coordinates
+            long double cx = (xx - width/2) * s.scale_coeff;
+            long double cy = (height/2 - yy) * s.scale_coeff;
+
+        // Compute 3D coordinates
+            Vector3D xyz = s.camera.planePoint(cx, cy);
+            long double x = xyz.x * s.dr;
+            long double y = xyz.y * s.dr;
+            long double z = xyz.z * s.dr;
+
+        // Compute probability or probability density, empty regions are filled with zero
+            long double v = 0;
+            if (s.vol) {
+                v = volumeValue(*s.vol, x / BOHR_RADIUS, y / BOHR_RADIUS, z / BOHR_RADIUS);
+            } else if (s.tree) {
+                double bx = x / BOHR_RADIUS, by = y / BOHR_RADIUS, bz = z / BOHR_RADIUS;
+                v = densityValue(s.tree->sample(bx, by, bz), bx*bx + by*by + bz*bz);
+            } else if (!s.space->isEmpty(x / BOHR_RADIUS, y / BOHR_RADIUS, z / BOHR_RADIUS)) {
+                v = squareCartesian(x, y, z);
+                if (!probability_density)
+                    v *= x*x + y*y + z*z;
+            }
+            p[(yy - region.y0) * stride + (xx - region.x0)] = v;
+            hist.add(v);
+        }
 }
 
 
 // Compute 2D model
 void AtomModel::model2D(long double *p, int width, int height) {
 
-    long double dr = maxRelativeRadius() * BOHR_RADIUS / sqrt(height*height + width*width) * 2;
+    SliceSetup s;
+    setup2D(s, width, height);
+
+// Per tile modelling, each worker collects histogram of its values
+    std::vector<DensityHistogram> hist(TileScheduler::threadCount());
+    TileScheduler::forEachTile(width, height, [&](const Tile &tile, int worker) {
+        region2D(s, p + (size_t)tile.y0 * width + tile.x0, width, width, height, tile, hist[worker]);
+    });
+
+// Go to the relative values
+    for (size_t i=1; i<hist.size(); i++)
+        hist[0].merge(hist[i]);
+    normalize(p, height*width, hist[0]);
+}
+
+
+// Compute 3D model
+void AtomModel::model3D(long double *p, int width, int height, long double mov_x, long double mov_y, long double rot_x, long double rot_y, long double zoom) {
+
+    SliceSetup s;
+    setup3D(s, width, height, mov_x, mov_y, rot_x, rot_y, zoom);
+
+// Per tile modelling, each worker collects histogram of its values
+    std::vector<DensityHistogram> hist(TileScheduler::threadCount());
+    TileScheduler::forEachTile(width, height, [&](const Tile &tile, int worker) {
+        region3D(s, p + (size_t)tile.y0 * width + tile.x0, width, width, height, tile, hist[worker]);
+    });
+
+// Go to the relative values
+    for (size_t i=1; i<hist.size(); i++)
+        hist[0].merge(hist[i]);
+    normalize(p, height*width, hist[0]);
+}
+
+
+// Compute regions in parallel, every worker has its own buffer and histogram
+DensityHistogram AtomModel::computeRegions(const std::vector<Tile> &regions,
+                                           const std::function<void(long double *p, const Tile &region, DensityHistogram &hist)> &compute,
+                                           const std::function<void(const Tile &region, const long double *p, int worker)> &output)
+{
+    std::vector<DensityHistogram> hist(TileScheduler::threadCount());
+    std::vector<std::vector<long double>> buffers(hist.size());
+    TileScheduler::forEach(regions.size(), [&](int index, int worker) {
+        const Tile &region = regions[index];
+        std::vector<long double> &p = buffers[worker];
+        p.resize((size_t)(region.x1 - region.x0) * (region.y1 - region.y0));
+        compute(p.data(), region, hist[worker]);
+        output(region, p.data(), worker);
+    });
+    for (size_t i=1; i<hist.size(); i++)
+        hist[0].merge(hist[i]);
+    return hist[0];
+}
+
+
+// Compute regions of 2D model
+DensityHistogram AtomModel::model2DRegions(int width, int height, const std::vector<Tile> &regions,
+                                           const std::function<void(const Tile &region, const long double *p, int worker)> &output)
+{
+    SliceSetup s;
+    setup2D(s, width, height);
+    return computeRegions(regions, [&](long double *p, const Tile &region, DensityHistogram &hist) {
+        region2D(s, p, region.x1 - region.x0, width, height, region, hist);
+    }, output);
+}
+
 
-    for (int yy=0; yy<height; yy++)
-        for (int xx=0; xx<width; xx++) {
+// Compute regions of 3D slice
+DensityHistogram AtomModel::model3DRegions(int width, int height, const std::vector<Tile> &regions,
+                                           long double mov_x, long double mov_y, long double rot_x, long double rot_y, long double zoom,
+                                           const std::function<void(const Tile &region, const long double *p, int worker)> &output)
+{
+    SliceSetup s;
+    setup3D(s, width, height, mov_x, mov_y, rot_x, rot_y, zoom);
+    return computeRegions(regions, [&](long double *p, const Tile &region, DensityHistogram &hist) {
+        region3D(s, p, region.x1 - region.x0, width, height, region, hist);
+    }, output);
+}
 
-            // Compute radius and theta
-                long double z = height/2 - yy;
-                long double xy = xx - width/2;
-                long double r = sqrt(z*z + xy*xy);
-                long double theta = acos(z / r);
-                r *= dr;
 
-            // Compute probability or probability density
-                if (probability_density) {
-                    p[yy*width + xx] = squareSpherical(r, theta, 0);
-                } else {
-                    p[yy*width + xx] = squareSpherical(r, theta, 0) * r * r;
+// Get white level of model values
+long double AtomModel::relativeLevel(const DensityHistogram &hist) const
+{
+    long double level = tone_map.clipLevel(hist);
+    return (level > 0) ? level : 0;
+}
+
+
+// Compute volumetric 3D model
+void AtomModel::modelVolume(long double *p, int width, int height, long double mov_x, long double mov_y, long double rot_x, long double rot_y, long double zoom) {
+
+    const int base_steps = 192;
+    const double transparency_limit = 0.002;
+    const double empty_threshold = 1e-6;
+
+    updateTables();
+    std::shared_ptr<const DensityVolume> vol;
+    std::shared_ptr<const DensityOctree> tree;
+    if (volume_enabled && volume_octree)
+        tree = getOctree();
+    else if (volume_enabled)
+        vol = getVolume();
+    Camera3D camera(mov_x, mov_y, rot_x, rot_y);
+    Vector3D dir = camera.viewDirection();
+    double dx = dir.x, dy = dir.y, dz = dir.z;
+
+// Rays are traced through the bounding sphere, its empty outer layer is skipped
+    double rmax = maxRelativeRadius();
+    const EmptySpaceMap &space = getEmptySpaceMap();
+    double bound = space.cutoffRadius() / rmax;
+    if (bound > 1)
+        bound = 1;
+    double base_step = 2 * bound / base_steps;
+    double kappa = volume_opacity;
+
+// Per tile ray marching, each worker collects histogram of its values
+    long double scale_coeff = 2.0l / sqrt(height*height + width*width) / zoom;
+    std::vector<DensityHistogram> hist(TileScheduler::threadCount());
+    TileScheduler::forEachTile(width, height, [&](const Tile &tile, int worker) {
+        for (int yy=tile.y0; yy<tile.y1; yy++)
+            for (int xx=tile.x0; xx<tile.x1; xx++) {
+
+            // Find intersection of the ray with bounding sphere
+                Vector3D origin = camera.planePoint((xx - width/2) * scale_coeff, (height/2 - yy) * scale_coeff);
+                double ox = origin.x, oy = origin.y, oz = origin.z;
+                double b = ox*dx + oy*dy + oz*dz;
+                double disc = b*b - (ox*ox + oy*oy + oz*oz - bound*bound);
+                long double v = 0;
+                if (disc > 0) {
+                    double t = -b - sqrt(disc);
+                    double t_end = -b + sqrt(disc);
+
+                // Emission-absorption integration, step grows in regions of low density
+                    double transparency = 1, light = 0;
+                    auto integrate = [&](double d, double step) {
+                    // Step absorbs 1 - exp(-depth) of the light reaching it, so a dense step of opaque model absorbs all of it
+                        double absorbed = 1 - exp(-kappa * d * step);
+                        light += transparency * absorbed;
+                        transparency -= transparency * absorbed;
+                    // Early ray termination, the rest of the ray is hidden
+                        return transparency >= transparency_limit;
+                    };
+
+                // Octree is traversed leaf by leaf (in Bohr radii), empty leaves are passed at once
+                    if (tree) {
+                        tree->traceRay(ox * rmax, oy * rmax, oz * rmax, dx, dy, dz, t * rmax, t_end * rmax,
+                                       [&](const DensityOctree::Leaf &leaf, double t_in, double t_out) {
+                            double lo[3] = {leaf.x0, leaf.y0, leaf.z0}, far_r2 = 0;
+                            for (int a=0; a<3; a++) {
+                                double f = fmax(fabs(lo[a]), fabs(lo[a] + leaf.size));
+                                far_r2 += f * f;
+                            }
+                            if (densityValue(leaf.maximum(), far_r2) < empty_threshold)
+                                return true;
+                            for (t = fmax(t, t_in / rmax); t * rmax < t_out; ) {
+                                double x = (ox + t*dx) * rmax, y = (oy + t*dy) * rmax, z = (oz + t*dz) * rmax;
+                                double d = densityValue(leaf.sample(x, y, z), x*x + y*y + z*z);
+                                double step = (d > 1.0 / 32) ? base_step : base_step * (4 - 96 * d);
+                                if (!integrate(d, step))
+                                    return false;
+                                t += step;
+                            }
+                            return true;
+                        });
+                        t = t_end;
+                    }
+                    while (t < t_end) {
+                        double x = (ox + t*dx) * rmax, y = (oy + t*dy) * rmax, z = (oz + t*dz) * rmax;
+                        double d = vol ? volumeValue(*vol, x, y, z) : tableValue(x, y, z);
+                    // Jump over empty shells and cones
+                        if (d < empty_threshold) {
+                            double skip = space.skipDistance(x, y, z) / rmax;
+                            if (skip > base_step) {
+                                t += skip;
+                                continue;
+                            }
+                        }
+                        double step = (d > 1.0 / 32) ? base_step : base_step * (4 - 96 * d);
+                        if (!integrate(d, step))
+                            break;
+                        t += step;
+                    }
+                    v = light;
                 }
-        }
+                p[yy*width + xx] = v;
+                hist[worker].add(v);
+            }
+    });
 
-// Go to the relative values, dividing all values ​​by the maximum
-    long double pmax = 0;
-    for (int i=0; i<height*width; i++)
-        if (p[i] > pmax)
-            pmax = p[i];
-    for (int i=0; i<height*width; i++)
-        p[i] /= pmax;
+// Go to the relative values
+    for (size_t i=1; i<hist.size(); i++)
+        hist[0].merge(hist[i]);
+    normalize(p, height*width, hist[0]);
 }
 
 
-// Compute 3D model
-void AtomModel::model3D(long double *p, int width, int height, long double mov_x, long double mov_y, long double rot_x, long double rot_y) {
+// Sample probability density at grid
+void AtomModel::modelGrid(float *p, int size, double radius) {
+
+    updateTables();
+    double step = 2 * radius / (size - 1);
+    TileScheduler::forEach(size, [&](int k, int) {
+        modelBox(p + (size_t)k * size * size, size, size, 1, -radius, -radius, -radius + k * step, step);
+    });
+}
 
-    long double dr = maxRelativeRadius() * BOHR_RADIUS;
 
-// Compute camera rotation matrix
-    Matrix3x3 yrot = Matrix3x3(cos(rot_y), 0, sin(rot_y),\
-                               0, 1, 0,\
-                               -sin(rot_y), 0, cos(rot_y));
-    Matrix3x3 xrot = Matrix3x3(1, 0, 0,\
-                               0, cos(rot_x), -sin(rot_x),\
-                               0, sin(rot_x), cos(rot_x));
-    Matrix3x3 camera_rotation = xrot * yrot;
+// Sample probability density at box grid
+void AtomModel::modelBox(float *p, int nx, int ny, int nz, double x0, double y0, double z0, double step) {
 
-// Compute camera position vector
-    Vector3D camera_position(0, mov_x, mov_y) ;
-    camera_position *= 0.2;
+    updateTables();
+    for (int k=0; k<nz; k++)
+        for (int j=0; j<ny; j++)
+            for (int i=0; i<nx; i++)
+                *p++ = tableDensity(x0 + i * step, y0 + j * step, z0 + k * step);
+}
 
-// Per pixel modelling
-    long double scale_coeff = 2.0l / sqrt(height*height + width*width);
-    for (int yy=0; yy<height; yy++)
-        for (int xx=0; xx<width; xx++) {
 
-        // Compute canvas coordinates
-            long double cx = (xx - width/2) * scale_coeff;
-            long double cy = (height/2 - yy) * scale_coeff;
+// Sample probability density at meridional plane grid
+void AtomModel::modelPlane(float *p, int nx, int nz, double x0, double z0, double step, int samples) {
 
-        // Compute 3D coordinates
-            Vector3D xyz = Vector3D(0, cx, cy) - camera_position;
-            xyz = camera_rotation * xyz;
-            long double x = xyz.x * dr;
-            long double y = xyz.y * dr;
-            long double z = xyz.z * dr;
-
-        // Compute probability or probability density
-            if (probability_density) {
-                p[yy*width + xx] = squareCartesian(x, y, z);
-            } else {
-                p[yy*width + xx] = squareCartesian(x, y, z) * (x*x+y*y+z*z);
+    updateTables();
+    double bohr3 = (double)BOHR_RADIUS * BOHR_RADIUS * BOHR_RADIUS;
+    if (step < table_radius / (RADIAL_TABLE_SIZE - 1)) {
+    // Radial table is too coarse, psi-function is scaled to the table units
+        for (int k=0; k<nz; k++)
+            for (int i=0; i<nx; i++) {
+                double x = x0 + i * step, z = z0 + k * step;
+                double r = sqrt(x*x + z*z);
+                double cos_theta = (r > 0) ? z / r : 1;
+                *p++ = squareRadialComponent(r * BOHR_RADIUS) * bohr3 * squareAngularComponent(acos(cos_theta), 0) * density_scale;
             }
+        return;
+    }
+    for (int k=0; k<nz; k++)
+        for (int i=0; i<nx; i++) {
+            double v = 0;
+            for (int b=0; b<samples; b++)
+                for (int a=0; a<samples; a++)
+                    v += tableDensity(x0 + (i + (a + 0.5) / samples - 0.5) * step, 0, z0 + (k + (b + 0.5) / samples - 0.5) * step);
+            *p++ = v / (samples * samples);
         }
+}
 
-// Go to the relative values, dividing all values ​​by the maximum
-    long double pmax = 0;
-    for (int i=0; i<height*width; i++)
-        if (p[i] > pmax)
-            pmax = p[i];
-   for (int i=0; i<height*width; i++)
-        p[i] /= pmax;
+
+// Sample probability density at meridional half plane
+void AtomModel::modelMeridional(float *p, int size) {
+
+    updateTables();
+    double step = table_radius / (size - 1);
+    TileScheduler::forEach(2 * size - 1, [&](int j, int) {
+        for (int i=0; i<size; i++)
+            p[(size_t)j * size + i] = tableDensity(i * step, 0, -table_radius + j * step);
+    });
+}
+
+
+// Build tables of psi-function components for current state, only tables of changed factors are rebuilt
+void AtomModel::updateTables()
+{
+    bool radial_changed = false, angular_changed = false;
+    auto start = std::chrono::steady_clock::now();
+
+// Radial table covers radius of probability model, which is the larger one
+    if (radial_n != qn || radial_l != ql) {
+        table_radius = qn * qn * 10 / log(qn+7);
+        radial_data = atlas ? atlas->radialTable(qn, ql, radial_peak, radial_probability_peak) : nullptr;
+        radial_entry.reset();
+        if (radial_data == nullptr && shared_cache) {
+            double peaks[2];
+            radial_data = sharedTable('R', qn, ql, RADIAL_TABLE_SIZE, peaks, 2, radial_entry);
+            radial_peak = peaks[0];
+            radial_probability_peak = peaks[1];
+        }
+    }
+
+// Both radius and exponential envelope exp(-2r/n) depend on n only
+    if (radial_data == nullptr && envelope_n != qn) {
+        envelope_table.resize(RADIAL_TABLE_SIZE);
+        for (int i=0; i<RADIAL_TABLE_SIZE; i++)
+            envelope_table[i] = exp(-2.0l * table_radius * i / (RADIAL_TABLE_SIZE - 1) / qn);
+        envelope_n = qn;
+    }
+
+// Radial table, R^2 * r0^3 = N^2 * (2/n)^3 * q^2l * exp(-q) * L(q)^2, q = 2r/(r0*n)
+    if (radial_n != qn || radial_l != ql) {
+        if (radial_data == nullptr) {
+            long double dr = table_radius / (RADIAL_TABLE_SIZE - 1);
+            long double norm = 1.0l * factor(qn-ql-1) / (2*qn) / factor(qn+ql) * binpow(2.0l / qn, 3);
+            radial_table.resize(RADIAL_TABLE_SIZE);
+            radial_peak = 0;
+            radial_probability_peak = 0;
+            for (int i=0; i<RADIAL_TABLE_SIZE; i++) {
+                long double r = dr * i;
+                long double q = 2 * r / qn;
+                long double L = LaguerrePoly(q);
+                radial_table[i] = norm * binpow(q, 2*ql) * envelope_table[i] * L * L;
+                if (radial_table[i] > radial_peak)
+                    radial_peak = radial_table[i];
+                if (radial_table[i] * r * r > radial_probability_peak)
+                    radial_probability_peak = radial_table[i] * r * r;
+            }
+            radial_data = radial_table.data();
+            double peaks[2] = {radial_peak, radial_probability_peak};
+            storeSharedTable('R', qn, ql, radial_data, RADIAL_TABLE_SIZE, peaks, 2);
+        }
+        radial_n = qn;
+        radial_l = ql;
+        radial_changed = true;
+    }
+
+// Angular table
+    if (angular_l != ql || angular_m != abs(qm)) {
+        angular_data = atlas ? atlas->angularTable(ql, qm, angular_peak) : nullptr;
+        angular_entry.reset();
+        if (angular_data == nullptr && shared_cache)
+            angular_data = sharedTable('A', ql, abs(qm), ANGULAR_TABLE_SIZE, &angular_peak, 1, angular_entry);
+        if (angular_data == nullptr) {
+            angular_table.resize(ANGULAR_TABLE_SIZE);
+            angular_peak = 0;
+            for (int i=0; i<ANGULAR_TABLE_SIZE; i++) {
+                long double c = -1 + 2.0l * i / (ANGULAR_TABLE_SIZE - 1);
+                angular_table[i] = squareAngularComponent(acos(c), 0);
+                if (angular_table[i] > angular_peak)
+                    angular_peak = angular_table[i];
+            }
+            angular_data = angular_table.data();
+            storeSharedTable('A', ql, abs(qm), angular_data, ANGULAR_TABLE_SIZE, &angular_peak, 1);
+        }
+        angular_l = ql;
+        angular_m = abs(qm);
+        angular_changed = true;
+    }
+
+    if (!radial_changed && !angular_changed)
+        return;
+
+// Empty regions of both model types
+    double dr = table_radius / (RADIAL_TABLE_SIZE - 1);
+    std::vector<double> radial_probability(RADIAL_TABLE_SIZE);
+    for (int i=0; i<RADIAL_TABLE_SIZE; i++)
+        radial_probability[i] = radial_data[i] * (dr * i) * (dr * i);
+    density_space.build(radial_data, RADIAL_TABLE_SIZE, table_radius, angular_data, ANGULAR_TABLE_SIZE, 1e-7);
+    probability_space.build(radial_probability.data(), RADIAL_TABLE_SIZE, table_radius, angular_data, ANGULAR_TABLE_SIZE, 1e-7);
+
+    radial_table_scale = (RADIAL_TABLE_SIZE - 1) / table_radius;
+    density_scale = (radial_peak > 0 && angular_peak > 0) ? 1 / (radial_peak * angular_peak) : 0;
+    probability_scale = (radial_probability_peak > 0 && angular_peak > 0) ? 1 / (radial_probability_peak * angular_peak) : 0;
+
+// Own tables are reaccounted on every rebuild, tables of atlas and shared cache are not owned
+    size_t size = (envelope_table.capacity() + radial_table.capacity() + angular_table.capacity()) * sizeof(double);
+    double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    CacheAccountant::global().miss(CACHE_TABLES);
+    CacheAccountant::global().remove(tables_id);
+    tables_id = CacheAccountant::global().add(CACHE_TABLES, size, ms, cache_guard, nullptr);
+}
+
+
+// Get table from shared cache
+const double * AtomModel::sharedTable(char kind, int a, int b, int size, double *peaks, int peak_count, std::shared_ptr<const void> &entry) const
+{
+    int32_t key[4] = {kind, a, b, size};
+    size_t bytes;
+    std::shared_ptr<const void> data = shared_cache->get(key, sizeof(key), bytes);
+    if (!data || bytes != (size_t)(peak_count + size) * sizeof(double))
+        return nullptr;
+    const double *values = static_cast<const double *>(data.get());
+    for (int i=0; i<peak_count; i++)
+        peaks[i] = values[i];
+    entry = data;
+    return values + peak_count;
+}
+
+
+// Store table with its maxima to shared cache
+void AtomModel::storeSharedTable(char kind, int a, int b, const double *table, int size, const double *peaks, int peak_count) const
+{
+    if (!shared_cache)
+        return;
+    int32_t key[4] = {kind, a, b, size};
+    std::vector<double> values(peaks, peaks + peak_count);
+    values.insert(values.end(), table, table + size);
+    shared_cache->put(key, sizeof(key), values.data(), values.size() * sizeof(double));
+}
+
+
+// Get empty regions of current state and model type
+const EmptySpaceMap & AtomModel::getEmptySpaceMap()
+{
+    updateTables();
+    return probability_density ? density_space : probability_space;
+}
+
+
+// Get radius beyond which probability density is negligible
+double AtomModel::densityCutoffRadius()
+{
+    updateTables();
+    return density_space.cutoffRadius();
+}
+
+
+// Get tabulated square of radial component, relative to its maximum
+double AtomModel::radialValue(double r)
+{
+    updateTables();
+    double fr = r * radial_table_scale;
+    if (fr < 0 || fr >= RADIAL_TABLE_SIZE - 1)
+        return 0;
+    int ir = (int)fr;
+    fr -= ir;
+    return (radial_data[ir] + (radial_data[ir+1] - radial_data[ir]) * fr) / radial_peak;
+}
+
+
+// Get tabulated square of angular component, relative to its maximum
+double AtomModel::angularValue(double cos_theta)
+{
+    updateTables();
+    double fa = (cos_theta + 1) * (0.5 * (ANGULAR_TABLE_SIZE - 1));
+    if (fa < 0)
+        fa = 0;
+    int ia = (int)fa;
+    if (ia >= ANGULAR_TABLE_SIZE - 1)
+        ia = ANGULAR_TABLE_SIZE - 2;
+    fa -= ia;
+    return (angular_data[ia] + (angular_data[ia+1] - angular_data[ia]) * fa) / angular_peak;
+}
+
+
+// Get radius covered by radial table
+double AtomModel::tableRadius()
+{
+    updateTables();
+    return table_radius;
+}
+
+
+// Get radial table with its maxima
+const double * AtomModel::radialTable(double &peak, double &probability_peak)
+{
+    updateTables();
+    peak = radial_peak;
+    probability_peak = radial_probability_peak;
+    return radial_data;
+}
+
+
+// Get angular table with its maximum
+const double * AtomModel::angularTable(double &peak)
+{
+    updateTables();
+    peak = angular_peak;
+    return angular_data;
+}
+
+
+// Get tabulated square of psi-function (not scaled), r2 is set to square of radius
+double AtomModel::tableProduct(double x, double y, double z, double &r2) const
+{
+    r2 = x*x + y*y + z*z;
+    double r = sqrt(r2);
+    double fr = r * radial_table_scale;
+    if (fr >= RADIAL_TABLE_SIZE - 1)
+        return 0;
+    int ir = (int)fr;
+    fr -= ir;
+    double radial = radial_data[ir] + (radial_data[ir+1] - radial_data[ir]) * fr;
+
+    double fa = (r > 0) ? (z / r + 1) * (0.5 * (ANGULAR_TABLE_SIZE - 1)) : ANGULAR_TABLE_SIZE - 1;
+    int ia = (int)fa;
+    if (ia >= ANGULAR_TABLE_SIZE - 1)
+        ia = ANGULAR_TABLE_SIZE - 2;
+    fa -= ia;
+    double angular = angular_data[ia] + (angular_data[ia+1] - angular_data[ia]) * fa;
+
+    return radial * angular;
+}
+
+
+// Get tabulated probability density, relative to its maximum
+double AtomModel::tableDensity(double x, double y, double z) const
+{
+    double r2;
+    return tableProduct(x, y, z, r2) * density_scale;
+}
+
+
+// Get tabulated probability or probability density, relative to its maximum
+double AtomModel::tableValue(double x, double y, double z) const
+{
+    double r2;
+    double v = tableProduct(x, y, z, r2);
+    if (probability_density)
+        return v * density_scale;
+    return v * r2 * probability_scale;
+}
+
+
+// Get probability or probability density from voxel volume, relative to its maximum
+double AtomModel::volumeValue(const DensityVolume &vol, double x, double y, double z) const
+{
+    double v = volume_tricubic ? vol.sampleTricubic(x, y, z) : vol.sampleTrilinear(x, y, z);
+    return densityValue(v, x*x + y*y + z*z);
+}
+
+
+// Convert relative probability density to the value of current mode
+double AtomModel::densityValue(double density, double r2) const
+{
+    if (probability_density)
+        return density;
+    return density * r2 * probability_scale / density_scale;
+}
+
+
+// Divide model values by the white level chosen from their histogram
+void AtomModel::normalize(long double *p, int size, const DensityHistogram &hist) const
+{
+    long double level = tone_map.clipLevel(hist);
+    if (!(level > 0))
+        return;
+    for (int i=0; i<size; i++)
+        p[i] /= level;
 }
 
 
@@ -284,7 +1212,7 @@ long double AtomModel::LaguerrePoly(long double x) {
     L[0] = 1;
     L[1] = 1 + a - x;
     for (int i=1; i<n; i++)
-        L[i+1] = ( (2*i+1-a-x) * L[i] - (i+a) * L[i-1] ) / (i+1);
+        L[i+1] = ( (2*i+1+a-x) * L[i] - (i+a) * L[i-1] ) / (i+1);
 
     return L[n];
 }
@@ -2,12 +2,38 @@
 #define ATOMMODEL_H
 
 
-#include <QString>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "cacheaccountant.h"
+#include "densityvolume.h"
+#include "emptyspace.h"
+#include "tonemap.h"
+
+
+class DensityOctree;
+class SharedCache;
+class StateAtlas;
+struct Tile;
 
 
 #define BOHR_RADIUS 0.52917720859e-10l
 
 
+// Canonical identity of quantum state: probability density depends on |m| only,
+// so states m and -m share all tables and cached results, m is stored as |m|
+struct QuantumState {
+    int n, l, m;
+
+    QuantumState(int _n = 1, int _l = 0, int _m = 0);
+    bool operator<(const QuantumState &op1) const;
+    bool operator==(const QuantumState &op1) const;
+    bool operator!=(const QuantumState &op1) const;
+};
+
+
 class AtomModel {
 
 // Quantum numbers
@@ -16,6 +42,58 @@ class AtomModel {
 // Type of model
     bool probability_density;
 
+// Tone mapping of 2D and 3D models
+    ToneMap tone_map;
+
+// Opacity of volumetric model
+    long double volume_opacity;
+
+// Revisions of radial (n, l) and angular (l, m) factors and of model type, changed by setters
+    unsigned long radial_revision, angular_revision, mode_revision;
+
+// Tabulated squares of radial and angular components for fast evaluation,
+// radius is in Bohr radii, cos(theta) is in [-1, 1]. Each table is rebuilt only when
+// the quantum numbers it depends on change: exp(-2r/n) envelope - n, radial - n and l, angular - l and m.
+// Tables are taken from atlas without copying when it has them
+    std::vector<double> envelope_table, radial_table, angular_table;
+    const double *radial_data, *angular_data;
+    int envelope_n, radial_n, radial_l, angular_l, angular_m;
+    double table_radius, radial_peak, radial_probability_peak, angular_peak;
+    double radial_table_scale, density_scale, probability_scale;
+
+// Empty regions of probability density and probability models of current state
+    EmptySpaceMap density_space, probability_space;
+
+// Optional voxel volume of current state, sampled by 3D models instead of psi-function
+    bool volume_enabled, volume_tricubic;
+    size_t volume_budget;
+    std::shared_ptr<const DensityVolume> volume;
+    QuantumState volume_state;
+
+// Mip levels of voxel volume, level 0 is the volume itself, coarser levels are built on first use
+    std::vector<std::shared_ptr<const DensityVolume>> volume_levels;
+
+// Optional adaptive octree used by 3D models instead of voxel volume
+    bool volume_octree;
+    std::shared_ptr<const DensityOctree> octree;
+    QuantumState octree_state;
+
+// Volume and octree are accounted by cache accountant, which evicts them under mutex of guard.
+// Own tables are accounted as one pinned entry
+    std::shared_ptr<CacheGuard> cache_guard;
+    uint64_t volume_id, octree_id, tables_id;
+
+// Drop voxel volume / octree of current state
+    void resetVolume();
+    void resetOctree();
+
+// Optional precomputed atlas of states
+    std::shared_ptr<const StateAtlas> atlas;
+
+// Optional cache shared with other processes, tables taken from it are kept by entries
+    std::shared_ptr<SharedCache> shared_cache;
+    std::shared_ptr<const void> radial_entry, angular_entry;
+
 // Compute square of psi-function
     long double squareCartesian(long double x, long double y, long double z);
     long double squareSpherical(long double r, long double theta, long double phi);
@@ -30,10 +108,59 @@ class AtomModel {
     long long factor(int n);
     long double binpow(long double x, int n);
 
+// Build tables of psi-function components for current state
+    void updateTables();
+
+// Get table of kind ('R' - radial, 'A' - angular) and quantum numbers from shared cache with its maxima,
+// which precede table values. nullptr if it is missing
+    const double * sharedTable(char kind, int a, int b, int size, double *peaks, int peak_count, std::shared_ptr<const void> &entry) const;
+    void storeSharedTable(char kind, int a, int b, const double *table, int size, const double *peaks, int peak_count) const;
+
+// Get tabulated probability or probability density, relative to its maximum
+    double tableProduct(double x, double y, double z, double &r2) const;
+    double tableValue(double x, double y, double z) const;
+    double tableDensity(double x, double y, double z) const;
+
+// Get probability or probability density from voxel volume, relative to its maximum
+    double volumeValue(const DensityVolume &vol, double x, double y, double z) const;
+
+// Convert relative probability density at square radius r2 to the value of current mode
+    double densityValue(double density, double r2) const;
+
+// Divide model values by the white level chosen from their histogram
+    void normalize(long double *p, int size, const DensityHistogram &hist) const;
+
+// Sources of 2D model or 3D slice chosen once for all its regions: empty space, meridional map of atlas,
+// voxel volume or octree, camera and pixel size
+    struct SliceSetup;
+    void setup2D(SliceSetup &s, int width, int height);
+    void setup3D(SliceSetup &s, int width, int height, long double mov_x, long double mov_y, long double rot_x, long double rot_y, long double zoom);
+
+// Compute region of width x height 2D model / 3D slice without going to relative values,
+// rows of region are stride values apart, values are added to histogram
+    void region2D(const SliceSetup &s, long double *p, size_t stride, int width, int height, const Tile &region, DensityHistogram &hist);
+    void region3D(const SliceSetup &s, long double *p, size_t stride, int width, int height, const Tile &region, DensityHistogram &hist);
+
+// Compute regions in parallel into buffers of workers and pass them to output, return histogram of all values
+    static DensityHistogram computeRegions(const std::vector<Tile> &regions,
+                                           const std::function<void(long double *p, const Tile &region, DensityHistogram &hist)> &compute,
+                                           const std::function<void(const Tile &region, const long double *p, int worker)> &output);
+
 public:
 
+// Sizes of radial and angular tables
+    static const int RADIAL_TABLE_SIZE = 8192;
+    static const int ANGULAR_TABLE_SIZE = 2048;
+
+// Largest principal quantum number: normalization uses exact factorials, which are tabulated up to (n + l)! = 20!
+    static const int MAX_N = 10;
+
 // Set n=1, l=0, m=0, probability_density = false
     AtomModel();
+    ~AtomModel();
+
+    AtomModel(const AtomModel &) = delete;
+    AtomModel & operator=(const AtomModel &) = delete;
 
 // Set / get quantum numbers
     bool set_n(int n);
@@ -43,20 +170,116 @@ public:
     int get_l() const;
     int get_m() const;
 
+// Get canonical identity of current state, used as key of cached results
+    QuantumState canonicalState() const;
+
 // Set / get model type
     void setProbabilityDensityStatus(bool prob_dens);
     bool isProbabilityDensity() const;
 
+// Get revisions of radial factor (n, l), angular factor (l, m) and model type,
+// a model has to be recomputed only when revisions it depends on change
+    unsigned long getRadialRevision() const;
+    unsigned long getAngularRevision() const;
+    unsigned long getModeRevision() const;
+
+// Set / get tone mapping of 2D and 3D models
+    void setToneMap(const ToneMap &tm);
+    const ToneMap & getToneMap() const;
+
+// Set / get opacity of volumetric model
+    bool setVolumeOpacity(long double opacity);
+    long double getVolumeOpacity() const;
+
+// Enable / disable voxel volume of 3D models, memory budget in bytes
+    void setVolumeCache(bool enabled, size_t budget_bytes = 64u << 20);
+    bool isVolumeCacheEnabled() const;
+    size_t getVolumeBudget() const;
+
+// Set / get tricubic (instead of trilinear) interpolation of voxel volume
+    void setVolumeTricubic(bool tricubic);
+    bool isVolumeTricubic() const;
+
+// Get voxel volume of current state, build it if needed
+    std::shared_ptr<const DensityVolume> getVolume();
+
+// Get mip level of voxel volume (0 - full resolution, every level halves grid size), build it if needed.
+// The coarsest level has grid size 16
+    std::shared_ptr<const DensityVolume> getVolumeLevel(int level);
+
+// Set / get adaptive octree (instead of voxel grid) used when voxel volume is enabled
+    void setVolumeOctree(bool enabled);
+    bool isVolumeOctree() const;
+
+// Get adaptive octree of current state, build it if needed
+    std::shared_ptr<const DensityOctree> getOctree();
+
+// Set / get precomputed atlas, states missing in atlas are computed
+    void setAtlas(std::shared_ptr<const StateAtlas> state_atlas);
+    std::shared_ptr<const StateAtlas> getAtlas() const;
+
+// Set / get cache shared with other processes, tables missing in atlas are taken from it
+    void setSharedCache(std::shared_ptr<SharedCache> cache);
+    std::shared_ptr<SharedCache> getSharedCache() const;
+
 // Get quantum state in text format
-    QString getState() const;
+    std::string getState() const;
 
 // Return maximum radius value (relative), when abs(psi(r))^2 >> 0
     long double maxRelativeRadius();
 
+// Get empty regions of current state and model type, radius is in Bohr radii
+    const EmptySpaceMap & getEmptySpaceMap();
+
+// Get radius (in Bohr radii) beyond which probability density is negligible
+    double densityCutoffRadius();
+
+// Get tabulated squares of radial (r in Bohr radii) and angular components, relative to their maxima
+    double radialValue(double r);
+    double angularValue(double cos_theta);
+
+// Get radius (in Bohr radii) covered by radial table
+    double tableRadius();
+
+// Get radial table (RADIAL_TABLE_SIZE values over [0, tableRadius()]) with maxima of R^2 and R^2*r^2,
+// and angular table (ANGULAR_TABLE_SIZE values over cos(theta) in [-1, 1]) with its maximum
+    const double * radialTable(double &peak, double &probability_peak);
+    const double * angularTable(double &peak);
+
 // Compute models
     void modelGraphic(long double *p, int points);
     void model2D(long double *p, int width, int height);
-    void model3D(long double *p, int width, int height, long double mov_x, long double mov_y, long double rot_x, long double rot_y);
+    void model3D(long double *p, int width, int height, long double mov_x, long double mov_y, long double rot_x, long double rot_y, long double zoom = 1);
+    void modelVolume(long double *p, int width, int height, long double mov_x, long double mov_y, long double rot_x, long double rot_y, long double zoom = 1);
+
+// Compute given regions of width x height 2D model / 3D slice, for images larger than memory. Regions are computed
+// in parallel, output gets region, its values (rows are region width apart) and worker. Values are not relative:
+// relative values are computed ones divided by relativeLevel() of histogram of all regions of the model
+    DensityHistogram model2DRegions(int width, int height, const std::vector<Tile> &regions,
+                                    const std::function<void(const Tile &region, const long double *p, int worker)> &output);
+    DensityHistogram model3DRegions(int width, int height, const std::vector<Tile> &regions,
+                                    long double mov_x, long double mov_y, long double rot_x, long double rot_y, long double zoom,
+                                    const std::function<void(const Tile &region, const long double *p, int worker)> &output);
+
+// Get white level (relative value 1) of model values with given histogram, 0 if values are zero
+    long double relativeLevel(const DensityHistogram &hist) const;
+
+// Sample probability density, relative to its maximum, at nx*nz grid nodes (x0 + i*step, 0, z0 + k*step) of meridional plane,
+// x index changes fastest. Every node is the mean of samples x samples tabulated values over its cell or, when step is
+// finer than radial table, psi-function square at the node. Plane is sampled by the calling thread
+    void modelPlane(float *p, int nx, int nz, double x0, double z0, double step, int samples);
+
+// Sample probability density, relative to its maximum, at size x (2*size-1) grid over meridional half plane
+// rho in [0, tableRadius()], z in [-tableRadius(), tableRadius()], rho index changes fastest
+    void modelMeridional(float *p, int size);
+
+// Sample probability density, relative to its maximum, at size^3 grid over cube [-radius, radius]^3 (Bohr radii),
+// x index changes fastest
+    void modelGrid(float *p, int size, double radius);
+
+// Sample probability density, relative to its maximum, at nx*ny*nz grid nodes (x0 + i*step, y0 + j*step, z0 + k*step),
+// x index changes fastest. Box is sampled by the calling thread
+    void modelBox(float *p, int nx, int ny, int nz, double x0, double y0, double z0, double step);
 
 };
 
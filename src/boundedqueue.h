@@ -0,0 +1,89 @@
+#ifndef BOUNDEDQUEUE_H
+#define BOUNDEDQUEUE_H
+
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <mutex>
+#include <vector>
+
+
+// Queue between producer and consumer threads. Producers wait while the queue is full,
+// so items in flight and their memory are bounded by capacity
+template <typename T>
+class BoundedQueue {
+
+    std::deque<T> items;
+    size_t capacity;
+    bool closed;
+    std::mutex mutex;
+    std::condition_variable not_empty, not_full;
+
+public:
+
+    explicit BoundedQueue(size_t _capacity) :
+        capacity(_capacity > 0 ? _capacity : 1),
+        closed(false) {
+    }
+
+    BoundedQueue(const BoundedQueue &) = delete;
+    BoundedQueue & operator=(const BoundedQueue &) = delete;
+
+// Put item, wait while the queue is full. False if the queue is closed
+    bool push(T item)
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        not_full.wait(lock, [&] { return closed || items.size() < capacity; });
+        if (closed)
+            return false;
+        items.push_back(std::move(item));
+        lock.unlock();
+        not_empty.notify_one();
+        return true;
+    }
+
+// Take item, wait while the queue is empty. False if the queue is closed and empty
+    bool pop(T &item)
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        not_empty.wait(lock, [&] { return closed || !items.empty(); });
+        if (items.empty())
+            return false;
+        item = std::move(items.front());
+        items.pop_front();
+        lock.unlock();
+        not_full.notify_one();
+        return true;
+    }
+
+// Take all items, wait while the queue is empty. False if the queue is closed and empty
+    bool popAll(std::vector<T> &batch)
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        not_empty.wait(lock, [&] { return closed || !items.empty(); });
+        if (items.empty())
+            return false;
+        for (auto &item : items)
+            batch.push_back(std::move(item));
+        items.clear();
+        lock.unlock();
+        not_full.notify_all();
+        return true;
+    }
+
+// Stop accepting items, consumers take the remaining ones
+    void close()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            closed = true;
+        }
+        not_empty.notify_all();
+        not_full.notify_all();
+    }
+
+};
+
+
+#endif // BOUNDEDQUEUE_H
@@ -0,0 +1,244 @@
+#include "cacheaccountant.h"
+
+
+CacheGuard::CacheGuard() :
+    alive(true) {
+}
+
+
+// Accountant of all caches of the process
+CacheAccountant & CacheAccountant::global()
+{
+    static CacheAccountant accountant;
+    return accountant;
+}
+
+
+CacheAccountant::CacheAccountant(size_t budget_bytes) :
+    budget(budget_bytes),
+    bytes(0),
+    policy(EVICT_LRU),
+    next_id(1),
+    use_counter(0),
+    inflation(0) {
+    for (int c=0; c<CACHE_CATEGORY_COUNT; c++)
+        category_stats[c] = CacheCategoryStats();
+}
+
+
+// Set memory budget
+void CacheAccountant::setBudget(size_t budget_bytes)
+{
+    std::vector<Victim> victims;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        budget = budget_bytes;
+        victims = collectVictims(0);
+    }
+    evict(victims);
+}
+
+
+// Get memory budget
+size_t CacheAccountant::getBudget() const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return budget;
+}
+
+
+// Set eviction policy
+void CacheAccountant::setPolicy(EvictionPolicy eviction_policy)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    policy = eviction_policy;
+}
+
+
+// Get eviction policy
+EvictionPolicy CacheAccountant::getPolicy() const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return policy;
+}
+
+
+// Priority of entry for cost-aware eviction
+double CacheAccountant::priority(const Entry &entry) const
+{
+    return inflation + entry.compute_ms / ((entry.bytes + 1) / 1048576.0);
+}
+
+
+// Add entry
+uint64_t CacheAccountant::add(CacheCategory category, size_t size, double compute_ms, const std::shared_ptr<CacheGuard> &guard,
+                              const std::function<void(uint64_t id)> &evictor)
+{
+    std::vector<Victim> victims;
+    uint64_t id;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        id = next_id++;
+        Entry &entry = entries[id];
+        entry.category = category;
+        entry.bytes = size;
+        entry.compute_ms = compute_ms;
+        entry.last_use = ++use_counter;
+        entry.priority = priority(entry);
+        entry.guard = guard;
+        entry.evictor = evictor;
+        bytes += size;
+        CacheCategoryStats &s = category_stats[category];
+        s.entries++;
+        s.bytes += size;
+        s.compute_ms += compute_ms;
+        victims = collectVictims(id);
+    }
+    evict(victims);
+    return id;
+}
+
+
+// Change size of entry
+void CacheAccountant::resize(uint64_t id, size_t size)
+{
+    std::vector<Victim> victims;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto it = entries.find(id);
+        if (it == entries.end())
+            return;
+        CacheCategoryStats &s = category_stats[it->second.category];
+        bytes = bytes - it->second.bytes + size;
+        s.bytes = s.bytes - it->second.bytes + size;
+        it->second.bytes = size;
+        victims = collectVictims(id);
+    }
+    evict(victims);
+}
+
+
+// Add compute time of entry
+void CacheAccountant::addCost(uint64_t id, double compute_ms)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = entries.find(id);
+    if (it == entries.end())
+        return;
+    Entry &entry = it->second;
+    entry.compute_ms += compute_ms;
+    entry.priority = priority(entry);
+    category_stats[entry.category].compute_ms += compute_ms;
+}
+
+
+// Count use of entry
+void CacheAccountant::hit(uint64_t id)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = entries.find(id);
+    if (it == entries.end())
+        return;
+    Entry &entry = it->second;
+    entry.last_use = ++use_counter;
+    entry.priority = priority(entry);
+    CacheCategoryStats &s = category_stats[entry.category];
+    s.hits++;
+    s.saved_ms += entry.compute_ms;
+}
+
+
+// Count lookup of missing entry
+void CacheAccountant::miss(CacheCategory category)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    category_stats[category].misses++;
+}
+
+
+// Remove entry
+void CacheAccountant::remove(uint64_t id)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = entries.find(id);
+    if (it == entries.end())
+        return;
+    CacheCategoryStats &s = category_stats[it->second.category];
+    s.entries--;
+    s.bytes -= it->second.bytes;
+    bytes -= it->second.bytes;
+    entries.erase(it);
+}
+
+
+// Remove entries over budget from accounting
+std::vector<CacheAccountant::Victim> CacheAccountant::collectVictims(uint64_t keep)
+{
+    std::vector<Victim> victims;
+    while (bytes > budget) {
+    // Pinned entries and the kept one are never chosen
+        auto victim = entries.end();
+        for (auto it = entries.begin(); it != entries.end(); ++it) {
+            if (it->first == keep || !it->second.evictor)
+                continue;
+            if (victim == entries.end() ||
+                    (policy == EVICT_LRU && it->second.last_use < victim->second.last_use) ||
+                    (policy == EVICT_COST && it->second.priority < victim->second.priority))
+                victim = it;
+        }
+        if (victim == entries.end())
+            break;
+        if (policy == EVICT_COST)
+            inflation = victim->second.priority;
+        Victim v = {victim->first, victim->second.guard, victim->second.evictor};
+        victims.push_back(v);
+        CacheCategoryStats &s = category_stats[victim->second.category];
+        s.entries--;
+        s.bytes -= victim->second.bytes;
+        s.evictions++;
+        bytes -= victim->second.bytes;
+        entries.erase(victim);
+    }
+    return victims;
+}
+
+
+// Run eviction callbacks under mutexes of their caches
+void CacheAccountant::evict(const std::vector<Victim> &victims)
+{
+    for (auto &v : victims) {
+        std::shared_ptr<CacheGuard> guard = v.guard.lock();
+        if (!guard)
+            continue;
+        std::lock_guard<std::mutex> lock(guard->mutex);
+        if (guard->alive)
+            v.evictor(v.id);
+    }
+}
+
+
+// Get statistics of category
+CacheCategoryStats CacheAccountant::stats(CacheCategory category) const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return category_stats[category];
+}
+
+
+// Get statistics of all categories
+CacheCategoryStats CacheAccountant::total() const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    CacheCategoryStats t = CacheCategoryStats();
+    for (int c=0; c<CACHE_CATEGORY_COUNT; c++) {
+        const CacheCategoryStats &s = category_stats[c];
+        t.entries += s.entries;
+        t.bytes += s.bytes;
+        t.hits += s.hits;
+        t.misses += s.misses;
+        t.evictions += s.evictions;
+        t.compute_ms += s.compute_ms;
+        t.saved_ms += s.saved_ms;
+    }
+    return t;
+}
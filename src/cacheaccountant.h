@@ -0,0 +1,135 @@
+#ifndef CACHEACCOUNTANT_H
+#define CACHEACCOUNTANT_H
+
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+
+// Kind of cached artifacts
+enum CacheCategory {
+    CACHE_TABLES,
+    CACHE_FRAMES,
+    CACHE_VOLUMES,
+    CACHE_MESHES,
+    CACHE_CLOUDS,
+    CACHE_PYRAMIDS,
+    CACHE_CATEGORY_COUNT
+};
+
+
+// Choice of evicted entry: least recently used, or the cheapest to recompute per byte
+// (GreedyDual-Size, expensive entries stay longer, unused ones still age out)
+enum EvictionPolicy {
+    EVICT_LRU,
+    EVICT_COST
+};
+
+
+// Statistics of category, compute time is spent on added entries, saved time is compute time of hit entries
+struct CacheCategoryStats {
+    size_t entries, bytes;
+    unsigned long long hits, misses, evictions;
+    double compute_ms, saved_ms;
+};
+
+
+// Lifetime guard of cache. Cache keeps its entries under the mutex, eviction callbacks are run
+// under it too, and are skipped when the cache is destroyed (alive is false)
+struct CacheGuard {
+    std::mutex mutex;
+    bool alive;
+
+    CacheGuard();
+};
+
+
+// Memory accounting of all cached artifacts with common budget. Caches add their entries with size
+// and compute time, and the accountant evicts entries of any cache over budget by their callbacks.
+// Callbacks are run without the accountant lock, so caches must not hold their mutex while adding
+// or resizing entries; hit(), miss() and remove() can be called under it
+class CacheAccountant {
+
+    struct Entry {
+        CacheCategory category;
+        size_t bytes;
+        double compute_ms;
+        unsigned long long last_use;
+        double priority;
+        std::weak_ptr<CacheGuard> guard;
+        std::function<void(uint64_t id)> evictor;
+    };
+
+    struct Victim {
+        uint64_t id;
+        std::weak_ptr<CacheGuard> guard;
+        std::function<void(uint64_t id)> evictor;
+    };
+
+    std::map<uint64_t, Entry> entries;
+    size_t budget, bytes;
+    EvictionPolicy policy;
+    uint64_t next_id;
+    unsigned long long use_counter;
+// Priority of the last evicted entry, priorities of new and hit entries start from it
+    double inflation;
+    CacheCategoryStats category_stats[CACHE_CATEGORY_COUNT];
+    mutable std::mutex mutex;
+
+// Priority of entry for cost-aware eviction: compute time per megabyte
+    double priority(const Entry &entry) const;
+
+// Remove entries over budget from accounting, except given one, and return them (mutex is locked)
+    std::vector<Victim> collectVictims(uint64_t keep);
+
+// Run eviction callbacks
+    static void evict(const std::vector<Victim> &victims);
+
+public:
+
+// Default memory budget in bytes
+    static const size_t DEFAULT_BUDGET = (size_t)1024 << 20;
+
+// Accountant of all caches of the process
+    static CacheAccountant & global();
+
+    explicit CacheAccountant(size_t budget_bytes = DEFAULT_BUDGET);
+
+// Set / get memory budget in bytes, entries over budget are evicted
+    void setBudget(size_t budget_bytes);
+    size_t getBudget() const;
+
+// Set / get eviction policy
+    void setPolicy(EvictionPolicy eviction_policy);
+    EvictionPolicy getPolicy() const;
+
+// Add entry and return its id, entries over budget are evicted. Entry without evictor is pinned:
+// it is accounted, but never evicted
+    uint64_t add(CacheCategory category, size_t size, double compute_ms, const std::shared_ptr<CacheGuard> &guard,
+                 const std::function<void(uint64_t id)> &evictor);
+
+// Change size of entry, entries over budget are evicted
+    void resize(uint64_t id, size_t size);
+
+// Add compute time spent on entry after it was added (parts computed on demand)
+    void addCost(uint64_t id, double compute_ms);
+
+// Count use of entry / lookup of missing entry
+    void hit(uint64_t id);
+    void miss(CacheCategory category);
+
+// Remove entry evicted or dropped by its cache, unknown ids are ignored
+    void remove(uint64_t id);
+
+    CacheCategoryStats stats(CacheCategory category) const;
+    CacheCategoryStats total() const;
+
+};
+
+
+#endif // CACHEACCOUNTANT_H
@@ -0,0 +1,40 @@
+#include "camera.h"
+
+
+Camera3D::Camera3D(long double mov_x, long double mov_y, long double rot_x, long double rot_y) {
+
+// Compute camera rotation matrix
+    Matrix3x3 yrot = Matrix3x3(cos(rot_y), 0, sin(rot_y),\
+                               0, 1, 0,\
+                               -sin(rot_y), 0, cos(rot_y));
+    Matrix3x3 xrot = Matrix3x3(1, 0, 0,\
+                               0, cos(rot_x), -sin(rot_x),\
+                               0, sin(rot_x), cos(rot_x));
+    rotation = xrot * yrot;
+
+// Compute camera position vector
+    position = Vector3D(0, mov_x, mov_y);
+    position *= 0.2;
+}
+
+
+// Get model point of view plane for canvas coordinates
+Vector3D Camera3D::planePoint(long double cx, long double cy) const {
+    return rotation * (Vector3D(0, cx, cy) - position);
+}
+
+
+// Get direction of view rays
+Vector3D Camera3D::viewDirection() const {
+    return rotation * Vector3D(1, 0, 0);
+}
+
+
+// Project model point to canvas coordinates
+void Camera3D::project(const Vector3D &point, long double &cx, long double &cy, long double &depth) const {
+// Rotation matrix is orthogonal, so inverse rotation is multiplication by transposed matrix
+    Vector3D v = point * rotation + position;
+    depth = v.x;
+    cx = v.y;
+    cy = v.z;
+}
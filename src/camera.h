@@ -0,0 +1,26 @@
+#ifndef CAMERA_H
+#define CAMERA_H
+
+
+#include "vectormatrix.h"
+
+
+// Camera of 3D model, coordinates are relative to the model radius
+struct Camera3D {
+    Matrix3x3 rotation;
+    Vector3D position;
+
+    Camera3D(long double mov_x, long double mov_y, long double rot_x, long double rot_y);
+
+// Get model point of view plane for canvas coordinates
+    Vector3D planePoint(long double cx, long double cy) const;
+
+// Get direction of view rays
+    Vector3D viewDirection() const;
+
+// Project model point to canvas coordinates, depth is distance along view rays
+    void project(const Vector3D &point, long double &cx, long double &cy, long double &depth) const;
+};
+
+
+#endif // CAMERA_H
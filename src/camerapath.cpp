@@ -0,0 +1,141 @@
+#include "camerapath.h"
+
+#include <climits>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+
+
+// Check that value is integer in range, before it is converted to int
+static bool is_integer(long double v, long double min, long double max)
+{
+    return v >= min && v <= max && v == floorl(v);
+}
+
+
+// Parse keyframes
+bool CameraPath::parse(const std::string &text)
+{
+    keys.clear();
+    size_t start = 0;
+    while (start < text.size()) {
+        size_t end = text.find('\n', start);
+        if (end == std::string::npos)
+            end = text.size();
+        std::string line = text.substr(start, end - start);
+        start = end + 1;
+        size_t comment = line.find('#');
+        if (comment != std::string::npos)
+            line.resize(comment);
+
+    // Line has 5, 6 or 9 numbers, empty lines are skipped
+        long double v[10];
+        int count = 0;
+        const char *p = line.c_str();
+        char *next;
+        while (count < 10) {
+            v[count] = strtold(p, &next);
+            if (next == p)
+                break;
+            count++;
+            p = next;
+        }
+        while (*p == ' ' || *p == '\t' || *p == '\r')
+            p++;
+        if (count == 0 && *p == 0)
+            continue;
+        if ((count != 5 && count != 6 && count != 9) || *p != 0)
+            return false;
+
+    // strtold accepts nan and inf, frame and state are integers, frame count fits in int
+        for (int i=0; i<count; i++)
+            if (!std::isfinite(v[i]))
+                return false;
+        if (!is_integer(v[0], 0, INT_MAX - 1))
+            return false;
+        if (count == 9 && (!is_integer(v[6], 1, AtomModel::MAX_N) || !is_integer(v[7], 0, AtomModel::MAX_N) ||
+                           !is_integer(v[8], -AtomModel::MAX_N, AtomModel::MAX_N)))
+            return false;
+
+        CameraKey key;
+        key.frame = (int)v[0];
+        key.mov_x = v[1];
+        key.mov_y = v[2];
+        key.rot_x = v[3];
+        key.rot_y = v[4];
+        key.zoom = (count > 5) ? v[5] : 1;
+        key.has_state = (count == 9);
+        if (key.has_state) {
+            int n = (int)v[6], l = (int)v[7], m = (int)v[8];
+            if (n < 1 || n > AtomModel::MAX_N || l < 0 || l >= n || abs(m) > l)
+                return false;
+            key.state = QuantumState(n, l, m);
+        }
+        if (key.frame < 0 || key.zoom <= 0 || (!keys.empty() && key.frame <= keys.back().frame))
+            return false;
+        keys.push_back(key);
+    }
+    return !keys.empty();
+}
+
+
+// Read keyframes from file
+bool CameraPath::load(const std::string &path)
+{
+    FILE *file = fopen(path.c_str(), "rb");
+    if (file == nullptr)
+        return false;
+    std::string text;
+    char buffer[4096];
+    size_t size;
+    while ((size = fread(buffer, 1, sizeof(buffer), file)) > 0)
+        text.append(buffer, size);
+    fclose(file);
+    return parse(text);
+}
+
+
+int CameraPath::frameCount() const
+{
+    return keys.empty() ? 0 : keys.back().frame + 1;
+}
+
+
+// Set camera of view at frame
+void CameraPath::camera(int frame, View3D &view) const
+{
+    if (keys.empty())
+        return;
+
+// Frames before the first keyframe and after the last one keep their camera
+    size_t next = 0;
+    while (next < keys.size() && keys[next].frame < frame)
+        next++;
+    if (next == keys.size())
+        next--;
+    const CameraKey &a = keys[(next > 0) ? next - 1 : 0], &b = keys[next];
+    long double t = (b.frame > a.frame) ? (long double)(frame - a.frame) / (b.frame - a.frame) : 0;
+    if (t < 0)
+        t = 0;
+    if (t > 1)
+        t = 1;
+    view.mov_x = a.mov_x + (b.mov_x - a.mov_x) * t;
+    view.mov_y = a.mov_y + (b.mov_y - a.mov_y) * t;
+    view.rot_x = a.rot_x + (b.rot_x - a.rot_x) * t;
+    view.rot_y = a.rot_y + (b.rot_y - a.rot_y) * t;
+    view.zoom = a.zoom + (b.zoom - a.zoom) * t;
+}
+
+
+// Get state at frame
+QuantumState CameraPath::state(int frame, const QuantumState &initial) const
+{
+    QuantumState state = initial;
+    for (auto &key : keys) {
+        if (key.frame > frame)
+            break;
+        if (key.has_state)
+            state = key.state;
+    }
+    return state;
+}
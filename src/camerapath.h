@@ -0,0 +1,48 @@
+#ifndef CAMERAPATH_H
+#define CAMERAPATH_H
+
+
+#include <string>
+#include <vector>
+
+#include "atommodel.h"
+#include "framerenderer.h"
+
+
+// Keyframe of camera path: camera of 3D model and, optionally, state shown from this frame
+struct CameraKey {
+    int frame;
+    long double mov_x, mov_y, rot_x, rot_y, zoom;
+    bool has_state;
+    QuantumState state;
+};
+
+
+// Camera trajectory of animation. Camera is interpolated linearly between keyframes,
+// state changes at keyframes which set it
+class CameraPath {
+
+    std::vector<CameraKey> keys;
+
+public:
+
+// Parse keyframes, one per line: FRAME MOV_X MOV_Y ROT_X ROT_Y [ZOOM [N L M]], '#' starts comment.
+// False on malformed line, invalid state or frames which don't increase
+    bool parse(const std::string &text);
+
+// Read keyframes from file
+    bool load(const std::string &path);
+
+// Number of frames: the last keyframe is the last frame
+    int frameCount() const;
+
+// Set camera and zoom of view at frame
+    void camera(int frame, View3D &view) const;
+
+// Get state at frame: state of the last keyframe with state at or before frame, or initial state
+    QuantumState state(int frame, const QuantumState &initial) const;
+
+};
+
+
+#endif // CAMERAPATH_H
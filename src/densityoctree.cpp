@@ -0,0 +1,272 @@
+#include "densityoctree.h"
+#include "atommodel.h"
+#include "parallel.h"
+
+#include <algorithm>
+#include <cmath>
+
+
+// Trilinear interpolation inside leaf
+float DensityOctree::Leaf::sample(double x, double y, double z) const
+{
+    float tx = (x - x0) / size, ty = (y - y0) / size, tz = (z - z0) / size;
+    tx = (tx < 0) ? 0 : (tx > 1) ? 1 : tx;
+    ty = (ty < 0) ? 0 : (ty > 1) ? 1 : ty;
+    tz = (tz < 0) ? 0 : (tz > 1) ? 1 : tz;
+    float c00 = corners[0] + (corners[1] - corners[0]) * tx;
+    float c10 = corners[2] + (corners[3] - corners[2]) * tx;
+    float c01 = corners[4] + (corners[5] - corners[4]) * tx;
+    float c11 = corners[6] + (corners[7] - corners[6]) * tx;
+    float c0 = c00 + (c10 - c00) * ty;
+    float c1 = c01 + (c11 - c01) * ty;
+    return c0 + (c1 - c0) * tz;
+}
+
+
+// Maximum of leaf corners, it is maximum of interpolated density too
+float DensityOctree::Leaf::maximum() const
+{
+    float v = corners[0];
+    for (int c=1; c<8; c++)
+        if (corners[c] > v)
+            v = corners[c];
+    return v;
+}
+
+
+// Distance along direction from point inside leaf to its boundary
+double DensityOctree::Leaf::exitDistance(double x, double y, double z, double dx, double dy, double dz) const
+{
+    double p[3] = {x, y, z}, d[3] = {dx, dy, dz}, lo[3] = {x0, y0, z0};
+    double t = INFINITY;
+    for (int a=0; a<3; a++) {
+        if (d[a] == 0)
+            continue;
+        double ta = ((d[a] > 0 ? lo[a] + size : lo[a]) - p[a]) / d[a];
+        if (ta < t)
+            t = ta;
+    }
+    return (t > 0) ? t : 0;
+}
+
+
+// Build octree of model's current state
+DensityOctree::DensityOctree(AtomModel &model, double density_tolerance, int depth_limit) :
+    radius(model.densityCutoffRadius()),
+    tolerance(density_tolerance),
+    max_depth(depth_limit < MIN_DEPTH ? MIN_DEPTH : depth_limit),
+    depth_reached(0) {
+
+// Two upper levels are always subdivided, their 64 cubes are built in parallel
+    const int split_depth = 2;
+    const int cubes = 1 << split_depth;
+    nodes.push_back(1);
+    for (int i=0; i<8; i++)
+        nodes.push_back(9 + 8*i);
+    nodes.resize(9 + 64);
+
+    struct Subtree {
+        std::vector<int32_t> nodes;
+        std::vector<float> corners;
+        int reached;
+    };
+    std::vector<Subtree> subtrees(cubes * cubes * cubes);
+    double size = 2 * radius / cubes;
+    TileScheduler::forEach(subtrees.size(), [&](int index, int) {
+        Subtree &s = subtrees[index];
+        int i = index % cubes, j = index / cubes % cubes, k = index / cubes / cubes;
+        s.nodes.assign(1, 0);
+        s.reached = split_depth;
+        build(model, s.nodes, s.corners, 0, -radius + i * size, -radius + j * size, -radius + k * size, size, split_depth, s.reached);
+    });
+
+// Join subtrees, local root takes the place of depth-2 node, other nodes and leaves are shifted
+    for (int index=0; index<(int)subtrees.size(); index++) {
+        Subtree &s = subtrees[index];
+        int i = index % cubes, j = index / cubes % cubes, k = index / cubes / cubes;
+        int parent = (i >> 1) | (j >> 1) << 1 | (k >> 1) << 2;
+        int slot = nodes[1 + parent] + ((i & 1) | (j & 1) << 1 | (k & 1) << 2);
+        int32_t node_base = nodes.size() - 1;
+        int32_t leaf_base = corners.size() / 8;
+        auto shift = [&](int32_t v) {
+            return (v >= 0) ? v + node_base : v - leaf_base;
+        };
+        nodes[slot] = shift(s.nodes[0]);
+        for (size_t n=1; n<s.nodes.size(); n++)
+            nodes.push_back(shift(s.nodes[n]));
+        corners.insert(corners.end(), s.corners.begin(), s.corners.end());
+        if (s.reached > depth_reached)
+            depth_reached = s.reached;
+    }
+}
+
+
+// Build subtree of cube into node of tree
+void DensityOctree::build(AtomModel &model, std::vector<int32_t> &tree_nodes, std::vector<float> &tree_corners, size_t node,
+                          double x0, double y0, double z0, double size, int depth, int &reached) const
+{
+    if (depth > reached)
+        reached = depth;
+
+// Density at 3x3x3 lattice, its corners are the cube corners
+    float lattice[27];
+    model.modelBox(lattice, 3, 3, 3, x0, y0, z0, size / 2);
+    float c[8];
+    for (int n=0; n<8; n++)
+        c[n] = lattice[(2 * (n >> 2) * 3 + 2 * (n >> 1 & 1)) * 3 + 2 * (n & 1)];
+
+// Largest error of trilinear interpolation at the other lattice nodes
+    float error = 0;
+    if (depth >= MIN_DEPTH && depth < max_depth)
+        for (int k=0; k<3; k++)
+            for (int j=0; j<3; j++)
+                for (int i=0; i<3; i++) {
+                    float tx = 0.5f * i, ty = 0.5f * j, tz = 0.5f * k;
+                    float c00 = c[0] + (c[1] - c[0]) * tx;
+                    float c10 = c[2] + (c[3] - c[2]) * tx;
+                    float c01 = c[4] + (c[5] - c[4]) * tx;
+                    float c11 = c[6] + (c[7] - c[6]) * tx;
+                    float c0 = c00 + (c10 - c00) * ty;
+                    float c1 = c01 + (c11 - c01) * ty;
+                    float e = fabs(lattice[(k * 3 + j) * 3 + i] - (c0 + (c1 - c0) * tz));
+                    if (e > error)
+                        error = e;
+                }
+
+// Leaf
+    if (depth >= max_depth || (depth >= MIN_DEPTH && error <= tolerance)) {
+        tree_nodes[node] = -1 - (int32_t)(tree_corners.size() / 8);
+        tree_corners.insert(tree_corners.end(), c, c + 8);
+        return;
+    }
+
+// Children are stored together
+    size_t first = tree_nodes.size();
+    tree_nodes.resize(first + 8);
+    tree_nodes[node] = first;
+    double half = size / 2;
+    for (int n=0; n<8; n++)
+        build(model, tree_nodes, tree_corners, first + n, x0 + (n & 1) * half, y0 + (n >> 1 & 1) * half, z0 + (n >> 2) * half,
+              half, depth + 1, reached);
+}
+
+
+// Get half side of cube
+double DensityOctree::getRadius() const
+{
+    return radius;
+}
+
+
+// Get absolute error of relative density
+double DensityOctree::getTolerance() const
+{
+    return tolerance;
+}
+
+
+// Get depth of the deepest leaf
+int DensityOctree::getDepth() const
+{
+    return depth_reached;
+}
+
+
+// Get number of nodes
+size_t DensityOctree::nodeCount() const
+{
+    return nodes.size();
+}
+
+
+// Get number of leaves
+size_t DensityOctree::leafCount() const
+{
+    return corners.size() / 8;
+}
+
+
+// Get memory usage in bytes
+size_t DensityOctree::memoryUsage() const
+{
+    return nodes.size() * sizeof(int32_t) + corners.size() * sizeof(float);
+}
+
+
+// Find leaf containing point
+bool DensityOctree::find(double x, double y, double z, Leaf &leaf) const
+{
+    leaf.x0 = -radius; leaf.y0 = -radius; leaf.z0 = -radius;
+    leaf.size = 2 * radius;
+    if (x < leaf.x0 || y < leaf.y0 || z < leaf.z0 || x > radius || y > radius || z > radius)
+        return false;
+    int32_t node = 0;
+    while (nodes[node] >= 0) {
+        leaf.size /= 2;
+        int octant = 0;
+        if (x >= leaf.x0 + leaf.size) {
+            octant |= 1;
+            leaf.x0 += leaf.size;
+        }
+        if (y >= leaf.y0 + leaf.size) {
+            octant |= 2;
+            leaf.y0 += leaf.size;
+        }
+        if (z >= leaf.z0 + leaf.size) {
+            octant |= 4;
+            leaf.z0 += leaf.size;
+        }
+        node = nodes[node] + octant;
+    }
+    leaf.corners = &corners[(size_t)(-1 - nodes[node]) * 8];
+    return true;
+}
+
+
+// Sample relative density at point
+float DensityOctree::sample(double x, double y, double z) const
+{
+    Leaf leaf;
+    if (!find(x, y, z, leaf))
+        return 0;
+    return leaf.sample(x, y, z);
+}
+
+
+// Visit leaves crossed by ray in order
+void DensityOctree::traceRay(double ox, double oy, double oz, double dx, double dy, double dz, double t0, double t1,
+                             const std::function<bool(const Leaf &leaf, double t_in, double t_out)> &visit) const
+{
+// Clip ray by the cube
+    double o[3] = {ox, oy, oz}, d[3] = {dx, dy, dz};
+    for (int a=0; a<3; a++) {
+        if (d[a] == 0) {
+            if (o[a] < -radius || o[a] > radius)
+                return;
+            continue;
+        }
+        double ta = (-radius - o[a]) / d[a], tb = (radius - o[a]) / d[a];
+        if (ta > tb)
+            std::swap(ta, tb);
+        if (ta > t0)
+            t0 = ta;
+        if (tb < t1)
+            t1 = tb;
+    }
+
+// Start slightly inside, so rounding of the entry point does not leave it out of the cube
+    Leaf leaf;
+    double t = t0 + 1e-9 * radius;
+    while (t < t1) {
+        double x = ox + t*dx, y = oy + t*dy, z = oz + t*dz;
+        if (!find(x, y, z, leaf))
+            return;
+        double t_out = t + leaf.exitDistance(x, y, z, dx, dy, dz);
+        if (t_out > t1)
+            t_out = t1;
+        if (!visit(leaf, t, t_out))
+            return;
+    // Step over the boundary, so the next point is in the next leaf
+        t = t_out + 1e-6 * leaf.size;
+    }
+}
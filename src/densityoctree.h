@@ -0,0 +1,72 @@
+#ifndef DENSITYOCTREE_H
+#define DENSITYOCTREE_H
+
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+
+class AtomModel;
+
+
+// Probability density of one state, relative to its maximum, stored by adaptive octree over cube [-radius, radius]^3
+// (Bohr radii). Every leaf keeps density at its 8 corners and is interpolated trilinearly. A cube is subdivided while
+// density at centers of its faces, edges and the cube itself differs from interpolation by more than tolerance,
+// so smooth regions and the near-zero tail take a few large leaves
+class DensityOctree {
+
+// Node is an index of its first child (children are stored together) or, if negative, -1 - index of leaf
+    std::vector<int32_t> nodes;
+    std::vector<float> corners;
+    double radius, tolerance;
+    int max_depth, depth_reached;
+
+// Build subtree of cube at (x0, y0, z0) into node of tree, depth of the deepest leaf is kept in reached
+    void build(AtomModel &model, std::vector<int32_t> &tree_nodes, std::vector<float> &tree_corners, size_t node,
+               double x0, double y0, double z0, double size, int depth, int &reached) const;
+
+public:
+
+// Leaf cube, x index of corners changes fastest
+    struct Leaf {
+        double x0, y0, z0, size;
+        const float *corners;
+
+    // Trilinear interpolation inside leaf and maximum of corners
+        float sample(double x, double y, double z) const;
+        float maximum() const;
+
+    // Distance along direction (unit vector) from point inside leaf to its boundary
+        double exitDistance(double x, double y, double z, double dx, double dy, double dz) const;
+    };
+
+// Minimum depth guarantees that small features between coarse samples are not lost
+    static const int MIN_DEPTH = 3;
+
+// Build octree of model's current state, tolerance is absolute error of relative density
+    DensityOctree(AtomModel &model, double density_tolerance = 2e-3, int depth_limit = 9);
+
+    double getRadius() const;
+    double getTolerance() const;
+    int getDepth() const;
+    size_t nodeCount() const;
+    size_t leafCount() const;
+    size_t memoryUsage() const;
+
+// Find leaf containing point (Bohr radii), false if point is out of octree
+    bool find(double x, double y, double z, Leaf &leaf) const;
+
+// Sample relative density at point (Bohr radii), points out of octree are zero
+    float sample(double x, double y, double z) const;
+
+// Visit leaves crossed by ray origin + t * direction (unit vector) for t in [t0, t1] in order,
+// visitor gets the leaf and the ray segment inside it, and returns false to stop traversal
+    void traceRay(double ox, double oy, double oz, double dx, double dy, double dz, double t0, double t1,
+                  const std::function<bool(const Leaf &leaf, double t_in, double t_out)> &visit) const;
+
+};
+
+
+#endif // DENSITYOCTREE_H
@@ -0,0 +1,220 @@
+#include "densitypyramid.h"
+#include "parallel.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+
+bool DensityPyramid::TileKey::operator<(const TileKey &op1) const
+{
+    if (level != op1.level)
+        return level < op1.level;
+    if (tz != op1.tz)
+        return tz < op1.tz;
+    return tx < op1.tx;
+}
+
+
+// Empty pyramid of model's current state
+DensityPyramid::DensityPyramid(AtomModel &model, size_t budget_bytes) :
+    state(model.canonicalState()),
+    radius(model.tableRadius()),
+    budget(budget_bytes),
+    bytes(0),
+    use_counter(0),
+    account_id(0) {
+}
+
+
+// Get state of pyramid
+const QuantumState & DensityPyramid::getState() const
+{
+    return state;
+}
+
+
+// Get half side of covered square
+double DensityPyramid::getRadius() const
+{
+    return radius;
+}
+
+
+// Get memory usage of computed tiles in bytes
+size_t DensityPyramid::memoryUsage() const
+{
+    return bytes;
+}
+
+
+// Get number of computed tiles
+size_t DensityPyramid::tileCount() const
+{
+    return tiles.size();
+}
+
+
+// Account pyramid to accountant entry
+void DensityPyramid::setAccountId(uint64_t id)
+{
+    account_id = id;
+}
+
+
+// Get node spacing of level
+double DensityPyramid::levelSpacing(int level) const
+{
+    return ldexp(2 * radius / TILE, -level);
+}
+
+
+// Get level with spacing nearest to given one
+int DensityPyramid::levelForSpacing(double spacing) const
+{
+    if (!(spacing > 0))
+        return MAX_LEVEL;
+    int level = (int)floor(log2(2 * radius / TILE / spacing) + 0.5);
+    return (level < 0) ? 0 : (level > MAX_LEVEL) ? MAX_LEVEL : level;
+}
+
+
+// Render frame of model's current state
+void DensityPyramid::render(AtomModel &model, long double *p, int width, int height, double center_x, double center_z, double spacing)
+{
+    model.tableRadius();
+    int level = levelForSpacing(spacing);
+    double s = levelSpacing(level);
+    long long nodes = (long long)TILE << level;
+    unsigned long long frame_use = ++use_counter;
+
+// Node g is at -radius + (g + 0.5) * s, tiles of nodes around the frame are visible
+    double gx0 = (center_x - width/2 * spacing + radius) / s - 0.5;
+    double gx1 = (center_x + (width - width/2) * spacing + radius) / s + 0.5;
+    double gz0 = (center_z - (height - height/2) * spacing + radius) / s - 0.5;
+    double gz1 = (center_z + height/2 * spacing + radius) / s + 0.5;
+    long long last = ((long long)1 << level) - 1;
+    long long tx0 = std::max(0ll, (long long)floor(gx0 / TILE)), tx1 = std::min(last, (long long)floor(gx1 / TILE));
+    long long tz0 = std::max(0ll, (long long)floor(gz0 / TILE)), tz1 = std::min(last, (long long)floor(gz1 / TILE));
+    int visible_x = (tx1 >= tx0) ? tx1 - tx0 + 1 : 0;
+    int visible_z = (tz1 >= tz0) ? tz1 - tz0 + 1 : 0;
+
+// Find visible tiles, compute missing ones in parallel
+    std::vector<const float *> visible((size_t)visible_x * visible_z, nullptr);
+    std::vector<TileKey> missing;
+    for (int j=0; j<visible_z; j++)
+        for (int i=0; i<visible_x; i++) {
+            TileKey key = {level, (int)(tx0 + i), (int)(tz0 + j)};
+            auto it = tiles.find(key);
+            if (it == tiles.end()) {
+                missing.push_back(key);
+                continue;
+            }
+            it->second.last_use = frame_use;
+            visible[(size_t)j * visible_x + i] = it->second.values.data();
+        }
+    std::vector<std::vector<float>> computed(missing.size());
+    auto start = std::chrono::steady_clock::now();
+    TileScheduler::forEach(missing.size(), [&](int index, int) {
+        const TileKey &key = missing[index];
+        computed[index].resize(TILE * TILE);
+        model.modelPlane(computed[index].data(), TILE, TILE, -radius + ((double)key.tx * TILE + 0.5) * s,
+                         -radius + ((double)key.tz * TILE + 0.5) * s, s, 2);
+    });
+    double compute_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    for (size_t i=0; i<missing.size(); i++) {
+        TileData &tile = tiles[missing[i]];
+        tile.values.swap(computed[i]);
+        tile.last_use = frame_use;
+        bytes += TILE * TILE * sizeof(float);
+        visible[(size_t)(missing[i].tz - tz0) * visible_x + (missing[i].tx - tx0)] = tile.values.data();
+    }
+
+// Node value, nodes out of pyramid are zero
+    auto node = [&](long long gx, long long gz) -> float {
+        if (gx < 0 || gz < 0 || gx >= nodes || gz >= nodes)
+            return 0;
+        const float *tile = visible[(size_t)(gz / TILE - tz0) * visible_x + (gx / TILE - tx0)];
+        return tile[(gz % TILE) * TILE + gx % TILE];
+    };
+
+// Per tile bilinear interpolation of the level, each worker collects histogram of its values
+    bool probability_density = model.isProbabilityDensity();
+    std::vector<DensityHistogram> hist(TileScheduler::threadCount());
+    TileScheduler::forEachTile(width, height, [&](const Tile &tile, int worker) {
+        for (int yy=tile.y0; yy<tile.y1; yy++)
+            for (int xx=tile.x0; xx<tile.x1; xx++) {
+                double x = center_x + (xx - width/2) * spacing;
+                double z = center_z + (height/2 - yy) * spacing;
+                double fx = (x + radius) / s - 0.5, fz = (z + radius) / s - 0.5;
+                long long i = (long long)floor(fx), k = (long long)floor(fz);
+                float tx = fx - i, tz = fz - k;
+                float c0 = node(i, k) + (node(i+1, k) - node(i, k)) * tx;
+                float c1 = node(i, k+1) + (node(i+1, k+1) - node(i, k+1)) * tx;
+                long double v = c0 + (c1 - c0) * tz;
+                if (!probability_density)
+                    v *= x*x + z*z;
+                p[yy*width + xx] = v;
+                hist[worker].add(v);
+            }
+    });
+
+// Go to the relative values
+    for (size_t i=1; i<hist.size(); i++)
+        hist[0].merge(hist[i]);
+    long double white = model.getToneMap().clipLevel(hist[0]);
+    if (white > 0)
+        for (int i=0; i<width*height; i++)
+            p[i] /= white;
+
+// Accountant gets size after eviction of tiles and time of new tiles, pyramids with many tiles are expensive
+    evict();
+    if (account_id != 0) {
+        CacheAccountant::global().resize(account_id, bytes);
+        if (!missing.empty())
+            CacheAccountant::global().addCost(account_id, compute_ms);
+    }
+}
+
+
+// Remove least recently used tiles over memory budget
+void DensityPyramid::evict()
+{
+    while (bytes > budget) {
+        auto lru = tiles.end();
+        for (auto it = tiles.begin(); it != tiles.end(); ++it)
+            if (it->second.last_use != use_counter && (lru == tiles.end() || it->second.last_use < lru->second.last_use))
+                lru = it;
+        if (lru == tiles.end())
+            return;
+        bytes -= lru->second.values.size() * sizeof(float);
+        tiles.erase(lru);
+    }
+}
+
+
+DensityPyramidCache::DensityPyramidCache(int max_pyramids) :
+    cache(CACHE_PYRAMIDS, max_pyramids) {
+}
+
+
+// Get pyramid of model's current state, create it if it is not cached. Pyramid is created empty,
+// its tiles are accounted by render()
+std::shared_ptr<DensityPyramid> DensityPyramidCache::get(AtomModel &model)
+{
+    uint64_t id = 0;
+    std::shared_ptr<DensityPyramid> pyramid = cache.get(model.canonicalState(), [&]() {
+        return std::make_shared<DensityPyramid>(model);
+    }, [](const DensityPyramid &created) {
+        return created.memoryUsage();
+    }, &id);
+    pyramid->setAccountId(id);
+    return pyramid;
+}
+
+
+// Remove all pyramids
+void DensityPyramidCache::clear()
+{
+    cache.clear();
+}
@@ -0,0 +1,88 @@
+#ifndef DENSITYPYRAMID_H
+#define DENSITYPYRAMID_H
+
+
+#include <map>
+#include <memory>
+#include <vector>
+
+#include "accountedcache.h"
+#include "atommodel.h"
+#include "tonemap.h"
+
+
+// Multi-resolution pyramid of probability density of one state in meridional plane y = 0.
+// Level L covers square [-radius, radius]^2 (Bohr radii) by 2^L x 2^L tiles of TILE x TILE cell-centered nodes,
+// every node is the mean density over its cell. Tiles are computed in parallel when a frame needs them,
+// so cost of a frame depends on its size only, least recently used tiles are removed over memory budget
+class DensityPyramid {
+
+    struct TileKey {
+        int level, tx, tz;
+        bool operator<(const TileKey &op1) const;
+    };
+
+    struct TileData {
+        std::vector<float> values;
+        unsigned long long last_use;
+    };
+
+    QuantumState state;
+    double radius;
+    size_t budget, bytes;
+    unsigned long long use_counter;
+    std::map<TileKey, TileData> tiles;
+// Accountant entry of pyramid, 0 if it isn't accounted
+    uint64_t account_id;
+
+// Remove least recently used tiles, which are not used by current frame, over memory budget
+    void evict();
+
+public:
+
+// Tile side in nodes, deepest level and default memory budget in bytes
+    static const int TILE = 64;
+    static const int MAX_LEVEL = 30;
+    static const size_t DEFAULT_BUDGET = 64u << 20;
+
+// Empty pyramid of model's current state
+    explicit DensityPyramid(AtomModel &model, size_t budget_bytes = DEFAULT_BUDGET);
+
+    const QuantumState & getState() const;
+    double getRadius() const;
+    size_t memoryUsage() const;
+    size_t tileCount() const;
+
+// Account memory and compute time of tiles to accountant entry, they are updated by every render
+    void setAccountId(uint64_t id);
+
+// Get node spacing of level, and level with spacing nearest to given one
+    double levelSpacing(int level) const;
+    int levelForSpacing(double spacing) const;
+
+// Render width x height frame of model's current state (it must be the pyramid's state) centered at (center_x, center_z),
+// spacing is pixel size (Bohr radii). Probability is density multiplied by r^2 like in AtomModel::model2D,
+// values are normalized by tone map white level
+    void render(AtomModel &model, long double *p, int width, int height, double center_x, double center_z, double spacing);
+
+};
+
+
+// Cache of pyramids per state
+class DensityPyramidCache {
+
+    AccountedCache<QuantumState, DensityPyramid> cache;
+
+public:
+
+    explicit DensityPyramidCache(int max_pyramids = 4);
+
+// Get pyramid of model's current state, create it if it is not cached
+    std::shared_ptr<DensityPyramid> get(AtomModel &model);
+
+    void clear();
+
+};
+
+
+#endif // DENSITYPYRAMID_H
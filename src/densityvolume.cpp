@@ -0,0 +1,265 @@
+#include "densityvolume.h"
+#include "atommodel.h"
+#include "parallel.h"
+
+#include <cmath>
+
+
+// Check if brick crosses the sphere inscribed in grid
+bool DensityVolume::brickInSphere(int bi, int bj, int bk, int grid_size)
+{
+// Distance from grid center to the nearest point of brick
+    double c = (grid_size - 1) / 2.0;
+    double d2 = 0;
+    int b[3] = {bi, bj, bk};
+    for (int a=0; a<3; a++) {
+        double lo = b[a] * BRICK, hi = lo + BRICK - 1;
+        double d = (c < lo) ? lo - c : (c > hi) ? c - hi : 0;
+        d2 += d * d;
+    }
+    return d2 <= c * c;
+}
+
+
+// Get voxels per brick
+int DensityVolume::brickVoxels()
+{
+    return BRICK_VOXELS;
+}
+
+
+// Get number of brick index elements, grid_size is multiple of 8
+size_t DensityVolume::indexSize(int grid_size)
+{
+    size_t n = grid_size / BRICK;
+    return n * n * n;
+}
+
+
+// Count bricks crossing the sphere inscribed in grid
+int DensityVolume::countBricks(int grid_size)
+{
+    int n = grid_size / BRICK;
+    int count = 0;
+    for (int bk=0; bk<n; bk++)
+        for (int bj=0; bj<n; bj++)
+            for (int bi=0; bi<n; bi++)
+                count += brickInSphere(bi, bj, bk, grid_size);
+    return count;
+}
+
+
+// Choose grid size, which fits memory budget
+int DensityVolume::sizeForBudget(size_t budget_bytes)
+{
+    int size = BRICK;
+    for (int s=2*BRICK; s<=MAX_SIZE; s+=BRICK) {
+        size_t bytes = (size_t)countBricks(s) * BRICK_VOXELS * sizeof(float) + indexSize(s) * sizeof(int);
+        if (bytes > budget_bytes)
+            break;
+        size = s;
+    }
+    return size;
+}
+
+
+// Set grid size and radius
+void DensityVolume::setGrid(int grid_size, double grid_radius)
+{
+    size = (grid_size + BRICK - 1) / BRICK * BRICK;
+    if (size < BRICK)
+        size = BRICK;
+    bricks_per_axis = size / BRICK;
+    radius = grid_radius;
+    step = 2 * radius / (size - 1);
+    inv_step = 1 / step;
+}
+
+
+// Sample model's current state
+DensityVolume::DensityVolume(AtomModel &model, int grid_size) {
+
+    setGrid(grid_size, model.densityCutoffRadius());
+
+// Keep bricks crossing the cutoff sphere
+    brick_index.assign(bricks_per_axis * bricks_per_axis * bricks_per_axis, -1);
+    int count = 0;
+    for (int bk=0; bk<bricks_per_axis; bk++)
+        for (int bj=0; bj<bricks_per_axis; bj++)
+            for (int bi=0; bi<bricks_per_axis; bi++)
+                if (brickInSphere(bi, bj, bk, size))
+                    brick_index[(bk * bricks_per_axis + bj) * bricks_per_axis + bi] = count++;
+
+// Sample bricks in parallel
+    bricks.resize((size_t)count * BRICK_VOXELS);
+    TileScheduler::forEach(brick_index.size(), [&](int b, int) {
+        if (brick_index[b] < 0)
+            return;
+        int bi = b % bricks_per_axis, bj = b / bricks_per_axis % bricks_per_axis, bk = b / bricks_per_axis / bricks_per_axis;
+        model.modelBox(&bricks[(size_t)brick_index[b] * BRICK_VOXELS], BRICK, BRICK, BRICK,
+                       -radius + bi * BRICK * step, -radius + bj * BRICK * step, -radius + bk * BRICK * step, step);
+    });
+    index_data = brick_index.data();
+    brick_data = bricks.data();
+    brick_count = count;
+}
+
+
+// Resample finer volume to coarser grid
+DensityVolume::DensityVolume(const DensityVolume &finer, int grid_size) {
+
+    setGrid(grid_size, finer.radius);
+    brick_index.assign(indexSize(size), -1);
+    int count = 0;
+    for (int bk=0; bk<bricks_per_axis; bk++)
+        for (int bj=0; bj<bricks_per_axis; bj++)
+            for (int bi=0; bi<bricks_per_axis; bi++)
+                if (brickInSphere(bi, bj, bk, size))
+                    brick_index[(bk * bricks_per_axis + bj) * bricks_per_axis + bi] = count++;
+
+// Every node is the mean of 2x2x2 trilinear samples of finer volume at quarters of the coarse cell
+    bricks.resize((size_t)count * BRICK_VOXELS);
+    double q = step / 4;
+    TileScheduler::forEach(brick_index.size(), [&](int b, int) {
+        if (brick_index[b] < 0)
+            return;
+        int bi = b % bricks_per_axis, bj = b / bricks_per_axis % bricks_per_axis, bk = b / bricks_per_axis / bricks_per_axis;
+        float *p = &bricks[(size_t)brick_index[b] * BRICK_VOXELS];
+        for (int k=0; k<BRICK; k++)
+            for (int j=0; j<BRICK; j++)
+                for (int i=0; i<BRICK; i++) {
+                    double x = -radius + (bi * BRICK + i) * step;
+                    double y = -radius + (bj * BRICK + j) * step;
+                    double z = -radius + (bk * BRICK + k) * step;
+                    float v = 0;
+                    for (int c=0; c<8; c++)
+                        v += finer.sampleTrilinear(x + ((c & 1) ? q : -q), y + ((c & 2) ? q : -q), z + ((c & 4) ? q : -q));
+                    *p++ = v / 8;
+                }
+    });
+    index_data = brick_index.data();
+    brick_data = bricks.data();
+    brick_count = count;
+}
+
+
+// Use brick index and voxels in external memory
+DensityVolume::DensityVolume(int grid_size, double grid_radius, const int *index, const float *voxels, std::shared_ptr<const void> memory_owner) :
+    index_data(index),
+    brick_data(voxels),
+    owner(memory_owner) {
+
+    setGrid(grid_size, grid_radius);
+    brick_count = countBricks(size);
+}
+
+
+// Get grid size
+int DensityVolume::gridSize() const
+{
+    return size;
+}
+
+
+// Get half side of sampled cube
+double DensityVolume::getRadius() const
+{
+    return radius;
+}
+
+
+// Get distance between grid nodes
+double DensityVolume::getStep() const
+{
+    return step;
+}
+
+
+// Get memory usage in bytes
+size_t DensityVolume::memoryUsage() const
+{
+    return brick_count * BRICK_VOXELS * sizeof(float) + indexSize(size) * sizeof(int);
+}
+
+
+// Get brick index
+const int * DensityVolume::brickIndex() const
+{
+    return index_data;
+}
+
+
+// Get voxels of stored bricks
+const float * DensityVolume::brickData() const
+{
+    return brick_data;
+}
+
+
+// Get number of stored bricks
+size_t DensityVolume::storedBricks() const
+{
+    return brick_count;
+}
+
+
+// Get voxel value
+float DensityVolume::voxel(int i, int j, int k) const
+{
+    if ((unsigned)i >= (unsigned)size || (unsigned)j >= (unsigned)size || (unsigned)k >= (unsigned)size)
+        return 0;
+    int b = index_data[((k / BRICK) * bricks_per_axis + j / BRICK) * bricks_per_axis + i / BRICK];
+    if (b < 0)
+        return 0;
+    return brick_data[(size_t)b * BRICK_VOXELS + ((k % BRICK) * BRICK + j % BRICK) * BRICK + i % BRICK];
+}
+
+
+// Sample relative density by trilinear interpolation
+float DensityVolume::sampleTrilinear(double x, double y, double z) const
+{
+    double fx = (x + radius) * inv_step, fy = (y + radius) * inv_step, fz = (z + radius) * inv_step;
+    if (fx < 0 || fy < 0 || fz < 0 || fx >= size - 1 || fy >= size - 1 || fz >= size - 1)
+        return 0;
+    int i = (int)fx, j = (int)fy, k = (int)fz;
+    float tx = fx - i, ty = fy - j, tz = fz - k;
+    float c00 = voxel(i, j, k) + (voxel(i+1, j, k) - voxel(i, j, k)) * tx;
+    float c10 = voxel(i, j+1, k) + (voxel(i+1, j+1, k) - voxel(i, j+1, k)) * tx;
+    float c01 = voxel(i, j, k+1) + (voxel(i+1, j, k+1) - voxel(i, j, k+1)) * tx;
+    float c11 = voxel(i, j+1, k+1) + (voxel(i+1, j+1, k+1) - voxel(i, j+1, k+1)) * tx;
+    float c0 = c00 + (c10 - c00) * ty;
+    float c1 = c01 + (c11 - c01) * ty;
+    return c0 + (c1 - c0) * tz;
+}
+
+
+// Sample relative density by tricubic (Catmull-Rom) interpolation
+float DensityVolume::sampleTricubic(double x, double y, double z) const
+{
+    double fx = (x + radius) * inv_step, fy = (y + radius) * inv_step, fz = (z + radius) * inv_step;
+    if (fx < 0 || fy < 0 || fz < 0 || fx >= size - 1 || fy >= size - 1 || fz >= size - 1)
+        return 0;
+    int i = (int)fx, j = (int)fy, k = (int)fz;
+    float t[3] = {(float)(fx - i), (float)(fy - j), (float)(fz - k)};
+
+// Catmull-Rom weights of four nodes along each axis
+    float w[3][4];
+    for (int a=0; a<3; a++) {
+        float s = t[a], s2 = s * s, s3 = s2 * s;
+        w[a][0] = 0.5f * (-s3 + 2*s2 - s);
+        w[a][1] = 0.5f * (3*s3 - 5*s2 + 2);
+        w[a][2] = 0.5f * (-3*s3 + 4*s2 + s);
+        w[a][3] = 0.5f * (s3 - s2);
+    }
+
+    float v = 0;
+    for (int c=0; c<4; c++)
+        for (int b=0; b<4; b++) {
+            float row = 0;
+            for (int a=0; a<4; a++)
+                row += w[0][a] * voxel(i - 1 + a, j - 1 + b, k - 1 + c);
+            v += w[1][b] * w[2][c] * row;
+        }
+// Cubic interpolation overshoots near sharp peaks, density is not negative
+    return (v > 0) ? v : 0;
+}
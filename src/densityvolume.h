@@ -0,0 +1,84 @@
+#ifndef DENSITYVOLUME_H
+#define DENSITYVOLUME_H
+
+
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+
+class AtomModel;
+
+
+// Probability density of one state, relative to its maximum, sampled at grid over cube [-radius, radius]^3
+// (Bohr radii). Grid is stored by 8x8x8 bricks, bricks outside of the cutoff sphere are not stored.
+class DensityVolume {
+
+    static const int BRICK = 8;
+    static const int BRICK_VOXELS = BRICK * BRICK * BRICK;
+
+    int size, bricks_per_axis;
+    double radius, step, inv_step;
+
+// Brick index (-1 - empty brick) and voxels of stored bricks, owned by the volume
+// or by external memory (e.g. mapped atlas file), which is kept alive by owner
+    std::vector<int> brick_index;
+    std::vector<float> bricks;
+    const int *index_data;
+    const float *brick_data;
+    size_t brick_count;
+    std::shared_ptr<const void> owner;
+
+// Check if brick crosses the sphere inscribed in grid
+    static bool brickInSphere(int bi, int bj, int bk, int grid_size);
+
+// Set grid size and radius
+    void setGrid(int grid_size, double grid_radius);
+
+// Get voxel value, voxels out of grid and in empty bricks are zero
+    float voxel(int i, int j, int k) const;
+
+public:
+
+// Largest grid size
+    static const int MAX_SIZE = 512;
+
+// Voxels per brick, number of brick index elements and number of stored bricks of grid
+    static int brickVoxels();
+    static size_t indexSize(int grid_size);
+    static int countBricks(int grid_size);
+
+// Choose grid size, which fits memory budget in bytes
+    static int sizeForBudget(size_t budget_bytes);
+
+// Sample model's current state, grid_size is rounded up to multiple of 8
+    DensityVolume(AtomModel &model, int grid_size);
+
+// Resample finer volume to coarser grid (mip level), every node averages finer volume over its cell
+    DensityVolume(const DensityVolume &finer, int grid_size);
+
+// Use brick index and voxels in external memory without copying, owner keeps memory valid
+    DensityVolume(int grid_size, double grid_radius, const int *index, const float *voxels, std::shared_ptr<const void> memory_owner);
+
+// Volume points to its own storage, so it is not copied
+    DensityVolume(const DensityVolume &) = delete;
+    DensityVolume & operator=(const DensityVolume &) = delete;
+
+    int gridSize() const;
+    double getRadius() const;
+    double getStep() const;
+    size_t memoryUsage() const;
+
+// Get brick index and voxels of stored bricks
+    const int * brickIndex() const;
+    const float * brickData() const;
+    size_t storedBricks() const;
+
+// Sample relative density at point (Bohr radii)
+    float sampleTrilinear(double x, double y, double z) const;
+    float sampleTricubic(double x, double y, double z) const;
+
+};
+
+
+#endif // DENSITYVOLUME_H
@@ -0,0 +1,160 @@
+#include "electroncloud.h"
+#include "parallel.h"
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+
+
+// Sample electron positions for model's current state
+ElectronCloud::ElectronCloud(AtomModel &model, int points, unsigned long long seed) :
+    positions((size_t)points * 3) {
+
+// Cumulative distribution of radius, probability of shell is R^2 * r^2 * dr
+    double radius = model.densityCutoffRadius();
+    double dr = radius / RADIAL_BINS;
+    std::vector<double> radial_cdf(RADIAL_BINS + 1, 0);
+    for (int i=0; i<RADIAL_BINS; i++) {
+        double r = (i + 0.5) * dr;
+        radial_cdf[i+1] = radial_cdf[i] + model.radialValue(r) * r * r;
+    }
+
+// Cumulative distribution of cos(theta), density does not depend on phi
+    double dc = 2.0 / ANGULAR_BINS;
+    std::vector<double> angular_cdf(ANGULAR_BINS + 1, 0);
+    for (int i=0; i<ANGULAR_BINS; i++)
+        angular_cdf[i+1] = angular_cdf[i] + model.angularValue(-1 + (i + 0.5) * dc);
+
+// Every chunk of points has its own random stream
+    int chunks = (points + CHUNK_SIZE - 1) / CHUNK_SIZE;
+    TileScheduler::forEach(chunks, [&](int chunk, int) {
+        std::mt19937_64 rng(seed * 0x9E3779B97F4A7C15ull + chunk);
+        std::uniform_real_distribution<double> uniform(0, 1);
+        int end = std::min(points, (chunk + 1) * CHUNK_SIZE);
+        for (int i=chunk*CHUNK_SIZE; i<end; i++) {
+            double r = inverse(radial_cdf, 0, dr, uniform(rng));
+            double c = inverse(angular_cdf, -1, dc, uniform(rng));
+            double phi = 2 * M_PI * uniform(rng);
+            double s = sqrt(1 - c*c);
+            positions[3*i] = r * s * cos(phi);
+            positions[3*i+1] = r * s * sin(phi);
+            positions[3*i+2] = r * c;
+        }
+    });
+}
+
+
+// Find x for cumulative distribution value u, density is constant inside each bin
+double ElectronCloud::inverse(const std::vector<double> &cdf, double x0, double dx, double u)
+{
+    double target = u * cdf.back();
+    int bin = std::upper_bound(cdf.begin(), cdf.end(), target) - cdf.begin() - 1;
+    if (bin < 0)
+        bin = 0;
+    if (bin >= (int)cdf.size() - 1)
+        bin = cdf.size() - 2;
+    double width = cdf[bin+1] - cdf[bin];
+    double t = (width > 0) ? (target - cdf[bin]) / width : 0.5;
+    return x0 + (bin + t) * dx;
+}
+
+
+// Get number of points
+int ElectronCloud::pointCount() const
+{
+    return positions.size() / 3;
+}
+
+
+// Get point coordinates, x, y, z for every point
+const float * ElectronCloud::data() const
+{
+    return positions.data();
+}
+
+
+// Splat points with camera of 3D model
+void ElectronCloud::render(const Camera3D &camera, double model_radius, const ToneMap &tone_map, long double *p, int width, int height, double zoom) const
+{
+// Transposed camera rotation brings model points to camera space
+    double rot[3][3];
+    for (int i=0; i<3; i++)
+        for (int j=0; j<3; j++)
+            rot[i][j] = camera.rotation.A[j][i] / model_radius;
+    double shift_x = camera.position.y, shift_y = camera.position.z;
+    double pixels_per_unit = sqrt(height*height + width*width) / 2.0 * zoom;
+
+// Every worker counts points in its own buffer
+    int workers = TileScheduler::threadCount();
+    std::vector<std::vector<float>> counts(workers);
+    int points = pointCount();
+    int chunks = (points + CHUNK_SIZE - 1) / CHUNK_SIZE;
+    TileScheduler::forEach(chunks, [&](int chunk, int worker) {
+        std::vector<float> &count = counts[worker];
+        if (count.empty())
+            count.assign((size_t)width * height, 0);
+        int end = std::min(points, (chunk + 1) * CHUNK_SIZE);
+        for (int i=chunk*CHUNK_SIZE; i<end; i++) {
+            const float *pos = &positions[3*i];
+            double cx = rot[1][0] * pos[0] + rot[1][1] * pos[1] + rot[1][2] * pos[2] + shift_x;
+            double cy = rot[2][0] * pos[0] + rot[2][1] * pos[1] + rot[2][2] * pos[2] + shift_y;
+            int xx = (int)floor(cx * pixels_per_unit + width/2 + 0.5);
+            int yy = (int)floor(height/2 - cy * pixels_per_unit + 0.5);
+            if (xx >= 0 && xx < width && yy >= 0 && yy < height)
+                count[yy*width + xx]++;
+        }
+    });
+
+// Sum worker buffers by image rows, collecting histogram
+    std::vector<DensityHistogram> hist(workers);
+    TileScheduler::forEach(height, [&](int yy, int worker) {
+        for (int xx=0; xx<width; xx++) {
+            long double v = 0;
+            for (auto &count : counts)
+                if (!count.empty())
+                    v += count[yy*width + xx];
+            p[yy*width + xx] = v;
+            hist[worker].add(v);
+        }
+    });
+    for (size_t i=1; i<hist.size(); i++)
+        hist[0].merge(hist[i]);
+
+// Go to the relative values
+    long double level = tone_map.clipLevel(hist[0]);
+    if (level > 0)
+        for (int i=0; i<width*height; i++)
+            p[i] /= level;
+}
+
+
+bool ElectronCloudCache::Key::operator<(const Key &op1) const
+{
+    if (state != op1.state)
+        return state < op1.state;
+    return points < op1.points;
+}
+
+
+ElectronCloudCache::ElectronCloudCache(int max_clouds) :
+    cache(CACHE_CLOUDS, max_clouds) {
+}
+
+
+// Get cloud of model's current state, sample it if it is not cached
+std::shared_ptr<const ElectronCloud> ElectronCloudCache::get(AtomModel &model, int points)
+{
+    Key key = {model.canonicalState(), points};
+    return cache.get(key, [&]() {
+        return std::make_shared<const ElectronCloud>(model, points);
+    }, [](const ElectronCloud &cloud) {
+        return (size_t)cloud.pointCount() * 3 * sizeof(float);
+    });
+}
+
+
+// Remove all clouds
+void ElectronCloudCache::clear()
+{
+    cache.clear();
+}
@@ -0,0 +1,69 @@
+#ifndef ELECTRONCLOUD_H
+#define ELECTRONCLOUD_H
+
+
+#include <map>
+#include <memory>
+#include <vector>
+
+#include "accountedcache.h"
+#include "atommodel.h"
+#include "camera.h"
+#include "tonemap.h"
+
+
+// Electron positions sampled from probability density of one state, coordinates are in Bohr radii
+class ElectronCloud {
+
+// Number of bins of inverse distribution tables and samples per random stream
+    static const int RADIAL_BINS = 16384;
+    static const int ANGULAR_BINS = 4096;
+    static const int CHUNK_SIZE = 65536;
+
+    std::vector<float> positions;
+
+// Find x in [x0, x0 + dx * bins] for cumulative distribution value u
+    static double inverse(const std::vector<double> &cdf, double x0, double dx, double u);
+
+public:
+
+// Default number of electron positions
+    static const int DEFAULT_POINTS = 1000000;
+
+// Sample electron positions for model's current state, result does not depend on number of threads
+    ElectronCloud(AtomModel &model, int points = DEFAULT_POINTS, unsigned long long seed = 1);
+
+    int pointCount() const;
+    const float * data() const;
+
+// Splat points to p with camera of AtomModel::model3D, model radius (Bohr radii) is shown as relative 1.
+// Point counts are normalized by tone map white level
+    void render(const Camera3D &camera, double model_radius, const ToneMap &tone_map, long double *p, int width, int height, double zoom = 1) const;
+
+};
+
+
+// Cache of electron clouds per state
+class ElectronCloudCache {
+
+    struct Key {
+        QuantumState state;
+        int points;
+        bool operator<(const Key &op1) const;
+    };
+
+    AccountedCache<Key, const ElectronCloud> cache;
+
+public:
+
+    explicit ElectronCloudCache(int max_clouds = 4);
+
+// Get cloud of model's current state, sample it if it is not cached
+    std::shared_ptr<const ElectronCloud> get(AtomModel &model, int points = ElectronCloud::DEFAULT_POINTS);
+
+    void clear();
+
+};
+
+
+#endif // ELECTRONCLOUD_H
@@ -0,0 +1,167 @@
+#include "emptyspace.h"
+
+#include <cmath>
+
+
+EmptySpaceMap::EmptySpaceMap() :
+    cutoff_radius(0),
+    radial_bin_scale(0) {
+}
+
+
+// Build map from tabulated radial and angular values
+void EmptySpaceMap::build(const double *radial, int radial_size, double radius, const double *angular, int angular_size, double threshold)
+{
+    shells.clear();
+    cones.clear();
+
+// Find maximum values
+    double radial_max = 0, angular_max = 0;
+    for (int i=0; i<radial_size; i++)
+        if (radial[i] > radial_max)
+            radial_max = radial[i];
+    for (int i=0; i<angular_size; i++)
+        if (angular[i] > angular_max)
+            angular_max = angular[i];
+
+// Runs of negligible radial values are shells, the last run is the tail.
+// Tables are interpolated linearly, so run of small samples is small between them too
+    double dr = radius / (radial_size - 1);
+    cutoff_radius = radius;
+    for (int i=0; i<radial_size; ) {
+        if (radial[i] > threshold * radial_max) {
+            i++;
+            continue;
+        }
+        int j = i;
+        while (j+1 < radial_size && radial[j+1] <= threshold * radial_max)
+            j++;
+        if (j == radial_size - 1)
+            cutoff_radius = i * dr;
+        else if (j > i) {
+            Interval shell = {i * dr, j * dr};
+            shells.push_back(shell);
+        }
+        i = j + 1;
+    }
+
+    if (cutoff_radius < dr)
+        cutoff_radius = dr;
+
+// Runs of negligible angular values are cones, cos(theta) is converted to theta
+    double dc = 2.0 / (angular_size - 1);
+    for (int i=0; i<angular_size; ) {
+        if (angular[i] > threshold * angular_max) {
+            i++;
+            continue;
+        }
+        int j = i;
+        while (j+1 < angular_size && angular[j+1] <= threshold * angular_max)
+            j++;
+        if (j > i) {
+            Interval cone = {acos(-1 + j * dc), acos(-1 + i * dc)};
+            cones.push_back(cone);
+        }
+        i = j + 1;
+    }
+
+// Lookup bins store index of region, which covers the whole bin, or -1
+    radial_bin_scale = RADIAL_BINS / cutoff_radius;
+    radial_bins.assign(RADIAL_BINS, -1);
+    for (int k=0; k<(int)shells.size(); k++)
+        for (int b=0; b<RADIAL_BINS; b++)
+            if (shells[k].from <= b / radial_bin_scale && (b + 1) / radial_bin_scale <= shells[k].to)
+                radial_bins[b] = k;
+    angular_bins.assign(ANGULAR_BINS, -1);
+    for (int k=0; k<(int)cones.size(); k++)
+        for (int b=0; b<ANGULAR_BINS; b++)
+            if (cones[k].from <= M_PI * b / ANGULAR_BINS && M_PI * (b + 1) / ANGULAR_BINS <= cones[k].to)
+                angular_bins[b] = k;
+}
+
+
+// Get radius beyond which all values are negligible
+double EmptySpaceMap::cutoffRadius() const
+{
+    return cutoff_radius;
+}
+
+
+// Get number of empty shells
+int EmptySpaceMap::shellCount() const
+{
+    return shells.size();
+}
+
+
+// Get number of empty cones
+int EmptySpaceMap::coneCount() const
+{
+    return cones.size();
+}
+
+
+// Check if point is in empty region
+bool EmptySpaceMap::isEmpty(double x, double y, double z) const
+{
+    double r = sqrt(x*x + y*y + z*z);
+    return isEmptySpherical(r, (r > 0) ? z / r : 1);
+}
+
+
+// Check if point, given in spherical coordinates, is in empty region
+bool EmptySpaceMap::isEmptySpherical(double r, double cos_theta) const
+{
+    if (r >= cutoff_radius)
+        return true;
+    if (radial_bins.empty())
+        return false;
+    if (radial_bins[(int)(r * radial_bin_scale)] >= 0)
+        return true;
+// Values out of [-1, 1], including NaN at the origin, are clamped
+    int b = ANGULAR_BINS - 1;
+    if (cos_theta >= 1)
+        b = 0;
+    else if (cos_theta > -1)
+        b = (int)(acos(cos_theta) * (ANGULAR_BINS / M_PI));
+    if (b >= ANGULAR_BINS)
+        b = ANGULAR_BINS - 1;
+    return angular_bins[b] >= 0;
+}
+
+
+// Return distance which can be passed from point in any direction without entering non-empty region
+double EmptySpaceMap::skipDistance(double x, double y, double z) const
+{
+    double r = sqrt(x*x + y*y + z*z);
+    if (r >= cutoff_radius)
+        return r - cutoff_radius;
+    if (radial_bins.empty())
+        return 0;
+
+// Distance to shell boundaries
+    double skip = 0;
+    int k = radial_bins[(int)(r * radial_bin_scale)];
+    if (k >= 0)
+        skip = fmin(r - shells[k].from, shells[k].to - r);
+
+// Distance to cone boundaries is r*sin(angle to the boundary), cones around z axis have one boundary
+    if (r > 0) {
+        double theta = acos(z / r);
+        int b = (int)(theta * (ANGULAR_BINS / M_PI));
+        if (b >= ANGULAR_BINS)
+            b = ANGULAR_BINS - 1;
+        k = angular_bins[b];
+        if (k >= 0) {
+            double angle = M_PI;
+            if (cones[k].from > 0)
+                angle = theta - cones[k].from;
+            if (cones[k].to < M_PI)
+                angle = fmin(angle, cones[k].to - theta);
+            double d = (angle < M_PI / 2) ? r * sin(angle) : r;
+            if (d > skip)
+                skip = d;
+        }
+    }
+    return skip;
+}
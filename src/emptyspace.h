@@ -0,0 +1,49 @@
+#ifndef EMPTYSPACE_H
+#define EMPTYSPACE_H
+
+
+#include <vector>
+
+
+// Regions of negligible psi-function square of one state: shells around radial nodes,
+// cones around angular nodes and the exponential tail. Radius is in Bohr radii.
+class EmptySpaceMap {
+
+    struct Interval {
+        double from, to;
+    };
+
+// Number of lookup bins over radius and theta
+    static const int RADIAL_BINS = 4096;
+    static const int ANGULAR_BINS = 1024;
+
+    std::vector<Interval> shells, cones;
+    std::vector<int> radial_bins, angular_bins;
+    double cutoff_radius, radial_bin_scale;
+
+public:
+
+    EmptySpaceMap();
+
+// Build map from tabulated radial (over [0, radius]) and angular (over cos(theta) in [-1, 1]) values,
+// regions with values below threshold * maximum are empty
+    void build(const double *radial, int radial_size, double radius, const double *angular, int angular_size, double threshold);
+
+// Get radius beyond which all values are negligible
+    double cutoffRadius() const;
+
+// Get number of empty shells and cones
+    int shellCount() const;
+    int coneCount() const;
+
+// Check if point is in empty region
+    bool isEmpty(double x, double y, double z) const;
+    bool isEmptySpherical(double r, double cos_theta) const;
+
+// Return distance which can be passed from point in any direction without entering non-empty region
+    double skipDistance(double x, double y, double z) const;
+
+};
+
+
+#endif // EMPTYSPACE_H
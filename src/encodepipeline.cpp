@@ -0,0 +1,57 @@
+#include "encodepipeline.h"
+#include "parallel.h"
+
+
+EncodePipeline::EncodePipeline(int encoder_count, size_t capacity) :
+    queue(capacity > 0 ? capacity : 2 * (encoder_count > 0 ? encoder_count : defaultEncoders()))
+{
+    if (encoder_count <= 0)
+        encoder_count = defaultEncoders();
+    for (int i=0; i<encoder_count; i++)
+        encoders.emplace_back(&EncodePipeline::run, this);
+}
+
+
+EncodePipeline::~EncodePipeline()
+{
+    finish();
+}
+
+
+// Get default number of encoders
+int EncodePipeline::defaultEncoders()
+{
+    int count = TileScheduler::threadCount() / 2;
+    return (count > 0) ? count : 1;
+}
+
+
+// Queue image
+bool EncodePipeline::submit(EncodeJob job)
+{
+    return queue.push(std::move(job));
+}
+
+
+// Write queued images and stop encoders
+void EncodePipeline::finish()
+{
+    queue.close();
+    for (auto &encoder : encoders)
+        encoder.join();
+    encoders.clear();
+}
+
+
+// Encoder loop, parallel jobs of encoding run inline: encoders work in parallel with each other
+void EncodePipeline::run()
+{
+    TileScheduler::setInline(true);
+    EncodeJob job;
+    while (queue.pop(job)) {
+        bool written = ImageWriter::writeImage(job.path, job.format, job.pixels.data(), job.width, job.height);
+        if (job.done)
+            job.done(written);
+        job.pixels = std::vector<unsigned int>();
+    }
+}
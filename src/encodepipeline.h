@@ -0,0 +1,56 @@
+#ifndef ENCODEPIPELINE_H
+#define ENCODEPIPELINE_H
+
+
+#include <functional>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "boundedqueue.h"
+#include "imagewriter.h"
+
+
+// Rendered image to encode and write: 0xAARRGGBB pixels, format and path. Done is called
+// by encoder thread after the file is written
+struct EncodeJob {
+    std::vector<unsigned int> pixels;
+    int width, height;
+    ImageFormat format;
+    std::string path;
+    std::function<void(bool written)> done;
+};
+
+
+// Stage of batch rendering which encodes and writes images, while render workers compute next ones.
+// Every encoder thread encodes one image at a time. Render workers wait while the queue is full,
+// so memory of images in flight stays flat
+class EncodePipeline {
+
+    BoundedQueue<EncodeJob> queue;
+    std::vector<std::thread> encoders;
+
+    void run();
+
+public:
+
+// Default number of encoders is half of worker threads, default capacity is twice the number of encoders
+    explicit EncodePipeline(int encoder_count = 0, size_t capacity = 0);
+    ~EncodePipeline();
+
+    EncodePipeline(const EncodePipeline &) = delete;
+    EncodePipeline & operator=(const EncodePipeline &) = delete;
+
+// Default number of encoders
+    static int defaultEncoders();
+
+// Queue image, wait while the queue is full. False if the pipeline is finished
+    bool submit(EncodeJob job);
+
+// Wait until all queued images are written and stop encoders
+    void finish();
+
+};
+
+
+#endif // ENCODEPIPELINE_H
@@ -0,0 +1,281 @@
+#include "framecache.h"
+
+#include <cstring>
+
+
+FrameKey::FrameKey(const AtomModel &model, FrameKind frame_kind, int frame_width, int frame_height) :
+    kind(frame_kind),
+    state(model.canonicalState()),
+    probability_density(model.isProbabilityDensity()),
+    mov_x(0),
+    mov_y(0),
+    rot_x(0),
+    rot_y(0),
+    zoom(1),
+    width(frame_width),
+    height(frame_height),
+    clip_percentile(model.getToneMap().getClipPercentile()),
+    source(!model.isVolumeCacheEnabled() ? 0 : model.isVolumeOctree() ? 3 : model.isVolumeTricubic() ? 2 : 1),
+    precision(0)
+{
+// Graphic depends on n, l and model type only
+    if (kind == FRAME_GRAPHIC) {
+        state.m = 0;
+        clip_percentile = 0;
+        source = 0;
+    }
+}
+
+
+// Set canonical state
+void FrameKey::setState(const QuantumState &frame_state)
+{
+    state = frame_state;
+    if (kind == FRAME_GRAPHIC)
+        state.m = 0;
+}
+
+
+// Set camera of 3D models, or view center of 2D model, and magnification
+void FrameKey::setView(long double _mov_x, long double _mov_y, long double _rot_x, long double _rot_y, long double _zoom)
+{
+    mov_x = _mov_x;
+    mov_y = _mov_y;
+    rot_x = _rot_x;
+    rot_y = _rot_y;
+    zoom = _zoom;
+}
+
+
+// Write key to buffer
+size_t FrameKey::serialize(unsigned char *buffer) const
+{
+// Integer fields, then view and precision as doubles, after type tag of key
+    int32_t numbers[8] = {kind, state.n, state.l, state.m, probability_density, width, height, source};
+    double values[7] = {(double)mov_x, (double)mov_y, (double)rot_x, (double)rot_y, (double)zoom, (double)clip_percentile, (double)precision};
+    buffer[0] = 'F';
+    memcpy(buffer + 1, numbers, sizeof(numbers));
+    memcpy(buffer + 1 + sizeof(numbers), values, sizeof(values));
+    return 1 + sizeof(numbers) + sizeof(values);
+}
+
+
+bool FrameKey::operator<(const FrameKey &op1) const
+{
+    if (kind != op1.kind)
+        return kind < op1.kind;
+    if (state != op1.state)
+        return state < op1.state;
+    if (probability_density != op1.probability_density)
+        return probability_density < op1.probability_density;
+    if (width != op1.width)
+        return width < op1.width;
+    if (height != op1.height)
+        return height < op1.height;
+    if (mov_x != op1.mov_x)
+        return mov_x < op1.mov_x;
+    if (mov_y != op1.mov_y)
+        return mov_y < op1.mov_y;
+    if (rot_x != op1.rot_x)
+        return rot_x < op1.rot_x;
+    if (rot_y != op1.rot_y)
+        return rot_y < op1.rot_y;
+    if (zoom != op1.zoom)
+        return zoom < op1.zoom;
+    if (clip_percentile != op1.clip_percentile)
+        return clip_percentile < op1.clip_percentile;
+    if (source != op1.source)
+        return source < op1.source;
+    return precision < op1.precision;
+}
+
+
+FrameCache::FrameCache(size_t budget_bytes) :
+    budget(budget_bytes),
+    bytes(0),
+    hits(0),
+    shared_hits(0),
+    misses(0),
+    evictions(0),
+    guard(new CacheGuard()) {
+}
+
+
+FrameCache::~FrameCache()
+{
+    std::lock_guard<std::mutex> lock(guard->mutex);
+    guard->alive = false;
+    for (auto &entry : lru)
+        CacheAccountant::global().remove(entry.id);
+}
+
+
+// Set memory budget
+void FrameCache::setBudget(size_t budget_bytes)
+{
+    std::lock_guard<std::mutex> lock(guard->mutex);
+    budget = budget_bytes;
+    shrink(budget);
+}
+
+
+// Get memory budget
+size_t FrameCache::getBudget() const
+{
+    std::lock_guard<std::mutex> lock(guard->mutex);
+    return budget;
+}
+
+
+// Set cache shared with other processes
+void FrameCache::setShared(const std::shared_ptr<SharedCache> &shared_cache)
+{
+    std::lock_guard<std::mutex> lock(guard->mutex);
+    shared = shared_cache;
+}
+
+
+// Get cache shared with other processes
+std::shared_ptr<SharedCache> FrameCache::getShared() const
+{
+    std::lock_guard<std::mutex> lock(guard->mutex);
+    return shared;
+}
+
+
+// Get frame, nullptr if it is not cached
+FrameCache::Frame FrameCache::get(const FrameKey &key)
+{
+    std::shared_ptr<SharedCache> shared_cache;
+    {
+        std::lock_guard<std::mutex> lock(guard->mutex);
+        auto it = index.find(key);
+        if (it != index.end()) {
+        // Move frame to the front of use list
+            lru.splice(lru.begin(), lru, it->second);
+            hits++;
+            CacheAccountant::global().hit(it->second->id);
+            return it->second->frame;
+        }
+        shared_cache = shared;
+    }
+
+// Frame computed by other process is copied from shared cache
+    if (shared_cache) {
+        unsigned char buffer[SharedCache::MAX_KEY_SIZE];
+        size_t size;
+        std::shared_ptr<const void> data = shared_cache->get(buffer, key.serialize(buffer), size);
+        if (data) {
+            const long double *values = static_cast<const long double *>(data.get());
+            Frame frame(new std::vector<long double>(values, values + size / sizeof(long double)));
+            store(key, frame, 0);
+            std::lock_guard<std::mutex> lock(guard->mutex);
+            shared_hits++;
+            return frame;
+        }
+    }
+
+    std::lock_guard<std::mutex> lock(guard->mutex);
+    misses++;
+    CacheAccountant::global().miss(CACHE_FRAMES);
+    return Frame();
+}
+
+
+// Check if frame is cached
+bool FrameCache::contains(const FrameKey &key) const
+{
+    std::lock_guard<std::mutex> lock(guard->mutex);
+    if (index.count(key) > 0)
+        return true;
+    unsigned char buffer[SharedCache::MAX_KEY_SIZE];
+    return shared && shared->contains(buffer, key.serialize(buffer));
+}
+
+
+// Put frame
+void FrameCache::put(const FrameKey &key, const Frame &frame, double compute_ms)
+{
+    store(key, frame, compute_ms);
+    std::shared_ptr<SharedCache> shared_cache = getShared();
+    if (shared_cache) {
+        unsigned char buffer[SharedCache::MAX_KEY_SIZE];
+        shared_cache->put(buffer, key.serialize(buffer), frame->data(), frame->size() * sizeof(long double));
+    }
+}
+
+
+// Put frame to this cache
+void FrameCache::store(const FrameKey &key, const Frame &frame, double compute_ms)
+{
+    size_t size = frame->size() * sizeof(long double) + sizeof(Entry);
+    if (size > getBudget())
+        return;
+
+// Frame is accounted before locking, accountant can evict frames of this cache
+    uint64_t id = CacheAccountant::global().add(CACHE_FRAMES, size, compute_ms, guard, [this, key](uint64_t id) {
+        auto it = index.find(key);
+        if (it == index.end() || it->second->id != id)
+            return;
+        bytes -= it->second->bytes;
+        lru.erase(it->second);
+        index.erase(it);
+        evictions++;
+    });
+
+    std::lock_guard<std::mutex> lock(guard->mutex);
+    auto it = index.find(key);
+    if (it != index.end()) {
+        bytes -= it->second->bytes;
+        CacheAccountant::global().remove(it->second->id);
+        lru.erase(it->second);
+        index.erase(it);
+    }
+    shrink(budget > size ? budget - size : 0);
+
+    Entry entry = {key, frame, size, id};
+    lru.push_front(entry);
+    index[key] = lru.begin();
+    bytes += size;
+}
+
+
+// Remove least recently used frames until total size fits limit
+void FrameCache::shrink(size_t limit)
+{
+    while (bytes > limit && !lru.empty()) {
+        bytes -= lru.back().bytes;
+        CacheAccountant::global().remove(lru.back().id);
+        index.erase(lru.back().key);
+        lru.pop_back();
+        evictions++;
+    }
+}
+
+
+// Remove all frames
+void FrameCache::clear()
+{
+    std::lock_guard<std::mutex> lock(guard->mutex);
+    for (auto &entry : lru)
+        CacheAccountant::global().remove(entry.id);
+    lru.clear();
+    index.clear();
+    bytes = 0;
+}
+
+
+// Get cache statistics
+FrameCacheStats FrameCache::stats() const
+{
+    std::lock_guard<std::mutex> lock(guard->mutex);
+    FrameCacheStats s;
+    s.hits = hits;
+    s.shared_hits = shared_hits;
+    s.misses = misses;
+    s.evictions = evictions;
+    s.entries = lru.size();
+    s.bytes = bytes;
+    s.budget = budget;
+    return s;
+}
@@ -0,0 +1,138 @@
+#ifndef FRAMECACHE_H
+#define FRAMECACHE_H
+
+
+#include <functional>
+#include <list>
+#include <map>
+#include <memory>
+#include <vector>
+
+#include "atommodel.h"
+#include "cacheaccountant.h"
+#include "sharedcache.h"
+
+
+// Kind of computed model
+enum FrameKind {
+    FRAME_GRAPHIC,
+    FRAME_2D,
+    FRAME_SLICE,
+    FRAME_VOLUME,
+    FRAME_ISOSURFACE,
+    FRAME_CLOUD
+};
+
+
+// Identity of computed model: canonical state, model type, view, size and precision
+struct FrameKey {
+    FrameKind kind;
+    QuantumState state;
+    bool probability_density;
+    long double mov_x, mov_y, rot_x, rot_y, zoom;
+    int width, height;
+    long double clip_percentile;
+// Source of 3D values: 0 - psi-function, 1 - voxel volume, 2 - voxel volume with tricubic interpolation,
+// 3 - adaptive octree
+    int source;
+// Kind specific precision: number of points, grid size, level or opacity
+    long double precision;
+
+// Key of model's current state without view, key of graphic doesn't depend on m, tone map and volume source
+    FrameKey(const AtomModel &model, FrameKind frame_kind, int frame_width, int frame_height = 1);
+
+// Set canonical state, m of graphic stays zero
+    void setState(const QuantumState &frame_state);
+
+// Set camera of 3D models, or view center (mov_x, mov_y) of 2D model, and magnification
+    void setView(long double _mov_x, long double _mov_y, long double _rot_x, long double _rot_y, long double _zoom = 1);
+
+    bool operator<(const FrameKey &op1) const;
+
+// Write key to buffer of SharedCache::MAX_KEY_SIZE bytes, return its size
+    size_t serialize(unsigned char *buffer) const;
+};
+
+
+// Frame to compute: key, number of values and computation by given model in the key's state
+struct FrameJob {
+    FrameKey key;
+    size_t size;
+    std::function<void(AtomModel &model, long double *p)> compute;
+};
+
+
+// Cache statistics
+struct FrameCacheStats {
+    unsigned long long hits, shared_hits, misses, evictions;
+    size_t entries, bytes, budget;
+};
+
+
+// Least recently used cache of computed models, it can be shared by threads
+class FrameCache {
+
+    typedef std::shared_ptr<const std::vector<long double>> Frame;
+
+    struct Entry {
+        FrameKey key;
+        Frame frame;
+        size_t bytes;
+        uint64_t id;
+    };
+
+    std::list<Entry> lru;
+    std::map<FrameKey, std::list<Entry>::iterator> index;
+    size_t budget, bytes;
+    unsigned long long hits, shared_hits, misses, evictions;
+
+// Frames are kept under mutex of guard, accountant evicts them over common budget
+    std::shared_ptr<CacheGuard> guard;
+
+// Optional cache shared with other processes, frames missing here are looked up there
+    std::shared_ptr<SharedCache> shared;
+
+// Remove least recently used frames until total size fits budget
+    void shrink(size_t limit);
+
+// Put frame to this cache only
+    void store(const FrameKey &key, const Frame &frame, double compute_ms);
+
+public:
+
+// Default memory budget in bytes
+    static const size_t DEFAULT_BUDGET = 256u << 20;
+
+    explicit FrameCache(size_t budget_bytes = DEFAULT_BUDGET);
+    ~FrameCache();
+
+    FrameCache(const FrameCache &) = delete;
+    FrameCache & operator=(const FrameCache &) = delete;
+
+// Set / get memory budget in bytes
+    void setBudget(size_t budget_bytes);
+    size_t getBudget() const;
+
+// Set / get cache shared with other processes, nullptr - don't use
+    void setShared(const std::shared_ptr<SharedCache> &shared_cache);
+    std::shared_ptr<SharedCache> getShared() const;
+
+// Get frame, nullptr if it is not cached
+    Frame get(const FrameKey &key);
+
+// Check if frame is cached, statistics and use order are not changed
+    bool contains(const FrameKey &key) const;
+
+// Put frame with time spent on its computation, frames larger than budget are not cached here.
+// Frame is put to shared cache too
+    void put(const FrameKey &key, const Frame &frame, double compute_ms = 0);
+
+// Remove all frames, statistics are kept
+    void clear();
+
+    FrameCacheStats stats() const;
+
+};
+
+
+#endif // FRAMECACHE_H
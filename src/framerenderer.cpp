@@ -0,0 +1,142 @@
+#include "framerenderer.h"
+#include "camera.h"
+#include "radialprofile.h"
+#include "rasterizer.h"
+
+#include <algorithm>
+#include <cmath>
+
+
+View3D::View3D(View3DMode _mode, long double _mov_x, long double _mov_y, long double _rot_x, long double _rot_y, long double _zoom) :
+    mode(_mode),
+    mov_x(_mov_x),
+    mov_y(_mov_y),
+    rot_x(_rot_x),
+    rot_y(_rot_y),
+    zoom(_zoom) {
+}
+
+
+// Get job of graphic
+FrameJob FrameRenderer::graphicJob(const AtomModel &model, int points)
+{
+    FrameJob job = {FrameKey(model, FRAME_GRAPHIC, points), (size_t)points, [points](AtomModel &m, long double *p) {
+        m.modelGraphic(p, points);
+    }};
+    return job;
+}
+
+
+// Get job of adaptive graphic
+FrameJob FrameRenderer::adaptiveGraphicJob(const AtomModel &model, double tolerance)
+{
+    size_t size = ADAPTIVE_GRAPHIC_HEADER + 2 * (size_t)ADAPTIVE_GRAPHIC_POINTS;
+    FrameJob job = {FrameKey(model, FRAME_GRAPHIC, ADAPTIVE_GRAPHIC_POINTS), size, [tolerance](AtomModel &m, long double *p) {
+        bool density = m.isProbabilityDensity();
+        long double radius = m.maxRelativeRadius();
+        long double *points = p + ADAPTIVE_GRAPHIC_HEADER;
+        long double max = 0;
+        size_t count = 0;
+        RadialProfile profile(m.get_n(), m.get_l());
+        RadialSummary summary;
+        profile.sampleAdaptive(tolerance, [&](const RadialSample *samples, size_t samples_count) {
+            for (size_t i=0; i<samples_count && count<(size_t)ADAPTIVE_GRAPHIC_POINTS; i++, count++) {
+                points[count*2] = samples[i].r;
+                points[count*2 + 1] = density ? samples[i].R * samples[i].R : samples[i].probability;
+                if (samples[i].r <= radius && points[count*2 + 1] > max)
+                    max = points[count*2 + 1];
+            }
+            return count < (size_t)ADAPTIVE_GRAPHIC_POINTS;
+        }, summary);
+        for (size_t i=0; i<count && max>0; i++)
+            points[i*2 + 1] /= max;
+
+        size_t nodes = std::min(summary.nodes.size(), (size_t)AtomModel::MAX_N);
+        p[0] = summary.peak_radius;
+        p[1] = summary.mean_radius;
+        p[2] = nodes;
+        p[3] = count;
+        for (size_t i=0; i<nodes; i++)
+            p[4 + i] = summary.nodes[i];
+    }};
+    job.key.precision = tolerance;
+    return job;
+}
+
+
+// Get job of 2D model
+FrameJob FrameRenderer::job2D(const AtomModel &model, int width, int height, long double zoom, long double center_x, long double center_y)
+{
+// Magnified or moved view is taken from density pyramid
+    FrameJob job = {FrameKey(model, FRAME_2D, width, height), (size_t)height * width, [=](AtomModel &m, long double *p) {
+        if (zoom == 1 && center_x == 0 && center_y == 0) {
+            m.model2D(p, width, height);
+            return;
+        }
+        long double radius = m.maxRelativeRadius();
+        long double spacing = radius * 2 / sqrt(height*height + width*width) / zoom;
+        pyramid_cache.get(m)->render(m, p, width, height, center_x * radius, center_y * radius, spacing);
+    }};
+    job.key.setView(center_x, center_y, 0, 0, zoom);
+    return job;
+}
+
+
+// Get job of 3D model
+FrameJob FrameRenderer::job3D(const AtomModel &model, int width, int height, const View3D &view)
+{
+    FrameJob job = {FrameKey(model, FRAME_SLICE, width, height), (size_t)height * width, [=](AtomModel &m, long double *p) {
+        Camera3D camera(view.mov_x, view.mov_y, view.rot_x, view.rot_y);
+        if (view.mode == VIEW_VOLUME) {
+            m.modelVolume(p, width, height, view.mov_x, view.mov_y, view.rot_x, view.rot_y, view.zoom);
+        } else if (view.mode == VIEW_ISOSURFACE) {
+            std::shared_ptr<const Mesh> mesh = iso_cache.get(m, view.level);
+            MeshRasterizer::render(*mesh, camera, m.maxRelativeRadius(), p, width, height, view.zoom);
+        } else if (view.mode == VIEW_CLOUD) {
+            std::shared_ptr<const ElectronCloud> cloud = cloud_cache.get(m);
+            cloud->render(camera, m.maxRelativeRadius(), m.getToneMap(), p, width, height, view.zoom);
+        } else {
+            m.model3D(p, width, height, view.mov_x, view.mov_y, view.rot_x, view.rot_y, view.zoom);
+        }
+    }};
+    job.key.setView(view.mov_x, view.mov_y, view.rot_x, view.rot_y, view.zoom);
+    if (view.mode == VIEW_VOLUME) {
+        job.key.kind = FRAME_VOLUME;
+        job.key.precision = model.getVolumeOpacity();
+    } else if (view.mode == VIEW_ISOSURFACE) {
+        job.key.kind = FRAME_ISOSURFACE;
+        job.key.precision = view.level.by_probability ? view.level.value : -view.level.value;
+    } else if (view.mode == VIEW_CLOUD) {
+        job.key.kind = FRAME_CLOUD;
+        job.key.precision = ElectronCloud::DEFAULT_POINTS;
+    }
+    return job;
+}
+
+
+// Build color tables of 2D and 3D models
+void FrameRenderer::buildColorTables(const ToneMap &tm, unsigned int *colors_2d, unsigned int *colors_3d)
+{
+    tm.buildColorTable(colors_2d, COLOR_TABLE_SIZE, 255, 128, 0);
+    tm.buildColorTable(colors_3d, COLOR_TABLE_SIZE, 128, 10, 255);
+}
+
+
+// Convert relative values to colors, tone curve is already in color table
+void FrameRenderer::colorize(const long double *p, size_t count, const unsigned int *table, unsigned int *colors)
+{
+    for (size_t i=0; i<count; i++) {
+        long double intensity = p[i];
+        int index = (intensity > 1) ? COLOR_TABLE_SIZE - 1 : (intensity > 0) ? (int)(intensity * (COLOR_TABLE_SIZE - 1)) : 0;
+        colors[i] = 0xFF000000 | table[index];
+    }
+}
+
+
+// Remove cached meshes, clouds and pyramids
+void FrameRenderer::clear()
+{
+    iso_cache.clear();
+    cloud_cache.clear();
+    pyramid_cache.clear();
+}
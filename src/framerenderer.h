@@ -0,0 +1,76 @@
+#ifndef FRAMERENDERER_H
+#define FRAMERENDERER_H
+
+
+#include "densitypyramid.h"
+#include "electroncloud.h"
+#include "framecache.h"
+#include "isosurface.h"
+#include "tonemap.h"
+
+
+// Type of 3D model
+enum View3DMode {
+    VIEW_SLICE,
+    VIEW_VOLUME,
+    VIEW_ISOSURFACE,
+    VIEW_CLOUD
+};
+
+
+// View of 3D model: type, camera, zoom and isosurface level
+struct View3D {
+    View3DMode mode;
+    long double mov_x, mov_y, rot_x, rot_y, zoom;
+    IsoLevel level;
+
+    View3D(View3DMode _mode = VIEW_SLICE, long double _mov_x = 0, long double _mov_y = 0, long double _rot_x = 0, long double _rot_y = 0, long double _zoom = 1);
+};
+
+
+// Jobs of models shown by the program, the same for window, command line renderer and tools.
+// Jobs of zoomed 2D view, isosurface and cloud use caches of renderer
+class FrameRenderer {
+
+    IsoSurfaceCache iso_cache;
+    ElectronCloudCache cloud_cache;
+    DensityPyramidCache pyramid_cache;
+
+public:
+
+// Number of points of graphic and size of color tables
+    static const int GRAPHIC_POINTS = 1000;
+    static const int COLOR_TABLE_SIZE = 65536;
+
+// Adaptive graphic: tolerance of sampling, maximum number of points, and values before points:
+// most probable radius, mean radius, number of nodes, number of points, then AtomModel::MAX_N nodes
+    static constexpr double GRAPHIC_TOLERANCE = 1e-4;
+    static const int ADAPTIVE_GRAPHIC_POINTS = 8192;
+    static const int ADAPTIVE_GRAPHIC_HEADER = 4 + AtomModel::MAX_N;
+
+// Job of graphic of radial component at points evenly spaced over model radius
+    FrameJob graphicJob(const AtomModel &model, int points = GRAPHIC_POINTS);
+
+// Job of graphic of radial component sampled adaptively up to its cutoff radius: header, then (r, value)
+// of points, values are relative to maximum within model radius
+    FrameJob adaptiveGraphicJob(const AtomModel &model, double tolerance = GRAPHIC_TOLERANCE);
+
+// Job of 2D model, center is relative to model radius
+    FrameJob job2D(const AtomModel &model, int width, int height, long double zoom = 1, long double center_x = 0, long double center_y = 0);
+
+// Job of 3D model
+    FrameJob job3D(const AtomModel &model, int width, int height, const View3D &view);
+
+// Build color tables of 2D and 3D models (COLOR_TABLE_SIZE entries each)
+    static void buildColorTables(const ToneMap &tm, unsigned int *colors_2d, unsigned int *colors_3d);
+
+// Convert relative values to opaque 0xFFRRGGBB colors by color table
+    static void colorize(const long double *p, size_t count, const unsigned int *table, unsigned int *colors);
+
+// Remove cached meshes, clouds and pyramids
+    void clear();
+
+};
+
+
+#endif // FRAMERENDERER_H
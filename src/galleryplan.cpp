@@ -0,0 +1,55 @@
+#include "galleryplan.h"
+
+#include <algorithm>
+#include <cstdio>
+
+
+// Get models of gallery
+std::vector<GalleryItem> GalleryPlan::items(int n_max, const std::vector<std::string> &views, const std::string &format)
+{
+    std::vector<GalleryItem> items;
+    char name[128];
+    for (int n=1; n<=n_max; n++)
+        for (int l=0; l<n; l++)
+            for (int m=0; m<=l; m++)
+                for (int density=0; density<2; density++)
+                    for (auto &view : views) {
+                        snprintf(name, sizeof(name), "n%d-l%d-m%d-%s-%s.%s", n, l, m, density ? "density" : "probability",
+                                 view.c_str(), format.c_str());
+                        GalleryItem item = {n, l, m, density != 0, view, name};
+                        items.push_back(item);
+                    }
+    return items;
+}
+
+
+// Get order of rendering of models which aren't done
+std::vector<const GalleryItem *> GalleryPlan::schedule(const std::vector<GalleryItem> &items,
+                                                       const std::function<bool(const GalleryItem &item)> &done)
+{
+    std::vector<const GalleryItem *> pending;
+    for (auto &item : items)
+        if (!done(item))
+            pending.push_back(&item);
+    std::stable_sort(pending.begin(), pending.end(), [](const GalleryItem *a, const GalleryItem *b) {
+        if (a->n != b->n)
+            return a->n > b->n;
+        return a->l > b->l;
+    });
+    return pending;
+}
+
+
+// Get manifest of models which are done
+std::string GalleryPlan::manifest(const std::vector<GalleryItem> &items, const std::function<bool(const GalleryItem &item)> &done)
+{
+    std::string manifest = "n,l,m,mode,view,file\n";
+    char line[128];
+    for (auto &item : items)
+        if (done(item)) {
+            snprintf(line, sizeof(line), "%d,%d,%d,%s,%s,", item.n, item.l, item.m, item.density ? "density" : "probability",
+                     item.view.c_str());
+            manifest += line + item.file + "\n";
+        }
+    return manifest;
+}
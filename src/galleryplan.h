@@ -0,0 +1,38 @@
+#ifndef GALLERYPLAN_H
+#define GALLERYPLAN_H
+
+
+#include <functional>
+#include <string>
+#include <vector>
+
+
+// Model of gallery: state, model type and view
+struct GalleryItem {
+    int n, l, m;
+    bool density;
+    std::string view, file;
+};
+
+
+// Models of gallery of all states up to given n, their rendering order and manifest
+class GalleryPlan {
+
+public:
+
+// Distinct states in both model types for every view, states m and -m have the same density, so m >= 0.
+// Files are named n<n>-l<l>-m<m>-<mode>-<view>.<format>
+    static std::vector<GalleryItem> items(int n_max, const std::vector<std::string> &views, const std::string &format);
+
+// Order of rendering of models which aren't done yet: the largest states go first, as their models take
+// the longest, and small ones fill the cores at the end
+    static std::vector<const GalleryItem *> schedule(const std::vector<GalleryItem> &items,
+                                                     const std::function<bool(const GalleryItem &item)> &done);
+
+// Manifest (CSV) of models which are done: n, l, m, mode, view and file
+    static std::string manifest(const std::vector<GalleryItem> &items, const std::function<bool(const GalleryItem &item)> &done);
+
+};
+
+
+#endif // GALLERYPLAN_H
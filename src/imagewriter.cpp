@@ -0,0 +1,472 @@
+#include "imagewriter.h"
+#include "parallel.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+
+#ifdef _WIN32
+#include <fcntl.h>
+#include <io.h>
+#endif
+
+
+// Deflate bit stream, bits are packed starting from the least significant one
+class BitWriter {
+
+    std::vector<unsigned char> &out;
+    uint32_t bits;
+    int count;
+
+public:
+
+    explicit BitWriter(std::vector<unsigned char> &_out) :
+        out(_out),
+        bits(0),
+        count(0) {
+    }
+
+// Put n lower bits of value
+    void put(uint32_t value, int n)
+    {
+        bits |= value << count;
+        count += n;
+        while (count >= 8) {
+            out.push_back(bits & 0xFF);
+            bits >>= 8;
+            count -= 8;
+        }
+    }
+
+// Put Huffman code, its most significant bit goes first
+    void code(uint32_t value, int n)
+    {
+        uint32_t reversed = 0;
+        for (int i=0; i<n; i++)
+            reversed |= ((value >> i) & 1) << (n - 1 - i);
+        put(reversed, n);
+    }
+
+// Pad stream to byte boundary
+    void align()
+    {
+        if (count > 0)
+            out.push_back(bits & 0xFF);
+        bits = 0;
+        count = 0;
+    }
+
+};
+
+
+// Put literal or length symbol with fixed Huffman code
+static void put_symbol(BitWriter &bw, int symbol)
+{
+    if (symbol < 144)
+        bw.code(0x30 + symbol, 8);
+    else if (symbol < 256)
+        bw.code(0x190 + symbol - 144, 9);
+    else if (symbol < 280)
+        bw.code(symbol - 256, 7);
+    else
+        bw.code(0xC0 + symbol - 280, 8);
+}
+
+
+// Put match of length 3..258 at distance 1..32768
+static void put_match(BitWriter &bw, int length, int distance)
+{
+    static const int length_base[29] = {
+        3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258
+    };
+    static const int length_extra[29] = {
+        0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0
+    };
+    static const int distance_base[30] = {
+        1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193, 257, 385, 513, 769, 1025, 1537, 2049, 3073,
+        4097, 6145, 8193, 12289, 16385, 24577
+    };
+    static const int distance_extra[30] = {
+        0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13
+    };
+    int l = 28;
+    while (length_base[l] > length)
+        l--;
+    put_symbol(bw, 257 + l);
+    bw.put(length - length_base[l], length_extra[l]);
+    int d = 29;
+    while (distance_base[d] > distance)
+        d--;
+    bw.code(d, 5);
+    bw.put(distance - distance_base[d], distance_extra[d]);
+}
+
+
+// Compress chunk to one block with fixed codes. Not final chunk ends with empty stored block,
+// which aligns it to byte boundary, so chunks compressed separately are joined as is
+static void deflate_chunk(const unsigned char *data, size_t size, bool final, std::vector<unsigned char> &out)
+{
+    const int HASH_BITS = 15, WINDOW = 32768, MAX_MATCH = 258;
+    BitWriter bw(out);
+    bw.put(final ? 1 : 0, 1);
+    bw.put(1, 2);
+
+// Greedy matching, the last position of every 3-byte hash is the only candidate
+    std::vector<int64_t> head((size_t)1 << HASH_BITS, -1);
+    auto hash = [&](size_t i) {
+        return ((data[i] << 10) ^ (data[i+1] << 5) ^ data[i+2]) & ((1 << HASH_BITS) - 1);
+    };
+    size_t i = 0;
+    while (i < size) {
+        int length = 0;
+        size_t candidate = 0;
+        if (i + 3 <= size) {
+            int h = hash(i);
+            int64_t last = head[h];
+            head[h] = i;
+            if (last >= 0 && i - last <= WINDOW) {
+                candidate = last;
+                size_t limit = (size - i < (size_t)MAX_MATCH) ? size - i : MAX_MATCH;
+                while ((size_t)length < limit && data[candidate + length] == data[i + length])
+                    length++;
+            }
+        }
+        if (length >= 3) {
+            put_match(bw, length, i - candidate);
+            for (size_t j = i + 1; j < i + length && j + 3 <= size; j++)
+                head[hash(j)] = j;
+            i += length;
+        } else {
+            put_symbol(bw, data[i]);
+            i++;
+        }
+    }
+    put_symbol(bw, 256);
+
+    if (!final) {
+        bw.put(0, 3);
+        bw.align();
+        out.push_back(0x00);
+        out.push_back(0x00);
+        out.push_back(0xFF);
+        out.push_back(0xFF);
+    } else {
+        bw.align();
+    }
+}
+
+
+// Compress data to zlib stream
+void ImageWriter::compress(const unsigned char *data, size_t size, std::vector<unsigned char> &out)
+{
+    const size_t CHUNK_SIZE = 256 << 10;
+    int chunks = (size + CHUNK_SIZE - 1) / CHUNK_SIZE;
+    if (chunks < 1)
+        chunks = 1;
+    std::vector<std::vector<unsigned char>> parts(chunks);
+    TileScheduler::forEach(chunks, [&](int c, int) {
+        size_t begin = c * CHUNK_SIZE;
+        size_t end = (begin + CHUNK_SIZE < size) ? begin + CHUNK_SIZE : size;
+        deflate_chunk(data + begin, end - begin, c == chunks - 1, parts[c]);
+    });
+
+// Header: deflate with 32K window, default compression, then chunks and checksum
+    out.push_back(0x78);
+    out.push_back(0x01);
+    for (auto &part : parts)
+        out.insert(out.end(), part.begin(), part.end());
+    uint32_t adler = adler32(data, size);
+    for (int s=24; s>=0; s-=8)
+        out.push_back(adler >> s & 0xFF);
+}
+
+
+// Compute CRC-32 of PNG chunks
+uint32_t ImageWriter::crc32(const unsigned char *data, size_t size, uint32_t crc)
+{
+// Table of remainders of all bytes, it is built once by the first caller
+    struct Table {
+        uint32_t values[256];
+        Table() {
+            for (uint32_t n=0; n<256; n++) {
+                uint32_t c = n;
+                for (int k=0; k<8; k++)
+                    c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+                values[n] = c;
+            }
+        }
+    };
+    static const Table table;
+    crc = ~crc;
+    for (size_t i=0; i<size; i++)
+        crc = table.values[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+    return ~crc;
+}
+
+
+// Compute Adler-32 of zlib streams
+uint32_t ImageWriter::adler32(const unsigned char *data, size_t size, uint32_t adler)
+{
+    uint32_t a = adler & 0xFFFF, b = adler >> 16;
+    while (size > 0) {
+    // Sums don't overflow for 5552 bytes
+        size_t n = (size < 5552) ? size : 5552;
+        for (size_t i=0; i<n; i++) {
+            a += data[i];
+            b += a;
+        }
+        a %= 65521;
+        b %= 65521;
+        data += n;
+        size -= n;
+    }
+    return b << 16 | a;
+}
+
+
+// Paeth predictor of PNG filter 4
+static int paeth(int a, int b, int c)
+{
+    int p = a + b - c;
+    int pa = abs(p - a), pb = abs(p - b), pc = abs(p - c);
+    if (pa <= pb && pa <= pc)
+        return a;
+    return (pb <= pc) ? b : c;
+}
+
+
+// Encode image to PNG
+void ImageWriter::encodePNG(const unsigned int *pixels, int width, int height, std::vector<unsigned char> &png)
+{
+    size_t stride = (size_t)width * 3;
+
+// Every row gets filter with the least sum of absolute differences, rows are filtered in parallel
+    std::vector<unsigned char> filtered((stride + 1) * height);
+    TileScheduler::forEach(height, [&](int y, int) {
+        std::vector<unsigned char> row(stride), prior(stride, 0), candidate(stride);
+        for (int x=0; x<width; x++) {
+            unsigned int c = pixels[(size_t)y * width + x];
+            row[x*3] = c >> 16 & 0xFF;
+            row[x*3+1] = c >> 8 & 0xFF;
+            row[x*3+2] = c & 0xFF;
+            if (y > 0) {
+                unsigned int u = pixels[(size_t)(y-1) * width + x];
+                prior[x*3] = u >> 16 & 0xFF;
+                prior[x*3+1] = u >> 8 & 0xFF;
+                prior[x*3+2] = u & 0xFF;
+            }
+        }
+        unsigned char *out = &filtered[(stride + 1) * y];
+        long best_sum = -1;
+        for (int filter=0; filter<5; filter++) {
+            long sum = 0;
+            for (size_t i=0; i<stride; i++) {
+                int a = (i >= 3) ? row[i-3] : 0, b = prior[i], c = (i >= 3) ? prior[i-3] : 0;
+                int predicted = (filter == 1) ? a : (filter == 2) ? b : (filter == 3) ? (a + b) / 2 : (filter == 4) ? paeth(a, b, c) : 0;
+                candidate[i] = row[i] - predicted;
+                sum += (candidate[i] < 128) ? candidate[i] : 256 - candidate[i];
+            }
+            if (best_sum < 0 || sum < best_sum) {
+                best_sum = sum;
+                out[0] = filter;
+                std::copy(candidate.begin(), candidate.end(), out + 1);
+            }
+        }
+    });
+    std::vector<unsigned char> idat;
+    compress(filtered.data(), filtered.size(), idat);
+
+// Chunk: length, type, data and CRC of type and data
+    auto put32 = [&](uint32_t v) {
+        for (int s=24; s>=0; s-=8)
+            png.push_back(v >> s & 0xFF);
+    };
+    auto chunk = [&](const char *type, const unsigned char *data, size_t size) {
+        put32(size);
+        size_t start = png.size();
+        png.insert(png.end(), type, type + 4);
+        png.insert(png.end(), data, data + size);
+        put32(crc32(&png[start], size + 4));
+    };
+    static const unsigned char signature[8] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n'};
+    png.assign(signature, signature + 8);
+    unsigned char header[13] = {
+        (unsigned char)(width >> 24), (unsigned char)(width >> 16), (unsigned char)(width >> 8), (unsigned char)width,
+        (unsigned char)(height >> 24), (unsigned char)(height >> 16), (unsigned char)(height >> 8), (unsigned char)height,
+        8, 2, 0, 0, 0
+    };
+    chunk("IHDR", header, sizeof(header));
+    chunk("IDAT", idat.data(), idat.size());
+    chunk("IEND", nullptr, 0);
+}
+
+
+// Write image to PNG file
+bool ImageWriter::writePNG(const std::string &path, const unsigned int *pixels, int width, int height)
+{
+    std::vector<unsigned char> png;
+    encodePNG(pixels, width, height, png);
+    return writeFile(path, png.data(), png.size());
+}
+
+
+// Encode image to QOI: runs of the previous pixel, recently seen pixels by hash, small differences
+// from the previous pixel, or literal pixels
+void ImageWriter::encodeQOI(const unsigned int *pixels, int width, int height, std::vector<unsigned char> &qoi)
+{
+    qoi.clear();
+    qoi.reserve(14 + (size_t)width * height * 4 + 8);
+    auto put32 = [&](uint32_t v) {
+        for (int s=24; s>=0; s-=8)
+            qoi.push_back(v >> s & 0xFF);
+    };
+    qoi.push_back('q');
+    qoi.push_back('o');
+    qoi.push_back('i');
+    qoi.push_back('f');
+    put32(width);
+    put32(height);
+    qoi.push_back(3);
+    qoi.push_back(0);
+
+// Seen pixels are opaque, so empty slots of index (transparent black) never match
+    uint32_t seen[64] = {};
+    uint32_t previous = 0xFF000000;
+    int run = 0;
+    size_t count = (size_t)width * height;
+    for (size_t i=0; i<count; i++) {
+        uint32_t pixel = pixels[i] | 0xFF000000;
+        if (pixel == previous) {
+            run++;
+            if (run == 62 || i + 1 == count) {
+                qoi.push_back(0xC0 | (run - 1));
+                run = 0;
+            }
+            continue;
+        }
+        if (run > 0) {
+            qoi.push_back(0xC0 | (run - 1));
+            run = 0;
+        }
+        int r = pixel >> 16 & 0xFF, g = pixel >> 8 & 0xFF, b = pixel & 0xFF;
+        int hash = (r * 3 + g * 5 + b * 7 + 255 * 11) % 64;
+        if (seen[hash] == pixel) {
+            qoi.push_back(hash);
+            previous = pixel;
+            continue;
+        }
+        seen[hash] = pixel;
+
+    // Differences wrap around like 8-bit values
+        int dr = (signed char)(r - (int)(previous >> 16 & 0xFF));
+        int dg = (signed char)(g - (int)(previous >> 8 & 0xFF));
+        int db = (signed char)(b - (int)(previous & 0xFF));
+        int dr_dg = dr - dg, db_dg = db - dg;
+        if (dr >= -2 && dr <= 1 && dg >= -2 && dg <= 1 && db >= -2 && db <= 1) {
+            qoi.push_back(0x40 | (dr + 2) << 4 | (dg + 2) << 2 | (db + 2));
+        } else if (dg >= -32 && dg <= 31 && dr_dg >= -8 && dr_dg <= 7 && db_dg >= -8 && db_dg <= 7) {
+            qoi.push_back(0x80 | (dg + 32));
+            qoi.push_back((dr_dg + 8) << 4 | (db_dg + 8));
+        } else {
+            qoi.push_back(0xFE);
+            qoi.push_back(r);
+            qoi.push_back(g);
+            qoi.push_back(b);
+        }
+        previous = pixel;
+    }
+    static const unsigned char end[8] = {0, 0, 0, 0, 0, 0, 0, 1};
+    qoi.insert(qoi.end(), end, end + 8);
+}
+
+
+// Get header of Y4M stream
+std::string ImageWriter::y4mHeader(int width, int height, int fps)
+{
+    char text[128];
+    snprintf(text, sizeof(text), "YUV4MPEG2 W%d H%d F%d:1 Ip A1:1 C444\n", width, height, fps);
+    return text;
+}
+
+
+// Convert image to Y4M frame
+void ImageWriter::encodeY4MFrame(const unsigned int *pixels, int width, int height, std::vector<unsigned char> &frame)
+{
+    static const char marker[] = "FRAME\n";
+    size_t count = (size_t)width * height, start = sizeof(marker) - 1;
+    frame.resize(start + 3 * count);
+    std::copy(marker, marker + start, frame.begin());
+    unsigned char *y = &frame[start], *cb = y + count, *cr = cb + count;
+    for (size_t i=0; i<count; i++) {
+        int r = pixels[i] >> 16 & 0xFF, g = pixels[i] >> 8 & 0xFF, b = pixels[i] & 0xFF;
+        y[i] = ((66 * r + 129 * g + 25 * b + 128) >> 8) + 16;
+        cb[i] = ((-38 * r - 74 * g + 112 * b + 128) >> 8) + 128;
+        cr[i] = ((112 * r - 94 * g - 18 * b + 128) >> 8) + 128;
+    }
+}
+
+
+// Encode image in given format
+void ImageWriter::encodeImage(ImageFormat format, const unsigned int *pixels, int width, int height, std::vector<unsigned char> &data)
+{
+    if (format == IMAGE_QOI)
+        encodeQOI(pixels, width, height, data);
+    else
+        encodePNG(pixels, width, height, data);
+}
+
+
+// Write image to file in given format
+bool ImageWriter::writeImage(const std::string &path, ImageFormat format, const unsigned int *pixels, int width, int height)
+{
+    std::vector<unsigned char> data;
+    encodeImage(format, pixels, width, height, data);
+    return writeFile(path, data.data(), data.size());
+}
+
+
+// Write values as 32-bit floats
+bool ImageWriter::writeRaw(const std::string &path, const long double *p, size_t count)
+{
+    std::vector<float> values(p, p + count);
+    return writeFile(path, values.data(), values.size() * sizeof(float));
+}
+
+
+// Write bytes to file
+bool ImageWriter::writeFile(const std::string &path, const void *data, size_t size)
+{
+    FILE *file = openFile(path);
+    if (file == nullptr)
+        return false;
+    return closeFile(file, fwrite(data, 1, size, file) == size);
+}
+
+
+// Check native byte order
+bool ImageWriter::littleEndian()
+{
+    uint16_t one = 1;
+    return *(unsigned char *)&one == 1;
+}
+
+
+// Open file for binary writing
+FILE * ImageWriter::openFile(const std::string &path)
+{
+    if (path != "-")
+        return fopen(path.c_str(), "wb");
+#ifdef _WIN32
+    _setmode(_fileno(stdout), _O_BINARY);
+#endif
+    return stdout;
+}
+
+
+// Close file, standard output is only flushed
+bool ImageWriter::closeFile(FILE *file, bool ok)
+{
+    if (file == stdout)
+        return fflush(file) == 0 && ok;
+    return fclose(file) == 0 && ok;
+}
@@ -0,0 +1,66 @@
+#ifndef IMAGEWRITER_H
+#define IMAGEWRITER_H
+
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+
+// Format of encoded images
+enum ImageFormat {
+    IMAGE_PNG,
+    IMAGE_QOI
+};
+
+
+// Encoding of rendered images and models without image libraries. Path "-" is standard output
+class ImageWriter {
+
+public:
+
+// Encode 0xAARRGGBB pixels (alpha is ignored) to RGB PNG, rows are filtered and compressed in parallel
+    static void encodePNG(const unsigned int *pixels, int width, int height, std::vector<unsigned char> &png);
+
+// Write image to PNG file
+    static bool writePNG(const std::string &path, const unsigned int *pixels, int width, int height);
+
+// Encode 0xAARRGGBB pixels (alpha is ignored) to RGB QOI, which is several times faster than PNG
+    static void encodeQOI(const unsigned int *pixels, int width, int height, std::vector<unsigned char> &qoi);
+
+// Header of Y4M stream of width x height frames at given frame rate, frames are 4:4:4
+    static std::string y4mHeader(int width, int height, int fps);
+
+// Convert image to Y4M frame: FRAME line and Y, Cb, Cr planes (BT.601, limited range)
+    static void encodeY4MFrame(const unsigned int *pixels, int width, int height, std::vector<unsigned char> &frame);
+
+// Encode image in given format and write it to file
+    static void encodeImage(ImageFormat format, const unsigned int *pixels, int width, int height, std::vector<unsigned char> &data);
+    static bool writeImage(const std::string &path, ImageFormat format, const unsigned int *pixels, int width, int height);
+
+// Write values as 32-bit floats with native byte order
+    static bool writeRaw(const std::string &path, const long double *p, size_t count);
+
+// Write bytes to file
+    static bool writeFile(const std::string &path, const void *data, size_t size);
+
+// Check if native byte order of written values is little endian
+    static bool littleEndian();
+
+// Open file for binary writing, standard output for path "-". Close it, false if writing or closing failed
+    static FILE * openFile(const std::string &path);
+    static bool closeFile(FILE *file, bool ok = true);
+
+// Compress data to zlib stream by deflate with fixed Huffman codes, chunks are compressed in parallel
+    static void compress(const unsigned char *data, size_t size, std::vector<unsigned char> &out);
+
+// Checksums of PNG chunks and zlib streams
+    static uint32_t crc32(const unsigned char *data, size_t size, uint32_t crc = 0);
+    static uint32_t adler32(const unsigned char *data, size_t size, uint32_t adler = 1);
+
+};
+
+
+#endif // IMAGEWRITER_H
@@ -0,0 +1,186 @@
+#include "isosurface.h"
+#include "parallel.h"
+
+#include <algorithm>
+#include <cmath>
+#include <functional>
+
+
+// Get number of triangles
+int Mesh::triangleCount() const
+{
+    return positions.size() / 9;
+}
+
+
+IsoLevel::IsoLevel(bool _by_probability, double _value) :
+    by_probability(_by_probability),
+    value(_value) {
+}
+
+
+bool IsoLevel::operator<(const IsoLevel &op1) const
+{
+    if (by_probability != op1.by_probability)
+        return by_probability < op1.by_probability;
+    return value < op1.value;
+}
+
+
+// Find relative density which encloses given probability on sampled grid
+double IsoSurface::levelForProbability(const float *grid, size_t count, double probability)
+{
+// Grid cells have equal volume, so probability inside the surface is the sum of the largest values
+    std::vector<float> values(grid, grid + count);
+    std::sort(values.begin(), values.end(), std::greater<float>());
+    double total = 0;
+    for (size_t i=0; i<count; i++)
+        total += values[i];
+    double sum = 0;
+    for (size_t i=0; i<count; i++) {
+        sum += values[i];
+        if (sum >= probability * total)
+            return values[i];
+    }
+    return 0;
+}
+
+
+// Extract isosurface of probability density of model's current state
+std::shared_ptr<const Mesh> IsoSurface::extract(AtomModel &model, const IsoLevel &level, int grid_size)
+{
+    double radius = model.densityCutoffRadius();
+    std::vector<float> grid((size_t)grid_size * grid_size * grid_size);
+    model.modelGrid(grid.data(), grid_size, radius);
+    double c = level.value;
+    if (level.by_probability)
+        c = levelForProbability(grid.data(), grid.size(), level.value);
+    return extractGrid(grid.data(), grid_size, radius, c);
+}
+
+
+// Extract isosurface from sampled grid by marching tetrahedra: every grid cube is split into
+// six tetrahedra along its main diagonal, and each tetrahedron gives up to two triangles
+std::shared_ptr<const Mesh> IsoSurface::extractGrid(const float *grid, int size, double radius, float level)
+{
+// Cube corners are numbered x + 2*y + 4*z, all tetrahedra share the diagonal 0-7
+    static const int tetrahedra[6][4] = {
+        {0, 1, 3, 7}, {0, 2, 3, 7}, {0, 2, 6, 7}, {0, 4, 6, 7}, {0, 4, 5, 7}, {0, 1, 5, 7}
+    };
+    double step = 2 * radius / (size - 1);
+    auto value = [&](int i, int j, int k) {
+        return grid[((size_t)k * size + j) * size + i];
+    };
+
+// Every slab of cubes is processed separately, then meshes are joined in order
+    std::vector<Mesh> slabs(size - 1);
+    TileScheduler::forEach(size - 1, [&](int k, int) {
+        Mesh &mesh = slabs[k];
+        float pos[8][3], grad[8][3], val[8];
+        for (int j=0; j<size-1; j++)
+            for (int i=0; i<size-1; i++) {
+
+            // Skip cubes, which are not crossed by the surface
+                int inside = 0;
+                for (int c=0; c<8; c++) {
+                    val[c] = value(i + (c & 1), j + (c >> 1 & 1), k + (c >> 2));
+                    inside += val[c] > level;
+                }
+                if (inside == 0 || inside == 8)
+                    continue;
+
+            // Corner positions and density gradients by central differences
+                for (int c=0; c<8; c++) {
+                    int ci = i + (c & 1), cj = j + (c >> 1 & 1), ck = k + (c >> 2);
+                    pos[c][0] = -radius + ci * step;
+                    pos[c][1] = -radius + cj * step;
+                    pos[c][2] = -radius + ck * step;
+                    grad[c][0] = value(std::min(ci+1, size-1), cj, ck) - value(std::max(ci-1, 0), cj, ck);
+                    grad[c][1] = value(ci, std::min(cj+1, size-1), ck) - value(ci, std::max(cj-1, 0), ck);
+                    grad[c][2] = value(ci, cj, std::min(ck+1, size-1)) - value(ci, cj, std::max(ck-1, 0));
+                }
+
+            // Add vertex on edge a-b, normal is directed to lower density
+                auto vertex = [&](int a, int b) {
+                    float t = (level - val[a]) / (val[b] - val[a]);
+                    float n[3];
+                    for (int d=0; d<3; d++) {
+                        mesh.positions.push_back(pos[a][d] + t * (pos[b][d] - pos[a][d]));
+                        n[d] = -(grad[a][d] + t * (grad[b][d] - grad[a][d]));
+                    }
+                    float len = sqrt(n[0]*n[0] + n[1]*n[1] + n[2]*n[2]);
+                    if (len > 0)
+                        len = 1 / len;
+                    for (int d=0; d<3; d++)
+                        mesh.normals.push_back(n[d] * len);
+                };
+
+                for (int t=0; t<6; t++) {
+                    int in[4], out[4], ni = 0, no = 0;
+                    for (int c=0; c<4; c++) {
+                        int corner = tetrahedra[t][c];
+                        if (val[corner] > level)
+                            in[ni++] = corner;
+                        else
+                            out[no++] = corner;
+                    }
+                    if (ni == 1) {
+                        vertex(in[0], out[0]); vertex(in[0], out[1]); vertex(in[0], out[2]);
+                    } else if (ni == 3) {
+                        vertex(out[0], in[0]); vertex(out[0], in[1]); vertex(out[0], in[2]);
+                    } else if (ni == 2) {
+                    // Quad in0-out0, in0-out1, in1-out1, in1-out0 is split into two triangles
+                        vertex(in[0], out[0]); vertex(in[0], out[1]); vertex(in[1], out[1]);
+                        vertex(in[0], out[0]); vertex(in[1], out[1]); vertex(in[1], out[0]);
+                    }
+                }
+            }
+    });
+
+// Join slabs
+    std::shared_ptr<Mesh> mesh(new Mesh());
+    size_t total = 0;
+    for (auto &slab : slabs)
+        total += slab.positions.size();
+    mesh->positions.reserve(total);
+    mesh->normals.reserve(total);
+    for (auto &slab : slabs) {
+        mesh->positions.insert(mesh->positions.end(), slab.positions.begin(), slab.positions.end());
+        mesh->normals.insert(mesh->normals.end(), slab.normals.begin(), slab.normals.end());
+    }
+    return mesh;
+}
+
+
+bool IsoSurfaceCache::Key::operator<(const Key &op1) const
+{
+    if (state != op1.state)
+        return state < op1.state;
+    if (grid_size != op1.grid_size)
+        return grid_size < op1.grid_size;
+    return level < op1.level;
+}
+
+
+IsoSurfaceCache::IsoSurfaceCache(int max_meshes) :
+    cache(CACHE_MESHES, max_meshes) {
+}
+
+
+// Get mesh of model's current state, extract it if it is not cached
+std::shared_ptr<const Mesh> IsoSurfaceCache::get(AtomModel &model, const IsoLevel &level, int grid_size)
+{
+    Key key = {model.canonicalState(), level, grid_size};
+    return cache.get(key, [&]() {
+        return IsoSurface::extract(model, level, grid_size);
+    }, [](const Mesh &mesh) {
+        return (mesh.positions.size() + mesh.normals.size()) * sizeof(float);
+    });
+}
+
+
+// Remove all meshes
+void IsoSurfaceCache::clear()
+{
+    cache.clear();
+}
@@ -0,0 +1,77 @@
+#ifndef ISOSURFACE_H
+#define ISOSURFACE_H
+
+
+#include <map>
+#include <memory>
+#include <vector>
+
+#include "accountedcache.h"
+#include "atommodel.h"
+
+
+// Triangle mesh, every three vertices form a triangle, coordinates are in Bohr radii
+struct Mesh {
+    std::vector<float> positions;
+    std::vector<float> normals;
+
+    int triangleCount() const;
+};
+
+
+// Level of isosurface: probability density relative to its maximum,
+// or probability to find electron inside the surface
+struct IsoLevel {
+    bool by_probability;
+    double value;
+
+    IsoLevel(bool _by_probability = true, double _value = 0.9);
+    bool operator<(const IsoLevel &op1) const;
+};
+
+
+class IsoSurface {
+
+public:
+
+// Default and maximum number of grid nodes along each axis, the whole grid is kept in memory (4 GB at most)
+    static const int DEFAULT_GRID_SIZE = 96;
+    static const int MAX_GRID_SIZE = 1024;
+
+// Find relative density which encloses given probability (0..1) on sampled grid
+    static double levelForProbability(const float *grid, size_t count, double probability);
+
+// Extract isosurface of probability density of model's current state
+    static std::shared_ptr<const Mesh> extract(AtomModel &model, const IsoLevel &level, int grid_size = DEFAULT_GRID_SIZE);
+
+// Extract isosurface of relative density level from sampled grid over cube [-radius, radius]^3
+    static std::shared_ptr<const Mesh> extractGrid(const float *grid, int size, double radius, float level);
+
+};
+
+
+// Cache of extracted meshes per state and level
+class IsoSurfaceCache {
+
+    struct Key {
+        QuantumState state;
+        IsoLevel level;
+        int grid_size;
+        bool operator<(const Key &op1) const;
+    };
+
+    AccountedCache<Key, const Mesh> cache;
+
+public:
+
+    explicit IsoSurfaceCache(int max_meshes = 8);
+
+// Get mesh of model's current state, extract it if it is not cached
+    std::shared_ptr<const Mesh> get(AtomModel &model, const IsoLevel &level, int grid_size = IsoSurface::DEFAULT_GRID_SIZE);
+
+    void clear();
+
+};
+
+
+#endif // ISOSURFACE_H
@@ -1,12 +1,76 @@
 #include "mainwindow.h"
+#include "sharedcache.h"
+#include "stateatlas.h"
 
 #include <QApplication>
+#include <QDir>
+#include <QFile>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+
+// Default atlas file, which is searched near the executable
+#define DEFAULT_ATLAS_NAME "simulatom.atlas"
+
+
+// Build atlas: --build-atlas FILE N_MAX [--meridional SIZE] [--volume SIZE]
+static int build_atlas(int argc, char *argv[])
+{
+    if (argc < 4) {
+        fprintf(stderr, "usage: %s --build-atlas FILE N_MAX [--meridional SIZE] [--volume SIZE]\n", argv[0]);
+        return 1;
+    }
+    int n_max = atoi(argv[3]);
+    if (n_max < 1 || n_max > AtomModel::MAX_N) {
+        fprintf(stderr, "N_MAX must be from 1 to %d\n", AtomModel::MAX_N);
+        return 1;
+    }
+    int meridional_size = 512, volume_size = 0;
+    for (int i=4; i+1<argc; i+=2) {
+        if (strcmp(argv[i], "--meridional") == 0)
+            meridional_size = atoi(argv[i+1]);
+        else if (strcmp(argv[i], "--volume") == 0)
+            volume_size = atoi(argv[i+1]);
+    }
+    bool ok = StateAtlas::build(argv[2], n_max, meridional_size, volume_size, [](int done, int total) {
+        fprintf(stderr, "\r%d / %d", done, total);
+    });
+    fprintf(stderr, ok ? "\n" : "\nfailed to write atlas %s\n", argv[2]);
+    return ok ? 0 : 1;
+}
 
 
 int main(int argc, char *argv[])
 {
+// Atlas is built without GUI
+    if (argc > 1 && strcmp(argv[1], "--build-atlas") == 0)
+        return build_atlas(argc, argv);
+
     QApplication a(argc, argv);
     MainWindow w;
+
+// Map atlas given by --atlas FILE or found near the executable
+    QString atlas_path = QDir(QApplication::applicationDirPath()).filePath(DEFAULT_ATLAS_NAME);
+    for (int i=1; i+1<argc; i++)
+        if (strcmp(argv[i], "--atlas") == 0)
+            atlas_path = QString::fromLocal8Bit(argv[i+1]);
+    if (QFile::exists(atlas_path)) {
+        std::shared_ptr<StateAtlas> atlas(new StateAtlas());
+        if (atlas->open(atlas_path.toLocal8Bit().toStdString()))
+            w.setAtlas(atlas);
+    }
+
+// Join cache shared by processes of the host: --shared-cache MB
+    for (int i=1; i+1<argc; i++)
+        if (strcmp(argv[i], "--shared-cache") == 0) {
+            std::shared_ptr<SharedCache> cache(new SharedCache());
+            if (cache->open(SharedCache::defaultName(), (size_t)atoi(argv[i+1]) << 20))
+                w.setSharedCache(cache);
+            else
+                fprintf(stderr, "shared cache is not available: %s\n", cache->getError().c_str());
+        }
+
     w.show();
     return a.exec();
 }
@@ -1,15 +1,40 @@
 #include "mainwindow.h"
 #include "ui_mainwindow.h"
 
+#include <QActionGroup>
+#include <QElapsedTimer>
+#include <QInputDialog>
+#include <QMessageBox>
+
 
 MainWindow::MainWindow(QWidget *parent)
     : QMainWindow(parent),
       ui(new Ui::MainWindow),
       image_2d(nullptr),
-      image_3d(nullptr)
+      image_3d(nullptr),
+      view_3d(VIEW_SLICE),
+      prefetcher(frame_cache),
+      graphic_radial_revision(~0ul),
+      graphic_mode_revision(~0ul),
+      colors_2d(new unsigned int[FrameRenderer::COLOR_TABLE_SIZE]),
+      colors_3d(new unsigned int[FrameRenderer::COLOR_TABLE_SIZE])
 {
     ui->setupUi(this);
     model = new AtomModel();
+    QActionGroup *tone_curves = new QActionGroup(this);
+    tone_curves->addAction(ui->action_tone_linear);
+    tone_curves->addAction(ui->action_tone_log);
+    tone_curves->addAction(ui->action_tone_gamma);
+    QActionGroup *views_3d = new QActionGroup(this);
+    views_3d->addAction(ui->action_view_slice);
+    views_3d->addAction(ui->action_view_volume);
+    views_3d->addAction(ui->action_view_isosurface);
+    views_3d->addAction(ui->action_view_cloud);
+    QActionGroup *eviction = new QActionGroup(this);
+    eviction->addAction(ui->action_evict_lru);
+    eviction->addAction(ui->action_evict_cost);
+    set_tone_map(model->getToneMap());
+    QObject::connect(ui->model_2d, SIGNAL(viewChanged(long double,long double,long double)), this, SLOT(on_model2d_viewChanged(long double,long double,long double)));
     QObject::connect(ui->model_3d, SIGNAL(viewChanged(long double,long double,long double,long double)), this, SLOT(on_model3d_viewChanged(long double,long double,long double,long double)));
     ui->statusbar->showMessage("Разработчик программы: студент группы ИВТ-12 НИУ МИЭТ Слесарев Вадим. Год разработки: 2021");
     ui->prob->setText("вероятность: |\u03A8|\u00B2*\u03C1\u00B2");
@@ -22,11 +47,30 @@ MainWindow::~MainWindow()
 {
     delete image_2d;
     delete image_3d;
+    delete[] colors_2d;
+    delete[] colors_3d;
     delete ui;
     delete model;
 }
 
 
+// Use precomputed atlas of states
+void MainWindow::setAtlas(std::shared_ptr<const StateAtlas> atlas)
+{
+    model->setAtlas(atlas);
+    frame_cache.clear();
+    redraw();
+}
+
+
+// Use cache shared with other processes
+void MainWindow::setSharedCache(std::shared_ptr<SharedCache> cache)
+{
+    model->setSharedCache(cache);
+    frame_cache.setShared(cache);
+}
+
+
 // Handle main quantum number changing
 void MainWindow::on_input_n_valueChanged(int arg1)
 {
@@ -74,6 +118,13 @@ void MainWindow::on_prob_toggled(bool checked)
 }
 
 
+// Handle 2D view changing
+void MainWindow::on_model2d_viewChanged(long double, long double, long double)
+{
+    redraw_2d();
+}
+
+
 // Handle view changing
 void MainWindow::on_model3d_viewChanged(long double mov_x, long double mov_y, long double rot_x, long double rot_y)
 {
@@ -85,43 +136,381 @@ void MainWindow::on_model3d_viewChanged(long double mov_x, long double mov_y, lo
 void MainWindow::on_reset_3d_clicked()
 {
     ui->model_3d->setView2Default();
-    redraw_3d(ui->model_3d->getMovX(), ui->model_3d->getMovY(), ui->model_3d->getRotX(), ui->model_3d->getRotX());
+    redraw_3d(ui->model_3d->getMovX(), ui->model_3d->getMovY(), ui->model_3d->getRotX(), ui->model_3d->getRotY());
+}
+
+
+// Handle linear tone curve selection
+void MainWindow::on_action_tone_linear_triggered()
+{
+    ToneMap tm = model->getToneMap();
+    tm.setCurve(TONE_LINEAR);
+    set_tone_map(tm);
+}
+
+
+// Handle logarithmic tone curve selection
+void MainWindow::on_action_tone_log_triggered()
+{
+    ToneMap tm = model->getToneMap();
+    tm.setCurve(TONE_LOG);
+    set_tone_map(tm);
+}
+
+
+// Handle gamma tone curve selection
+void MainWindow::on_action_tone_gamma_triggered()
+{
+    ToneMap tm = model->getToneMap();
+    tm.setCurve(TONE_GAMMA);
+    set_tone_map(tm);
+}
+
+
+// Handle gamma exponent changing
+void MainWindow::on_action_tone_gamma_value_triggered()
+{
+    ToneMap tm = model->getToneMap();
+    bool ok;
+    double gamma = QInputDialog::getDouble(this, "Гамма-кривая", "Показатель гаммы:", tm.getGamma(), 0.1, 10, 2, &ok);
+    if (!ok || !tm.setGamma(gamma))
+        return;
+    set_tone_map(tm);
+}
+
+
+// Handle logarithmic scale range changing
+void MainWindow::on_action_tone_decades_triggered()
+{
+    ToneMap tm = model->getToneMap();
+    bool ok;
+    double decades = QInputDialog::getDouble(this, "Логарифмическая шкала", "Диапазон, порядков:", tm.getDecades(), 1, 4.8, 1, &ok);
+    if (!ok || !tm.setDecades(decades))
+        return;
+    set_tone_map(tm);
+}
+
+
+// Handle white level percentile changing
+void MainWindow::on_action_tone_clip_triggered()
+{
+    ToneMap tm = model->getToneMap();
+    bool ok;
+    double percentile = QInputDialog::getDouble(this, "Отсечение", "Перцентиль уровня белого, %:", tm.getClipPercentile(), 50, 100, 2, &ok);
+    if (!ok || !tm.setClipPercentile(percentile))
+        return;
+    set_tone_map(tm);
+}
+
+
+// Handle 3D slice model selection
+void MainWindow::on_action_view_slice_triggered()
+{
+    view_3d = VIEW_SLICE;
+    redraw_3d(ui->model_3d->getMovX(), ui->model_3d->getMovY(), ui->model_3d->getRotX(), ui->model_3d->getRotY());
+}
+
+
+// Handle volumetric 3D model selection
+void MainWindow::on_action_view_volume_triggered()
+{
+    view_3d = VIEW_VOLUME;
+    redraw_3d(ui->model_3d->getMovX(), ui->model_3d->getMovY(), ui->model_3d->getRotX(), ui->model_3d->getRotY());
+}
+
+
+// Handle isosurface 3D model selection
+void MainWindow::on_action_view_isosurface_triggered()
+{
+    view_3d = VIEW_ISOSURFACE;
+    redraw_3d(ui->model_3d->getMovX(), ui->model_3d->getMovY(), ui->model_3d->getRotX(), ui->model_3d->getRotY());
+}
+
+
+// Handle electron cloud 3D model selection
+void MainWindow::on_action_view_cloud_triggered()
+{
+    view_3d = VIEW_CLOUD;
+    redraw_3d(ui->model_3d->getMovX(), ui->model_3d->getMovY(), ui->model_3d->getRotX(), ui->model_3d->getRotY());
+}
+
+
+// Handle isosurface level changing by enclosed probability
+void MainWindow::on_action_iso_probability_triggered()
+{
+    bool ok;
+    double probability = QInputDialog::getDouble(this, "Изоповерхность", "Вероятность нахождения электрона внутри поверхности, %:",
+                                                 iso_level.by_probability ? iso_level.value * 100 : 90, 1, 99.9, 1, &ok);
+    if (!ok)
+        return;
+    iso_level = IsoLevel(true, probability / 100);
+    if (view_3d == VIEW_ISOSURFACE)
+        redraw_3d(ui->model_3d->getMovX(), ui->model_3d->getMovY(), ui->model_3d->getRotX(), ui->model_3d->getRotY());
+}
+
+
+// Handle isosurface level changing by density value
+void MainWindow::on_action_iso_level_triggered()
+{
+    bool ok;
+    double level = QInputDialog::getDouble(this, "Изоповерхность", "Плотность вероятности относительно максимальной, %:",
+                                           iso_level.by_probability ? 5 : iso_level.value * 100, 0.001, 99, 3, &ok);
+    if (!ok)
+        return;
+    iso_level = IsoLevel(false, level / 100);
+    if (view_3d == VIEW_ISOSURFACE)
+        redraw_3d(ui->model_3d->getMovX(), ui->model_3d->getMovY(), ui->model_3d->getRotX(), ui->model_3d->getRotY());
+}
+
+
+// Handle voxel volume cache switching
+void MainWindow::on_action_volume_cache_toggled(bool checked)
+{
+    model->setVolumeCache(checked);
+    redraw_3d(ui->model_3d->getMovX(), ui->model_3d->getMovY(), ui->model_3d->getRotX(), ui->model_3d->getRotY());
+}
+
+
+// Handle voxel volume interpolation changing
+void MainWindow::on_action_volume_tricubic_toggled(bool checked)
+{
+    model->setVolumeTricubic(checked);
+    redraw_3d(ui->model_3d->getMovX(), ui->model_3d->getMovY(), ui->model_3d->getRotX(), ui->model_3d->getRotY());
+}
+
+
+// Handle switching between voxel grid and adaptive octree
+void MainWindow::on_action_volume_octree_toggled(bool checked)
+{
+    model->setVolumeOctree(checked);
+    redraw_3d(ui->model_3d->getMovX(), ui->model_3d->getMovY(), ui->model_3d->getRotX(), ui->model_3d->getRotY());
+}
+
+
+// Show cache statistics
+void MainWindow::on_action_cache_stats_triggered()
+{
+    FrameCacheStats stats = frame_cache.stats();
+    unsigned long long requests = stats.hits + stats.shared_hits + stats.misses;
+    QString text = QString("Изображений в кэше: %1\nИспользовано памяти: %2 из %3 МБ\n"
+                           "Попаданий: %4, из общего кэша: %5, промахов: %6 (%7% попаданий)\nВытеснено изображений: %8")
+            .arg(stats.entries)
+            .arg(stats.bytes / 1048576.0, 0, 'f', 1)
+            .arg(stats.budget >> 20)
+            .arg(stats.hits)
+            .arg(stats.shared_hits)
+            .arg(stats.misses)
+            .arg(requests ? 100.0 * (stats.hits + stats.shared_hits) / requests : 0.0, 0, 'f', 1)
+            .arg(stats.evictions);
+
+// Cache shared by processes of the host
+    std::shared_ptr<SharedCache> shared = frame_cache.getShared();
+    if (shared) {
+        SharedCacheStats s = shared->stats();
+        text += QString("\n\nОбщий кэш процессов: %1 записей, %2 из %3 МБ\nПопаданий: %4, промахов: %5, вытеснено: %6")
+                .arg(s.entries)
+                .arg(s.bytes / 1048576.0, 0, 'f', 1)
+                .arg(s.capacity >> 20)
+                .arg(s.hits)
+                .arg(s.misses)
+                .arg(s.evictions);
+    }
+
+// All caches of the process by category
+    static const char *names[CACHE_CATEGORY_COUNT] = {
+        "Таблицы", "Изображения", "Объёмы", "Поверхности", "Облака точек", "Пирамиды"
+    };
+    CacheAccountant &accountant = CacheAccountant::global();
+    CacheCategoryStats total = accountant.total();
+    text += QString("\n\nВсе кэши: %1 из %2 МБ, сэкономлено вычислений: %3 с")
+            .arg(total.bytes / 1048576.0, 0, 'f', 1)
+            .arg(accountant.getBudget() >> 20)
+            .arg(total.saved_ms / 1000, 0, 'f', 1);
+    for (int c=0; c<CACHE_CATEGORY_COUNT; c++) {
+        CacheCategoryStats s = accountant.stats((CacheCategory)c);
+        unsigned long long lookups = s.hits + s.misses;
+        text += QString("\n%1: %2 записей, %3 МБ, %4% попаданий, вытеснено: %5, сэкономлено: %6 с")
+                .arg(names[c])
+                .arg(s.entries)
+                .arg(s.bytes / 1048576.0, 0, 'f', 1)
+                .arg(lookups ? 100.0 * s.hits / lookups : 0.0, 0, 'f', 1)
+                .arg(s.evictions)
+                .arg(s.saved_ms / 1000, 0, 'f', 1);
+    }
+    QMessageBox::information(this, "Кэш изображений", text);
+}
+
+
+// Handle cache memory budget changing
+void MainWindow::on_action_cache_budget_triggered()
+{
+    bool ok;
+    int budget = QInputDialog::getInt(this, "Кэш изображений", "Объём памяти кэша, МБ:", frame_cache.getBudget() >> 20, 0, 65536, 16, &ok);
+    if (!ok)
+        return;
+    frame_cache.setBudget((size_t)budget << 20);
+}
+
+
+// Handle common memory budget of all caches changing
+void MainWindow::on_action_cache_total_budget_triggered()
+{
+    bool ok;
+    int budget = QInputDialog::getInt(this, "Кэши", "Общий объём памяти кэшей, МБ:", CacheAccountant::global().getBudget() >> 20, 16, 1048576, 64, &ok);
+    if (!ok)
+        return;
+    CacheAccountant::global().setBudget((size_t)budget << 20);
+}
+
+
+// Evict least recently used entries over common budget
+void MainWindow::on_action_evict_lru_triggered()
+{
+    CacheAccountant::global().setPolicy(EVICT_LRU);
+}
+
+
+// Evict entries with the least compute time per byte over common budget
+void MainWindow::on_action_evict_cost_triggered()
+{
+    CacheAccountant::global().setPolicy(EVICT_COST);
+}
+
+
+// Handle switching of neighbouring states precomputation
+void MainWindow::on_action_prefetch_toggled(bool checked)
+{
+    if (checked)
+        prefetch();
+    else
+        prefetcher.cancel();
+}
+
+
+// Apply tone mapping settings and redraw images
+void MainWindow::set_tone_map(const ToneMap &tm)
+{
+    model->setToneMap(tm);
+    FrameRenderer::buildColorTables(tm, colors_2d, colors_3d);
+    if (image_2d == nullptr)
+        return;
+    redraw_2d();
+    redraw_3d(ui->model_3d->getMovX(), ui->model_3d->getMovY(), ui->model_3d->getRotX(), ui->model_3d->getRotY());
 }
 
 
 // Redraw all models
 void MainWindow::redraw()
 {
-    ui->quantum_state->setText("Состояние: " + model->getState());
-    redraw_graphic();
+    ui->quantum_state->setText("Состояние: " + QString::fromStdString(model->getState()));
+// Graphic doesn't depend on m, so it isn't redrawn when only m is changed
+    if (graphic_radial_revision != model->getRadialRevision() || graphic_mode_revision != model->getModeRevision()) {
+        graphic_radial_revision = model->getRadialRevision();
+        graphic_mode_revision = model->getModeRevision();
+        redraw_graphic();
+    }
+    ui->model_2d->setView2Default();
     redraw_2d();
     ui->model_3d->setView2Default();
-    redraw_3d(ui->model_3d->getMovX(), ui->model_3d->getMovY(), ui->model_3d->getRotX(), ui->model_3d->getRotX());
+    redraw_3d(ui->model_3d->getMovX(), ui->model_3d->getMovY(), ui->model_3d->getRotX(), ui->model_3d->getRotY());
+    prefetch();
+}
+
+
+// Get model from cache or compute and cache it
+std::shared_ptr<const std::vector<long double>> MainWindow::compute_frame(const FrameJob &job)
+{
+    std::shared_ptr<const std::vector<long double>> frame = frame_cache.get(job.key);
+    if (frame)
+        return frame;
+    std::shared_ptr<std::vector<long double>> computed(new std::vector<long double>(job.size));
+    QElapsedTimer timer;
+    timer.start();
+    job.compute(*model, computed->data());
+    frame_cache.put(job.key, computed, timer.nsecsElapsed() / 1e6);
+    return computed;
+}
+
+
+// Get job of graphic
+FrameJob MainWindow::graphic_job()
+{
+    return renderer.adaptiveGraphicJob(*model);
+}
+
+
+// Get job of 2D model
+FrameJob MainWindow::job_2d()
+{
+    return renderer.job2D(*model, ui->model_2d->width(), ui->model_2d->height(),
+                          ui->model_2d->getZoom(), ui->model_2d->getCenterX(), ui->model_2d->getCenterY());
+}
+
+
+// Get job of 3D model
+FrameJob MainWindow::job_3d(long double mov_x, long double mov_y, long double rot_x, long double rot_y)
+{
+    View3D view(view_3d, mov_x, mov_y, rot_x, rot_y, ui->model_3d->getZoom());
+    view.level = iso_level;
+    return renderer.job3D(*model, ui->model_3d->width(), ui->model_3d->height(), view);
+}
+
+
+// Start computing models of neighbouring states, as they are shown right after state changing
+void MainWindow::prefetch()
+{
+    if (!ui->action_prefetch->isChecked())
+        return;
+    std::vector<FrameJob> jobs;
+    jobs.push_back(graphic_job());
+// Isosurface, cloud and zoomed 2D model are computed with meshes, clouds and pyramids of window, which the
+// prefetcher thread must not touch: 2D model is prefetched unzoomed, 3D model only as slice or volume
+    jobs.push_back(renderer.job2D(*model, ui->model_2d->width(), ui->model_2d->height()));
+    if (view_3d == VIEW_SLICE || view_3d == VIEW_VOLUME)
+        jobs.push_back(job_3d(ui->model_3d->getMovX(), ui->model_3d->getMovY(), ui->model_3d->getRotX(), ui->model_3d->getRotY()));
+    prefetcher.start(*model, jobs);
 }
 
 
 // Redraw graphic
 void MainWindow::redraw_graphic()
 {
-    const int points_count = 1000;
-
-// Compute model
-    long double *p = new long double[points_count];
-    model->modelGraphic(p, points_count);
+// Compute model: radial component is sampled adaptively up to its cutoff radius, points are dense where
+// the curve bends. Graphic shows part of it, which is relative to its maximum
+    std::shared_ptr<const std::vector<long double>> p = compute_frame(graphic_job());
+    const long double *points = p->data() + FrameRenderer::ADAPTIVE_GRAPHIC_HEADER;
+    int points_count = (int)(*p)[3];
+    double radius = model->maxRelativeRadius();
     QVector<double> x(points_count), y(points_count);
     for (int i=0; i<points_count; i++) {
-        x[i] = model->maxRelativeRadius() * i / points_count;
-        y[i] = p[i];
+        x[i] = points[i*2];
+        y[i] = points[i*2 + 1];
     }
-    delete[] p;
 
-// Build graphic
+// Build graphic, radial nodes are marked on the axis
+    ui->model_graphic->clearGraphs();
+    ui->model_graphic->clearItems();
     ui->model_graphic->addGraph();
     ui->model_graphic->graph(0)->setData(x, y);
+    ui->model_graphic->addGraph();
+    ui->model_graphic->graph(1)->setLineStyle(QCPGraph::lsNone);
+    ui->model_graphic->graph(1)->setScatterStyle(QCPScatterStyle(QCPScatterStyle::ssCircle, 6));
+    QVector<double> nodes;
+    for (int i=0; i<(int)(*p)[2]; i++)
+        nodes.push_back((*p)[4 + i]);
+    ui->model_graphic->graph(1)->setData(nodes, QVector<double>(nodes.size(), 0));
+
+// Most probable and mean radii
+    QCPItemText *text = new QCPItemText(ui->model_graphic);
+    text->position->setType(QCPItemPosition::ptAxisRectRatio);
+    text->position->setCoords(0.98, 0.05);
+    text->setPositionAlignment(Qt::AlignRight | Qt::AlignTop);
+    text->setText(QString("наиболее вероятное \u03C1 = %1, <\u03C1> = %2, радиальных узлов: %3")
+                  .arg((double)(*p)[0], 0, 'f', 3).arg((double)(*p)[1], 0, 'f', 3).arg(nodes.size()));
 
 // Set horizontal (r) axis
     ui->model_graphic->xAxis->setLabel("\u03C1 = r / r\u2080, r\u2080 = 0,529*10\u207B\u00B9\u2070 м - боровский радиус");
-    ui->model_graphic->xAxis->setRange(0, model->maxRelativeRadius());
+    ui->model_graphic->xAxis->setRange(0, radius);
 
 // Set vertical (phi^2*r^2 or phi^2) axis
     if (model->isProbabilityDensity()) {
@@ -148,26 +537,14 @@ void MainWindow::redraw_2d()
         image_2d = new QImage(width, height, QImage::Format_RGB32);
 
 // Compute model
-    long double *p = new long double[height * width];
-    model->model2D(p, width, height);
+    std::shared_ptr<const std::vector<long double>> frame = compute_frame(job_2d());
+    const long double *p = frame->data();
 
-// Per pixel drawing
+// Per line drawing, tone curve is already in color table
     for (int yy=0; yy<height; yy++)
-        for (int xx=0; xx<width; xx++)  {
-            long double intensity = p[yy*width + xx];
-        // Compute 8-bit color components
-            int r = 255 * intensity;
-            int g = 128 * intensity;
-            int b = 0 * intensity;
-            r = (r < 0) ? 0 : r; r = (r > 0xFF) ? 0xFF : r;
-            g = (g < 0) ? 0 : g; g = (g > 0xFF) ? 0xFF : g;
-            b = (b < 0) ? 0 : b; b = (b > 0xFF) ? 0xFF : b;
-        // Draw pixel
-            image_2d->setPixel(xx, yy, r<<16 | g<<8 | b);
-        }
+        FrameRenderer::colorize(p + yy*width, width, colors_2d, reinterpret_cast<unsigned int *>(image_2d->scanLine(yy)));
 
 // Show results
-    delete[] p;
     ui->model_2d->setPixmap(QPixmap::fromImage(*image_2d));
 }
 
@@ -183,25 +560,13 @@ void MainWindow::redraw_3d(long double mov_x, long double mov_y, long double rot
         image_3d = new QImage(width, height, QImage::Format_RGB32);
 
 // Compute model
-    long double *p = new long double[height * width];
-    model->model3D(p, width, height, mov_x, mov_y, rot_x, rot_y);
+    std::shared_ptr<const std::vector<long double>> frame = compute_frame(job_3d(mov_x, mov_y, rot_x, rot_y));
+    const long double *p = frame->data();
 
-// Per pixel drawing
+// Per line drawing, tone curve is already in color table
     for (int yy=0; yy<height; yy++)
-        for (int xx=0; xx<width; xx++)  {
-            long double intensity = p[yy*width + xx];
-        // Compute 8-bit color components
-            int r = 128 * intensity;
-            int g = 10 * intensity;
-            int b = 255 * intensity;
-            r = (r < 0) ? 0 : r; r = (r > 0xFF) ? 0xFF : r;
-            g = (g < 0) ? 0 : g; g = (g > 0xFF) ? 0xFF : g;
-            b = (b < 0) ? 0 : b; b = (b > 0xFF) ? 0xFF : b;
-        // Draw pixel
-            image_3d->setPixel(xx, yy, r<<16 | g<<8 | b);
-        }
+        FrameRenderer::colorize(p + yy*width, width, colors_3d, reinterpret_cast<unsigned int *>(image_3d->scanLine(yy)));
 
 // Show results
-    delete[] p;
     ui->model_3d->setPixmap(QPixmap::fromImage(*image_3d));
 }
@@ -3,9 +3,15 @@
 
 
 #include <QMainWindow>
+#include <functional>
 
 #include "atommodel.h"
+#include "framecache.h"
+#include "framerenderer.h"
+#include "prefetcher.h"
 #include "qcustomplot.h"
+#include "stateatlas.h"
+#include "viewer2d.h"
 #include "viewer3d.h"
 
 
@@ -21,19 +27,83 @@ public:
     MainWindow(QWidget *parent = nullptr);
     ~MainWindow();
 
+// Use precomputed atlas of states
+    void setAtlas(std::shared_ptr<const StateAtlas> atlas);
+
+// Use cache shared with other processes
+    void setSharedCache(std::shared_ptr<SharedCache> cache);
+
 private slots:
     void on_input_n_valueChanged(int arg1);
     void on_input_l_valueChanged(int arg1);
     void on_input_m_valueChanged(int arg1);
     void on_prob_dens_toggled(bool checked);
     void on_prob_toggled(bool checked);
+    void on_model2d_viewChanged(long double zoom, long double center_x, long double center_y);
     void on_model3d_viewChanged(long double mov_x, long double mov_y, long double rot_x, long double rot_y);
     void on_reset_3d_clicked();
+    void on_action_tone_linear_triggered();
+    void on_action_tone_log_triggered();
+    void on_action_tone_gamma_triggered();
+    void on_action_tone_gamma_value_triggered();
+    void on_action_tone_decades_triggered();
+    void on_action_tone_clip_triggered();
+    void on_action_view_slice_triggered();
+    void on_action_view_volume_triggered();
+    void on_action_view_isosurface_triggered();
+    void on_action_view_cloud_triggered();
+    void on_action_iso_probability_triggered();
+    void on_action_iso_level_triggered();
+    void on_action_volume_cache_toggled(bool checked);
+    void on_action_volume_tricubic_toggled(bool checked);
+    void on_action_volume_octree_toggled(bool checked);
+    void on_action_cache_stats_triggered();
+    void on_action_cache_budget_triggered();
+    void on_action_prefetch_toggled(bool checked);
+    void on_action_cache_total_budget_triggered();
+    void on_action_evict_lru_triggered();
+    void on_action_evict_cost_triggered();
 
 private:
+
     Ui::MainWindow *ui;
     AtomModel *model;
     QImage *image_2d, *image_3d;
+    View3DMode view_3d;
+
+// Isosurface level
+    IsoLevel iso_level;
+
+// Jobs of models with caches of extracted meshes, sampled electron positions and density pyramids of
+// zoomed 2D models: rotation of isosurface and cloud needs rasterization or reprojection only
+    FrameRenderer renderer;
+
+// Computed models of recent states and views
+    FrameCache frame_cache;
+
+// Background computation of models of neighbouring states, it puts them to frame cache
+    StatePrefetcher prefetcher;
+
+// Revisions of model shown by graphic, it depends on radial factor and model type only
+    unsigned long graphic_radial_revision, graphic_mode_revision;
+
+// Color tables of 2D and 3D models, indexed by relative value
+    unsigned int *colors_2d, *colors_3d;
+
+// Apply tone mapping settings
+    void set_tone_map(const ToneMap &tm);
+
+// Get model from cache or compute and cache it
+    std::shared_ptr<const std::vector<long double>> compute_frame(const FrameJob &job);
+
+// Jobs of shown models for current state and views. Jobs of zoomed 2D view, isosurface and cloud
+// use caches of renderer, they are run by GUI thread only
+    FrameJob graphic_job();
+    FrameJob job_2d();
+    FrameJob job_3d(long double mov_x, long double mov_y, long double rot_x, long double rot_y);
+
+// Start computing models of neighbouring states
+    void prefetch();
 
 // Model redraw
     void redraw();
@@ -0,0 +1,198 @@
+#include "mappedfile.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+
+MappedFile::MappedFile() :
+    data(nullptr),
+    length(0),
+    writable(false),
+#ifdef _WIN32
+    file(INVALID_HANDLE_VALUE),
+    mapping(nullptr) {
+#else
+    file(-1) {
+#endif
+}
+
+
+MappedFile::~MappedFile()
+{
+    close();
+}
+
+
+// Map file to memory
+bool MappedFile::open(const std::string &path)
+{
+    close();
+#ifdef _WIN32
+    file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE)
+        return false;
+    LARGE_INTEGER file_size;
+    if (!GetFileSizeEx(file, &file_size) || file_size.QuadPart == 0) {
+        close();
+        return false;
+    }
+    mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (mapping == nullptr) {
+        close();
+        return false;
+    }
+    data = (const unsigned char *)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    if (data == nullptr) {
+        close();
+        return false;
+    }
+    length = file_size.QuadPart;
+#else
+    file = ::open(path.c_str(), O_RDONLY);
+    if (file < 0)
+        return false;
+    struct stat st;
+    if (fstat(file, &st) != 0 || st.st_size == 0) {
+        close();
+        return false;
+    }
+    void *p = mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, file, 0);
+    if (p == MAP_FAILED) {
+        close();
+        return false;
+    }
+    data = (const unsigned char *)p;
+    length = st.st_size;
+#endif
+    return true;
+}
+
+
+// Unmap file
+void MappedFile::close()
+{
+#ifdef _WIN32
+    if (data != nullptr)
+        UnmapViewOfFile(data);
+    if (mapping != nullptr)
+        CloseHandle(mapping);
+    if (file != INVALID_HANDLE_VALUE)
+        CloseHandle(file);
+    mapping = nullptr;
+    file = INVALID_HANDLE_VALUE;
+#else
+    if (data != nullptr)
+        munmap((void *)data, length);
+    if (file >= 0)
+        ::close(file);
+    file = -1;
+#endif
+    data = nullptr;
+    length = 0;
+    writable = false;
+}
+
+
+// Create file and map it for writing
+bool MappedFile::create(const std::string &path, size_t size)
+{
+    close();
+    if (size == 0)
+        return false;
+#ifdef _WIN32
+    file = CreateFileA(path.c_str(), GENERIC_READ | GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE)
+        return false;
+    mapping = CreateFileMappingA(file, nullptr, PAGE_READWRITE, (DWORD)((unsigned long long)size >> 32), (DWORD)size, nullptr);
+    if (mapping == nullptr) {
+        close();
+        return false;
+    }
+    data = (const unsigned char *)MapViewOfFile(mapping, FILE_MAP_WRITE, 0, 0, size);
+    if (data == nullptr) {
+        close();
+        return false;
+    }
+#else
+    file = ::open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (file < 0)
+        return false;
+    if (ftruncate(file, size) != 0) {
+        close();
+        return false;
+    }
+    void *p = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, file, 0);
+    if (p == MAP_FAILED) {
+        close();
+        return false;
+    }
+    data = (const unsigned char *)p;
+#endif
+    length = size;
+    writable = true;
+    return true;
+}
+
+
+// Write range to disk and drop its pages, range is extended to whole pages
+bool MappedFile::flush(size_t offset, size_t size)
+{
+    if (!writable || offset >= length)
+        return false;
+    if (size > length - offset)
+        size = length - offset;
+#ifdef _WIN32
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    size_t page = info.dwAllocationGranularity;
+#else
+    size_t page = sysconf(_SC_PAGESIZE);
+#endif
+    size_t start = offset / page * page;
+    size = offset + size - start;
+    void *p = (void *)(data + start);
+#ifdef _WIN32
+// Unlocking pages which are not locked removes them from working set
+    if (!FlushViewOfFile(p, size))
+        return false;
+    VirtualUnlock(p, size);
+    return true;
+#else
+// Pages of shared mapping keep their data in page cache of the file
+    return msync(p, size, MS_SYNC) == 0 && madvise(p, size, MADV_DONTNEED) == 0;
+#endif
+}
+
+
+// Check if file is mapped
+bool MappedFile::isOpen() const
+{
+    return data != nullptr;
+}
+
+
+// Get mapped bytes
+const unsigned char * MappedFile::getData() const
+{
+    return data;
+}
+
+
+// Get file size
+size_t MappedFile::getSize() const
+{
+    return length;
+}
+
+
+// Get mapped bytes for writing
+unsigned char * MappedFile::getWritableData() const
+{
+    return writable ? (unsigned char *)data : nullptr;
+}
@@ -0,0 +1,51 @@
+#ifndef MAPPEDFILE_H
+#define MAPPEDFILE_H
+
+
+#include <cstddef>
+#include <string>
+
+
+// File mapped to memory, pages are loaded by the system on first access. Files are mapped read-only,
+// or created for writing, then written pages can be flushed and dropped from memory
+class MappedFile {
+
+    const unsigned char *data;
+    size_t length;
+    bool writable;
+#ifdef _WIN32
+    void *file, *mapping;
+#else
+    int file;
+#endif
+
+public:
+
+    MappedFile();
+    ~MappedFile();
+
+// File mapping can't be copied
+    MappedFile(const MappedFile &) = delete;
+    MappedFile & operator=(const MappedFile &) = delete;
+
+// Map / unmap file
+    bool open(const std::string &path);
+    void close();
+
+// Create file of given size (replacing existing one) and map it for writing, file is filled with zeros
+    bool create(const std::string &path, size_t size);
+
+// Write range of created file to disk and drop its pages from memory of the process
+    bool flush(size_t offset, size_t size);
+
+    bool isOpen() const;
+    const unsigned char * getData() const;
+    size_t getSize() const;
+
+// Get mapped bytes of created file, nullptr for read-only file
+    unsigned char * getWritableData() const;
+
+};
+
+
+#endif // MAPPEDFILE_H
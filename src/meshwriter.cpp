@@ -0,0 +1,139 @@
+#include "meshwriter.h"
+#include "imagewriter.h"
+#include "parallel.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <string>
+#include <vector>
+
+
+// Build array of count elements by chunks: batch of chunks is filled in parallel, then written in order.
+// Fill gets buffer and range of elements [first, last)
+static bool write_chunks(FILE *file, size_t count, size_t element_size, const std::function<void(unsigned char *out, size_t first, size_t last)> &fill)
+{
+    size_t chunk = MeshWriter::CHUNK_VERTICES;
+    size_t batch = chunk * TileScheduler::threadCount();
+    std::vector<unsigned char> buffer(std::min(count, batch) * element_size);
+    for (size_t start=0; start<count; start+=batch) {
+        size_t end = std::min(count, start + batch);
+        TileScheduler::forEach((end - start + chunk - 1) / chunk, [&](int index, int) {
+            size_t first = start + index * chunk, last = std::min(end, first + chunk);
+            fill(&buffer[(first - start) * element_size], first, last);
+        });
+        size_t size = (end - start) * element_size;
+        if (fwrite(buffer.data(), 1, size, file) != size)
+            return false;
+    }
+    return true;
+}
+
+
+// Write array with 64-bit byte count of VTK appended data
+static bool write_appended(FILE *file, const void *data, uint64_t size)
+{
+    return fwrite(&size, sizeof(size), 1, file) == 1 && fwrite(data, 1, size, file) == size;
+}
+
+
+// Write binary PLY
+bool MeshWriter::writePLY(FILE *file, const Mesh &mesh)
+{
+    size_t vertices = mesh.positions.size() / 3;
+    char text[512];
+    snprintf(text, sizeof(text),
+             "ply\n"
+             "format %s 1.0\n"
+             "comment isosurface of probability density, coordinates in Bohr radii\n"
+             "element vertex %llu\n"
+             "property float x\n"
+             "property float y\n"
+             "property float z\n"
+             "property float nx\n"
+             "property float ny\n"
+             "property float nz\n"
+             "element face %d\n"
+             "property list uchar int vertex_indices\n"
+             "end_header\n",
+             ImageWriter::littleEndian() ? "binary_little_endian" : "binary_big_endian", (unsigned long long)vertices, mesh.triangleCount());
+    if (fwrite(text, 1, strlen(text), file) != strlen(text))
+        return false;
+
+// Vertex records interleave position and normal
+    const float *positions = mesh.positions.data(), *normals = mesh.normals.data();
+    bool ok = write_chunks(file, vertices, 6 * sizeof(float), [=](unsigned char *out, size_t first, size_t last) {
+        float *record = (float *)out;
+        for (size_t i=first; i<last; i++, record+=6) {
+            memcpy(record, positions + 3 * i, 3 * sizeof(float));
+            memcpy(record + 3, normals + 3 * i, 3 * sizeof(float));
+        }
+    });
+
+// Every face is vertex count and three indices of consecutive vertices
+    return ok && write_chunks(file, mesh.triangleCount(), 13, [](unsigned char *out, size_t first, size_t last) {
+        for (size_t t=first; t<last; t++, out+=13) {
+            int32_t index[3] = {(int32_t)(3 * t), (int32_t)(3 * t + 1), (int32_t)(3 * t + 2)};
+            out[0] = 3;
+            memcpy(out + 1, index, sizeof(index));
+        }
+    });
+}
+
+
+// Write VTK PolyData
+bool MeshWriter::writeVTP(FILE *file, const Mesh &mesh)
+{
+    size_t vertices = mesh.positions.size() / 3;
+    size_t triangles = mesh.triangleCount();
+    uint64_t points_size = mesh.positions.size() * sizeof(float), normals_size = mesh.normals.size() * sizeof(float);
+    uint64_t connectivity_size = vertices * sizeof(int32_t), offsets_size = triangles * sizeof(int32_t);
+
+// Offsets of arrays in appended data include their byte counts
+    uint64_t normals_offset = sizeof(uint64_t) + points_size;
+    uint64_t connectivity_offset = normals_offset + sizeof(uint64_t) + normals_size;
+    uint64_t offsets_offset = connectivity_offset + sizeof(uint64_t) + connectivity_size;
+    char text[2048];
+    snprintf(text, sizeof(text),
+             "<?xml version=\"1.0\"?>\n"
+             "<VTKFile type=\"PolyData\" version=\"1.0\" byte_order=\"%s\" header_type=\"UInt64\">\n"
+             "  <PolyData>\n"
+             "    <Piece NumberOfPoints=\"%llu\" NumberOfPolys=\"%llu\">\n"
+             "      <PointData Normals=\"Normals\">\n"
+             "        <DataArray type=\"Float32\" Name=\"Normals\" NumberOfComponents=\"3\" format=\"appended\" offset=\"%llu\"/>\n"
+             "      </PointData>\n"
+             "      <Points>\n"
+             "        <DataArray type=\"Float32\" Name=\"Points\" NumberOfComponents=\"3\" format=\"appended\" offset=\"0\"/>\n"
+             "      </Points>\n"
+             "      <Polys>\n"
+             "        <DataArray type=\"Int32\" Name=\"connectivity\" format=\"appended\" offset=\"%llu\"/>\n"
+             "        <DataArray type=\"Int32\" Name=\"offsets\" format=\"appended\" offset=\"%llu\"/>\n"
+             "      </Polys>\n"
+             "    </Piece>\n"
+             "  </PolyData>\n"
+             "  <AppendedData encoding=\"raw\">\n"
+             "   _",
+             ImageWriter::littleEndian() ? "LittleEndian" : "BigEndian", (unsigned long long)vertices, (unsigned long long)triangles,
+             (unsigned long long)normals_offset, (unsigned long long)connectivity_offset, (unsigned long long)offsets_offset);
+    if (fwrite(text, 1, strlen(text), file) != strlen(text))
+        return false;
+    if (!write_appended(file, mesh.positions.data(), points_size) || !write_appended(file, mesh.normals.data(), normals_size))
+        return false;
+
+// Triangles use consecutive vertices, so connectivity is 0, 1, 2, ... and offsets are 3, 6, 9, ...
+    bool ok = fwrite(&connectivity_size, sizeof(uint64_t), 1, file) == 1 &&
+        write_chunks(file, vertices, sizeof(int32_t), [](unsigned char *out, size_t first, size_t last) {
+            int32_t *index = (int32_t *)out;
+            for (size_t i=first; i<last; i++)
+                *index++ = (int32_t)i;
+        });
+    ok = ok && fwrite(&offsets_size, sizeof(uint64_t), 1, file) == 1 &&
+        write_chunks(file, triangles, sizeof(int32_t), [](unsigned char *out, size_t first, size_t last) {
+            int32_t *offset = (int32_t *)out;
+            for (size_t t=first; t<last; t++)
+                *offset++ = (int32_t)(3 * t + 3);
+        });
+    const char *tail = "\n  </AppendedData>\n</VTKFile>\n";
+    return ok && fwrite(tail, 1, strlen(tail), file) == strlen(tail);
+}
@@ -0,0 +1,28 @@
+#ifndef MESHWRITER_H
+#define MESHWRITER_H
+
+
+#include <cstdio>
+
+#include "isosurface.h"
+
+
+// Export of triangle meshes to binary files of external tools, without text encodings. Arrays, which
+// have the layout of the file, are written directly from the mesh, other ones are built by chunks in parallel
+class MeshWriter {
+
+public:
+
+// Vertices per chunk of built arrays
+    static const int CHUNK_VERTICES = 1 << 16;
+
+// Binary PLY: vertices with positions and normals, triangles as vertex index lists
+    static bool writePLY(FILE *file, const Mesh &mesh);
+
+// VTK PolyData with binary appended data: points and normals are written from the mesh
+    static bool writeVTP(FILE *file, const Mesh &mesh);
+
+};
+
+
+#endif // MESHWRITER_H
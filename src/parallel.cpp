@@ -0,0 +1,88 @@
+#include "parallel.h"
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+
+// Configured number of workers, 0 - use all hardware threads
+static std::atomic<int> configured_threads(0);
+
+// Set while the current thread runs a scheduled job, nested calls run inline
+static thread_local bool inside_job = false;
+
+
+// Set number of worker threads
+void TileScheduler::setThreadCount(int count)
+{
+    configured_threads = (count < 0) ? 0 : count;
+}
+
+
+// Get number of worker threads
+int TileScheduler::threadCount()
+{
+    int count = configured_threads;
+    if (count > 0)
+        return count;
+    count = std::thread::hardware_concurrency();
+    return (count > 0) ? count : 1;
+}
+
+
+// Set running of jobs of the calling thread by the thread itself
+void TileScheduler::setInline(bool enabled)
+{
+    inside_job = enabled;
+}
+
+
+// Run job for every index in [0, count)
+void TileScheduler::forEach(int count, const std::function<void(int index, int worker)> &job)
+{
+    if (count <= 0)
+        return;
+
+// Nested or trivial calls are executed by the current thread
+    int workers = threadCount();
+    if (workers > count)
+        workers = count;
+    if (inside_job || workers == 1) {
+        for (int i=0; i<count; i++)
+            job(i, 0);
+        return;
+    }
+
+// Workers take indexes one by one, so uneven jobs are balanced
+    std::atomic<int> next(0);
+    auto worker_loop = [&](int worker) {
+        inside_job = true;
+        for (int i = next++; i < count; i = next++)
+            job(i, worker);
+        inside_job = false;
+    };
+
+    std::vector<std::thread> threads;
+    for (int w=1; w<workers; w++)
+        threads.emplace_back(worker_loop, w);
+    worker_loop(0);
+    for (auto &t : threads)
+        t.join();
+}
+
+
+// Run job for every tile of width x height image
+void TileScheduler::forEachTile(int width, int height, const std::function<void(const Tile &tile, int worker)> &job)
+{
+    int tiles_x = (width + TILE_SIZE - 1) / TILE_SIZE;
+    int tiles_y = (height + TILE_SIZE - 1) / TILE_SIZE;
+
+    forEach(tiles_x * tiles_y, [&](int index, int worker) {
+        Tile tile;
+        tile.x0 = (index % tiles_x) * TILE_SIZE;
+        tile.y0 = (index / tiles_x) * TILE_SIZE;
+        tile.x1 = (tile.x0 + TILE_SIZE < width) ? tile.x0 + TILE_SIZE : width;
+        tile.y1 = (tile.y0 + TILE_SIZE < height) ? tile.y0 + TILE_SIZE : height;
+        job(tile, worker);
+    });
+}
@@ -0,0 +1,37 @@
+#ifndef PARALLEL_H
+#define PARALLEL_H
+
+
+#include <functional>
+
+
+// Rectangular block of image [x0, x1) x [y0, y1)
+struct Tile {
+    int x0, y0, x1, y1;
+};
+
+
+class TileScheduler {
+
+public:
+
+// Tile side in pixels
+    static const int TILE_SIZE = 32;
+
+// Set / get number of worker threads (0 - use all hardware threads)
+    static void setThreadCount(int count);
+    static int threadCount();
+
+// Set / reset running of all jobs of the calling thread by the thread itself (e.g. in background threads)
+    static void setInline(bool enabled);
+
+// Run job for every tile of width x height image, worker is in [0, threadCount())
+    static void forEachTile(int width, int height, const std::function<void(const Tile &tile, int worker)> &job);
+
+// Run job for every index in [0, count), worker is in [0, threadCount())
+    static void forEach(int count, const std::function<void(int index, int worker)> &job);
+
+};
+
+
+#endif // PARALLEL_H
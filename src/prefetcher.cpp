@@ -0,0 +1,149 @@
+#include "prefetcher.h"
+#include "parallel.h"
+
+#include <chrono>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+
+StatePrefetcher::StatePrefetcher(FrameCache &frame_cache) :
+    cache(frame_cache),
+    stopping(false),
+    generation(0) {
+    worker = std::thread(&StatePrefetcher::run, this);
+}
+
+
+StatePrefetcher::~StatePrefetcher()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+        generation++;
+    }
+    wake.notify_one();
+    worker.join();
+}
+
+
+// Get states next to given one
+std::vector<QuantumState> StatePrefetcher::neighbours(const QuantumState &state)
+{
+// Decreasing n or l clamps lower numbers like limits of spin boxes do
+    std::vector<QuantumState> candidates;
+    candidates.push_back(QuantumState(state.n, state.l, state.m + 1));
+    candidates.push_back(QuantumState(state.n, state.l, state.m - 1));
+    candidates.push_back(QuantumState(state.n, state.l + 1, state.m));
+    candidates.push_back(QuantumState(state.n, state.l - 1, (state.m < state.l) ? state.m : state.l - 1));
+    candidates.push_back(QuantumState(state.n + 1, state.l, state.m));
+    int l = (state.l < state.n - 1) ? state.l : state.n - 2;
+    candidates.push_back(QuantumState(state.n - 1, l, (state.m < l) ? state.m : l));
+
+    std::vector<QuantumState> states;
+    for (auto &s : candidates) {
+        if (s.n < 1 || s.l < 0 || s.l >= s.n || s.m > s.l || s == state)
+            continue;
+        bool found = false;
+        for (auto &t : states)
+            found |= (t == s);
+        if (!found)
+            states.push_back(s);
+    }
+    return states;
+}
+
+
+// Start computing frames for neighbours of model's current state
+void StatePrefetcher::start(const AtomModel &model, const std::vector<FrameJob> &frames)
+{
+// Worker gets its own model with the same settings
+    std::shared_ptr<AtomModel> copy(new AtomModel());
+    copy->setProbabilityDensityStatus(model.isProbabilityDensity());
+    copy->setToneMap(model.getToneMap());
+    copy->setVolumeOpacity(model.getVolumeOpacity());
+    copy->setVolumeCache(model.isVolumeCacheEnabled(), model.getVolumeBudget());
+    copy->setVolumeTricubic(model.isVolumeTricubic());
+    copy->setVolumeOctree(model.isVolumeOctree());
+    copy->setAtlas(model.getAtlas());
+    copy->setSharedCache(model.getSharedCache());
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        task_model = copy;
+        task_state = model.canonicalState();
+        task_frames = frames;
+        generation++;
+    }
+    wake.notify_one();
+}
+
+
+// Cancel running task
+void StatePrefetcher::cancel()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    task_model.reset();
+    generation++;
+}
+
+
+// Worker loop
+void StatePrefetcher::run()
+{
+// Idle priority, models of the current state are never slowed down
+#ifdef _WIN32
+    SetThreadPriority(GetCurrentThread(), THREAD_PRIORITY_IDLE);
+#elif defined(SCHED_IDLE)
+    sched_param param = {};
+    pthread_setschedparam(pthread_self(), SCHED_IDLE, &param);
+#endif
+    TileScheduler::setInline(true);
+
+    while (true) {
+        std::shared_ptr<AtomModel> model;
+        QuantumState state;
+        std::vector<FrameJob> frames;
+        unsigned long task;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            wake.wait(lock, [&] { return stopping || task_model; });
+            if (stopping)
+                return;
+            model.swap(task_model);
+            state = task_state;
+            frames.swap(task_frames);
+            task = generation;
+        }
+
+    // Frames of every neighbour are computed in order of jobs, until the budget is spent
+        size_t limit = cache.getBudget() / 2, total = 0;
+        for (auto &s : neighbours(state)) {
+            model->set_n(s.n);
+            model->set_l(s.l);
+            model->set_m(s.m);
+            for (auto &job : frames) {
+                if (generation != task)
+                    break;
+                FrameKey key = job.key;
+                key.setState(s);
+                if (cache.contains(key))
+                    continue;
+                total += job.size * sizeof(long double);
+                if (total > limit)
+                    break;
+                std::shared_ptr<std::vector<long double>> frame(new std::vector<long double>(job.size));
+                auto start = std::chrono::steady_clock::now();
+                job.compute(*model, frame->data());
+                double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+                if (generation == task)
+                    cache.put(key, frame, ms);
+            }
+            if (generation != task || total > limit)
+                break;
+        }
+    }
+}
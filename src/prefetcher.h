@@ -0,0 +1,60 @@
+#ifndef PREFETCHER_H
+#define PREFETCHER_H
+
+
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "atommodel.h"
+#include "framecache.h"
+
+
+// Background precomputation of frames of states next to the current one (n, l or m changed by one),
+// so stepping through states takes frames from cache. The worker thread has idle priority and runs
+// models without parallel workers, it takes spare cores only
+class StatePrefetcher {
+
+    FrameCache &cache;
+    std::thread worker;
+    std::mutex mutex;
+    std::condition_variable wake;
+    bool stopping;
+
+// Pending task: model with settings of the current model, its state, and frames to compute
+    std::shared_ptr<AtomModel> task_model;
+    QuantumState task_state;
+    std::vector<FrameJob> task_frames;
+
+// Incremented by every new task and cancelling, running task stops when it changes
+    std::atomic<unsigned long> generation;
+
+    void run();
+
+public:
+
+// Prefetched frames are put to cache
+    explicit StatePrefetcher(FrameCache &frame_cache);
+    ~StatePrefetcher();
+
+    StatePrefetcher(const StatePrefetcher &) = delete;
+    StatePrefetcher & operator=(const StatePrefetcher &) = delete;
+
+// Get distinct states reachable by changing n, l or m by one, as spin boxes change them
+    static std::vector<QuantumState> neighbours(const QuantumState &state);
+
+// Start computing frames for neighbours of model's current state, running task is cancelled.
+// Frames are given for the current state, their keys get the state of neighbour. Total size of
+// prefetched frames is limited by half of cache budget
+    void start(const AtomModel &model, const std::vector<FrameJob> &frames);
+
+// Cancel running task, the frame being computed is discarded
+    void cancel();
+
+};
+
+
+#endif // PREFETCHER_H
@@ -0,0 +1,334 @@
+#include "radialprofile.h"
+#include "parallel.h"
+
+#include <algorithm>
+#include <cmath>
+
+
+RadialSummary::RadialSummary() :
+    samples(0),
+    total(0),
+    peak_radius(0),
+    peak_probability(0),
+    mean_radius(0) {
+}
+
+
+struct RadialProfile::Chunk {
+    std::vector<double> r, R;
+    std::vector<RadialSample> samples;
+    double integral, moment;
+    size_t peak;
+    std::vector<double> nodes;
+};
+
+
+// Points are evaluated by blocks, every step of Laguerre recurrence is done for the whole block
+static const int BLOCK_POINTS = 256;
+
+
+RadialProfile::RadialProfile(int _n, int _l, double _radius) :
+    n(_n),
+    l(_l),
+    radius(_radius) {
+
+// R * r0^1.5 = N * q^l * exp(-q/2) * L(q), q = 2r/(r0*n), N^2 = (2/n)^3 * (n-l-1)! / (2n * (n+l)!)
+    log_norm = 0.5 * (3 * log(2.0 / n) + std::lgamma(n - l) - log(2.0 * n) - std::lgamma(n + l + 1));
+    if (!(radius > 0))
+        radius = cutoffRadius(n, l);
+}
+
+
+// Get sampled radius
+double RadialProfile::getRadius() const
+{
+    return radius;
+}
+
+
+// Get radius where radial probability density decays below 1e-15 of its maximum. Laguerre polynomial
+// has no roots beyond q = 4n, so density beyond r = 2n^2 only decays
+double RadialProfile::cutoffRadius(int n, int l)
+{
+    RadialProfile profile(n, l, 1);
+    double step = 0.05 * n, peak = 0;
+    for (double r=step; ; r+=step) {
+        double R = profile.value(r);
+        double P = R * R * r * r;
+        if (P > peak)
+            peak = P;
+        else if (r > 2.0 * n * n && P < peak * 1e-15)
+            return r;
+    }
+}
+
+
+// Evaluate R at count radii
+void RadialProfile::evaluate(const double *r, double *R, size_t count) const
+{
+    int k = n - l - 1;
+    int a = 2*l + 1;
+    double q[BLOCK_POINTS], L0[BLOCK_POINTS], L1[BLOCK_POINTS];
+    for (size_t first=0; first<count; first+=BLOCK_POINTS) {
+        int size = (int)std::min<size_t>(BLOCK_POINTS, count - first);
+        const double *rb = r + first;
+        double *Rb = R + first;
+
+    // Prefactor N * q^l * exp(-q/2) in logarithms, it doesn't overflow for large n
+        for (int i=0; i<size; i++) {
+            q[i] = 2 * rb[i] / n;
+            Rb[i] = exp(log_norm - 0.5 * q[i] + (l ? l * log(q[i]) : 0.0));
+        }
+        if (k == 0)
+            continue;
+
+    // Recurrence (i+1) L[i+1] = (2i+1+a-q) L[i] - (i+a) L[i-1]
+        for (int i=0; i<size; i++) {
+            L0[i] = 1;
+            L1[i] = 1 + a - q[i];
+        }
+        for (int j=1; j<k; j++) {
+            double c = 1.0 / (j + 1);
+            for (int i=0; i<size; i++) {
+                double L2 = ((2*j + 1 + a - q[i]) * L1[i] - (j + a) * L0[i]) * c;
+                L0[i] = L1[i];
+                L1[i] = L2;
+            }
+        }
+        for (int i=0; i<size; i++)
+            Rb[i] *= L1[i];
+    }
+}
+
+
+double RadialProfile::value(double r) const
+{
+    double R;
+    evaluate(&r, &R, 1);
+    return R;
+}
+
+
+// Compute generalized Laguerre polynomial L[k, a](q)
+static double laguerre(int k, int a, double q)
+{
+    if (k <= 0)
+        return (k == 0) ? 1 : 0;
+    double L0 = 1, L1 = 1 + a - q;
+    for (int j=1; j<k; j++) {
+        double L2 = ((2*j + 1 + a - q) * L1 - (j + a) * L0) / (j + 1);
+        L0 = L1;
+        L1 = L2;
+    }
+    return L1;
+}
+
+
+// Get sign of dP/dr at r > 0: dP/dr = 2rR (R + r dR/dr), R + r dR/dr = N q^l exp(-q/2) ((1+l-q/2) L(q) + q L'(q)),
+// derivative of Laguerre polynomial L'[k, a](q) = -L[k-1, a+1](q)
+double RadialProfile::slope(double r) const
+{
+    int k = n - l - 1;
+    int a = 2*l + 1;
+    double q = 2 * r / n;
+    return value(r) * ((1 + l - 0.5 * q) * laguerre(k, a, q) - q * laguerre(k - 1, a + 1, q));
+}
+
+
+// Compute samples of chunk with probabilities from its start, integrals by trapezoids, maximum and nodes
+void RadialProfile::finishChunk(Chunk &chunk) const
+{
+    size_t count = chunk.r.size();
+    chunk.samples.resize(count);
+    chunk.integral = 0;
+    chunk.moment = 0;
+    chunk.peak = 0;
+    chunk.nodes.clear();
+    for (size_t i=0; i<count; i++) {
+        RadialSample &s = chunk.samples[i];
+        s.r = chunk.r[i];
+        s.R = chunk.R[i];
+        s.probability = s.R * s.R * s.r * s.r;
+        if (i > 0) {
+            const RadialSample &prev = chunk.samples[i-1];
+            double dr = s.r - prev.r;
+            chunk.integral += (prev.probability + s.probability) * 0.5 * dr;
+            chunk.moment += (prev.probability * prev.r + s.probability * s.r) * 0.5 * dr;
+        }
+        s.cumulative = chunk.integral;
+        if (s.probability > chunk.samples[chunk.peak].probability)
+            chunk.peak = i;
+    }
+
+// Node between points of different signs is found by bisection of exact function
+    for (size_t i=1; i<count; i++) {
+        if (!(chunk.R[i-1] * chunk.R[i] < 0))
+            continue;
+        double a = chunk.r[i-1], b = chunk.r[i];
+        double Ra = chunk.R[i-1];
+        for (int it=0; it<64; it++) {
+            double middle = 0.5 * (a + b);
+            if (middle <= a || middle >= b)
+                break;
+            double Rm = value(middle);
+            if ((Rm < 0) == (Ra < 0)) {
+                a = middle;
+                Ra = Rm;
+            } else {
+                b = middle;
+            }
+        }
+        chunk.nodes.push_back(0.5 * (a + b));
+    }
+}
+
+
+// Sample chunks in windows of several chunks per worker: window is computed in parallel, then its chunks
+// get probabilities from zero radius and go to output in order. Boundary point of chunk is output by the next one
+bool RadialProfile::run(size_t count, const std::function<void(size_t index, std::vector<double> &r, std::vector<double> &R)> &fill,
+                        const std::function<bool(const RadialSample *samples, size_t count)> &output, RadialSummary &summary) const
+{
+    summary = RadialSummary();
+    size_t window = 4 * TileScheduler::threadCount();
+    std::vector<Chunk> chunks(std::min(window, count));
+    double peak_left = 0, peak_right = 0;
+    for (size_t first=0; first<count; first+=window) {
+        size_t size = std::min(window, count - first);
+        TileScheduler::forEach(size, [&](int index, int) {
+            Chunk &chunk = chunks[index];
+            fill(first + index, chunk.r, chunk.R);
+            finishChunk(chunk);
+        });
+        for (size_t c=0; c<size; c++) {
+            Chunk &chunk = chunks[c];
+            size_t emitted = chunk.samples.size() - ((first + c + 1 == count) ? 0 : 1);
+            for (size_t i=0; i<emitted; i++)
+                chunk.samples[i].cumulative += summary.total;
+
+        // Maximum at boundary point is seen by both chunks, its bracket spans both
+            const RadialSample &peak = chunk.samples[chunk.peak];
+            double left = chunk.r[chunk.peak > 0 ? chunk.peak - 1 : 0];
+            double right = chunk.r[std::min(chunk.peak + 1, chunk.r.size() - 1)];
+            if (peak.probability > summary.peak_probability) {
+                summary.peak_probability = peak.probability;
+                summary.peak_radius = peak.r;
+                peak_left = left;
+                peak_right = right;
+            } else if (peak.probability == summary.peak_probability && peak.r == summary.peak_radius) {
+                peak_left = std::min(peak_left, left);
+                peak_right = std::max(peak_right, right);
+            }
+            summary.nodes.insert(summary.nodes.end(), chunk.nodes.begin(), chunk.nodes.end());
+            summary.total += chunk.integral;
+            summary.mean_radius += chunk.moment;
+            summary.samples += emitted;
+            if (emitted > 0 && !output(chunk.samples.data(), emitted))
+                return false;
+        }
+    }
+
+// Maximum of P is refined by bisection of dP/dr between neighbours of the largest sample,
+// maximum at the ends of sampled radius is kept
+    double a = peak_left, b = peak_right;
+    if (a > 0 && slope(a) > 0 && slope(b) < 0) {
+        for (int it=0; it<64; it++) {
+            double middle = 0.5 * (a + b);
+            if (middle <= a || middle >= b)
+                break;
+            if (slope(middle) > 0)
+                a = middle;
+            else
+                b = middle;
+        }
+        double R = value(0.5 * (a + b));
+        summary.peak_radius = 0.5 * (a + b);
+        summary.peak_probability = std::max(summary.peak_probability, R * R * summary.peak_radius * summary.peak_radius);
+    }
+    return true;
+}
+
+
+// Sample at evenly spaced radii
+bool RadialProfile::sample(size_t points, const std::function<bool(const RadialSample *samples, size_t count)> &output, RadialSummary &summary) const
+{
+    if (points < 2)
+        return false;
+    size_t intervals = points - 1;
+    size_t chunks = (intervals + CHUNK_POINTS - 1) / CHUNK_POINTS;
+    return run(chunks, [&](size_t index, std::vector<double> &r, std::vector<double> &R) {
+        size_t first = index * CHUNK_POINTS;
+        size_t last = std::min(first + CHUNK_POINTS, intervals);
+        r.resize(last - first + 1);
+        R.resize(r.size());
+        for (size_t i=0; i<r.size(); i++)
+            r[i] = radius * (first + i) / intervals;
+        evaluate(r.data(), R.data(), r.size());
+    }, output, summary);
+}
+
+
+// Sample adaptively, every base interval is a chunk. All middles of one halving are evaluated at once
+bool RadialProfile::sampleAdaptive(double tolerance, const std::function<bool(const RadialSample *samples, size_t count)> &output,
+                                   RadialSummary &summary) const
+{
+    if (!(tolerance > 0))
+        return false;
+
+// Maxima of R^2 and P are taken from base points
+    std::vector<double> base_r(ADAPTIVE_INTERVALS + 1), base_R(ADAPTIVE_INTERVALS + 1);
+    for (int i=0; i<=ADAPTIVE_INTERVALS; i++)
+        base_r[i] = radius * i / ADAPTIVE_INTERVALS;
+    evaluate(base_r.data(), base_R.data(), base_r.size());
+    double peak_square = 0, peak_probability = 0;
+    for (int i=0; i<=ADAPTIVE_INTERVALS; i++) {
+        double square = base_R[i] * base_R[i];
+        peak_square = std::max(peak_square, square);
+        peak_probability = std::max(peak_probability, square * base_r[i] * base_r[i]);
+    }
+    double tolerance_square = tolerance * peak_square, tolerance_probability = tolerance * peak_probability;
+
+    return run(ADAPTIVE_INTERVALS, [&](size_t index, std::vector<double> &r, std::vector<double> &R) {
+        r.assign(base_r.begin() + index, base_r.begin() + index + 2);
+        R.assign(base_R.begin() + index, base_R.begin() + index + 2);
+        std::vector<char> open(1, 1), next_open;
+        std::vector<double> middle_r, middle_R, next_r, next_R;
+        for (int depth=0; depth<ADAPTIVE_DEPTH; depth++) {
+            middle_r.clear();
+            for (size_t i=0; i+1<r.size(); i++)
+                if (open[i])
+                    middle_r.push_back(0.5 * (r[i] + r[i+1]));
+            if (middle_r.empty())
+                break;
+            middle_R.resize(middle_r.size());
+            evaluate(middle_r.data(), middle_R.data(), middle_r.size());
+
+        // Interval whose middle misses linear interpolation is replaced by two open halves
+            next_r.clear();
+            next_R.clear();
+            next_open.clear();
+            size_t m = 0;
+            for (size_t i=0; i+1<r.size(); i++) {
+                next_r.push_back(r[i]);
+                next_R.push_back(R[i]);
+                if (!open[i]) {
+                    next_open.push_back(0);
+                    continue;
+                }
+                double x = middle_r[m], Rx = middle_R[m++];
+                double square = Rx * Rx, probability = square * x * x;
+                double left = R[i] * R[i], right = R[i+1] * R[i+1];
+                bool split = fabs(square - 0.5 * (left + right)) > tolerance_square ||
+                             fabs(probability - 0.5 * (left * r[i] * r[i] + right * r[i+1] * r[i+1])) > tolerance_probability;
+                next_r.push_back(x);
+                next_R.push_back(Rx);
+                next_open.push_back(split);
+                next_open.push_back(split);
+            }
+            next_r.push_back(r.back());
+            next_R.push_back(R.back());
+            r.swap(next_r);
+            R.swap(next_R);
+            open.swap(next_open);
+        }
+    }, output, summary);
+}
@@ -0,0 +1,80 @@
+#ifndef RADIALPROFILE_H
+#define RADIALPROFILE_H
+
+
+#include <cstddef>
+#include <functional>
+#include <vector>
+
+
+// Sample of radial component at radius r (Bohr radii): R(r) * r0^1.5, radial probability density
+// P(r) = R^2 * r^2 (per Bohr radius) and probability to find electron inside radius r
+struct RadialSample {
+    double r, R, probability, cumulative;
+};
+
+
+// Summary of sampled radial component: probability inside sampled radius, most probable radius (maximum of P),
+// mean radius <r> (integral of r*P over sampled radius) and radial nodes (zeros of R, r > 0), radii in Bohr radii
+struct RadialSummary {
+    size_t samples;
+    double total, peak_radius, peak_probability, mean_radius;
+    std::vector<double> nodes;
+
+    RadialSummary();
+};
+
+
+// Radial component R(r) of hydrogen-like state (n, l), sampled over [0, radius] by any number of points.
+// Points are evaluated by chunks in parallel, every chunk in blocks of points at once, and chunks are passed
+// to output in order of radius, so profile of millions of points is streamed without keeping it in memory.
+// Summary is gathered in the same pass, extrema and nodes are then refined by the exact function
+class RadialProfile {
+
+    int n, l;
+    double radius, log_norm;
+
+// Points of chunk from its first to its last radius inclusive, neighbouring chunks share boundary point
+    struct Chunk;
+    void finishChunk(Chunk &chunk) const;
+
+// Get sign of dP/dr at r > 0
+    double slope(double r) const;
+
+// Sample chunks given by fill (radii and values of chunk points) and stream them to output
+    bool run(size_t chunks, const std::function<void(size_t index, std::vector<double> &r, std::vector<double> &R)> &fill,
+             const std::function<bool(const RadialSample *samples, size_t count)> &output, RadialSummary &summary) const;
+
+public:
+
+// Points of chunk of uniform sampling, base intervals and maximum halvings of adaptive sampling
+    static const int CHUNK_POINTS = 16384;
+    static const int ADAPTIVE_INTERVALS = 1024;
+    static const int ADAPTIVE_DEPTH = 24;
+
+// Profile of state over [0, radius], radius 0 - cutoff radius of state
+    RadialProfile(int n, int l, double radius = 0);
+
+// Get sampled radius
+    double getRadius() const;
+
+// Get radius beyond which radial probability density is below 1e-15 of its maximum
+    static double cutoffRadius(int n, int l);
+
+// Evaluate R at count radii
+    void evaluate(const double *r, double *R, size_t count) const;
+    double value(double r) const;
+
+// Sample at points evenly spaced radii from 0 to radius inclusive (points >= 2). Output gets samples in order
+// of radius from the calling thread, sampling stops when it returns false. False if output failed
+    bool sample(size_t points, const std::function<bool(const RadialSample *samples, size_t count)> &output, RadialSummary &summary) const;
+
+// Sample adaptively: base intervals are halved until linear interpolation of both R^2 and P at their middle
+// is within tolerance of maximum of each function
+    bool sampleAdaptive(double tolerance, const std::function<bool(const RadialSample *samples, size_t count)> &output,
+                        RadialSummary &summary) const;
+
+};
+
+
+#endif // RADIALPROFILE_H
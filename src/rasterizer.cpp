@@ -0,0 +1,95 @@
+#include "rasterizer.h"
+#include "parallel.h"
+
+#include <algorithm>
+#include <cmath>
+
+
+// Render mesh with z-buffer and Gouraud shading
+void MeshRasterizer::render(const Mesh &mesh, const Camera3D &camera, double model_radius, long double *p, int width, int height, double zoom)
+{
+    const double ambient = 0.15;
+
+// Transposed camera rotation brings model points to camera space
+    double rot[3][3];
+    for (int i=0; i<3; i++)
+        for (int j=0; j<3; j++)
+            rot[i][j] = camera.rotation.A[j][i];
+    double shift[3] = {(double)camera.position.x, (double)camera.position.y, (double)camera.position.z};
+    double pixels_per_unit = sqrt(height*height + width*width) / 2.0 * zoom;
+
+// Project vertices to screen, compute their lighting
+    int vertex_count = mesh.positions.size() / 3;
+    std::vector<float> sx(vertex_count), sy(vertex_count), depth(vertex_count), light(vertex_count);
+    TileScheduler::forEach((vertex_count + 4095) / 4096, [&](int chunk, int) {
+        int end = std::min(vertex_count, (chunk + 1) * 4096);
+        for (int v=chunk*4096; v<end; v++) {
+            const float *pos = &mesh.positions[3*v];
+            const float *nrm = &mesh.normals[3*v];
+            double c[3];
+            for (int i=0; i<3; i++)
+                c[i] = (rot[i][0] * pos[0] + rot[i][1] * pos[1] + rot[i][2] * pos[2]) / model_radius + shift[i];
+            depth[v] = c[0];
+            sx[v] = c[1] * pixels_per_unit + width/2;
+            sy[v] = height/2 - c[2] * pixels_per_unit;
+        // Two-sided lighting, light is directed along view rays
+            double n = rot[0][0] * nrm[0] + rot[0][1] * nrm[1] + rot[0][2] * nrm[2];
+            light[v] = ambient + (1 - ambient) * fabs(n);
+        }
+    });
+
+// Bin triangles to screen tiles
+    const int tile_size = TileScheduler::TILE_SIZE;
+    int tiles_x = (width + tile_size - 1) / tile_size;
+    int tiles_y = (height + tile_size - 1) / tile_size;
+    std::vector<std::vector<int>> bins(tiles_x * tiles_y);
+    for (int t=0; t<vertex_count/3; t++) {
+        float x0 = std::min(sx[3*t], std::min(sx[3*t+1], sx[3*t+2]));
+        float x1 = std::max(sx[3*t], std::max(sx[3*t+1], sx[3*t+2]));
+        float y0 = std::min(sy[3*t], std::min(sy[3*t+1], sy[3*t+2]));
+        float y1 = std::max(sy[3*t], std::max(sy[3*t+1], sy[3*t+2]));
+        if (x1 < 0 || y1 < 0 || x0 > width - 1 || y0 > height - 1)
+            continue;
+        int tx0 = std::max(0, (int)x0 / tile_size), tx1 = std::min(tiles_x - 1, (int)x1 / tile_size);
+        int ty0 = std::max(0, (int)y0 / tile_size), ty1 = std::min(tiles_y - 1, (int)y1 / tile_size);
+        for (int ty=ty0; ty<=ty1; ty++)
+            for (int tx=tx0; tx<=tx1; tx++)
+                bins[ty * tiles_x + tx].push_back(t);
+    }
+
+// Rasterize tiles in parallel, each tile has its own z-buffer
+    TileScheduler::forEachTile(width, height, [&](const Tile &tile, int) {
+        int tw = tile.x1 - tile.x0;
+        std::vector<float> zbuf(tw * (tile.y1 - tile.y0), INFINITY);
+        for (int yy=tile.y0; yy<tile.y1; yy++)
+            for (int xx=tile.x0; xx<tile.x1; xx++)
+                p[yy*width + xx] = 0;
+
+        for (int t : bins[(tile.y0 / tile_size) * tiles_x + tile.x0 / tile_size]) {
+            int a = 3*t, b = 3*t+1, c = 3*t+2;
+            float area = (sx[b] - sx[a]) * (sy[c] - sy[a]) - (sx[c] - sx[a]) * (sy[b] - sy[a]);
+            if (area == 0)
+                continue;
+            float inv_area = 1 / area;
+            int x0 = std::max(tile.x0, (int)ceil(std::min(sx[a], std::min(sx[b], sx[c]))));
+            int x1 = std::min(tile.x1 - 1, (int)floor(std::max(sx[a], std::max(sx[b], sx[c]))));
+            int y0 = std::max(tile.y0, (int)ceil(std::min(sy[a], std::min(sy[b], sy[c]))));
+            int y1 = std::min(tile.y1 - 1, (int)floor(std::max(sy[a], std::max(sy[b], sy[c]))));
+            for (int yy=y0; yy<=y1; yy++)
+                for (int xx=x0; xx<=x1; xx++) {
+                // Barycentric coordinates of pixel
+                    float wa = ((sx[b] - xx) * (sy[c] - yy) - (sx[c] - xx) * (sy[b] - yy)) * inv_area;
+                    float wb = ((sx[c] - xx) * (sy[a] - yy) - (sx[a] - xx) * (sy[c] - yy)) * inv_area;
+                    float wc = 1 - wa - wb;
+                    if (wa < 0 || wb < 0 || wc < 0)
+                        continue;
+                    float z = wa * depth[a] + wb * depth[b] + wc * depth[c];
+                    float &zb = zbuf[(yy - tile.y0) * tw + xx - tile.x0];
+                    if (z >= zb)
+                        continue;
+                    zb = z;
+                    p[yy*width + xx] = wa * light[a] + wb * light[b] + wc * light[c];
+                }
+        }
+    });
+}
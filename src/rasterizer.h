@@ -0,0 +1,20 @@
+#ifndef RASTERIZER_H
+#define RASTERIZER_H
+
+
+#include "camera.h"
+#include "isosurface.h"
+
+
+class MeshRasterizer {
+
+public:
+
+// Render mesh with z-buffer and Gouraud shading lit from the camera, p gets intensity in [0, 1].
+// Model radius (Bohr radii) is the distance shown as relative 1 by the camera, like in AtomModel::model3D
+    static void render(const Mesh &mesh, const Camera3D &camera, double model_radius, long double *p, int width, int height, double zoom = 1);
+
+};
+
+
+#endif // RASTERIZER_H
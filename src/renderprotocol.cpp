@@ -0,0 +1,275 @@
+#include "renderprotocol.h"
+#include "atommodel.h"
+
+#include <atomic>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+
+#ifndef _WIN32
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+
+const char *RenderProtocol::DEFAULT_SOCKET = "/tmp/simulatom.sock";
+
+#if !defined(_WIN32) && defined(MSG_NOSIGNAL)
+static const int SEND_FLAGS = MSG_NOSIGNAL;
+#else
+static const int SEND_FLAGS = 0;
+#endif
+
+
+// Create request with default view
+RenderRequest RenderProtocol::request(uint32_t id)
+{
+    RenderRequest r;
+    memset(&r, 0, sizeof(r));
+    r.magic = MAGIC;
+    r.version = VERSION;
+    r.id = id;
+    r.n = 1;
+    r.view = RENDER_SLICE;
+    r.format = RENDER_PNG;
+    r.iso_by_probability = 1;
+    r.width = 512;
+    r.height = 512;
+    r.zoom = 1;
+    r.iso_level = 90;
+    return r;
+}
+
+
+// Check state, view, size, format and camera of request
+bool RenderProtocol::valid(const RenderRequest &r)
+{
+    const float camera[] = {r.mov_x, r.mov_y, r.rot_x, r.rot_y, r.center_x, r.center_y, r.zoom};
+    for (float value : camera)
+        if (!std::isfinite(value))
+            return false;
+    return r.n >= 1 && r.n <= AtomModel::MAX_N && r.l >= 0 && r.l < r.n && abs(r.m) <= r.l &&
+           r.view <= RENDER_CLOUD && r.format <= RENDER_QOI && r.zoom > 0 && r.iso_level > 0 && r.iso_level <= 100 &&
+           r.width >= 2 && r.height >= 1 && r.width <= MAX_SIDE && r.height <= MAX_SIDE && (int64_t)r.width * r.height <= MAX_AREA;
+}
+
+
+#ifndef _WIN32
+// Fill address of socket path, false if path is too long
+static bool socket_address(const std::string &path, sockaddr_un &address)
+{
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    if (path.empty() || path.size() >= sizeof(address.sun_path))
+        return false;
+    memcpy(address.sun_path, path.c_str(), path.size());
+    return true;
+}
+#endif
+
+
+// Listen on socket path
+int RenderProtocol::listen(const std::string &path)
+{
+#ifdef _WIN32
+    (void)path;
+    return -1;
+#else
+    sockaddr_un address;
+    if (!socket_address(path, address))
+        return -1;
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0)
+        return -1;
+    unlink(path.c_str());
+    if (bind(fd, (const sockaddr *)&address, sizeof(address)) != 0 || ::listen(fd, 64) != 0) {
+        ::close(fd);
+        return -1;
+    }
+    return fd;
+#endif
+}
+
+
+// Connect to daemon
+int RenderProtocol::connect(const std::string &path)
+{
+#ifdef _WIN32
+    (void)path;
+    return -1;
+#else
+    sockaddr_un address;
+    if (!socket_address(path, address))
+        return -1;
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0)
+        return -1;
+    if (::connect(fd, (const sockaddr *)&address, sizeof(address)) != 0) {
+        ::close(fd);
+        return -1;
+    }
+    return fd;
+#endif
+}
+
+
+// Send message, descriptor goes with its first byte
+bool RenderProtocol::send(int socket, const void *data, size_t size, int fd)
+{
+#ifdef _WIN32
+    (void)socket;
+    (void)data;
+    (void)size;
+    (void)fd;
+    return false;
+#else
+    const char *bytes = (const char *)data;
+    size_t sent = 0;
+    while (sent < size) {
+        iovec io = {(void *)(bytes + sent), size - sent};
+        msghdr message;
+        memset(&message, 0, sizeof(message));
+        message.msg_iov = &io;
+        message.msg_iovlen = 1;
+        char control[CMSG_SPACE(sizeof(int))];
+        if (sent == 0 && fd >= 0) {
+            memset(control, 0, sizeof(control));
+            message.msg_control = control;
+            message.msg_controllen = sizeof(control);
+            cmsghdr *header = CMSG_FIRSTHDR(&message);
+            header->cmsg_level = SOL_SOCKET;
+            header->cmsg_type = SCM_RIGHTS;
+            header->cmsg_len = CMSG_LEN(sizeof(int));
+            memcpy(CMSG_DATA(header), &fd, sizeof(int));
+        }
+        ssize_t result = sendmsg(socket, &message, SEND_FLAGS);
+        if (result < 0 && errno == EINTR)
+            continue;
+        if (result <= 0)
+            return false;
+        sent += result;
+    }
+    return true;
+#endif
+}
+
+
+// Receive message, descriptor comes with its first byte
+bool RenderProtocol::receive(int socket, void *data, size_t size, int *fd)
+{
+    if (fd != nullptr)
+        *fd = -1;
+#ifdef _WIN32
+    (void)socket;
+    (void)data;
+    (void)size;
+    return false;
+#else
+    char *bytes = (char *)data;
+    size_t received = 0;
+    while (received < size) {
+        iovec io = {bytes + received, size - received};
+        msghdr message;
+        memset(&message, 0, sizeof(message));
+        message.msg_iov = &io;
+        message.msg_iovlen = 1;
+        char control[CMSG_SPACE(sizeof(int))];
+        message.msg_control = control;
+        message.msg_controllen = sizeof(control);
+        ssize_t result = recvmsg(socket, &message, 0);
+        if (result < 0 && errno == EINTR)
+            continue;
+        if (result <= 0)
+            return false;
+        received += result;
+
+    // Descriptor nobody asked for is closed
+        for (cmsghdr *header = CMSG_FIRSTHDR(&message); header != nullptr; header = CMSG_NXTHDR(&message, header))
+            if (header->cmsg_level == SOL_SOCKET && header->cmsg_type == SCM_RIGHTS) {
+                int passed;
+                memcpy(&passed, CMSG_DATA(header), sizeof(int));
+                if (fd != nullptr && *fd < 0)
+                    *fd = passed;
+                else
+                    ::close(passed);
+            }
+    }
+    return true;
+#endif
+}
+
+
+// Create anonymous shared memory: segment is unlinked right after creation, it lives while it is open or mapped.
+// Segment is opened for reading once more before unlinking, and only that descriptor leaves the daemon: clients
+// can neither write frame shared by the batch nor resize it
+int RenderProtocol::createShared(size_t size, void *&data)
+{
+    data = nullptr;
+#ifdef _WIN32
+    (void)size;
+    return -1;
+#else
+    static std::atomic<unsigned> counter(0);
+    std::string name = "/simulatom-frame-" + std::to_string(getpid()) + "-" + std::to_string(counter++);
+    int fd = shm_open(name.c_str(), O_RDWR | O_CREAT | O_EXCL, 0600);
+    if (fd < 0)
+        return -1;
+    int reader = shm_open(name.c_str(), O_RDONLY, 0);
+    shm_unlink(name.c_str());
+    void *mapped = MAP_FAILED;
+    if (reader >= 0 && size > 0 && ftruncate(fd, size) == 0)
+        mapped = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (mapped == MAP_FAILED) {
+        if (reader >= 0)
+            ::close(reader);
+        return -1;
+    }
+    data = mapped;
+    return reader;
+#endif
+}
+
+
+// Map shared memory for reading
+const void * RenderProtocol::mapShared(int fd, size_t size)
+{
+#ifdef _WIN32
+    (void)fd;
+    (void)size;
+    return nullptr;
+#else
+    if (fd < 0 || size == 0)
+        return nullptr;
+    void *mapped = mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+    return (mapped == MAP_FAILED) ? nullptr : mapped;
+#endif
+}
+
+
+void RenderProtocol::unmap(const void *data, size_t size)
+{
+#ifdef _WIN32
+    (void)data;
+    (void)size;
+#else
+    if (data != nullptr)
+        munmap(const_cast<void *>(data), size);
+#endif
+}
+
+
+void RenderProtocol::close(int fd)
+{
+#ifndef _WIN32
+    if (fd >= 0)
+        ::close(fd);
+#else
+    (void)fd;
+#endif
+}
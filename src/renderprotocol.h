@@ -0,0 +1,107 @@
+#ifndef RENDERPROTOCOL_H
+#define RENDERPROTOCOL_H
+
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+
+// View of requested frame
+enum RenderView {
+    RENDER_GRAPHIC,
+    RENDER_2D,
+    RENDER_SLICE,
+    RENDER_VOLUME,
+    RENDER_ISOSURFACE,
+    RENDER_CLOUD
+};
+
+
+// Format of frame data: relative values as 32-bit floats, 0xAARRGGBB pixels, PNG or QOI file
+enum RenderFormat {
+    RENDER_FLOAT32,
+    RENDER_PIXELS,
+    RENDER_PNG,
+    RENDER_QOI
+};
+
+
+// Status of reply
+enum RenderStatus {
+    RENDER_OK,
+    RENDER_INVALID,
+    RENDER_FAILED
+};
+
+
+// Request of frame: state, view, size and format. Graphic has width points (float32) or width x height image.
+// Camera is used by 3D views, center and zoom by 2D view, isosurface level is in percents
+struct RenderRequest {
+    uint32_t magic, version, id;
+    int32_t n, l, m;
+    uint8_t density, view, format, iso_by_probability;
+    int32_t width, height;
+    float mov_x, mov_y, rot_x, rot_y, zoom, center_x, center_y, iso_level;
+};
+
+
+// Reply to request with given id. Frame of size bytes is in shared memory, whose descriptor comes with reply.
+// Batch is number of requests of the same state rendered together with this one
+struct RenderReply {
+    uint32_t magic, id;
+    int32_t status;
+    uint32_t format;
+    int32_t width, height;
+    uint32_t batch, reserved;
+    uint64_t size;
+};
+
+
+// Binary protocol of render daemon on Unix domain socket. Messages are the structures above in native byte order,
+// as clients run on the same machine. Client sends requests without waiting for replies, daemon answers every
+// request when its frame is ready. Frame is written to shared memory once, and its descriptor is passed with the
+// reply (SCM_RIGHTS), so clients map the frame without copying it through the socket. Unix only
+class RenderProtocol {
+
+public:
+
+    static const uint32_t MAGIC = 0x524D4953;
+    static const uint32_t VERSION = 1;
+
+// Largest side and area of frame
+    static const int MAX_SIDE = 16384;
+    static const int64_t MAX_AREA = (int64_t)1 << 26;
+
+// Socket path used when none is given
+    static const char *DEFAULT_SOCKET;
+
+// Create request with protocol header and default view: slice 512x512, PNG
+    static RenderRequest request(uint32_t id = 0);
+
+// Check state, view, size, format and camera of request, header is checked by receiver
+    static bool valid(const RenderRequest &r);
+
+// Listen on socket path, stale socket file is replaced. Connect to daemon. -1 on failure
+    static int listen(const std::string &path);
+    static int connect(const std::string &path);
+
+// Send message with optional descriptor. Receive message, descriptor is -1 if it has none.
+// False on error or closed connection
+    static bool send(int socket, const void *data, size_t size, int fd = -1);
+    static bool receive(int socket, void *data, size_t size, int *fd = nullptr);
+
+// Create anonymous shared memory of size bytes mapped for writing, return its read-only descriptor, -1 on failure
+    static int createShared(size_t size, void *&data);
+
+// Map shared memory of size bytes for reading, nullptr on failure. Unmap shared memory
+    static const void * mapShared(int fd, size_t size);
+    static void unmap(const void *data, size_t size);
+
+// Close socket or descriptor
+    static void close(int fd);
+
+};
+
+
+#endif // RENDERPROTOCOL_H
@@ -0,0 +1,502 @@
+#include "sharedcache.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <new>
+#include <thread>
+
+#ifndef _WIN32
+#include <cerrno>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+
+const char *SharedCache::DEFAULT_NAME = "/simulatom-cache";
+
+// Status of slot: never used, being written, ready for readers, being evicted, evicted
+enum {
+    SLOT_EMPTY,
+    SLOT_WRITING,
+    SLOT_READY,
+    SLOT_EVICTING,
+    SLOT_FREE
+};
+
+// Slots checked for a key, starting from its hash
+static const uint32_t MAX_PROBES = 64;
+
+
+// Segment layout: header, slots, page map (1 - page is used), data pages
+struct SharedCache::Header {
+    char magic[8];
+    uint32_t version, long_double_size;
+    uint64_t segment_size, slots_offset, page_map_offset, data_offset;
+    uint32_t slot_count, page_count;
+    std::atomic<uint32_t> ready;
+    std::atomic<uint32_t> entries;
+    std::atomic<uint64_t> bytes, use_counter;
+    std::atomic<uint64_t> hits, misses, stores, evictions;
+#ifndef _WIN32
+    pthread_mutex_t mutex;
+#endif
+};
+
+
+// Fields of slot are changed only while it is not ready and isn't referenced
+struct SharedCache::Slot {
+    std::atomic<uint32_t> status;
+    std::atomic<int32_t> refs;
+    std::atomic<uint64_t> last_use;
+    uint64_t hash, size;
+    uint32_t first_page, page_count, key_size, reserved;
+    unsigned char key[MAX_KEY_SIZE];
+};
+
+
+// FNV-1a hash of key
+static uint64_t hashKey(const void *key, size_t key_size)
+{
+    const unsigned char *bytes = static_cast<const unsigned char *>(key);
+    uint64_t hash = 14695981039346656037ull;
+    for (size_t i=0; i<key_size; i++) {
+        hash ^= bytes[i];
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+
+// Round size up to multiple of alignment
+static uint64_t alignUp(uint64_t size, uint64_t alignment)
+{
+    return (size + alignment - 1) / alignment * alignment;
+}
+
+
+SharedCache::Segment::~Segment()
+{
+#ifndef _WIN32
+    munmap(data, size);
+#endif
+}
+
+
+SharedCache::SharedCache() :
+    header(nullptr),
+    slots(nullptr),
+    pages(nullptr) {
+}
+
+
+SharedCache::~SharedCache()
+{
+    close();
+}
+
+
+// Open segment, create it if it doesn't exist
+bool SharedCache::open(const std::string &name, size_t capacity)
+{
+    close();
+    error.clear();
+#ifdef _WIN32
+    (void)name;
+    (void)capacity;
+    error = "shared memory is not supported";
+    return false;
+#else
+// Every entry takes at least one page, so twice more slots keep probing short
+    uint64_t page_count = capacity / PAGE_SIZE;
+    if (page_count < 1 || page_count > 0x7FFFFFFF) {
+        error = "invalid capacity";
+        return false;
+    }
+    uint64_t slot_count = page_count * 2;
+    uint64_t slots_offset = alignUp(sizeof(Header), 64);
+    uint64_t page_map_offset = slots_offset + slot_count * sizeof(Slot);
+    uint64_t data_offset = alignUp(page_map_offset + page_count, PAGE_SIZE);
+    uint64_t size = data_offset + page_count * PAGE_SIZE;
+
+// The first process creates segment, others wait until it is initialized. Segment is private to its owner:
+// processes trust entries and page runs of each other, so segment of other user is not used
+    int fd = shm_open(name.c_str(), O_RDWR | O_CREAT | O_EXCL, 0600);
+    bool created = (fd >= 0);
+    if (created) {
+        if (ftruncate(fd, size) != 0) {
+            error = "failed to allocate segment " + name;
+            ::close(fd);
+            shm_unlink(name.c_str());
+            return false;
+        }
+    } else {
+        if (errno == EEXIST)
+            fd = shm_open(name.c_str(), O_RDWR, 0);
+        if (fd < 0) {
+            error = "failed to open segment " + name;
+            return false;
+        }
+        struct stat st;
+        for (int i=0; i<1000; i++) {
+            if (fstat(fd, &st) != 0 || st.st_uid != geteuid() || (st.st_mode & (S_IRWXG | S_IRWXO)) != 0) {
+                error = "segment " + name + " belongs to another user or is accessible to others";
+                ::close(fd);
+                return false;
+            }
+            if (st.st_size > 0)
+                break;
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        size = st.st_size;
+    }
+    void *data = (size >= sizeof(Header)) ? mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0) : MAP_FAILED;
+    ::close(fd);
+    if (data == MAP_FAILED) {
+        error = "failed to map segment " + name;
+        return false;
+    }
+    std::shared_ptr<Segment> mapped(new Segment());
+    mapped->data = static_cast<unsigned char *>(data);
+    mapped->size = size;
+    Header *h = reinterpret_cast<Header *>(mapped->data);
+
+    if (created) {
+        h = new (mapped->data) Header();
+        memcpy(h->magic, "SIMCACHE", 8);
+        h->version = VERSION;
+        h->long_double_size = sizeof(long double);
+        h->segment_size = size;
+        h->slots_offset = slots_offset;
+        h->page_map_offset = page_map_offset;
+        h->data_offset = data_offset;
+        h->slot_count = slot_count;
+        h->page_count = page_count;
+        pthread_mutexattr_t attr;
+        pthread_mutexattr_init(&attr);
+        pthread_mutexattr_setpshared(&attr, PTHREAD_PROCESS_SHARED);
+#ifdef __linux__
+        pthread_mutexattr_setrobust(&attr, PTHREAD_MUTEX_ROBUST);
+#endif
+        pthread_mutex_init(&h->mutex, &attr);
+        pthread_mutexattr_destroy(&attr);
+        h->ready = 1;
+    } else {
+        for (int i=0; i<1000 && h->ready == 0; i++)
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    // Segment of other version or build is not used
+        if (h->ready == 0 || memcmp(h->magic, "SIMCACHE", 8) != 0 || h->version != VERSION ||
+                h->long_double_size != sizeof(long double) || h->segment_size != size ||
+                h->slots_offset + (uint64_t)h->slot_count * sizeof(Slot) > h->page_map_offset ||
+                h->page_map_offset + h->page_count > h->data_offset ||
+                h->data_offset + (uint64_t)h->page_count * PAGE_SIZE > size) {
+            error = "segment " + name + " has other version or layout";
+            return false;
+        }
+    }
+
+    segment = mapped;
+    header = h;
+    slots = reinterpret_cast<Slot *>(mapped->data + h->slots_offset);
+    pages = mapped->data + h->page_map_offset;
+    return true;
+#endif
+}
+
+
+// Get default segment of the user
+std::string SharedCache::defaultName()
+{
+#ifdef _WIN32
+    return DEFAULT_NAME;
+#else
+    return DEFAULT_NAME + ("-" + std::to_string(geteuid()));
+#endif
+}
+
+
+// Get reason of failed open
+const std::string & SharedCache::getError() const
+{
+    return error;
+}
+
+
+// Unmap segment, pinned entries keep it mapped
+void SharedCache::close()
+{
+    segment.reset();
+    header = nullptr;
+    slots = nullptr;
+    pages = nullptr;
+}
+
+
+// Check if segment is opened
+bool SharedCache::isOpen() const
+{
+    return header != nullptr;
+}
+
+
+// Remove segment
+bool SharedCache::remove(const std::string &name)
+{
+#ifdef _WIN32
+    (void)name;
+    return false;
+#else
+    return shm_unlink(name.c_str()) == 0;
+#endif
+}
+
+
+// Lock mutex of segment
+void SharedCache::lock() const
+{
+#ifndef _WIN32
+    int result = pthread_mutex_lock(&header->mutex);
+#ifdef __linux__
+    if (result == EOWNERDEAD) {
+    // Owner crashed while storing or evicting: unfinished slots are freed and page map is rebuilt
+        memset(pages, 0, header->page_count);
+        uint64_t bytes = 0;
+        uint32_t entries = 0;
+        for (uint32_t i=0; i<header->slot_count; i++) {
+            Slot &s = slots[i];
+            if (s.status == SLOT_WRITING || s.status == SLOT_EVICTING || (s.status == SLOT_READY && !inBounds(s.first_page, s.page_count, s.size)))
+                s.status = SLOT_FREE;
+            if (s.status == SLOT_READY) {
+                memset(pages + s.first_page, 1, s.page_count);
+                bytes += s.size;
+                entries++;
+            }
+        }
+        header->bytes = bytes;
+        header->entries = entries;
+        pthread_mutex_consistent(&header->mutex);
+    }
+#else
+    (void)result;
+#endif
+#endif
+}
+
+
+// Unlock mutex of segment
+void SharedCache::unlock() const
+{
+#ifndef _WIN32
+    pthread_mutex_unlock(&header->mutex);
+#endif
+}
+
+
+// Check run of pages and size of entry, slots are read from memory writable by other processes
+bool SharedCache::inBounds(uint64_t first_page, uint64_t page_count, uint64_t size) const
+{
+    return page_count >= 1 && first_page + page_count <= header->page_count && size <= page_count * PAGE_SIZE;
+}
+
+
+// Find ready entry of key
+SharedCache::Slot * SharedCache::find(const void *key, size_t key_size, uint64_t hash) const
+{
+    for (uint32_t p=0; p<MAX_PROBES && p<header->slot_count; p++) {
+        Slot &s = slots[(hash + p) % header->slot_count];
+        uint32_t status = s.status;
+    // Probing ends at never used slot, evicted slots are passed
+        if (status == SLOT_EMPTY)
+            return nullptr;
+        if (status == SLOT_READY && s.hash == hash && s.key_size == key_size && memcmp(s.key, key, key_size) == 0)
+            return &s;
+    }
+    return nullptr;
+}
+
+
+// Get data of entry
+std::shared_ptr<const void> SharedCache::get(const void *key, size_t key_size, size_t &size) const
+{
+    if (header == nullptr || key_size > MAX_KEY_SIZE)
+        return nullptr;
+    uint64_t hash = hashKey(key, key_size);
+    Slot *slot = find(key, key_size, hash);
+
+// Entry is pinned, then checked again: it could be evicted and reused before pinning
+    if (slot) {
+        slot->refs++;
+        if (slot->status != SLOT_READY || slot->hash != hash || slot->key_size != key_size || memcmp(slot->key, key, key_size) != 0) {
+            slot->refs--;
+            slot = nullptr;
+        }
+    }
+    if (slot == nullptr) {
+        header->misses++;
+        return nullptr;
+    }
+
+// Pinned entry doesn't change, its page run is checked once and used from local copies
+    uint64_t first_page = slot->first_page, page_count = slot->page_count, entry_size = slot->size;
+    if (!inBounds(first_page, page_count, entry_size)) {
+        slot->refs--;
+        header->misses++;
+        return nullptr;
+    }
+    header->hits++;
+    slot->last_use = ++header->use_counter;
+    size = entry_size;
+
+// Reference is released with the last copy of pointer, segment stays mapped until then
+    std::shared_ptr<Segment> keep = segment;
+    const unsigned char *data = segment->data + header->data_offset + first_page * PAGE_SIZE;
+    return std::shared_ptr<const void>(data, [keep, slot](const void *) {
+        slot->refs--;
+    });
+}
+
+
+// Check if entry is stored
+bool SharedCache::contains(const void *key, size_t key_size) const
+{
+    if (header == nullptr || key_size > MAX_KEY_SIZE)
+        return false;
+    return find(key, key_size, hashKey(key, key_size)) != nullptr;
+}
+
+
+// Evict entry if it isn't used, or least recently used unused entry
+bool SharedCache::evict(Slot *slot)
+{
+    if (slot == nullptr) {
+    // Entries pinned during the search are skipped by the next attempt
+        for (int attempt=0; attempt<8; attempt++) {
+            Slot *oldest = nullptr;
+            for (uint32_t i=0; i<header->slot_count; i++) {
+                Slot &s = slots[i];
+                if (s.status == SLOT_READY && s.refs == 0 && (oldest == nullptr || s.last_use < oldest->last_use))
+                    oldest = &s;
+            }
+            if (oldest == nullptr)
+                return false;
+            if (evict(oldest))
+                return true;
+        }
+        return false;
+    }
+
+// Readers pin entry before checking its status, so one of both sees the other
+    uint32_t expected = SLOT_READY;
+    if (!slot->status.compare_exchange_strong(expected, SLOT_EVICTING))
+        return false;
+    if (slot->refs != 0) {
+        slot->status = SLOT_READY;
+        return false;
+    }
+    memset(pages + slot->first_page, 0, slot->page_count);
+    header->bytes -= slot->size;
+    header->entries--;
+    header->evictions++;
+    slot->status = SLOT_FREE;
+    return true;
+}
+
+
+// Allocate run of pages, first fit
+int64_t SharedCache::allocate(uint32_t count) const
+{
+    uint32_t run = 0;
+    for (uint32_t i=0; i<header->page_count; i++) {
+        run = pages[i] ? 0 : run + 1;
+        if (run == count)
+            return i + 1 - count;
+    }
+    return -1;
+}
+
+
+// Store entry
+bool SharedCache::put(const void *key, size_t key_size, const void *data, size_t size)
+{
+    if (header == nullptr || key_size > MAX_KEY_SIZE)
+        return false;
+    uint64_t count = (size + PAGE_SIZE - 1) / PAGE_SIZE;
+    if (count < 1)
+        count = 1;
+    if (count > header->page_count)
+        return false;
+    uint64_t hash = hashKey(key, key_size);
+
+    lock();
+    if (find(key, key_size, hash)) {
+        unlock();
+        return true;
+    }
+
+// Free slot among probed ones, or least recently used unused entry of them is evicted
+    Slot *slot = nullptr;
+    for (int attempt=0; attempt<8 && slot == nullptr; attempt++) {
+        Slot *oldest = nullptr;
+        for (uint32_t p=0; p<MAX_PROBES && p<header->slot_count; p++) {
+            Slot &s = slots[(hash + p) % header->slot_count];
+            if (s.status == SLOT_EMPTY || s.status == SLOT_FREE) {
+                slot = &s;
+                break;
+            }
+            if (s.status == SLOT_READY && s.refs == 0 && (oldest == nullptr || s.last_use < oldest->last_use))
+                oldest = &s;
+        }
+        if (slot == nullptr && oldest != nullptr && evict(oldest))
+            slot = oldest;
+    }
+    if (slot == nullptr) {
+        unlock();
+        return false;
+    }
+    slot->status = SLOT_WRITING;
+
+// Pages are freed by evicting least recently used entries
+    int64_t first;
+    while ((first = allocate(count)) < 0)
+        if (!evict(nullptr)) {
+            slot->status = SLOT_FREE;
+            unlock();
+            return false;
+        }
+
+    slot->hash = hash;
+    slot->size = size;
+    slot->first_page = first;
+    slot->page_count = count;
+    slot->key_size = key_size;
+    memcpy(slot->key, key, key_size);
+    memset(pages + first, 1, count);
+    memcpy(segment->data + header->data_offset + (uint64_t)first * PAGE_SIZE, data, size);
+    slot->last_use = ++header->use_counter;
+    slot->status = SLOT_READY;
+    header->bytes += size;
+    header->entries++;
+    header->stores++;
+    unlock();
+    return true;
+}
+
+
+// Get cache statistics
+SharedCacheStats SharedCache::stats() const
+{
+    SharedCacheStats s = {};
+    if (header == nullptr)
+        return s;
+    s.hits = header->hits;
+    s.misses = header->misses;
+    s.stores = header->stores;
+    s.evictions = header->evictions;
+    s.entries = header->entries;
+    s.bytes = header->bytes;
+    s.capacity = (size_t)header->page_count * PAGE_SIZE;
+    return s;
+}
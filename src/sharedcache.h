@@ -0,0 +1,103 @@
+#ifndef SHAREDCACHE_H
+#define SHAREDCACHE_H
+
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+
+// Cache statistics of shared memory segment, counters are common for all processes
+struct SharedCacheStats {
+    unsigned long long hits, misses, stores, evictions;
+    size_t entries, bytes, capacity;
+};
+
+
+// Cache of immutable binary entries in POSIX shared memory, shared by all processes of the host.
+// Entries are found without locking: a reader pins entry by its reference counter and uses data
+// in place. Storing and eviction are serialized by process-shared mutex, least recently used
+// entries without references are evicted. Segment is accessible to its owner only.
+// Pins are plain counters: entries pinned by a process that crashed are never evicted and keep
+// their pages until the segment is removed. Not available on Windows, open() fails there
+class SharedCache {
+
+    struct Header;
+    struct Slot;
+
+// Mapped segment, it is kept alive by pinned entries
+    struct Segment {
+        unsigned char *data;
+        size_t size;
+        ~Segment();
+    };
+
+    std::shared_ptr<Segment> segment;
+    Header *header;
+    Slot *slots;
+    unsigned char *pages;
+    std::string error;
+
+// Find ready entry of key, nullptr if it is missing
+    Slot * find(const void *key, size_t key_size, uint64_t hash) const;
+
+// Lock / unlock mutex of segment, state left by crashed process is repaired
+    void lock() const;
+    void unlock() const;
+
+// Evict entry if it isn't used, or least recently used unused entry when slot is nullptr
+    bool evict(Slot *slot);
+
+// Allocate run of pages, -1 if there is no free run
+    int64_t allocate(uint32_t count) const;
+
+// Check that run of pages lies within segment and holds size bytes
+    bool inBounds(uint64_t first_page, uint64_t page_count, uint64_t size) const;
+
+public:
+
+    static const uint32_t VERSION = 1;
+
+// Maximum key size in bytes and size of data pages
+    static const int MAX_KEY_SIZE = 96;
+    static const size_t PAGE_SIZE = 64u << 10;
+
+// Prefix of default segment name and default size
+    static const char *DEFAULT_NAME;
+    static const size_t DEFAULT_CAPACITY = 512u << 20;
+
+    SharedCache();
+    ~SharedCache();
+
+    SharedCache(const SharedCache &) = delete;
+    SharedCache & operator=(const SharedCache &) = delete;
+
+// Default segment of the user: prefix with effective user id, so every user of the host has own cache
+    static std::string defaultName();
+
+// Open segment, it is created with given capacity (bytes of data) by the first process.
+// Name starts with '/', segment stays in memory until it is removed. getError() tells why open failed
+    bool open(const std::string &name = defaultName(), size_t capacity = DEFAULT_CAPACITY);
+    void close();
+    bool isOpen() const;
+    const std::string & getError() const;
+
+// Remove segment, processes which have it opened keep using it
+    static bool remove(const std::string &name = defaultName());
+
+// Get data of entry, it is valid while returned pointer is kept. nullptr if entry is missing
+    std::shared_ptr<const void> get(const void *key, size_t key_size, size_t &size) const;
+
+// Check if entry is stored, statistics are not changed
+    bool contains(const void *key, size_t key_size) const;
+
+// Store entry, existing entry of the key is kept. Data is copied, false if it doesn't fit
+    bool put(const void *key, size_t key_size, const void *data, size_t size);
+
+    SharedCacheStats stats() const;
+
+};
+
+
+#endif // SHAREDCACHE_H
@@ -11,23 +11,24 @@ QMAKE_LFLAGS += -static -static-libgcc
 #DEFINES += QT_DISABLE_DEPRECATED_BEFORE=0x060000    # disables all the APIs deprecated before Qt 6.0.0
 
 SOURCES += \
-    atommodel.cpp \
     main.cpp \
     mainwindow.cpp \
     qcustomplot.cpp \
-    vectormatrix.cpp \
+    viewer2d.cpp \
     viewer3d.cpp
 
 HEADERS += \
-    atommodel.h \
     mainwindow.h \
     qcustomplot.h \
-    vectormatrix.h \
+    viewer2d.h \
     viewer3d.h
 
 FORMS += \
     mainwindow.ui
 
+# Model and render kernels are built as Qt-free library by core/core.pro
+include(../core/core.pri)
+
 # Default rules for deployment.
 qnx: target.path = /tmp/$${TARGET}/bin
 else: unix:!android: target.path = /opt/$${TARGET}/bin
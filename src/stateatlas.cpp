@@ -0,0 +1,370 @@
+#include "stateatlas.h"
+
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+
+static const char ATLAS_MAGIC[8] = {'S', 'I', 'M', 'A', 'T', 'L', 'A', 'S'};
+static const uint32_t ATLAS_BYTE_ORDER = 0x01020304u;
+
+
+// CRC-32 of bytes
+uint32_t StateAtlas::checksum(const void *data, size_t size, uint32_t crc)
+{
+    static uint32_t table[256];
+    static bool table_ready = [] {
+        for (uint32_t i=0; i<256; i++) {
+            uint32_t c = i;
+            for (int k=0; k<8; k++)
+                c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+            table[i] = c;
+        }
+        return true;
+    }();
+    (void)table_ready;
+
+    const unsigned char *p = (const unsigned char *)data;
+    crc = ~crc;
+    for (size_t i=0; i<size; i++)
+        crc = table[(crc ^ p[i]) & 0xFF] ^ (crc >> 8);
+    return ~crc;
+}
+
+
+// Compute atlas of all states up to n_max and write it to file
+bool StateAtlas::build(const std::string &path, int n_max, int meridional_size, int volume_size,
+                       const std::function<void(int done, int total)> &progress)
+{
+    if (n_max < 1 || n_max > AtomModel::MAX_N || meridional_size < 0 || meridional_size == 1 || volume_size < 0)
+        return false;
+    if (volume_size > DensityVolume::MAX_SIZE)
+        volume_size = DensityVolume::MAX_SIZE;
+    volume_size = (volume_size + 7) / 8 * 8;
+
+// Directory: radial tables of (n, l), angular tables of (l, |m|), canonical states
+    std::vector<RadialEntry> radial;
+    std::vector<AngularEntry> angular;
+    std::vector<StateEntry> states;
+    for (int n=1; n<=n_max; n++)
+        for (int l=0; l<n; l++) {
+            RadialEntry r = {n, l, 0, 0, 0, 0};
+            radial.push_back(r);
+            for (int m=0; m<=l; m++) {
+                StateEntry s = {n, l, m, NO_BLOCK, NO_BLOCK, NO_BLOCK, 0, 0};
+                states.push_back(s);
+            }
+        }
+    for (int l=0; l<n_max; l++)
+        for (int m=0; m<=l; m++) {
+            AngularEntry a = {l, m, 0, 0, 0};
+            angular.push_back(a);
+        }
+    int block_count = radial.size() + angular.size() + states.size() * ((meridional_size > 0) + 2 * (volume_size > 0));
+    std::vector<Block> blocks;
+    blocks.reserve(block_count);
+
+    FILE *f = fopen(path.c_str(), "wb");
+    if (f == nullptr)
+        return false;
+
+    uint64_t offset = 0;
+    bool ok = true;
+    auto write = [&](const void *data, uint64_t size) {
+        ok = ok && fwrite(data, 1, size, f) == size;
+        offset += size;
+    };
+
+// Directory is written after data, reserve space for it
+    std::vector<char> zeros(ALIGNMENT, 0);
+    uint64_t directory_end = sizeof(Header) + radial.size() * sizeof(RadialEntry) + angular.size() * sizeof(AngularEntry)
+                             + states.size() * sizeof(StateEntry) + block_count * sizeof(Block);
+    while (offset < directory_end)
+        write(zeros.data(), (directory_end - offset < ALIGNMENT) ? directory_end - offset : ALIGNMENT);
+    auto writeBlock = [&](const void *data, uint64_t size) {
+        write(zeros.data(), (ALIGNMENT - offset % ALIGNMENT) % ALIGNMENT);
+        Block b = {offset, size, checksum(data, size), 0};
+        blocks.push_back(b);
+        write(data, size);
+        if (progress)
+            progress(blocks.size(), block_count);
+        return (uint32_t)(blocks.size() - 1);
+    };
+
+    AtomModel model;
+    auto setState = [&](int n, int l, int m) {
+        model.set_n(n);
+        model.set_l(l);
+        model.set_m(m);
+    };
+
+    for (auto &r : radial) {
+        setState(r.n, r.l, 0);
+        const double *table = model.radialTable(r.peak, r.probability_peak);
+        r.block = writeBlock(table, AtomModel::RADIAL_TABLE_SIZE * sizeof(double));
+    }
+    for (auto &a : angular) {
+        setState(a.l + 1, a.l, a.m);
+        const double *table = model.angularTable(a.peak);
+        a.block = writeBlock(table, AtomModel::ANGULAR_TABLE_SIZE * sizeof(double));
+    }
+    for (auto &s : states) {
+        setState(s.n, s.l, s.m);
+        s.radius = model.tableRadius();
+        if (meridional_size > 0) {
+            std::vector<float> map((size_t)meridional_size * (2 * meridional_size - 1));
+            model.modelMeridional(map.data(), meridional_size);
+            s.meridional_block = writeBlock(map.data(), map.size() * sizeof(float));
+        }
+        if (volume_size > 0) {
+            DensityVolume vol(model, volume_size);
+            s.volume_radius = vol.getRadius();
+            s.volume_index_block = writeBlock(vol.brickIndex(), DensityVolume::indexSize(volume_size) * sizeof(int));
+            s.volume_data_block = writeBlock(vol.brickData(), vol.storedBricks() * DensityVolume::brickVoxels() * sizeof(float));
+        }
+    }
+
+// Header and directory with checksums
+    Header h;
+    memset(&h, 0, sizeof(h));
+    memcpy(h.magic, ATLAS_MAGIC, sizeof(h.magic));
+    h.version = VERSION;
+    h.byte_order = ATLAS_BYTE_ORDER;
+    h.radial_size = AtomModel::RADIAL_TABLE_SIZE;
+    h.angular_size = AtomModel::ANGULAR_TABLE_SIZE;
+    h.meridional_size = meridional_size;
+    h.volume_size = volume_size;
+    h.n_max = n_max;
+    h.radial_count = radial.size();
+    h.angular_count = angular.size();
+    h.state_count = states.size();
+    h.block_count = blocks.size();
+    h.file_size = offset;
+    uint32_t crc = checksum(radial.data(), radial.size() * sizeof(RadialEntry));
+    crc = checksum(angular.data(), angular.size() * sizeof(AngularEntry), crc);
+    crc = checksum(states.data(), states.size() * sizeof(StateEntry), crc);
+    h.directory_crc = checksum(blocks.data(), blocks.size() * sizeof(Block), crc);
+    h.header_crc = checksum(&h, sizeof(h));
+
+    ok = ok && fseek(f, 0, SEEK_SET) == 0;
+    ok = ok && fwrite(&h, sizeof(h), 1, f) == 1;
+    ok = ok && fwrite(radial.data(), sizeof(RadialEntry), radial.size(), f) == radial.size();
+    ok = ok && fwrite(angular.data(), sizeof(AngularEntry), angular.size(), f) == angular.size();
+    ok = ok && fwrite(states.data(), sizeof(StateEntry), states.size(), f) == states.size();
+    ok = ok && fwrite(blocks.data(), sizeof(Block), blocks.size(), f) == blocks.size();
+    ok = (fclose(f) == 0) && ok;
+    if (!ok)
+        remove(path.c_str());
+    return ok;
+}
+
+
+StateAtlas::StateAtlas() :
+    header(nullptr),
+    radial_entries(nullptr),
+    angular_entries(nullptr),
+    state_entries(nullptr),
+    blocks(nullptr) {
+}
+
+
+// Map atlas file, check its version, header and directory
+bool StateAtlas::open(const std::string &path)
+{
+    close();
+    if (!file.open(path) || file.getSize() < sizeof(Header)) {
+        close();
+        return false;
+    }
+    const unsigned char *data = file.getData();
+    Header h;
+    memcpy(&h, data, sizeof(h));
+    uint32_t header_crc = h.header_crc;
+    h.header_crc = 0;
+
+// Atlas must be written by this version for the same tables and byte order
+    if (memcmp(h.magic, ATLAS_MAGIC, sizeof(h.magic)) != 0 || h.version != VERSION || h.byte_order != ATLAS_BYTE_ORDER ||
+        checksum(&h, sizeof(h)) != header_crc || h.file_size != file.getSize() ||
+        h.radial_size != (uint32_t)AtomModel::RADIAL_TABLE_SIZE || h.angular_size != (uint32_t)AtomModel::ANGULAR_TABLE_SIZE) {
+        close();
+        return false;
+    }
+    uint64_t directory_size = (uint64_t)h.radial_count * sizeof(RadialEntry) + (uint64_t)h.angular_count * sizeof(AngularEntry)
+                              + (uint64_t)h.state_count * sizeof(StateEntry) + (uint64_t)h.block_count * sizeof(Block);
+    if (directory_size > h.file_size - sizeof(Header) || checksum(data + sizeof(Header), directory_size) != h.directory_crc) {
+        close();
+        return false;
+    }
+
+    header = (const Header *)data;
+    radial_entries = (const RadialEntry *)(data + sizeof(Header));
+    angular_entries = (const AngularEntry *)(radial_entries + h.radial_count);
+    state_entries = (const StateEntry *)(angular_entries + h.angular_count);
+    blocks = (const Block *)(state_entries + h.state_count);
+
+// Blocks must lie inside the file and be aligned for their values
+    for (uint32_t i=0; i<h.block_count; i++)
+        if (blocks[i].offset % 8 != 0 || blocks[i].offset > h.file_size || blocks[i].size > h.file_size - blocks[i].offset) {
+            close();
+            return false;
+        }
+
+    for (uint32_t i=0; i<h.radial_count; i++)
+        radial_index[std::make_pair(radial_entries[i].n, radial_entries[i].l)] = i;
+    for (uint32_t i=0; i<h.angular_count; i++)
+        angular_index[std::make_pair(angular_entries[i].l, angular_entries[i].m)] = i;
+    for (uint32_t i=0; i<h.state_count; i++)
+        state_index[QuantumState(state_entries[i].n, state_entries[i].l, state_entries[i].m)] = i;
+    block_status.reset(new std::atomic<unsigned char>[h.block_count]);
+    for (uint32_t i=0; i<h.block_count; i++)
+        block_status[i] = 0;
+    return true;
+}
+
+
+// Unmap atlas file
+void StateAtlas::close()
+{
+    header = nullptr;
+    radial_entries = nullptr;
+    angular_entries = nullptr;
+    state_entries = nullptr;
+    blocks = nullptr;
+    radial_index.clear();
+    angular_index.clear();
+    state_index.clear();
+    block_status.reset();
+    file.close();
+}
+
+
+// Check if atlas is mapped
+bool StateAtlas::isOpen() const
+{
+    return header != nullptr;
+}
+
+
+// Get data of block with expected size, checksum is verified on first use
+const unsigned char * StateAtlas::block(uint32_t index, uint64_t size) const
+{
+    if (header == nullptr || index >= header->block_count || blocks[index].size != size)
+        return nullptr;
+    const unsigned char *data = file.getData() + blocks[index].offset;
+    unsigned char status = block_status[index];
+    if (status == 0) {
+    // Concurrent first uses verify the block twice with the same result
+        status = (checksum(data, size) == blocks[index].crc) ? 1 : 2;
+        block_status[index] = status;
+    }
+    return (status == 1) ? data : nullptr;
+}
+
+
+// Verify checksums of all blocks
+bool StateAtlas::verify() const
+{
+    if (header == nullptr)
+        return false;
+    bool ok = true;
+    for (uint32_t i=0; i<header->block_count; i++)
+        ok = block(i, blocks[i].size) != nullptr && ok;
+    return ok;
+}
+
+
+// Get maximum main quantum number
+int StateAtlas::getMaxN() const
+{
+    return header ? header->n_max : 0;
+}
+
+
+// Get size of meridional maps
+int StateAtlas::getMeridionalSize() const
+{
+    return header ? header->meridional_size : 0;
+}
+
+
+// Get size of voxel volumes
+int StateAtlas::getVolumeSize() const
+{
+    return header ? header->volume_size : 0;
+}
+
+
+// Get radial table of (n, l)
+const double * StateAtlas::radialTable(int n, int l, double &peak, double &probability_peak) const
+{
+    auto it = radial_index.find(std::make_pair(n, l));
+    if (it == radial_index.end())
+        return nullptr;
+    const RadialEntry &e = radial_entries[it->second];
+    const double *table = (const double *)block(e.block, header->radial_size * sizeof(double));
+    peak = e.peak;
+    probability_peak = e.probability_peak;
+    return table;
+}
+
+
+// Get angular table of (l, |m|)
+const double * StateAtlas::angularTable(int l, int m, double &peak) const
+{
+    auto it = angular_index.find(std::make_pair(l, m < 0 ? -m : m));
+    if (it == angular_index.end())
+        return nullptr;
+    const AngularEntry &e = angular_entries[it->second];
+    peak = e.peak;
+    return (const double *)block(e.block, header->angular_size * sizeof(double));
+}
+
+
+// Get meridional map of state
+const float * StateAtlas::meridionalMap(const QuantumState &state, double &radius) const
+{
+    auto it = state_index.find(state);
+    if (it == state_index.end() || header->meridional_size == 0)
+        return nullptr;
+    const StateEntry &e = state_entries[it->second];
+    uint64_t size = (uint64_t)header->meridional_size;
+    radius = e.radius;
+    return (const float *)block(e.meridional_block, size * (2 * size - 1) * sizeof(float));
+}
+
+
+// Sample meridional map by bilinear interpolation
+float StateAtlas::sampleMeridional(const float *map, int size, double radius, double rho, double z)
+{
+    double scale = (size - 1) / radius;
+    double fx = rho * scale, fy = (z + radius) * scale;
+    if (fx < 0 || fy < 0 || fx >= size - 1 || fy >= 2 * size - 2)
+        return 0;
+    int i = (int)fx, j = (int)fy;
+    float tx = fx - i, ty = fy - j;
+    const float *row0 = map + (size_t)j * size + i, *row1 = row0 + size;
+    float c0 = row0[0] + (row0[1] - row0[0]) * tx;
+    float c1 = row1[0] + (row1[1] - row1[0]) * tx;
+    return c0 + (c1 - c0) * ty;
+}
+
+
+// Get voxel volume of state
+std::shared_ptr<const DensityVolume> StateAtlas::volume(const QuantumState &state) const
+{
+    auto it = state_index.find(state);
+    if (it == state_index.end() || header->volume_size == 0)
+        return nullptr;
+    const StateEntry &e = state_entries[it->second];
+    int size = header->volume_size;
+    const int *index = (const int *)block(e.volume_index_block, DensityVolume::indexSize(size) * sizeof(int));
+    const float *voxels = (const float *)block(e.volume_data_block,
+                                               (uint64_t)DensityVolume::countBricks(size) * DensityVolume::brickVoxels() * sizeof(float));
+    if (index == nullptr || voxels == nullptr)
+        return nullptr;
+    int bricks = DensityVolume::countBricks(size);
+    for (size_t i=0; i<DensityVolume::indexSize(size); i++)
+        if (index[i] >= bricks)
+            return nullptr;
+    return std::make_shared<const DensityVolume>(size, e.volume_radius, index, voxels, shared_from_this());
+}
@@ -0,0 +1,121 @@
+#ifndef STATEATLAS_H
+#define STATEATLAS_H
+
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <string>
+#include <utility>
+
+#include "atommodel.h"
+#include "densityvolume.h"
+#include "mappedfile.h"
+
+
+// Precomputed radial and angular tables, meridional maps and voxel volumes of all states up to n_max,
+// stored in one versioned binary file. The file is mapped to memory and its data is used without copying.
+// Every data block has its own checksum, which is verified on first use of the block.
+class StateAtlas : public std::enable_shared_from_this<StateAtlas> {
+
+// File layout: header, directory (radial, angular and state entries, blocks), data blocks aligned to 64 bytes
+    struct Header {
+        char magic[8];
+        uint32_t version, byte_order;
+        uint32_t radial_size, angular_size, meridional_size, volume_size;
+        uint32_t n_max, radial_count, angular_count, state_count, block_count;
+        uint32_t directory_crc;
+        uint64_t file_size;
+        uint32_t header_crc, reserved;
+    };
+
+    struct Block {
+        uint64_t offset, size;
+        uint32_t crc, reserved;
+    };
+
+    struct RadialEntry {
+        int32_t n, l;
+        uint32_t block, reserved;
+        double peak, probability_peak;
+    };
+
+    struct AngularEntry {
+        int32_t l, m;
+        uint32_t block, reserved;
+        double peak;
+    };
+
+    struct StateEntry {
+        int32_t n, l, m;
+        uint32_t meridional_block, volume_index_block, volume_data_block;
+        double radius, volume_radius;
+    };
+
+    static const uint32_t NO_BLOCK = 0xFFFFFFFFu;
+    static const int ALIGNMENT = 64;
+
+    MappedFile file;
+    const Header *header;
+    const RadialEntry *radial_entries;
+    const AngularEntry *angular_entries;
+    const StateEntry *state_entries;
+    const Block *blocks;
+    std::map<std::pair<int, int>, int> radial_index, angular_index;
+    std::map<QuantumState, int> state_index;
+
+// Checksum state of blocks: 0 - not verified, 1 - valid, 2 - corrupted
+    std::unique_ptr<std::atomic<unsigned char>[]> block_status;
+
+// Get data of block with expected size, nullptr if block is missing or corrupted
+    const unsigned char * block(uint32_t index, uint64_t size) const;
+
+public:
+
+    static const uint32_t VERSION = 1;
+
+// CRC-32 (IEEE 802.3) of bytes, crc is checksum of preceding bytes
+    static uint32_t checksum(const void *data, size_t size, uint32_t crc = 0);
+
+// Compute atlas of all states up to n_max and write it to file. Meridional maps have size x (2*size-1)
+// nodes, voxel volumes have grid size^3, 0 - don't store. Progress is called after every written block
+    static bool build(const std::string &path, int n_max, int meridional_size, int volume_size,
+                      const std::function<void(int done, int total)> &progress = nullptr);
+
+    StateAtlas();
+
+// Map atlas file, check its version, header and directory
+    bool open(const std::string &path);
+    void close();
+    bool isOpen() const;
+
+// Verify checksums of all blocks
+    bool verify() const;
+
+// Get maximum main quantum number, size of meridional maps and voxel volumes (0 - not stored)
+    int getMaxN() const;
+    int getMeridionalSize() const;
+    int getVolumeSize() const;
+
+// Get radial table of (n, l) with its maxima of density and probability, nullptr if it is missing
+    const double * radialTable(int n, int l, double &peak, double &probability_peak) const;
+
+// Get angular table of (l, |m|) with its maximum, nullptr if it is missing
+    const double * angularTable(int l, int m, double &peak) const;
+
+// Get meridional map of relative probability density, size x (2*size-1) nodes over rho in [0, radius],
+// z in [-radius, radius] (Bohr radii), rho index changes fastest. nullptr if it is missing
+    const float * meridionalMap(const QuantumState &state, double &radius) const;
+
+// Sample meridional map by bilinear interpolation, points out of map are zero
+    static float sampleMeridional(const float *map, int size, double radius, double rho, double z);
+
+// Get voxel volume of state, it keeps atlas mapped. nullptr if it is missing
+    std::shared_ptr<const DensityVolume> volume(const QuantumState &state) const;
+
+};
+
+
+#endif // STATEATLAS_H
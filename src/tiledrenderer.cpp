@@ -0,0 +1,231 @@
+#include "tiledrenderer.h"
+#include "mappedfile.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+
+TiledRenderer::TiledRenderer(AtomModel &_model, int _width, int _height) :
+    model(_model),
+    width(_width),
+    height(_height),
+    slice(false) {
+}
+
+
+TiledRenderer::TiledRenderer(AtomModel &_model, int _width, int _height, const View3D &_view) :
+    model(_model),
+    width(_width),
+    height(_height),
+    slice(true),
+    view(_view) {
+}
+
+
+// Compute regions of 2D model or 3D slice
+DensityHistogram TiledRenderer::compute(int image_width, int image_height, const std::vector<Tile> &regions,
+                                        const std::function<void(const Tile &region, const long double *p, int worker)> &output)
+{
+    if (slice)
+        return model.model3DRegions(image_width, image_height, regions, view.mov_x, view.mov_y, view.rot_x, view.rot_y, view.zoom, output);
+    return model.model2DRegions(image_width, image_height, regions, output);
+}
+
+
+// Write relative values as raw floats
+bool TiledRenderer::writeRaw(const std::string &path, const std::function<void(int done, int total)> &progress)
+{
+    MappedFile file;
+    size_t row_bytes = (size_t)width * sizeof(float);
+    if (!file.create(path, row_bytes * height))
+        return false;
+    float *out = (float *)file.getWritableData();
+
+// Band has whole rows, so it is contiguous in file, and is split to regions of TILE_SIZE columns
+    int band_rows = std::max(1, std::min(height, (int)(BAND_BYTES / row_bytes)));
+    int bands = (height + band_rows - 1) / band_rows;
+    DensityHistogram hist;
+    bool ok = true;
+    for (int band=0; band<bands && ok; band++) {
+        int y0 = band * band_rows, y1 = std::min(height, y0 + band_rows);
+        std::vector<Tile> regions;
+        for (int x0=0; x0<width; x0+=TILE_SIZE) {
+            Tile region = {x0, y0, std::min(width, x0 + TILE_SIZE), y1};
+            regions.push_back(region);
+        }
+        hist.merge(compute(width, height, regions, [&](const Tile &region, const long double *p, int) {
+            int columns = region.x1 - region.x0;
+            for (int y=region.y0; y<region.y1; y++) {
+                float *row = out + (size_t)y * width + region.x0;
+                for (int x=0; x<columns; x++)
+                    row[x] = (float)*p++;
+            }
+        }));
+        ok = file.flush((size_t)y0 * row_bytes, (size_t)(y1 - y0) * row_bytes);
+        if (progress)
+            progress(band + 1, 2 * bands);
+    }
+
+// Values go to relative ones in place, band by band
+    long double level = model.relativeLevel(hist);
+    for (int band=0; band<bands && ok && level > 0; band++) {
+        int y0 = band * band_rows, y1 = std::min(height, y0 + band_rows);
+        float scale = (float)(1 / level);
+        TileScheduler::forEach(y1 - y0, [&](int index, int) {
+            float *row = out + (size_t)(y0 + index) * width;
+            for (int x=0; x<width; x++)
+                row[x] *= scale;
+        });
+        ok = file.flush((size_t)y0 * row_bytes, (size_t)(y1 - y0) * row_bytes);
+        if (progress)
+            progress(bands + band + 1, 2 * bands);
+    }
+    file.close();
+    return ok;
+}
+
+
+// Write colored image to tiled TIFF
+bool TiledRenderer::writeTIFF(const std::string &path, const unsigned int *colors, const std::function<void(int done, int total)> &progress)
+{
+// White level is taken from preview, which has the same framing as the image
+    double shrink = std::max(1.0, sqrt((double)width * height / PREVIEW_PIXELS));
+    int preview_width = std::max(1, (int)(width / shrink)), preview_height = std::max(1, (int)(height / shrink));
+    std::vector<Tile> preview;
+    for (int y0=0; y0<preview_height; y0+=TILE_SIZE)
+        for (int x0=0; x0<preview_width; x0+=TILE_SIZE) {
+            Tile region = {x0, y0, std::min(preview_width, x0 + TILE_SIZE), std::min(preview_height, y0 + TILE_SIZE)};
+            preview.push_back(region);
+        }
+    long double level = model.relativeLevel(compute(preview_width, preview_height, preview, [](const Tile &, const long double *, int) {}));
+
+// Tiles are stored uncompressed in row-major order after header, edge tiles are padded
+    int tiles_x = (width + TILE_SIZE - 1) / TILE_SIZE, tiles_y = (height + TILE_SIZE - 1) / TILE_SIZE;
+    size_t tile_bytes = (size_t)TILE_SIZE * TILE_SIZE * 3, tile_count = (size_t)tiles_x * tiles_y;
+    std::vector<unsigned char> header;
+    tiffHeader(false, 0, header);
+    bool big = (header.size() + tile_count * tile_bytes + 4096 > 0xFFFFFFFFull);
+    tiffHeader(big, 0, header);
+    size_t data_offset = (header.size() + 4095) / 4096 * 4096;
+    tiffHeader(big, data_offset, header);
+
+    MappedFile file;
+    if (!file.create(path, data_offset + tile_count * tile_bytes))
+        return false;
+    unsigned char *out = file.getWritableData();
+    memcpy(out, header.data(), header.size());
+
+// Band is a run of tiles, contiguous in file, with a few tiles per worker
+    size_t band_tiles = 4 * TileScheduler::threadCount();
+    int bands = (int)((tile_count + band_tiles - 1) / band_tiles);
+    std::vector<std::vector<unsigned int>> rgb(TileScheduler::threadCount());
+    bool ok = true;
+    for (int band=0; band<bands && ok; band++) {
+        size_t first = band * band_tiles, last = std::min(tile_count, first + band_tiles);
+        std::vector<Tile> regions;
+        for (size_t t=first; t<last; t++) {
+            int x0 = (t % tiles_x) * TILE_SIZE, y0 = (t / tiles_x) * TILE_SIZE;
+            Tile region = {x0, y0, std::min(width, x0 + TILE_SIZE), std::min(height, y0 + TILE_SIZE)};
+            regions.push_back(region);
+        }
+        compute(width, height, regions, [&](const Tile &region, const long double *p, int worker) {
+            int columns = region.x1 - region.x0, rows = region.y1 - region.y0;
+            size_t t = (size_t)(region.y0 / TILE_SIZE) * tiles_x + region.x0 / TILE_SIZE;
+            unsigned char *tile = out + data_offset + t * tile_bytes;
+            std::vector<long double> relative(p, p + (size_t)columns * rows);
+            if (level > 0)
+                for (auto &v : relative)
+                    v /= level;
+            std::vector<unsigned int> &c = rgb[worker];
+            c.resize(relative.size());
+            FrameRenderer::colorize(relative.data(), relative.size(), colors, c.data());
+            for (int y=0; y<rows; y++) {
+                unsigned char *row = tile + (size_t)y * TILE_SIZE * 3;
+                for (int x=0; x<columns; x++) {
+                    unsigned int color = c[(size_t)y * columns + x];
+                    row[3*x] = color >> 16 & 0xFF;
+                    row[3*x + 1] = color >> 8 & 0xFF;
+                    row[3*x + 2] = color & 0xFF;
+                }
+            }
+        });
+        ok = file.flush(data_offset + first * tile_bytes, (last - first) * tile_bytes);
+        if (progress)
+            progress(band + 1, bands);
+    }
+    ok = ok && file.flush(0, header.size());
+    file.close();
+    return ok;
+}
+
+
+// Build header of tiled TIFF: file header, IFD and arrays which don't fit in IFD entries. Values are little endian
+void TiledRenderer::tiffHeader(bool big, size_t data_offset, std::vector<unsigned char> &header) const
+{
+    int tiles_x = (width + TILE_SIZE - 1) / TILE_SIZE, tiles_y = (height + TILE_SIZE - 1) / TILE_SIZE;
+    size_t tile_count = (size_t)tiles_x * tiles_y, tile_bytes = (size_t)TILE_SIZE * TILE_SIZE * 3;
+    const int SHORT = 3, LONG = 4, LONG8 = 16;
+
+// Tag, type, values; offsets and counts of tiles are generated
+    struct Entry {
+        int tag, type;
+        std::vector<unsigned long long> values;
+    };
+    std::vector<Entry> entries = {
+        {256, LONG, {(unsigned long long)width}},
+        {257, LONG, {(unsigned long long)height}},
+        {258, SHORT, {8, 8, 8}},
+        {259, SHORT, {1}},
+        {262, SHORT, {2}},
+        {277, SHORT, {3}},
+        {284, SHORT, {1}},
+        {322, LONG, {(unsigned long long)TILE_SIZE}},
+        {323, LONG, {(unsigned long long)TILE_SIZE}},
+        {324, big ? LONG8 : LONG, {}},
+        {325, big ? LONG8 : LONG, {}}
+    };
+    for (size_t t=0; t<tile_count; t++) {
+        entries[9].values.push_back(data_offset + t * tile_bytes);
+        entries[10].values.push_back(tile_bytes);
+    }
+
+    header.clear();
+    auto put = [&](std::vector<unsigned char> &out, unsigned long long v, int bytes) {
+        for (int i=0; i<bytes; i++)
+            out.push_back(v >> (8 * i) & 0xFF);
+    };
+    int offset_bytes = big ? 8 : 4;
+    size_t ifd_offset = big ? 16 : 8;
+    size_t ifd_size = big ? 8 + 20 * entries.size() + 8 : 2 + 12 * entries.size() + 4;
+    header.push_back('I');
+    header.push_back('I');
+    put(header, big ? 43 : 42, 2);
+    if (big) {
+        put(header, 8, 2);
+        put(header, 0, 2);
+    }
+    put(header, ifd_offset, offset_bytes);
+
+// Values which don't fit in entry follow IFD
+    std::vector<unsigned char> extra;
+    put(header, entries.size(), big ? 8 : 2);
+    for (auto &e : entries) {
+        int size = (e.type == SHORT) ? 2 : (e.type == LONG) ? 4 : 8;
+        std::vector<unsigned char> bytes;
+        for (auto v : e.values)
+            put(bytes, v, size);
+        put(header, e.tag, 2);
+        put(header, e.type, 2);
+        put(header, e.values.size(), offset_bytes);
+        if ((int)bytes.size() <= offset_bytes) {
+            bytes.resize(offset_bytes, 0);
+            header.insert(header.end(), bytes.begin(), bytes.end());
+        } else {
+            put(header, ifd_offset + ifd_size + extra.size(), offset_bytes);
+            extra.insert(extra.end(), bytes.begin(), bytes.end());
+        }
+    }
+    put(header, 0, offset_bytes);
+    header.insert(header.end(), extra.begin(), extra.end());
+}
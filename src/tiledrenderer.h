@@ -0,0 +1,53 @@
+#ifndef TILEDRENDERER_H
+#define TILEDRENDERER_H
+
+
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "atommodel.h"
+#include "framerenderer.h"
+#include "parallel.h"
+
+
+// Rendering of 2D models and 3D slices larger than memory (e.g. 32k x 32k posters) into memory-mapped file.
+// Image is computed by bands of tiles in parallel, workers write tiles directly into the mapping, and every
+// finished band is flushed to disk and dropped from memory, so resident memory is bounded by one band
+class TiledRenderer {
+
+    AtomModel &model;
+    int width, height;
+    bool slice;
+    View3D view;
+
+// Compute regions of model, return histogram of their values
+    DensityHistogram compute(int image_width, int image_height, const std::vector<Tile> &regions,
+                             const std::function<void(const Tile &region, const long double *p, int worker)> &output);
+
+public:
+
+// Side of TIFF tiles and regions, bytes of raw band, and pixels of preview which gives white level of TIFF
+    static const int TILE_SIZE = 256;
+    static const size_t BAND_BYTES = 32 << 20;
+    static const int PREVIEW_PIXELS = 1 << 22;
+
+// Renderer of 2D model or 3D slice with given view of model's current state
+    TiledRenderer(AtomModel &model, int width, int height);
+    TiledRenderer(AtomModel &model, int width, int height, const View3D &view);
+
+// Write relative values as 32-bit floats with native byte order, row by row. Values of the first pass
+// are scaled in place by the second pass, so they are the same as ones of a single frame
+    bool writeRaw(const std::string &path, const std::function<void(int done, int total)> &progress = nullptr);
+
+// Write image colored by color table (FrameRenderer::COLOR_TABLE_SIZE entries) to tiled RGB TIFF, BigTIFF
+// when file exceeds 4 GB. White level is taken from histogram of preview of at most PREVIEW_PIXELS pixels
+    bool writeTIFF(const std::string &path, const unsigned int *colors, const std::function<void(int done, int total)> &progress = nullptr);
+
+// Build header of tiled TIFF with tile data at given offset, BigTIFF has 64-bit offsets
+    void tiffHeader(bool big, size_t data_offset, std::vector<unsigned char> &header) const;
+
+};
+
+
+#endif // TILEDRENDERER_H
@@ -0,0 +1,209 @@
+#include "tonemap.h"
+
+#include <cmath>
+
+
+DensityHistogram::DensityHistogram() :
+    bins((MAX_EXPONENT - MIN_EXPONENT) * BINS_PER_OCTAVE, 0),
+    zeros(0),
+    total(0),
+    vmax(0) {
+}
+
+
+// Add value to histogram
+void DensityHistogram::add(long double v)
+{
+    total++;
+    if (!(v > 0)) {
+        zeros++;
+        return;
+    }
+    if (v > vmax)
+        vmax = v;
+
+// v = mantissa * 2^exponent, mantissa is in [0.5, 1)
+    int exponent;
+    long double mantissa = frexp(v, &exponent);
+    int bin = (exponent - MIN_EXPONENT) * BINS_PER_OCTAVE + (int)((mantissa - 0.5l) * 2 * BINS_PER_OCTAVE);
+    if (bin < 0)
+        bin = 0;
+    if (bin >= (int)bins.size())
+        bin = bins.size() - 1;
+    bins[bin]++;
+}
+
+
+// Add other histogram
+void DensityHistogram::merge(const DensityHistogram &other)
+{
+    for (size_t i=0; i<bins.size(); i++)
+        bins[i] += other.bins[i];
+    zeros += other.zeros;
+    total += other.total;
+    if (other.vmax > vmax)
+        vmax = other.vmax;
+}
+
+
+// Get value of bin upper edge
+long double DensityHistogram::binUpperEdge(int bin) const
+{
+    int exponent = bin / BINS_PER_OCTAVE + MIN_EXPONENT;
+    long double mantissa = 0.5l + 0.5l * (bin % BINS_PER_OCTAVE + 1) / BINS_PER_OCTAVE;
+    return ldexp(mantissa, exponent);
+}
+
+
+// Return value below which given fraction of all values lie
+long double DensityHistogram::percentile(long double fraction) const
+{
+    if (fraction >= 1 || total == 0)
+        return vmax;
+    unsigned long long target = (unsigned long long)ceil(fraction * total);
+    unsigned long long sum = zeros;
+    if (sum >= target)
+        return 0;
+    for (size_t i=0; i<bins.size(); i++) {
+        sum += bins[i];
+        if (sum >= target) {
+            long double v = binUpperEdge(i);
+            return (v < vmax) ? v : vmax;
+        }
+    }
+    return vmax;
+}
+
+
+// Return maximum value
+long double DensityHistogram::maximum() const
+{
+    return vmax;
+}
+
+
+// Return number of values
+unsigned long long DensityHistogram::count() const
+{
+    return total;
+}
+
+
+ToneMap::ToneMap() :
+    curve(TONE_LINEAR),
+    gamma(2.2l),
+    decades(4),
+    clip_percentile(100) {
+}
+
+
+// Set tone curve
+void ToneMap::setCurve(ToneCurve c)
+{
+    curve = c;
+}
+
+
+// Get tone curve
+ToneCurve ToneMap::getCurve() const
+{
+    return curve;
+}
+
+
+// Set exponent of gamma curve, y = x^(1/gamma)
+bool ToneMap::setGamma(long double g)
+{
+    if (!(g > 0))
+        return false;
+    gamma = g;
+    return true;
+}
+
+
+// Get exponent of gamma curve
+long double ToneMap::getGamma() const
+{
+    return gamma;
+}
+
+
+// Set number of decades shown by logarithmic curve
+bool ToneMap::setDecades(long double d)
+{
+    if (!(d > 0))
+        return false;
+    decades = d;
+    return true;
+}
+
+
+// Get number of decades shown by logarithmic curve
+long double ToneMap::getDecades() const
+{
+    return decades;
+}
+
+
+// Set percentile used as white level
+bool ToneMap::setClipPercentile(long double p)
+{
+    if (!(p > 0 && p <= 100))
+        return false;
+    clip_percentile = p;
+    return true;
+}
+
+
+// Get percentile used as white level
+long double ToneMap::getClipPercentile() const
+{
+    return clip_percentile;
+}
+
+
+// Return value mapped to 1.0 for given histogram of model values
+long double ToneMap::clipLevel(const DensityHistogram &hist) const
+{
+    long double level = hist.percentile(clip_percentile / 100);
+// Percentile can fall to zero for mostly empty images, use maximum then
+    if (!(level > 0))
+        level = hist.maximum();
+    return level;
+}
+
+
+// Apply tone curve to relative value
+long double ToneMap::apply(long double x) const
+{
+    if (!(x > 0))
+        return 0;
+    if (x > 1)
+        x = 1;
+    switch (curve) {
+    case TONE_LOG:
+        x = 1 + log10(x) / decades;
+        return (x < 0) ? 0 : x;
+    case TONE_GAMMA:
+        return pow(x, 1 / gamma);
+    default:
+        return x;
+    }
+}
+
+
+// Build color table for relative values
+void ToneMap::buildColorTable(unsigned int *table, int size, int r, int g, int b) const
+{
+    for (int i=0; i<size; i++) {
+        long double intensity = apply((long double)i / (size - 1));
+    // Compute 8-bit color components
+        int cr = r * intensity;
+        int cg = g * intensity;
+        int cb = b * intensity;
+        cr = (cr < 0) ? 0 : cr; cr = (cr > 0xFF) ? 0xFF : cr;
+        cg = (cg < 0) ? 0 : cg; cg = (cg > 0xFF) ? 0xFF : cg;
+        cb = (cb < 0) ? 0 : cb; cb = (cb > 0xFF) ? 0xFF : cb;
+        table[i] = cr<<16 | cg<<8 | cb;
+    }
+}
@@ -0,0 +1,90 @@
+#ifndef TONEMAP_H
+#define TONEMAP_H
+
+
+#include <vector>
+
+
+// Logarithmic histogram of non-negative values, filled while a model is computed
+class DensityHistogram {
+
+// Bins per binary order of value and range of binary exponents
+    static const int BINS_PER_OCTAVE = 16;
+    static const int MIN_EXPONENT = -1024;
+    static const int MAX_EXPONENT = 1024;
+
+    std::vector<unsigned long long> bins;
+    unsigned long long zeros, total;
+    long double vmax;
+
+// Get value of bin upper edge
+    long double binUpperEdge(int bin) const;
+
+public:
+
+    DensityHistogram();
+
+// Add value / add other histogram
+    void add(long double v);
+    void merge(const DensityHistogram &other);
+
+// Return value below which given fraction (0..1) of all values lie
+    long double percentile(long double fraction) const;
+
+// Return maximum value and number of values
+    long double maximum() const;
+    unsigned long long count() const;
+
+};
+
+
+// Type of tone curve
+enum ToneCurve {
+    TONE_LINEAR,
+    TONE_LOG,
+    TONE_GAMMA
+};
+
+
+// Mapping of relative model values to colors
+class ToneMap {
+
+    ToneCurve curve;
+    long double gamma;
+    long double decades;
+    long double clip_percentile;
+
+public:
+
+// Linear curve without clipping
+    ToneMap();
+
+// Set / get tone curve
+    void setCurve(ToneCurve c);
+    ToneCurve getCurve() const;
+
+// Set / get exponent of gamma curve
+    bool setGamma(long double g);
+    long double getGamma() const;
+
+// Set / get number of decades shown by logarithmic curve
+    bool setDecades(long double d);
+    long double getDecades() const;
+
+// Set / get percentile (0..100] used as white level, 100 - maximum value
+    bool setClipPercentile(long double p);
+    long double getClipPercentile() const;
+
+// Return value mapped to 1.0 for given histogram of model values
+    long double clipLevel(const DensityHistogram &hist) const;
+
+// Apply tone curve to relative value (0..1)
+    long double apply(long double x) const;
+
+// Build color table, table[i] is 0xRRGGBB color of relative value i/(size-1)
+    void buildColorTable(unsigned int *table, int size, int r, int g, int b) const;
+
+};
+
+
+#endif // TONEMAP_H
@@ -0,0 +1,96 @@
+#include "viewer2d.h"
+
+#include <cmath>
+
+
+Viewer2D::Viewer2D(QWidget *parent) :
+    QLabel(parent),
+// Mouse button is released
+    isLeftMouseButtonPressed(false),
+// Set view to default
+    zoom(1),
+    center_x(0),
+    center_y(0) {
+}
+
+
+// Set view to default
+void Viewer2D::setView2Default() {
+    zoom = 1;
+    center_x = 0; center_y = 0;
+}
+
+
+// Get current magnification
+long double Viewer2D::getZoom() const {
+    return zoom;
+}
+
+
+// Get relative horizontal position of view center
+long double Viewer2D::getCenterX() const {
+    return center_x;
+}
+
+
+// Get relative vertical position of view center
+long double Viewer2D::getCenterY() const {
+    return center_y;
+}
+
+
+// Relative distance between pixels, model radius is half of image diagonal
+long double Viewer2D::pixelSize() const {
+    return 2.0l / sqrt(width()*width() + height()*height());
+}
+
+
+void Viewer2D::mousePressEvent(QMouseEvent *event) {
+    isLeftMouseButtonPressed = event->buttons() & Qt::LeftButton;
+    mouse_pos = event->pos();
+}
+
+
+void Viewer2D::mouseReleaseEvent(QMouseEvent *event) {
+    isLeftMouseButtonPressed = event->buttons() & Qt::LeftButton;
+    mouse_pos = event->pos();
+}
+
+
+void Viewer2D::mouseMoveEvent(QMouseEvent *event) {
+    if (!isLeftMouseButtonPressed)
+        return;
+
+// Move view with the mouse
+    QPoint delta = event->pos();
+    delta -= mouse_pos;
+    mouse_pos = event->pos();
+    center_x -= delta.x() * pixelSize() / zoom;
+    center_y += delta.y() * pixelSize() / zoom;
+
+// Call handler
+    emit viewChanged(zoom, center_x, center_y);
+}
+
+
+void Viewer2D::wheelEvent(QWheelEvent *event) {
+
+// One wheel step changes magnification by 1.25 times
+    long double new_zoom = zoom * pow(1.25l, event->angleDelta().y() / 120.0l);
+    if (new_zoom < MIN_ZOOM)
+        new_zoom = MIN_ZOOM;
+    if (new_zoom > MAX_ZOOM)
+        new_zoom = MAX_ZOOM;
+
+// Point under the cursor stays in place
+    QPoint pos = event->position().toPoint();
+    long double dx = (pos.x() - width()/2) * pixelSize();
+    long double dy = (height()/2 - pos.y()) * pixelSize();
+    center_x += dx / zoom - dx / new_zoom;
+    center_y += dy / zoom - dy / new_zoom;
+    zoom = new_zoom;
+    event->accept();
+
+// Call handler
+    emit viewChanged(zoom, center_x, center_y);
+}
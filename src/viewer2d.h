@@ -0,0 +1,54 @@
+#ifndef VIEWER2D_H
+#define VIEWER2D_H
+
+
+#include <Qt>
+#include <QWidget>
+#include <QLabel>
+#include <QMouseEvent>
+#include <QWheelEvent>
+
+
+class Viewer2D : public QLabel
+{
+    Q_OBJECT
+
+private:
+    bool isLeftMouseButtonPressed;
+    QPoint mouse_pos;
+
+// Magnification and view center, relative to model radius
+    long double zoom;
+    long double center_x, center_y;
+
+// Relative distance between pixels without magnification
+    long double pixelSize() const;
+
+public:
+
+// Limits of magnification
+    static constexpr long double MIN_ZOOM = 0.25l;
+    static constexpr long double MAX_ZOOM = 1e6l;
+
+    explicit Viewer2D(QWidget *parent = nullptr);
+
+// Set view to default
+    void setView2Default();
+
+// Get current magnification and view center
+    long double getZoom() const;
+    long double getCenterX() const;
+    long double getCenterY() const;
+
+signals:
+    void viewChanged(long double zoom, long double center_x, long double center_y);
+
+protected:
+    virtual void mousePressEvent(QMouseEvent *event) override;
+    virtual void mouseReleaseEvent(QMouseEvent *event) override;
+    virtual void mouseMoveEvent(QMouseEvent *event) override;
+    virtual void wheelEvent(QWheelEvent *event) override;
+
+};
+
+#endif // VIEWER2D_H
@@ -11,7 +11,8 @@ Viewer3D::Viewer3D(QWidget *parent) :
     raw_mov_x(0),
     raw_mov_y(0),
     raw_rot_x(0),
-    raw_rot_y(0) {
+    raw_rot_y(0),
+    zoom(1) {
 
 // Set move limits
     raw_mov_x_min = -width();
@@ -31,6 +32,7 @@ Viewer3D::Viewer3D(QWidget *parent) :
 void Viewer3D::setView2Default() {
     raw_mov_x = 0; raw_mov_y = 0;
     raw_rot_x = 0; raw_rot_y = 0;
+    zoom = 1;
 }
 
 
@@ -62,6 +64,12 @@ long double Viewer3D::getRotY() const {
 }
 
 
+// Get current magnification
+long double Viewer3D::getZoom() const {
+    return zoom;
+}
+
+
 void Viewer3D::mousePressEvent(QMouseEvent *event) {
     isLeftMouseButtonPressed = event->buttons() & Qt::LeftButton;
     isRightMouseButtonPressed = event->buttons() & Qt::RightButton;
@@ -91,13 +99,13 @@ void Viewer3D::mouseMoveEvent(QMouseEvent *event) {
 
     if (isLeftMouseButtonPressed) {
     // Process horizontal movement
-        raw_mov_x += dx;
+        raw_mov_x += dx / zoom;
         if (raw_mov_x < raw_mov_x_min)
             raw_mov_x = raw_mov_x_min;
         if (raw_mov_x > raw_mov_x_max)
             raw_mov_x = raw_mov_x_max;
      // Process vertical movement
-        raw_mov_y += dy;
+        raw_mov_y += dy / zoom;
         if (raw_mov_y < raw_mov_y_min)
             raw_mov_y = raw_mov_y_min;
         if (raw_mov_y > raw_mov_y_max)
@@ -120,3 +128,18 @@ void Viewer3D::mouseMoveEvent(QMouseEvent *event) {
 // Call handler
     emit viewChanged(getMovX(), getMovY(), getRotX(), getRotY());
 }
+
+
+void Viewer3D::wheelEvent(QWheelEvent *event) {
+
+// One wheel step changes magnification by 1.25 times
+    zoom *= pow(1.25l, event->angleDelta().y() / 120.0l);
+    if (zoom < MIN_ZOOM)
+        zoom = MIN_ZOOM;
+    if (zoom > MAX_ZOOM)
+        zoom = MAX_ZOOM;
+    event->accept();
+
+// Call handler
+    emit viewChanged(getMovX(), getMovY(), getRotX(), getRotY());
+}
@@ -6,6 +6,7 @@
 #include <QWidget>
 #include <QLabel>
 #include <QMouseEvent>
+#include <QWheelEvent>
 
 
 class Viewer3D : public QLabel
@@ -17,12 +18,21 @@ private:
     bool isRightMouseButtonPressed;
     QPoint mouse_pos;
 
-    int raw_mov_x, raw_mov_x_min, raw_mov_x_max;
-    int raw_mov_y, raw_mov_y_min, raw_mov_y_max;
+    long double raw_mov_x, raw_mov_y;
+    int raw_mov_x_min, raw_mov_x_max;
+    int raw_mov_y_min, raw_mov_y_max;
     int raw_rot_x, raw_rot_x_min, raw_rot_x_max;
     int raw_rot_y, raw_rot_y_min, raw_rot_y_max;
 
+// Magnification, movement by mouse is divided by it
+    long double zoom;
+
 public:
+
+// Limits of magnification
+    static constexpr long double MIN_ZOOM = 0.25l;
+    static constexpr long double MAX_ZOOM = 1e6l;
+
     explicit Viewer3D(QWidget *parent = nullptr);
 
 // Set view to default
@@ -33,6 +43,7 @@ public:
     long double getMovY() const;
     long double getRotX() const;
     long double getRotY() const;
+    long double getZoom() const;
 
 signals:
     void viewChanged(long double mov_x, long double mov_y, long double rot_x, long double rot_y);
@@ -41,6 +52,7 @@ protected:
     virtual void mousePressEvent(QMouseEvent *event) override;
     virtual void mouseReleaseEvent(QMouseEvent *event) override;
     virtual void mouseMoveEvent(QMouseEvent *event) override;
+    virtual void wheelEvent(QWheelEvent *event) override;
 
 };
 
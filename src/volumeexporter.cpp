@@ -0,0 +1,219 @@
+#include "volumeexporter.h"
+#include "atommodel.h"
+#include "imagewriter.h"
+#include "parallel.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+
+VolumeGrid::VolumeGrid(int size, double radius) :
+    nx(size),
+    ny(size),
+    nz(size),
+    x0(-radius),
+    y0(-radius),
+    z0(-radius),
+    spacing(2 * radius / (size - 1)) {
+}
+
+
+VolumeExporter::VolumeExporter(AtomModel &_model, const VolumeGrid &_grid, VolumeSample _sample) :
+    model(_model),
+    grid(_grid),
+    sample(_sample)
+{
+    size_t plane = (size_t)grid.nx * grid.ny * sampleSize();
+    slab_planes = std::max(1, std::min(grid.nz, (int)(SLAB_BYTES / plane)));
+}
+
+
+size_t VolumeExporter::sampleSize() const
+{
+    return (sample == SAMPLE_FLOAT16) ? 2 : 4;
+}
+
+
+int VolumeExporter::slabPlanes() const
+{
+    return slab_planes;
+}
+
+
+size_t VolumeExporter::volumeSize() const
+{
+    return (size_t)grid.nx * grid.ny * grid.nz * sampleSize();
+}
+
+
+// Compute slabs and pass them to writer
+bool VolumeExporter::stream(const std::function<bool(const void *data, size_t size, int planes)> &writer)
+{
+// Tables are built before rows are sampled in parallel
+    double cutoff = model.densityCutoffRadius();
+    size_t row_bytes = (size_t)grid.nx * sampleSize();
+    std::vector<unsigned char> slabs[2];
+    std::vector<std::vector<float>> rows(TileScheduler::threadCount(), std::vector<float>(grid.nx));
+    std::thread writing;
+    bool written = true;
+
+    for (int z=0, slab=0; z<grid.nz; z+=slab_planes, slab++) {
+        int planes = std::min(slab_planes, grid.nz - z);
+        std::vector<unsigned char> &data = slabs[slab % 2];
+        data.resize(row_bytes * grid.ny * planes);
+        TileScheduler::forEach(planes * grid.ny, [&](int index, int worker) {
+            double y = grid.y0 + (index % grid.ny) * grid.spacing;
+            double zk = grid.z0 + (z + index / grid.ny) * grid.spacing;
+            unsigned char *out = &data[index * row_bytes];
+        // Rows which don't cross the cutoff sphere are empty
+            if (y*y + zk*zk > cutoff*cutoff) {
+                memset(out, 0, row_bytes);
+                return;
+            }
+            float *row = rows[worker].data();
+            model.modelBox(row, grid.nx, 1, 1, grid.x0, y, zk, grid.spacing);
+            if (sample == SAMPLE_FLOAT32) {
+                memcpy(out, row, row_bytes);
+                return;
+            }
+            uint16_t *half = (uint16_t *)out;
+            for (int i=0; i<grid.nx; i++)
+                half[i] = toHalf(row[i]);
+        });
+
+    // Previous slab has to be written before its buffer is reused
+        if (writing.joinable())
+            writing.join();
+        if (!written)
+            return false;
+        writing = std::thread([&written, &writer, &data, planes]() {
+            written = writer(data.data(), data.size(), planes);
+        });
+    }
+    if (writing.joinable())
+        writing.join();
+    return written;
+}
+
+
+// Write volume file
+bool VolumeExporter::write(FILE *file, VolumeFormat format, const std::function<void(int planes)> &progress)
+{
+    if (format != VOLUME_RAW && sample != SAMPLE_FLOAT32)
+        return false;
+    const char *order = ImageWriter::littleEndian() ? "little" : "big";
+    char text[2048];
+    std::string head, tail;
+
+// VTK ImageData: XML header, then raw appended data after '_', starting with 64-bit byte count
+    if (format == VOLUME_VTI) {
+        snprintf(text, sizeof(text),
+                 "<?xml version=\"1.0\"?>\n"
+                 "<VTKFile type=\"ImageData\" version=\"1.0\" byte_order=\"%s\" header_type=\"UInt64\">\n"
+                 "  <ImageData WholeExtent=\"0 %d 0 %d 0 %d\" Origin=\"%.17g %.17g %.17g\" Spacing=\"%.17g %.17g %.17g\">\n"
+                 "    <Piece Extent=\"0 %d 0 %d 0 %d\">\n"
+                 "      <PointData Scalars=\"density\">\n"
+                 "        <DataArray type=\"Float32\" Name=\"density\" format=\"appended\" offset=\"0\"/>\n"
+                 "      </PointData>\n"
+                 "    </Piece>\n"
+                 "  </ImageData>\n"
+                 "  <AppendedData encoding=\"raw\">\n"
+                 "   _",
+                 ImageWriter::littleEndian() ? "LittleEndian" : "BigEndian", grid.nx - 1, grid.ny - 1, grid.nz - 1,
+                 grid.x0, grid.y0, grid.z0, grid.spacing, grid.spacing, grid.spacing, grid.nx - 1, grid.ny - 1, grid.nz - 1);
+        head = text;
+        uint64_t size = volumeSize();
+        head.append((const char *)&size, sizeof(size));
+        tail = "\n  </AppendedData>\n</VTKFile>\n";
+    }
+
+// NRRD: text header ends with empty line, then raw data
+    if (format == VOLUME_NRRD) {
+        snprintf(text, sizeof(text),
+                 "NRRD0004\n"
+                 "# probability density |psi|^2 of state n=%d l=%d m=%d, relative to its maximum\n"
+                 "type: float\n"
+                 "dimension: 3\n"
+                 "space dimension: 3\n"
+                 "sizes: %d %d %d\n"
+                 "space directions: (%.17g,0,0) (0,%.17g,0) (0,0,%.17g)\n"
+                 "space origin: (%.17g,%.17g,%.17g)\n"
+                 "space units: \"bohr\" \"bohr\" \"bohr\"\n"
+                 "endian: %s\n"
+                 "encoding: raw\n"
+                 "\n",
+                 model.get_n(), model.get_l(), model.get_m(), grid.nx, grid.ny, grid.nz,
+                 grid.spacing, grid.spacing, grid.spacing, grid.x0, grid.y0, grid.z0, order);
+        head = text;
+    }
+
+    if (fwrite(head.data(), 1, head.size(), file) != head.size())
+        return false;
+    bool ok = stream([&](const void *data, size_t size, int planes) {
+        if (progress)
+            progress(planes);
+        return fwrite(data, 1, size, file) == size;
+    });
+    return ok && fwrite(tail.data(), 1, tail.size(), file) == tail.size();
+}
+
+
+// Get sidecar header of raw volume file
+std::string VolumeExporter::header(const std::string &data_file) const
+{
+    bool little = ImageWriter::littleEndian();
+    char text[1024];
+    snprintf(text, sizeof(text),
+             "{\n"
+             "  \"data\": \"%s\",\n"
+             "  \"type\": \"%s\",\n"
+             "  \"endian\": \"%s\",\n"
+             "  \"dimensions\": [%d, %d, %d],\n"
+             "  \"order\": \"x fastest, then y, then z\",\n"
+             "  \"origin\": [%.17g, %.17g, %.17g],\n"
+             "  \"spacing\": [%.17g, %.17g, %.17g],\n"
+             "  \"units\": \"bohr\",\n"
+             "  \"state\": {\"n\": %d, \"l\": %d, \"m\": %d},\n"
+             "  \"value\": \"probability density |psi|^2, relative to its maximum\"\n"
+             "}\n",
+             data_file.c_str(), (sample == SAMPLE_FLOAT16) ? "float16" : "float32", little ? "little" : "big",
+             grid.nx, grid.ny, grid.nz, grid.x0, grid.y0, grid.z0, grid.spacing, grid.spacing, grid.spacing,
+             model.get_n(), model.get_l(), model.get_m());
+    return text;
+}
+
+
+// Convert float to half precision float
+uint16_t VolumeExporter::toHalf(float value)
+{
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    uint16_t sign = (bits >> 16) & 0x8000;
+    int exponent = (int)((bits >> 23) & 0xFF) - 127 + 15;
+    uint32_t mantissa = bits & 0x7FFFFF;
+
+// Infinity and NaN, overflow gives infinity
+    if (((bits >> 23) & 0xFF) == 0xFF)
+        return sign | 0x7C00 | (mantissa ? 0x200 : 0);
+    if (exponent >= 31)
+        return sign | 0x7C00;
+
+// Subnormal half, rounding may carry into exponent, which gives correct result
+    if (exponent <= 0) {
+        if (exponent < -10)
+            return sign;
+        mantissa |= 0x800000;
+        int shift = 14 - exponent;
+        uint32_t half = mantissa >> shift, rest = mantissa & ((1u << shift) - 1), halfway = 1u << (shift - 1);
+        if (rest > halfway || (rest == halfway && (half & 1)))
+            half++;
+        return sign | half;
+    }
+    uint32_t half = ((uint32_t)exponent << 10) | (mantissa >> 13), rest = mantissa & 0x1FFF;
+    if (rest > 0x1000 || (rest == 0x1000 && (half & 1)))
+        half++;
+    return sign | half;
+}
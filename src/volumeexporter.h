@@ -0,0 +1,81 @@
+#ifndef VOLUMEEXPORTER_H
+#define VOLUMEEXPORTER_H
+
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <functional>
+#include <string>
+
+
+class AtomModel;
+
+
+// Type of exported samples
+enum VolumeSample {
+    SAMPLE_FLOAT32,
+    SAMPLE_FLOAT16
+};
+
+
+// Format of volume file: raw samples (with sidecar header), VTK ImageData with binary appended data
+// or NRRD with attached header. VTK and NRRD files have float32 samples
+enum VolumeFormat {
+    VOLUME_RAW,
+    VOLUME_VTI,
+    VOLUME_NRRD
+};
+
+
+// Grid of nx*ny*nz nodes (x0 + i*spacing, y0 + j*spacing, z0 + k*spacing), Bohr radii
+struct VolumeGrid {
+    int nx, ny, nz;
+    double x0, y0, z0, spacing;
+
+// Cube grid of size^3 nodes over [-radius, radius]^3
+    VolumeGrid(int size = 2, double radius = 1);
+};
+
+
+// Export of probability density, relative to its maximum, sampled at grid of any size. Volume is computed
+// by slabs of z planes in parallel, and every slab is passed to writer while the next one is computed,
+// so at most two slabs are in memory
+class VolumeExporter {
+
+    AtomModel &model;
+    VolumeGrid grid;
+    VolumeSample sample;
+    int slab_planes;
+
+public:
+
+// Bytes of slab, slab has at least one plane, and maximum grid size, plane of which takes 16 MB of float32
+    static const size_t SLAB_BYTES = 32 << 20;
+    static const int MAX_GRID_SIZE = 2048;
+
+    VolumeExporter(AtomModel &model, const VolumeGrid &grid, VolumeSample sample = SAMPLE_FLOAT32);
+
+// Bytes of sample, planes of slab and bytes of whole volume
+    size_t sampleSize() const;
+    int slabPlanes() const;
+    size_t volumeSize() const;
+
+// Compute slabs in z order, x index changes fastest, samples have native byte order. Writer gets slab data,
+// its size and number of planes, and is called by another thread. False if writer failed
+    bool stream(const std::function<bool(const void *data, size_t size, int planes)> &writer);
+
+// Write volume file to opened file: header, slabs as they are computed, footer. Slabs are written
+// from buffers they are computed in. Progress gets number of planes of every written slab
+    bool write(FILE *file, VolumeFormat format, const std::function<void(int planes)> &progress = nullptr);
+
+// Sidecar header of raw volume file (JSON): grid, spacing in Bohr radii, sample type and state
+    std::string header(const std::string &data_file) const;
+
+// Convert float to half precision float, rounded to nearest even
+    static uint16_t toHalf(float value);
+
+};
+
+
+#endif // VOLUMEEXPORTER_H
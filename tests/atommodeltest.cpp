@@ -0,0 +1,54 @@
+#include "atommodel.h"
+#include "framecache.h"
+#include "tests.h"
+
+#include <vector>
+
+
+// Revisions change only when a setter really changes factor they belong to: n and l change radial factor,
+// l and m angular factor, invalid and repeated values change nothing
+void test_revisions()
+{
+    AtomModel model;
+    model.set_n(3);
+    unsigned long radial = model.getRadialRevision(), angular = model.getAngularRevision(), mode = model.getModeRevision();
+    CHECK(model.set_n(3));
+    model.setProbabilityDensityStatus(model.isProbabilityDensity());
+    CHECK(!model.set_l(3));
+    CHECK(model.getRadialRevision() == radial && model.getAngularRevision() == angular && model.getModeRevision() == mode);
+
+    CHECK(model.set_l(1));
+    CHECK(model.getRadialRevision() != radial && model.getAngularRevision() != angular);
+    radial = model.getRadialRevision();
+    angular = model.getAngularRevision();
+    CHECK(model.set_m(-1));
+    CHECK(model.getRadialRevision() == radial && model.getAngularRevision() != angular);
+    angular = model.getAngularRevision();
+    CHECK(model.set_n(4));
+    CHECK(model.getRadialRevision() != radial && model.getAngularRevision() == angular && model.getModeRevision() == mode);
+    model.setProbabilityDensityStatus(!model.isProbabilityDensity());
+    CHECK(model.getModeRevision() != mode);
+}
+
+
+// States m and -m have the same canonical state, angular revision, frame keys and probability density
+void test_canonical_state()
+{
+    CHECK(QuantumState(3, 2, -1) == QuantumState(3, 2, 1) && QuantumState(3, 2, 1) != QuantumState(3, 2, 2));
+    AtomModel model;
+    model.set_n(3);
+    model.set_l(2);
+    model.set_m(1);
+    unsigned long angular = model.getAngularRevision();
+    FrameKey key(model, FRAME_2D, 32, 32);
+    std::vector<long double> plus(32 * 32), minus(32 * 32);
+    model.model2D(plus.data(), 32, 32);
+
+    CHECK(model.set_m(-1));
+    CHECK(model.get_m() == -1 && model.canonicalState() == QuantumState(3, 2, 1));
+    CHECK(model.getAngularRevision() == angular);
+    FrameKey mirrored(model, FRAME_2D, 32, 32);
+    CHECK(!(key < mirrored) && !(mirrored < key));
+    model.model2D(minus.data(), 32, 32);
+    CHECK(plus == minus);
+}
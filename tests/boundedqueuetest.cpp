@@ -0,0 +1,69 @@
+#include "boundedqueue.h"
+#include "encodepipeline.h"
+#include "tests.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifndef _WIN32
+#include <unistd.h>
+#endif
+
+
+// Producer waits while queue is full, closed queue refuses items and is drained by consumers,
+// encoders write all submitted images before finish returns
+void test_bounded_queue()
+{
+    BoundedQueue<int> queue(2);
+    CHECK(queue.push(1) && queue.push(2));
+    std::atomic<bool> pushed(false);
+    std::thread producer([&] {
+        queue.push(3);
+        pushed = true;
+    });
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    CHECK(!pushed);
+    int item = 0;
+    CHECK(queue.pop(item) && item == 1);
+    producer.join();
+    CHECK(pushed);
+
+    std::vector<int> batch;
+    CHECK(queue.popAll(batch) && batch.size() == 2 && batch[0] == 2 && batch[1] == 3);
+    CHECK(queue.push(4));
+    queue.close();
+    CHECK(!queue.push(5));
+    CHECK(queue.pop(item) && item == 4);
+    CHECK(!queue.pop(item) && !queue.popAll(batch));
+
+// Producer waiting on full queue is released by close
+    BoundedQueue<int> full(1);
+    full.push(1);
+    std::atomic<int> result(-1);
+    std::thread waiting([&] { result = full.push(2) ? 1 : 0; });
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    full.close();
+    waiting.join();
+    CHECK(result == 0);
+
+#ifndef _WIN32
+    std::string prefix = "/tmp/simulatom-tests-" + std::to_string(getpid()) + "-";
+    std::atomic<int> written(0);
+    EncodePipeline pipeline(2, 2);
+    for (int i=0; i<8; i++) {
+        EncodeJob job = {std::vector<unsigned int>(4 * 4, 0xFF00FF00u), 4, 4, IMAGE_QOI, prefix + std::to_string(i) + ".qoi",
+                         [&](bool ok) { written += ok; }};
+        CHECK(pipeline.submit(std::move(job)));
+    }
+    pipeline.finish();
+    CHECK(written == 8);
+    EncodeJob late = {std::vector<unsigned int>(1), 1, 1, IMAGE_QOI, prefix + "late.qoi", nullptr};
+    CHECK(!pipeline.submit(std::move(late)));
+    for (int i=0; i<8; i++)
+        CHECK(remove((prefix + std::to_string(i) + ".qoi").c_str()) == 0);
+#endif
+}
@@ -0,0 +1,49 @@
+#include "cacheaccountant.h"
+#include "tests.h"
+
+#include <memory>
+#include <vector>
+
+
+// Entries over budget are evicted by their callbacks: least recently used ones, or the cheapest per byte
+// with cost policy. Pinned entries stay, callbacks of destroyed caches are skipped
+void test_cache_accountant()
+{
+    std::shared_ptr<CacheGuard> guard(new CacheGuard());
+    std::vector<uint64_t> evicted;
+    auto evictor = [&](uint64_t id) { evicted.push_back(id); };
+
+    CacheAccountant lru(300);
+    CHECK(lru.getBudget() == 300 && lru.getPolicy() == EVICT_LRU);
+    uint64_t a = lru.add(CACHE_FRAMES, 100, 1, guard, evictor);
+    uint64_t b = lru.add(CACHE_FRAMES, 100, 1, guard, evictor);
+    uint64_t pinned = lru.add(CACHE_TABLES, 100, 1, guard, nullptr);
+    lru.hit(a);
+    uint64_t c = lru.add(CACHE_MESHES, 100, 1, guard, evictor);
+    CHECK(evicted.size() == 1 && evicted[0] == b);
+    CHECK(lru.total().bytes == 300 && lru.stats(CACHE_FRAMES).entries == 1 && lru.stats(CACHE_FRAMES).hits == 1);
+    lru.resize(c, 200);
+    CHECK(evicted.size() == 2 && evicted[1] == a && lru.stats(CACHE_TABLES).entries == 1);
+    lru.remove(pinned);
+    lru.remove(12345);
+    CHECK(lru.total().bytes == 200 && lru.total().evictions == 2);
+
+    evicted.clear();
+    CacheAccountant cost(300);
+    cost.setPolicy(EVICT_COST);
+    uint64_t expensive = cost.add(CACHE_VOLUMES, 100, 1000, guard, evictor);
+    uint64_t cheap = cost.add(CACHE_FRAMES, 100, 1, guard, evictor);
+    cost.add(CACHE_FRAMES, 100, 10, guard, evictor);
+    cost.hit(cheap);
+    cost.add(CACHE_FRAMES, 100, 10, guard, evictor);
+    CHECK(evicted.size() == 1 && evicted[0] == cheap);
+    CHECK(cost.stats(CACHE_VOLUMES).entries == 1 && cost.stats(CACHE_VOLUMES).compute_ms == 1000);
+    cost.hit(expensive);
+    CHECK(cost.stats(CACHE_VOLUMES).saved_ms == 1000);
+
+// Entries of destroyed cache are evicted without callbacks
+    evicted.clear();
+    guard->alive = false;
+    cost.setBudget(100);
+    CHECK(evicted.empty() && cost.total().bytes <= 100);
+}
@@ -0,0 +1,48 @@
+#include "camerapath.h"
+#include "tests.h"
+
+#include <climits>
+#include <cmath>
+
+
+// Keyframes of camera path: interpolation, states, comments and malformed lines
+void test_camera_path()
+{
+    CameraPath path;
+    CHECK(path.parse("# orbit\n"
+                     "0 0 0 0 0\n"
+                     "\n"
+                     "10 1 -2 0.5 1 3   # closer\n"
+                     "20 1 -2 0.5 1 3 3 2 -1\r\n"));
+    CHECK(path.frameCount() == 21);
+
+    View3D view;
+    path.camera(5, view);
+    CHECK(fabsl(view.mov_x - 0.5) < 1e-12 && fabsl(view.mov_y + 1) < 1e-12 && fabsl(view.zoom - 2) < 1e-12);
+    path.camera(30, view);
+    CHECK(fabsl(view.rot_x - 0.5) < 1e-12 && fabsl(view.zoom - 3) < 1e-12);
+
+    QuantumState initial(2, 1, 0);
+    CHECK(path.state(19, initial) == initial);
+    CHECK(path.state(20, initial) == QuantumState(3, 2, 1));
+
+    CHECK(!path.parse(""));
+    CHECK(!path.parse("0 0 0 0\n"));
+    CHECK(!path.parse("0 0 0 0 0 1 1\n"));
+    CHECK(!path.parse("0 0 0 0 0 x\n"));
+    CHECK(!path.parse("5 0 0 0 0\n5 0 0 0 0\n"));
+    CHECK(!path.parse("0 0 0 0 0 0\n"));
+    CHECK(!path.parse("0 0 0 0 0 1 2 2 0\n"));
+    CHECK(!path.parse("0 0 0 0 0 1 11 0 0\n"));
+
+// Values are finite, frames and states are integers in range
+    CHECK(!path.parse("0 nan 0 0 0\n"));
+    CHECK(!path.parse("0 0 0 0 0 inf\n"));
+    CHECK(!path.parse("1.5 0 0 0 0\n"));
+    CHECK(!path.parse("4294967296 0 0 0 0\n"));
+    CHECK(!path.parse("1e30 0 0 0 0\n"));
+    CHECK(!path.parse("0 0 0 0 0 1 2.5 1 0\n"));
+    CHECK(!path.parse("0 0 0 0 0 1 1e20 0 0\n"));
+    CHECK(!path.parse("2147483647 0 0 0 0\n"));
+    CHECK(path.parse("2147483646 0 0 0 0\n") && path.frameCount() == INT_MAX);
+}
@@ -0,0 +1,60 @@
+#include "atommodel.h"
+#include "densityoctree.h"
+#include "tests.h"
+
+#include <cmath>
+#include <vector>
+
+
+// Leaves above the depth limit interpolate density at their 3x3x3 lattice within tolerance, and within twice
+// tolerance between its nodes, rays visit leaves in order without gaps
+void test_density_octree()
+{
+    const double tolerance = 2e-3;
+    const int depth_limit = 7;
+    const int states[][3] = {{1, 0, 0}, {2, 1, 0}, {3, 2, 1}, {4, 1, 1}};
+    for (auto &s : states) {
+        AtomModel model;
+        model.set_n(s[0]);
+        model.set_l(s[1]);
+        model.set_m(s[2]);
+        DensityOctree tree(model, tolerance, depth_limit);
+        double radius = tree.getRadius(), smallest = 2 * radius / (1 << depth_limit);
+        CHECK(tree.getTolerance() == tolerance && tree.getDepth() <= depth_limit && tree.leafCount() > 0);
+
+    // Box nodes are off the octree lattice
+        const int size = 25;
+        double step = 2 * radius / size, x0 = -radius + step * 0.37;
+        std::vector<float> box(size * size * size);
+        model.modelBox(box.data(), size, size, size, x0, x0, x0, step);
+        double node_error = 0, error = 0;
+        for (int k=0; k<size; k++)
+            for (int j=0; j<size; j++)
+                for (int i=0; i<size; i++) {
+                    double x = x0 + i * step, y = x0 + j * step, z = x0 + k * step;
+                    DensityOctree::Leaf leaf;
+                    if (!tree.find(x, y, z, leaf) || leaf.size < smallest * 1.5)
+                        continue;
+                    error = fmax(error, fabs(tree.sample(x, y, z) - box[(k * size + j) * size + i]));
+                    float lattice[27];
+                    model.modelBox(lattice, 3, 3, 3, leaf.x0, leaf.y0, leaf.z0, leaf.size / 2);
+                    for (int n=0; n<27; n++)
+                        node_error = fmax(node_error, fabs(leaf.sample(leaf.x0 + n % 3 * leaf.size / 2, leaf.y0 + n / 3 % 3 * leaf.size / 2,
+                                                                       leaf.z0 + n / 9 * leaf.size / 2) - lattice[n]));
+                }
+        CHECK(node_error <= tolerance * 1.001);
+        CHECK(error <= tolerance * 2);
+    }
+
+    AtomModel model;
+    DensityOctree tree(model);
+    double r = tree.getRadius(), t_last = 0;
+    bool ordered = true;
+    tree.traceRay(-r, 0.1, 0.2, 1, 0, 0, 0, 2 * r, [&](const DensityOctree::Leaf &, double t_in, double t_out) {
+        ordered = ordered && fabs(t_in - t_last) < 1e-5 * r && t_out > t_in;
+        t_last = t_out;
+        return true;
+    });
+    CHECK(ordered && fabs(t_last - 2 * r) < 1e-5 * r);
+    CHECK(tree.sample(2 * r, 0, 0) == 0);
+}
@@ -0,0 +1,41 @@
+#include "atommodel.h"
+#include "densitypyramid.h"
+#include "tests.h"
+
+#include <cmath>
+#include <vector>
+
+
+// Levels halve node spacing, unzoomed frame of pyramid matches 2D model, tiles over budget are removed
+// except ones of current frame
+void test_density_pyramid()
+{
+    AtomModel model;
+    model.set_n(3);
+    model.set_l(1);
+    DensityPyramid pyramid(model, 1 << 20);
+    CHECK(pyramid.getState() == model.canonicalState() && pyramid.tileCount() == 0);
+    CHECK(fabs(pyramid.levelSpacing(0) - 2 * pyramid.getRadius() / DensityPyramid::TILE) < 1e-12);
+    CHECK(fabs(pyramid.levelSpacing(3) * 8 - pyramid.levelSpacing(0)) < 1e-12);
+    CHECK(pyramid.levelForSpacing(pyramid.levelSpacing(4) * 1.1) == 4);
+    CHECK(pyramid.levelForSpacing(pyramid.levelSpacing(0) * 4) == 0);
+
+// Frame of the same extent as 2D model
+    const int size = 128;
+    std::vector<long double> direct(size * size), tiled(size * size);
+    model.model2D(direct.data(), size, size);
+    long double radius = model.maxRelativeRadius();
+    pyramid.render(model, tiled.data(), size, size, 0, 0, radius * 2 / sqrt(2.0 * size * size));
+    CHECK(pyramid.tileCount() > 0 && pyramid.memoryUsage() > 0);
+    long double error = 0, mean = 0;
+    for (int i=0; i<size*size; i++) {
+        error += fabsl(direct[i] - tiled[i]);
+        mean += direct[i];
+    }
+    CHECK(mean > 0 && error < 0.05l * mean);
+
+// Zoomed frames at other places stay within budget
+    for (int i=0; i<8; i++)
+        pyramid.render(model, tiled.data(), size, size, i * 2.0 - 8, i * 1.5 - 6, 0.01);
+    CHECK(pyramid.memoryUsage() <= (1 << 20) + (size_t)16 * DensityPyramid::TILE * DensityPyramid::TILE * sizeof(float));
+}
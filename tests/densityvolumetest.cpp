@@ -0,0 +1,34 @@
+#include "atommodel.h"
+#include "densityvolume.h"
+#include "tests.h"
+
+#include <cmath>
+
+
+// Voxel volume of 1s follows relative density exp(-2r), bricks outside of the cutoff sphere are dropped,
+// coarser level and volume over external memory give the same values
+void test_density_volume()
+{
+    AtomModel model;
+    DensityVolume volume(model, 60);
+    CHECK(volume.gridSize() == 64);
+    CHECK(volume.storedBricks() > 0 && (int)volume.storedBricks() == DensityVolume::countBricks(64));
+    CHECK(volume.storedBricks() < DensityVolume::indexSize(64));
+    double error = 0, cubic_error = 0;
+    for (double r=0.5; r<3; r+=0.25) {
+        double exact = exp(-2 * r);
+        error = fmax(error, fabs(volume.sampleTrilinear(r * 0.6, r * 0.8, 0) - exact));
+        cubic_error = fmax(cubic_error, fabs(volume.sampleTricubic(0, r * 0.8, -r * 0.6) - exact));
+    }
+    CHECK(error < 0.02 && cubic_error < 0.02);
+    CHECK(volume.sampleTrilinear(volume.getRadius() * 2, 0, 0) == 0);
+
+    DensityVolume coarse(volume, 32);
+    CHECK(coarse.gridSize() == 32 && coarse.getRadius() == volume.getRadius());
+    CHECK(fabs(coarse.sampleTrilinear(1, 0, 0) - exp(-2.0)) < 0.05);
+    DensityVolume external(volume.gridSize(), volume.getRadius(), volume.brickIndex(), volume.brickData(), nullptr);
+    CHECK(external.sampleTrilinear(0.3, -0.7, 1.1) == volume.sampleTrilinear(0.3, -0.7, 1.1));
+
+    int small = DensityVolume::sizeForBudget(1 << 20), large = DensityVolume::sizeForBudget(1u << 31);
+    CHECK(small >= 8 && small <= large && large <= DensityVolume::MAX_SIZE);
+}
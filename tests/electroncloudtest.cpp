@@ -0,0 +1,42 @@
+#include "electroncloud.h"
+#include "parallel.h"
+#include "tests.h"
+
+#include <cmath>
+#include <cstring>
+
+
+// Cloud samples probability density: <r> = 3/2 for 1s, <cos^2(theta)> = 3/5 for 2p0.
+// Positions depend on seed only, not on number of threads
+void test_electron_cloud()
+{
+    const int points = 200000;
+    AtomModel model;
+    ElectronCloud s(model, points);
+    CHECK(s.pointCount() == points);
+    double mean_radius = 0;
+    for (int i=0; i<points; i++) {
+        const float *p = s.data() + i * 3;
+        mean_radius += sqrt(p[0]*p[0] + p[1]*p[1] + p[2]*p[2]) / points;
+    }
+    CHECK(fabs(mean_radius - 1.5) < 0.02);
+
+    model.set_n(2);
+    model.set_l(1);
+    ElectronCloud p(model, points);
+    double z2 = 0, r2 = 0;
+    for (int i=0; i<points; i++) {
+        const float *q = p.data() + i * 3;
+        z2 += q[2] * q[2];
+        r2 += q[0]*q[0] + q[1]*q[1] + q[2]*q[2];
+    }
+    CHECK(fabs(z2 / r2 - 0.6) < 0.01);
+
+    int threads = TileScheduler::threadCount();
+    TileScheduler::setThreadCount(1);
+    ElectronCloud single(model, points);
+    TileScheduler::setThreadCount(threads);
+    CHECK(memcmp(single.data(), p.data(), points * 3 * sizeof(float)) == 0);
+    ElectronCloud other(model, points, 2);
+    CHECK(memcmp(other.data(), p.data(), points * 3 * sizeof(float)) != 0);
+}
@@ -0,0 +1,39 @@
+#include "atommodel.h"
+#include "emptyspace.h"
+#include "tests.h"
+
+#include <cmath>
+#include <vector>
+
+
+// Runs of negligible table values: radial ones are shells and the tail, angular ones are cones.
+// Points in them are empty and can be skipped, points of the model's density beyond the cutoff are empty
+void test_empty_space()
+{
+// Radial values over [0, 10] vanish on [4, 5] and beyond 9, angular ones around cos(theta) = 0
+    std::vector<double> radial(101, 1), angular(201, 1);
+    for (int i=40; i<=50; i++)
+        radial[i] = 0;
+    for (int i=90; i<=100; i++)
+        radial[i] = 1e-9;
+    for (int i=90; i<=110; i++)
+        angular[i] = 0;
+    EmptySpaceMap map;
+    map.build(radial.data(), (int)radial.size(), 10, angular.data(), (int)angular.size(), 1e-7);
+    CHECK(map.shellCount() == 1 && map.coneCount() == 1);
+    CHECK(fabs(map.cutoffRadius() - 9) < 1e-9);
+    CHECK(map.isEmptySpherical(4.5, 0.9) && map.isEmptySpherical(9.5, 0.9) && map.isEmptySpherical(2, 0));
+    CHECK(!map.isEmptySpherical(2, 0.9) && !map.isEmptySpherical(6, -0.5));
+    CHECK(map.isEmpty(2, 0, 0) && !map.isEmpty(0, 0, 2));
+    CHECK(map.skipDistance(0, 0, 2) == 0);
+    double skip = map.skipDistance(4.5, 0, 0);
+    CHECK(skip > 0 && skip <= 0.5);
+
+// Model's density vanishes at the nucleus for l > 0 and beyond the cutoff
+    AtomModel model;
+    model.set_n(3);
+    model.set_l(1);
+    const EmptySpaceMap &p = model.getEmptySpaceMap();
+    CHECK(p.shellCount() == 1 && p.cutoffRadius() > 12);
+    CHECK(p.isEmptySpherical(0, 1) && p.isEmptySpherical(p.cutoffRadius() * 1.01, 1) && !p.isEmptySpherical(3, 1));
+}
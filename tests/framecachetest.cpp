@@ -0,0 +1,41 @@
+#include "framecache.h"
+#include "tests.h"
+
+#include <vector>
+
+
+// Keys are equal when state, type, size and view are; cache evicts least recently used frames over budget
+void test_frame_cache()
+{
+    AtomModel model;
+    model.set_n(3);
+    model.set_l(1);
+    FrameKey a(model, FRAME_2D, 100, 100), same(model, FRAME_2D, 100, 100), wide(model, FRAME_2D, 200, 100);
+    CHECK(!(a < same) && !(same < a));
+    CHECK((a < wide) != (wide < a));
+    FrameKey moved = same;
+    moved.setView(0.5l, 0, 0, 0);
+    CHECK(a < moved || moved < a);
+    model.setProbabilityDensityStatus(!model.isProbabilityDensity());
+    FrameKey density(model, FRAME_2D, 100, 100);
+    CHECK(a < density || density < a);
+
+// Budget holds two frames of 1000 values
+    FrameCache cache(40000);
+    std::shared_ptr<const std::vector<long double>> frame(new std::vector<long double>(1000, 1));
+    CHECK(!cache.get(a));
+    cache.put(a, frame);
+    cache.put(wide, frame);
+    CHECK(cache.get(a) == frame);
+    cache.put(moved, frame);
+    CHECK(cache.contains(a) && !cache.contains(wide) && cache.contains(moved));
+    cache.put(density, std::shared_ptr<const std::vector<long double>>(new std::vector<long double>(5000)));
+    CHECK(!cache.contains(density));
+
+    FrameCacheStats stats = cache.stats();
+    CHECK(stats.hits == 1 && stats.misses == 1 && stats.evictions == 1 && stats.entries == 2 && stats.bytes <= 40000);
+    cache.setBudget(20000);
+    CHECK(cache.stats().entries == 1 && cache.contains(moved));
+    cache.clear();
+    CHECK(!cache.contains(moved) && cache.stats().bytes == 0);
+}
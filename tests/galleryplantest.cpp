@@ -0,0 +1,41 @@
+#include "galleryplan.h"
+#include "tests.h"
+
+#include <string>
+#include <vector>
+
+
+// Gallery has every state with m >= 0 once per model type and view, models on disk are skipped and listed
+// in manifest, the largest states are rendered first
+void test_gallery()
+{
+    std::vector<std::string> views = {"2d", "slice"};
+    std::vector<GalleryItem> items = GalleryPlan::items(3, views, "png");
+    CHECK(items.size() == 10 * 2 * 2);
+    CHECK(items[0].file == "n1-l0-m0-probability-2d.png" && items[3].file == "n1-l0-m0-density-slice.png");
+    bool m_positive = true;
+    for (auto &item : items)
+        m_positive = m_positive && item.m >= 0 && item.m <= item.l && item.l < item.n;
+    CHECK(m_positive);
+
+    auto done = [](const GalleryItem &item) { return item.n == 3 && item.l == 2; };
+    std::vector<const GalleryItem *> pending = GalleryPlan::schedule(items, done);
+    CHECK(pending.size() == items.size() - 3 * 2 * 2);
+    bool ordered = true, skipped = true;
+    for (size_t i=0; i<pending.size(); i++) {
+        skipped = skipped && !done(*pending[i]);
+        if (i > 0)
+            ordered = ordered && (pending[i-1]->n > pending[i]->n || (pending[i-1]->n == pending[i]->n && pending[i-1]->l >= pending[i]->l));
+    }
+    CHECK(skipped && ordered);
+    CHECK(pending[0]->n == 3 && pending[0]->l == 1 && pending.back()->n == 1);
+
+    std::string manifest = GalleryPlan::manifest(items, done);
+    CHECK(manifest.compare(0, 21, "n,l,m,mode,view,file\n") == 0);
+    CHECK(manifest.find("3,2,1,density,slice,n3-l2-m1-density-slice.png\n") != std::string::npos);
+    CHECK(manifest.find("n3-l1") == std::string::npos);
+    int lines = 0;
+    for (char c : manifest)
+        lines += (c == '\n');
+    CHECK(lines == 1 + 3 * 2 * 2);
+}
@@ -0,0 +1,45 @@
+#include "atommodel.h"
+#include "isosurface.h"
+#include "tests.h"
+
+#include <cmath>
+#include <vector>
+
+
+// Isosurface of field 1 - r^2 / 16 at level 0.75 is the sphere r = 2 with unit radial normals, level for
+// probability takes the largest values, meshes are cached per state and level
+void test_isosurface()
+{
+    const int size = 33;
+    const double radius = 4;
+    std::vector<float> grid((size_t)size * size * size);
+    for (int k=0; k<size; k++)
+        for (int j=0; j<size; j++)
+            for (int i=0; i<size; i++) {
+                double x = -radius + 2 * radius * i / (size - 1), y = -radius + 2 * radius * j / (size - 1), z = -radius + 2 * radius * k / (size - 1);
+                grid[((size_t)k * size + j) * size + i] = 1 - (x*x + y*y + z*z) / (radius * radius);
+            }
+    std::shared_ptr<const Mesh> mesh = IsoSurface::extractGrid(grid.data(), size, radius, 0.75f);
+    CHECK(mesh->triangleCount() > 100 && mesh->positions.size() == mesh->normals.size());
+    double error = 0, normal_error = 0;
+    for (size_t v=0; v+2<mesh->positions.size(); v+=3) {
+        const float *p = &mesh->positions[v], *n = &mesh->normals[v];
+        double r = sqrt(p[0]*p[0] + p[1]*p[1] + p[2]*p[2]);
+        error = fmax(error, fabs(r - 2));
+        normal_error = fmax(normal_error, fabs(fabs(n[0]*p[0] + n[1]*p[1] + n[2]*p[2]) / r - 1));
+    }
+    CHECK(error < 0.05);
+    CHECK(normal_error < 0.05);
+
+    const float values[] = {0.5f, 4, 1, 2, 0.5f};
+    CHECK(IsoSurface::levelForProbability(values, 5, 0.5) == 4 && IsoSurface::levelForProbability(values, 5, 0.6) == 2);
+    CHECK(IsoSurface::levelForProbability(values, 5, 1) == 0.5f);
+
+    AtomModel model;
+    model.set_n(2);
+    model.set_l(1);
+    IsoSurfaceCache cache;
+    std::shared_ptr<const Mesh> a = cache.get(model, IsoLevel(true, 0.9), 32);
+    CHECK(a->triangleCount() > 0 && cache.get(model, IsoLevel(true, 0.9), 32) == a);
+    CHECK(cache.get(model, IsoLevel(true, 0.5), 32) != a);
+}
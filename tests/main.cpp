@@ -0,0 +1,48 @@
+#include "tests.h"
+
+#include <cstdio>
+
+
+static int checks = 0, failures = 0;
+
+
+// Count check, print failed one with its location
+void check(bool ok, const char *text, const char *file, int line)
+{
+    checks++;
+    if (!ok) {
+        failures++;
+        fprintf(stderr, "%s:%d: failed: %s\n", file, line, text);
+    }
+}
+
+
+// Tests of Qt-free core: simulatom-tests, exit status is 1 if any check fails
+int main()
+{
+    test_tone_map();
+    test_volume_model();
+    test_empty_space();
+    test_isosurface();
+    test_electron_cloud();
+    test_frame_cache();
+    test_density_volume();
+    test_revisions();
+    test_canonical_state();
+    test_state_atlas();
+    test_density_pyramid();
+    test_density_octree();
+    test_prefetcher();
+    test_shared_cache();
+    test_cache_accountant();
+    test_gallery();
+    test_volume_exporter();
+    test_mesh_writer();
+    test_bounded_queue();
+    test_camera_path();
+    test_tiled_renderer();
+    test_radial_profile();
+    test_render_protocol();
+    printf("%d checks, %d failed\n", checks, failures);
+    return failures > 0 ? 1 : 0;
+}
@@ -0,0 +1,80 @@
+#include "meshwriter.h"
+#include "tests.h"
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+
+
+// Write mesh to temporary file and read it back
+static std::string mesh_file(const Mesh &mesh, bool vtp)
+{
+    FILE *file = tmpfile();
+    if (file == nullptr)
+        return "";
+    std::string data;
+    if (vtp ? MeshWriter::writeVTP(file, mesh) : MeshWriter::writePLY(file, mesh)) {
+        rewind(file);
+        char buffer[4096];
+        size_t size;
+        while ((size = fread(buffer, 1, sizeof(buffer), file)) > 0)
+            data.append(buffer, size);
+    }
+    fclose(file);
+    return data;
+}
+
+
+// PLY has vertex records with normals after header, then faces of three consecutive vertices. VTK PolyData
+// has points, normals, connectivity and offsets at offsets given by header. Meshes span several chunks
+void test_mesh_writer()
+{
+    Mesh mesh;
+    const int triangles = MeshWriter::CHUNK_VERTICES / 3 + 5, vertices = triangles * 3;
+    for (int i=0; i<vertices * 3; i++) {
+        mesh.positions.push_back(i * 0.5f);
+        mesh.normals.push_back(-i * 0.25f);
+    }
+
+    std::string ply = mesh_file(mesh, false);
+    size_t header = ply.find("end_header\n");
+    CHECK(ply.compare(0, 4, "ply\n") == 0 && header != std::string::npos);
+    CHECK(ply.find("element vertex " + std::to_string(vertices) + "\n") != std::string::npos);
+    CHECK(ply.find("element face " + std::to_string(triangles) + "\n") != std::string::npos);
+    size_t data = header + 11;
+    CHECK(ply.size() == data + (size_t)vertices * 24 + (size_t)triangles * 13);
+    if (ply.size() == data + (size_t)vertices * 24 + (size_t)triangles * 13) {
+        float record[6];
+        memcpy(record, ply.data() + data + 24 * (vertices - 1), sizeof(record));
+        int last = (vertices - 1) * 3;
+        CHECK(record[0] == last * 0.5f && record[2] == (last + 2) * 0.5f && record[3] == -last * 0.25f);
+        const unsigned char *face = (const unsigned char *)ply.data() + data + (size_t)vertices * 24 + (size_t)(triangles - 1) * 13;
+        int32_t index[3];
+        memcpy(index, face + 1, sizeof(index));
+        CHECK(face[0] == 3 && index[0] == vertices - 3 && index[2] == vertices - 1);
+    }
+
+    std::string vtp = mesh_file(mesh, true);
+    const std::string appended = "<AppendedData encoding=\"raw\">\n   _";
+    size_t start = vtp.find(appended);
+    CHECK(start != std::string::npos);
+    if (start == std::string::npos)
+        return;
+    start += appended.size();
+    uint64_t points = (uint64_t)vertices * 12, ints = (uint64_t)vertices * 4, offsets = (uint64_t)triangles * 4;
+    const std::string tail = "\n  </AppendedData>\n</VTKFile>\n";
+    CHECK(vtp.size() == start + 8 + points + 8 + points + 8 + ints + 8 + offsets + tail.size());
+    CHECK(vtp.find("NumberOfPoints=\"" + std::to_string(vertices) + "\" NumberOfPolys=\"" + std::to_string(triangles) + "\"") != std::string::npos);
+    CHECK(vtp.find("Name=\"Normals\" NumberOfComponents=\"3\" format=\"appended\" offset=\"" + std::to_string(8 + points) + "\"") != std::string::npos);
+    if (vtp.size() != start + 8 + points + 8 + points + 8 + ints + 8 + offsets + tail.size())
+        return;
+    uint64_t count;
+    int32_t value;
+    memcpy(&count, vtp.data() + start + 16 + 2 * points, sizeof(count));
+    memcpy(&value, vtp.data() + start + 24 + 2 * points + ints - 4, sizeof(value));
+    CHECK(count == ints && value == vertices - 1);
+    memcpy(&count, vtp.data() + start + 24 + 2 * points + ints, sizeof(count));
+    memcpy(&value, vtp.data() + start + 32 + 2 * points + ints + offsets - 4, sizeof(value));
+    CHECK(count == offsets && value == vertices);
+}
@@ -0,0 +1,59 @@
+#include "framerenderer.h"
+#include "prefetcher.h"
+#include "tests.h"
+
+#include <chrono>
+#include <thread>
+#include <vector>
+
+
+// Neighbours are valid states next to the current one, prefetched frames of all of them appear in cache
+// under keys of neighbours
+void test_prefetcher()
+{
+    std::vector<QuantumState> ground = StatePrefetcher::neighbours(QuantumState(1, 0, 0));
+    CHECK(ground.size() == 1 && ground[0] == QuantumState(2, 0, 0));
+    std::vector<QuantumState> p = StatePrefetcher::neighbours(QuantumState(3, 1, 1));
+    const QuantumState expected[] = {QuantumState(3, 1, 0), QuantumState(3, 2, 1), QuantumState(3, 0, 0), QuantumState(4, 1, 1), QuantumState(2, 1, 1)};
+    CHECK(p.size() == 5);
+    for (size_t i=0; i<p.size() && i<5; i++)
+        CHECK(p[i] == expected[i]);
+
+    FrameCache cache;
+    FrameRenderer renderer;
+    AtomModel model;
+    model.set_n(3);
+    model.set_l(1);
+    model.set_m(-1);
+    std::vector<FrameJob> jobs;
+    jobs.push_back(renderer.job2D(model, 32, 32));
+    jobs.push_back(renderer.adaptiveGraphicJob(model));
+    {
+        StatePrefetcher prefetcher(cache);
+        prefetcher.start(model, jobs);
+        bool done = false;
+        for (int i=0; i<1000 && !done; i++) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+            done = true;
+            for (auto &s : p)
+                for (auto &job : jobs) {
+                    FrameKey key = job.key;
+                    key.setState(s);
+                    done = done && cache.contains(key);
+                }
+        }
+        CHECK(done);
+        CHECK(!cache.contains(jobs[0].key));
+        prefetcher.start(model, jobs);
+        prefetcher.cancel();
+    }
+
+// Prefetched frame is the one computed for the state itself
+    model.set_n(4);
+    FrameKey key = jobs[0].key;
+    key.setState(QuantumState(4, 1, 1));
+    std::shared_ptr<const std::vector<long double>> prefetched = cache.get(key);
+    std::vector<long double> frame(32 * 32);
+    model.model2D(frame.data(), 32, 32);
+    CHECK(prefetched && *prefetched == frame);
+}
@@ -0,0 +1,64 @@
+#include "atommodel.h"
+#include "framerenderer.h"
+#include "radialprofile.h"
+#include "tests.h"
+
+#include <cmath>
+#include <vector>
+
+
+// Radial component: 3s integrates to 1 with nodes at (9 -+ 3 sqrt(3)) / 2 and <r> = 27/2, radial tables of
+// the model agree with the profile, which has its own Laguerre recurrence and normalization.
+// Adaptive graphic has the same nodes and is keyed by n, l and model type only
+void test_radial_profile()
+{
+    RadialProfile profile(3, 0);
+    RadialSummary summary;
+    CHECK(profile.sample(200000, [](const RadialSample *, size_t) { return true; }, summary));
+    CHECK(fabs(summary.total - 1) < 1e-6);
+    CHECK(fabs(summary.mean_radius - 13.5) < 1e-4);
+    CHECK(summary.nodes.size() == 2);
+    if (summary.nodes.size() == 2)
+        CHECK(fabs(summary.nodes[0] - (9 - 3 * sqrt(3.0)) / 2) < 1e-6 && fabs(summary.nodes[1] - (9 + 3 * sqrt(3.0)) / 2) < 1e-6);
+
+    const int states[][2] = {{3, 0}, {4, 1}, {5, 0}, {7, 2}, {10, 0}, {10, 3}};
+    for (auto &s : states) {
+        AtomModel model;
+        model.set_n(s[0]);
+        model.set_l(s[1]);
+        RadialProfile exact(s[0], s[1]);
+        double peak, probability_peak, error = 0;
+        const double *table = model.radialTable(peak, probability_peak);
+        for (int i=0; i<AtomModel::RADIAL_TABLE_SIZE; i++) {
+            double R = exact.value(model.tableRadius() * i / (AtomModel::RADIAL_TABLE_SIZE - 1));
+            error = fmax(error, fabs(table[i] - R * R));
+        }
+        CHECK(error < 1e-9 * peak);
+    }
+
+    AtomModel model;
+    model.set_n(3);
+    model.set_l(1);
+    model.set_m(1);
+    FrameRenderer renderer;
+    FrameJob job = renderer.adaptiveGraphicJob(model);
+    std::vector<long double> p(job.size);
+    job.compute(model, p.data());
+    int count = (int)p[3];
+    CHECK(p[2] == 1 && fabsl(p[4] - 6) < 1e-6);
+    CHECK(count > 100 && count < FrameRenderer::ADAPTIVE_GRAPHIC_POINTS);
+    long double max = 0;
+    for (int i=0; i<count; i++)
+        if (p[FrameRenderer::ADAPTIVE_GRAPHIC_HEADER + i*2] <= model.maxRelativeRadius())
+            max = fmaxl(max, p[FrameRenderer::ADAPTIVE_GRAPHIC_HEADER + i*2 + 1]);
+    CHECK(max == 1);
+
+    model.set_m(0);
+    FrameKey key = renderer.adaptiveGraphicJob(model).key;
+    CHECK(!(key < job.key) && !(job.key < key));
+    key.setState(QuantumState(3, 1, 1));
+    CHECK(!(key < job.key) && !(job.key < key));
+    model.setProbabilityDensityStatus(!model.isProbabilityDensity());
+    key = renderer.adaptiveGraphicJob(model).key;
+    CHECK(key < job.key || job.key < key);
+}
@@ -0,0 +1,74 @@
+#include "renderprotocol.h"
+#include "tests.h"
+
+#include <cmath>
+#include <cstring>
+
+#ifndef _WIN32
+#include <sys/socket.h>
+#endif
+
+
+// Default request is valid, state, camera, size, view and isosurface level out of range are rejected.
+// Reply comes with descriptor of shared frame, which is mapped by receiver
+void test_render_protocol()
+{
+    RenderRequest r = RenderProtocol::request(7);
+    CHECK(r.magic == RenderProtocol::MAGIC && r.version == RenderProtocol::VERSION && r.id == 7);
+    CHECK(RenderProtocol::valid(r));
+
+    auto invalid = [&](void (*change)(RenderRequest &)) {
+        RenderRequest c = r;
+        change(c);
+        return !RenderProtocol::valid(c);
+    };
+    CHECK(invalid([](RenderRequest &c) { c.n = 11; }));
+    CHECK(invalid([](RenderRequest &c) { c.n = 0; }));
+    CHECK(invalid([](RenderRequest &c) { c.n = 2; c.l = 2; }));
+    CHECK(invalid([](RenderRequest &c) { c.n = 3; c.l = 1; c.m = -2; }));
+    CHECK(invalid([](RenderRequest &c) { c.rot_x = NAN; }));
+    CHECK(invalid([](RenderRequest &c) { c.center_y = INFINITY; }));
+    CHECK(invalid([](RenderRequest &c) { c.zoom = 0; }));
+    CHECK(invalid([](RenderRequest &c) { c.width = 1; }));
+    CHECK(invalid([](RenderRequest &c) { c.height = 0; }));
+    CHECK(invalid([](RenderRequest &c) { c.width = RenderProtocol::MAX_SIDE + 1; }));
+    CHECK(invalid([](RenderRequest &c) { c.width = RenderProtocol::MAX_SIDE; c.height = RenderProtocol::MAX_SIDE; }));
+    CHECK(invalid([](RenderRequest &c) { c.iso_level = 0; }));
+    CHECK(invalid([](RenderRequest &c) { c.iso_level = 101; }));
+    CHECK(invalid([](RenderRequest &c) { c.view = RENDER_CLOUD + 1; }));
+    CHECK(invalid([](RenderRequest &c) { c.format = RENDER_QOI + 1; }));
+    CHECK(!invalid([](RenderRequest &c) { c.n = 3; c.l = 2; c.m = -2; c.view = RENDER_CLOUD; c.iso_level = 100; }));
+
+#ifndef _WIN32
+    int sockets[2];
+    CHECK(socketpair(AF_UNIX, SOCK_STREAM, 0, sockets) == 0);
+    const char frame[] = "frame";
+    void *data = nullptr;
+    int fd = RenderProtocol::createShared(sizeof(frame), data);
+    CHECK(fd >= 0 && data != nullptr);
+    memcpy(data, frame, sizeof(frame));
+    RenderProtocol::unmap(data, sizeof(frame));
+
+    RenderReply reply = {RenderProtocol::MAGIC, 7, RENDER_OK, RENDER_PIXELS, 2, 1, 1, 0, sizeof(frame)};
+    CHECK(RenderProtocol::send(sockets[0], &reply, sizeof(reply), fd));
+    RenderProtocol::close(fd);
+    RenderReply received;
+    int received_fd = -1;
+    CHECK(RenderProtocol::receive(sockets[1], &received, sizeof(received), &received_fd));
+    CHECK(received.id == 7 && received.status == RENDER_OK && received.size == sizeof(frame) && received_fd >= 0);
+    const void *mapped = RenderProtocol::mapShared(received_fd, received.size);
+    CHECK(mapped != nullptr && memcmp(mapped, frame, sizeof(frame)) == 0);
+    RenderProtocol::unmap(mapped, received.size);
+    RenderProtocol::close(received_fd);
+
+// Reply without frame has no descriptor, closed connection fails receive
+    reply.status = RENDER_INVALID;
+    reply.size = 0;
+    CHECK(RenderProtocol::send(sockets[0], &reply, sizeof(reply)));
+    CHECK(RenderProtocol::receive(sockets[1], &received, sizeof(received), &received_fd));
+    CHECK(received.status == RENDER_INVALID && received_fd == -1);
+    RenderProtocol::close(sockets[0]);
+    CHECK(!RenderProtocol::receive(sockets[1], &received, sizeof(received), &received_fd));
+    RenderProtocol::close(sockets[1]);
+#endif
+}
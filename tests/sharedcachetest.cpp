@@ -0,0 +1,77 @@
+#include "sharedcache.h"
+#include "tests.h"
+
+#include <cstring>
+#include <string>
+#include <vector>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+
+// Shared cache: stored entries are found by other instances, pinned entries survive eviction,
+// least recently used ones are evicted, entries larger than the segment are refused.
+// Default segment is private to the user, segment accessible to others is rejected with reason
+void test_shared_cache()
+{
+#ifdef _WIN32
+    SharedCache unavailable;
+    CHECK(!unavailable.open("/simulatom-tests"));
+#else
+    std::string name = "/simulatom-tests-" + std::to_string(getpid());
+    SharedCache::remove(name);
+    SharedCache cache, other;
+    CHECK(cache.open(name, 4 * SharedCache::PAGE_SIZE));
+    CHECK(other.open(name, 4 * SharedCache::PAGE_SIZE));
+    if (!cache.isOpen() || !other.isOpen())
+        return;
+
+    std::vector<unsigned char> data(SharedCache::PAGE_SIZE);
+    for (size_t i=0; i<data.size(); i++)
+        data[i] = (unsigned char)(i * 7);
+    size_t size = 0;
+    CHECK(!cache.get("a", 1, size));
+    CHECK(cache.put("a", 1, data.data(), 100));
+    std::shared_ptr<const void> a = other.get("a", 1, size);
+    CHECK(a && size == 100 && memcmp(a.get(), data.data(), 100) == 0);
+    CHECK(other.contains("a", 1) && !other.contains("ab", 2));
+
+// Segment holds 4 pages: "a" is pinned, "b" is the least recently used of the others
+    CHECK(cache.put("b", 1, data.data(), data.size()));
+    CHECK(cache.put("c", 1, data.data(), data.size()));
+    CHECK(cache.put("d", 1, data.data(), data.size()));
+    CHECK(cache.get("c", 1, size) && cache.get("d", 1, size));
+    CHECK(cache.put("e", 1, data.data(), data.size()));
+    CHECK(cache.contains("a", 1) && !cache.contains("b", 1) && cache.contains("e", 1));
+    std::shared_ptr<const void> e = cache.get("e", 1, size);
+    CHECK(e && size == data.size() && memcmp(e.get(), data.data(), size) == 0);
+
+// Unpinned entry can be evicted, entry over capacity or with long key is refused
+    a.reset();
+    CHECK(cache.put("f", 1, data.data(), data.size()));
+    CHECK(!cache.contains("a", 1));
+    std::vector<unsigned char> large(5 * SharedCache::PAGE_SIZE);
+    CHECK(!cache.put("g", 1, large.data(), large.size()));
+    std::string long_key(SharedCache::MAX_KEY_SIZE + 1, 'k');
+    CHECK(!cache.put(long_key.data(), long_key.size(), data.data(), 1));
+
+    SharedCacheStats stats = other.stats();
+    CHECK(stats.entries == 4 && stats.evictions == 2 && stats.stores == 6 && stats.capacity == 4 * SharedCache::PAGE_SIZE);
+    CHECK(SharedCache::remove(name));
+
+    CHECK(SharedCache::defaultName() == std::string(SharedCache::DEFAULT_NAME) + "-" + std::to_string(geteuid()));
+    int fd = shm_open(name.c_str(), O_RDWR | O_CREAT | O_EXCL, 0600);
+    CHECK(fd >= 0);
+    if (fd >= 0) {
+        fchmod(fd, 0660);
+        close(fd);
+        SharedCache shared;
+        CHECK(!shared.open(name, 4 * SharedCache::PAGE_SIZE) && !shared.getError().empty());
+        CHECK(SharedCache::remove(name));
+    }
+#endif
+}
@@ -0,0 +1,12 @@
+#include "stateatlas.h"
+#include "tests.h"
+
+
+// CRC-32 of atlas blocks: check value of the standard, continuation of checksum
+void test_state_atlas()
+{
+    const char *text = "123456789";
+    CHECK(StateAtlas::checksum(text, 9) == 0xCBF43926u);
+    CHECK(StateAtlas::checksum(text, 0) == 0);
+    CHECK(StateAtlas::checksum(text + 4, 5, StateAtlas::checksum(text, 4)) == 0xCBF43926u);
+}
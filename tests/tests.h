@@ -0,0 +1,36 @@
+#ifndef TESTS_H
+#define TESTS_H
+
+
+// Count check, print failed one with its location
+#define CHECK(condition) check((condition), #condition, __FILE__, __LINE__)
+
+void check(bool ok, const char *text, const char *file, int line);
+
+// Tests of core modules
+void test_tone_map();
+void test_volume_model();
+void test_empty_space();
+void test_isosurface();
+void test_electron_cloud();
+void test_frame_cache();
+void test_density_volume();
+void test_revisions();
+void test_canonical_state();
+void test_state_atlas();
+void test_density_pyramid();
+void test_density_octree();
+void test_prefetcher();
+void test_shared_cache();
+void test_cache_accountant();
+void test_gallery();
+void test_volume_exporter();
+void test_mesh_writer();
+void test_bounded_queue();
+void test_camera_path();
+void test_tiled_renderer();
+void test_radial_profile();
+void test_render_protocol();
+
+
+#endif // TESTS_H
@@ -0,0 +1,36 @@
+# Tests of Qt-free core: simulatom-tests, exit status is 1 if any check fails
+TEMPLATE = app
+TARGET = simulatom-tests
+
+CONFIG += c++11 console thread
+CONFIG -= qt app_bundle
+
+include(../core/core.pri)
+
+HEADERS += \
+    tests.h
+
+SOURCES += \
+    atommodeltest.cpp \
+    boundedqueuetest.cpp \
+    cacheaccountanttest.cpp \
+    camerapathtest.cpp \
+    densityoctreetest.cpp \
+    densitypyramidtest.cpp \
+    densityvolumetest.cpp \
+    electroncloudtest.cpp \
+    emptyspacetest.cpp \
+    framecachetest.cpp \
+    galleryplantest.cpp \
+    isosurfacetest.cpp \
+    main.cpp \
+    meshwritertest.cpp \
+    prefetchertest.cpp \
+    radialprofiletest.cpp \
+    renderprotocoltest.cpp \
+    sharedcachetest.cpp \
+    stateatlastest.cpp \
+    tiledrenderertest.cpp \
+    tonemaptest.cpp \
+    volumeexportertest.cpp \
+    volumemodeltest.cpp
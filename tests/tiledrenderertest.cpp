@@ -0,0 +1,67 @@
+#include "tiledrenderer.h"
+#include "tests.h"
+
+#include <vector>
+
+
+// Read little endian value of TIFF header
+static unsigned long long tiff_value(const std::vector<unsigned char> &header, size_t offset, int bytes)
+{
+    unsigned long long v = 0;
+    for (int i=bytes-1; i>=0; i--)
+        v = (v << 8) | header[offset + i];
+    return v;
+}
+
+
+// Find entry of tag in TIFF or BigTIFF directory, return offset of its count field, 0 if it is missing
+static size_t tiff_entry(const std::vector<unsigned char> &header, bool big, int tag)
+{
+    size_t ifd = tiff_value(header, big ? 8 : 4, big ? 8 : 4);
+    unsigned long long count = tiff_value(header, ifd, big ? 8 : 2);
+    size_t entry = ifd + (big ? 8 : 2);
+    for (unsigned long long i=0; i<count; i++, entry += big ? 20 : 12)
+        if ((int)tiff_value(header, entry, 2) == tag)
+            return entry + 4;
+    return 0;
+}
+
+
+// Headers of tiled TIFF and BigTIFF: image and tile sizes, tile offsets and byte counts
+void test_tiled_renderer()
+{
+    AtomModel model;
+    TiledRenderer renderer(model, 600, 300);
+    const size_t tile_bytes = (size_t)TiledRenderer::TILE_SIZE * TiledRenderer::TILE_SIZE * 3;
+    for (int big=0; big<2; big++) {
+        std::vector<unsigned char> header;
+        size_t data_offset = big ? ((size_t)5 << 30) : 4096;
+        renderer.tiffHeader(big, data_offset, header);
+        int bytes = big ? 8 : 4;
+        CHECK(header.size() > 16 && header[0] == 'I' && header[1] == 'I');
+        CHECK(tiff_value(header, 2, 2) == (big ? 43u : 42u));
+        if (big)
+            CHECK(tiff_value(header, 4, 2) == 8 && tiff_value(header, 6, 2) == 0);
+
+        size_t width = tiff_entry(header, big, 256), height = tiff_entry(header, big, 257), tile = tiff_entry(header, big, 322);
+        CHECK(width != 0 && tiff_value(header, width + bytes, 4) == 600);
+        CHECK(height != 0 && tiff_value(header, height + bytes, 4) == 300);
+        CHECK(tile != 0 && tiff_value(header, tile + bytes, 4) == (unsigned)TiledRenderer::TILE_SIZE);
+
+    // 3 x 2 tiles, offsets and counts don't fit in entries and follow directory
+        size_t offsets = tiff_entry(header, big, 324), counts = tiff_entry(header, big, 325);
+        CHECK(offsets != 0 && counts != 0);
+        if (offsets == 0 || counts == 0)
+            continue;
+        CHECK(tiff_value(header, offsets - 2, 2) == (big ? 16u : 4u));
+        CHECK(tiff_value(header, offsets, bytes) == 6 && tiff_value(header, counts, bytes) == 6);
+        size_t offsets_at = tiff_value(header, offsets + bytes, bytes), counts_at = tiff_value(header, counts + bytes, bytes);
+        CHECK(offsets_at + 6 * bytes <= header.size() && counts_at + 6 * bytes <= header.size());
+        if (offsets_at + 6 * bytes > header.size() || counts_at + 6 * bytes > header.size())
+            continue;
+        for (int t=0; t<6; t++) {
+            CHECK(tiff_value(header, offsets_at + t * bytes, bytes) == data_offset + t * tile_bytes);
+            CHECK(tiff_value(header, counts_at + t * bytes, bytes) == tile_bytes);
+        }
+    }
+}
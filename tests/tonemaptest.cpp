@@ -0,0 +1,52 @@
+#include "tonemap.h"
+#include "tests.h"
+
+#include <cmath>
+
+
+// Histogram percentiles are within one bin (1/16 of octave) above exact ones, merged histograms add up.
+// Tone curves map 0..1 to 0..1, color table spans black to given color
+void test_tone_map()
+{
+    DensityHistogram hist, other;
+    for (int i=1; i<=500; i++)
+        hist.add(i);
+    for (int i=501; i<=1000; i++)
+        other.add(i);
+    other.add(0);
+    hist.merge(other);
+    CHECK(hist.count() == 1001 && hist.maximum() == 1000);
+    CHECK(hist.percentile(1) == 1000);
+    long double median = hist.percentile(0.5l);
+    CHECK(median >= 500 && median <= 500 * (1 + 1.0l / 16));
+    long double p99 = hist.percentile(0.99l);
+    CHECK(p99 >= 990 && p99 <= 1000);
+
+// Percentile of mostly empty image is zero, clip level falls back to maximum
+    DensityHistogram empty;
+    for (int i=0; i<99; i++)
+        empty.add(0);
+    empty.add(0.25l);
+    CHECK(empty.percentile(0.5l) == 0);
+    ToneMap tm;
+    CHECK(tm.setClipPercentile(50));
+    CHECK(tm.clipLevel(empty) == 0.25l);
+    CHECK(tm.clipLevel(hist) == median);
+    CHECK(!tm.setClipPercentile(0) && !tm.setClipPercentile(101) && !tm.setGamma(0) && !tm.setDecades(-1));
+
+    CHECK(tm.apply(-1) == 0 && tm.apply(0.5l) == 0.5l && tm.apply(2) == 1);
+    tm.setCurve(TONE_LOG);
+    CHECK(tm.setDecades(4));
+    CHECK(tm.apply(1) == 1 && fabsl(tm.apply(0.01l) - 0.5l) < 1e-12 && tm.apply(1e-5l) == 0);
+    tm.setCurve(TONE_GAMMA);
+    CHECK(tm.setGamma(2));
+    CHECK(fabsl(tm.apply(0.25l) - 0.5l) < 1e-12);
+
+    unsigned int table[256];
+    tm.buildColorTable(table, 256, 0xFF, 0x80, 0);
+    CHECK(table[0] == 0 && table[255] == 0xFF8000);
+    bool increasing = true;
+    for (int i=1; i<256; i++)
+        increasing = increasing && (table[i] >> 16) >= (table[i-1] >> 16);
+    CHECK(increasing);
+}
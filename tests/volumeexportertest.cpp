@@ -0,0 +1,96 @@
+#include "atommodel.h"
+#include "volumeexporter.h"
+#include "tests.h"
+
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <string>
+
+
+// Write volume to temporary file and read it back
+static std::string volume_file(VolumeExporter &exporter, VolumeFormat format)
+{
+    FILE *file = tmpfile();
+    if (file == nullptr)
+        return "";
+    std::string data;
+    if (exporter.write(file, format)) {
+        rewind(file);
+        char buffer[4096];
+        size_t size;
+        while ((size = fread(buffer, 1, sizeof(buffer), file)) > 0)
+            data.append(buffer, size);
+    }
+    fclose(file);
+    return data;
+}
+
+
+// Half precision: exact values, rounding to nearest even, overflow, subnormals, infinity and NaN
+void test_volume_exporter()
+{
+    CHECK(VolumeExporter::toHalf(0.0f) == 0x0000);
+    CHECK(VolumeExporter::toHalf(-0.0f) == 0x8000);
+    CHECK(VolumeExporter::toHalf(1.0f) == 0x3C00);
+    CHECK(VolumeExporter::toHalf(-2.0f) == 0xC000);
+    CHECK(VolumeExporter::toHalf(65504.0f) == 0x7BFF);
+    CHECK(VolumeExporter::toHalf(ldexpf(1, -14)) == 0x0400);
+
+// Halfway between two halves goes to the even one, above halfway goes up
+    CHECK(VolumeExporter::toHalf(1 + ldexpf(1, -11)) == 0x3C00);
+    CHECK(VolumeExporter::toHalf(1 + 3 * ldexpf(1, -11)) == 0x3C02);
+    CHECK(VolumeExporter::toHalf(1 + ldexpf(1, -11) + ldexpf(1, -20)) == 0x3C01);
+    CHECK(VolumeExporter::toHalf(65519.0f) == 0x7BFF);
+    CHECK(VolumeExporter::toHalf(65520.0f) == 0x7C00);
+    CHECK(VolumeExporter::toHalf(1e10f) == 0x7C00);
+
+// Subnormals: the smallest one, ties to even, and rounding which carries into exponent
+    CHECK(VolumeExporter::toHalf(ldexpf(1, -24)) == 0x0001);
+    CHECK(VolumeExporter::toHalf(ldexpf(1, -25)) == 0x0000);
+    CHECK(VolumeExporter::toHalf(ldexpf(3, -25)) == 0x0002);
+    CHECK(VolumeExporter::toHalf(ldexpf(1, -26)) == 0x0000);
+    CHECK(VolumeExporter::toHalf(-ldexpf(1, -24)) == 0x8001);
+    CHECK(VolumeExporter::toHalf(ldexpf(1023, -24)) == 0x03FF);
+    CHECK(VolumeExporter::toHalf(ldexpf(2047, -25)) == 0x0400);
+
+    CHECK(VolumeExporter::toHalf(INFINITY) == 0x7C00);
+    CHECK(VolumeExporter::toHalf(-INFINITY) == 0xFC00);
+    uint16_t nan = VolumeExporter::toHalf(NAN);
+    CHECK((nan & 0x7C00) == 0x7C00 && (nan & 0x03FF) != 0);
+
+// NRRD header ends with empty line before samples, VTK appended data starts with byte count after '_'.
+// Samples of both are the ones of raw file
+    AtomModel model;
+    VolumeGrid grid(9, 4);
+    VolumeExporter exporter(model, grid);
+    size_t bytes = 9 * 9 * 9 * sizeof(float);
+    CHECK(exporter.volumeSize() == bytes);
+    std::string raw = volume_file(exporter, VOLUME_RAW), nrrd = volume_file(exporter, VOLUME_NRRD), vti = volume_file(exporter, VOLUME_VTI);
+    CHECK(raw.size() == bytes);
+    float center;
+    memcpy(&center, raw.data() + (raw.size() / 2 & ~(size_t)3), sizeof(center));
+    CHECK(fabs(center - 1) < 1e-6);
+
+    size_t header = nrrd.find("\n\n");
+    CHECK(nrrd.compare(0, 9, "NRRD0004\n") == 0 && header != std::string::npos);
+    CHECK(nrrd.find("sizes: 9 9 9\n") != std::string::npos && nrrd.find("type: float\n") != std::string::npos);
+    CHECK(nrrd.find("space origin: (-4,-4,-4)\n") != std::string::npos && nrrd.find("(1,0,0)") != std::string::npos);
+    CHECK(header != std::string::npos && nrrd.size() == header + 2 + bytes && nrrd.compare(header + 2, bytes, raw) == 0);
+
+    const std::string appended = "<AppendedData encoding=\"raw\">\n   _";
+    size_t data = vti.find(appended);
+    if (data != std::string::npos)
+        data += appended.size() - 1;
+    CHECK(vti.compare(0, 21, "<?xml version=\"1.0\"?>") == 0 && data != std::string::npos);
+    CHECK(vti.find("WholeExtent=\"0 8 0 8 0 8\" Origin=\"-4 -4 -4\" Spacing=\"1 1 1\"") != std::string::npos);
+    const std::string tail = "\n  </AppendedData>\n</VTKFile>\n";
+    CHECK(data != std::string::npos && vti.size() == data + 1 + 8 + bytes + tail.size());
+    if (data != std::string::npos && vti.size() == data + 1 + 8 + bytes + tail.size()) {
+        uint64_t count;
+        memcpy(&count, vti.data() + data + 1, sizeof(count));
+        CHECK(count == bytes && vti.compare(data + 9, bytes, raw) == 0 && vti.compare(vti.size() - tail.size(), tail.size(), tail) == 0);
+    }
+    VolumeExporter half(model, grid, SAMPLE_FLOAT16);
+    CHECK(half.volumeSize() == bytes / 2 && volume_file(half, VOLUME_NRRD).empty());
+}
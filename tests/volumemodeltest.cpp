@@ -0,0 +1,36 @@
+#include "atommodel.h"
+#include "tests.h"
+
+#include <cmath>
+#include <vector>
+
+
+// Volume rays accumulate finite values in [0, 1] for any opacity, rays missing the bounding sphere are black,
+// and a spherical state gives the same image from any direction
+void test_volume_model()
+{
+    AtomModel model;
+    model.set_n(2);
+    CHECK(!model.setVolumeOpacity(0) && !model.setVolumeOpacity(-1));
+    const int size = 64;
+    std::vector<long double> thin(size * size), opaque(size * size), rotated(size * size);
+    CHECK(model.setVolumeOpacity(0.01l));
+    model.modelVolume(thin.data(), size, size, 0, 0, 0, 0);
+    CHECK(model.setVolumeOpacity(1e6l));
+    model.modelVolume(opaque.data(), size, size, 0, 0, 0, 0);
+    model.modelVolume(rotated.data(), size, size, 0, 0, 1, 2);
+
+    bool bounded = true;
+    long double max = 0, difference = 0;
+    for (int i=0; i<size*size; i++) {
+        bounded = bounded && std::isfinite((double)thin[i]) && std::isfinite((double)opaque[i]) &&
+                  thin[i] >= 0 && opaque[i] >= 0 && thin[i] <= 1 && opaque[i] <= 1;
+        max = fmaxl(max, opaque[i]);
+        difference = fmaxl(difference, fabsl(opaque[i] - rotated[i]));
+    }
+    CHECK(bounded);
+    CHECK(max > 0.5l);
+    CHECK(difference < 0.05l);
+    CHECK(opaque[size/2 * size + size/2] > 0 && thin[size/2 * size + size/2] > 0);
+    CHECK(opaque[0] == 0 && thin[0] == 0);
+}